@@ -31,6 +31,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
     
 #include <stdbool.h>
+#include <string.h>
 #include "radio_driver_hal.h"
 #include "sys.h"
 #include "conf_pmm.h"
@@ -38,6 +39,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "pmm.h"
 #endif
 #include "conf_radio.h"
+#include "radio_registers_SX1276.h"
 
 /******************************************************************************/
 /*  Defines                                                                   */
@@ -225,6 +227,14 @@ static void HAL_ResetPinOutputValue(uint8_t value);
  */
 static uint8_t HAL_SPISend(uint8_t data);
 
+/*
+ * \brief This function is used to transfer a stream of bytes in a single SPI burst
+ * \param[in] txData Data to be written, NULL to send dummy bytes
+ * \param[out] rxData Buffer for the data read, NULL to discard it
+ * \param[in] length Number of bytes to be transferred
+ */
+static void HAL_SPIBurst(const uint8_t *txData, uint8_t *rxData, uint8_t length);
+
 /*
  * \brief This function is called to select a SPI slave
  */
@@ -235,9 +245,36 @@ static void HAL_SPICSAssert(void);
  */
 static void HAL_SPICSDeassert(void);
 
+/*
+ * \brief This function checks if a register is held in the shadow
+ * \param[in] reg Radio register
+ * \retval true if the register only changes when it is written
+ */
+static bool RADIO_ShadowIsCached(uint8_t reg);
+
 /***************************************** GLOBALS ***************************/
 static uint8_t dioStatus;	
 
+/* Registers that only change when written, in both modems:
+ * FRF, PACONFIG, PARAMP, OCP, DIOMAPPING1/2, TCXO and PADAC */
+static const uint32_t shadowCommonMask[RADIO_SHADOW_WORDS] = {
+	0x00000FC0, 0x00000000, 0x00002803, 0x00000000
+};
+
+/* Registers of the LoRa modem that only change when written: FIFO base
+ * addresses, IRQFLAGSMASK, MODEMCONFIG1/2/3, SYMBTIMEOUTLSB, preamble,
+ * payload lengths, HOPPERIOD, DETECTOPTIMIZE, INVERTIQ, DETECTIONTHRESHOLD,
+ * sync word and the errata registers 0x2F, 0x30, 0x36, 0x3A and 0x3B */
+static const uint32_t shadowLoraMask[RADIO_SHADOW_WORDS] = {
+	0xE002C000, 0x0ECB805F, 0x00000000, 0x00000000
+};
+
+/* RAM copy of the radio registers, a register is used once its bit is valid */
+static uint8_t regShadow[RADIO_SHADOW_WORDS * 32];
+static uint32_t regShadowValid[RADIO_SHADOW_WORDS];
+/* The LoRa registers share their addresses with the FSK ones */
+static bool regShadowLora;
+
 /*********************************** Implementation***************************/
 /*
  * \brief These functions are temporarily placed here 
@@ -303,6 +340,7 @@ void HAL_RadioInit(void)
 {
 	HAL_RadioIOInit();
 	HAL_RadioSpiInit();
+	RADIO_ShadowInvalidate();
 }
 /**
  * \brief This function is used to initialize the SPI Interface after PMM wakeup
@@ -314,6 +352,8 @@ void HAL_Radio_resources_init(void)
 	while (SERCOM4_REGS->SPIM.SERCOM_SYNCBUSY) {
 		/* Wait until the synchronization is complete */
 	}
+	/* The radio may have lost its registers while the MCU was sleeping */
+	RADIO_ShadowInvalidate();
 }
 /**
  * \brief This function is used to deinitialize the SPI Interface
@@ -339,6 +379,7 @@ void RADIO_Reset(void)
     delay_ms(5);
     /* Make sure this pin is not floating */
     HAL_ResetPinOutputValue(1);
+    RADIO_ShadowInvalidate();
 }
 
 /** 
@@ -348,6 +389,22 @@ void RADIO_Reset(void)
  */
 void RADIO_RegisterWrite(uint8_t reg, uint8_t value)
 {
+	if (RADIO_ShadowIsCached(reg))
+	{
+		if ((regShadowValid[reg / 32] & (1UL << (reg % 32))) && (regShadow[reg] == value))
+		{
+			return;
+		}
+		regShadow[reg] = value;
+		regShadowValid[reg / 32] |= (1UL << (reg % 32));
+	}
+	else if ((REG_OPMODE == reg) && (regShadowLora != ((value & 0x80) != 0)))
+	{
+		/* Switching the modem maps other registers at the same addresses */
+		RADIO_ShadowInvalidate();
+		regShadowLora = ((value & 0x80) != 0);
+	}
+
 	HAL_SPICSAssert();
 	HAL_SPISend(REG_WRITE_CMD | reg);
 	HAL_SPISend(value);
@@ -363,13 +420,102 @@ uint8_t RADIO_RegisterRead(uint8_t reg)
 {
 	uint8_t readValue;
 	reg &= 0x7F;    // Make sure write bit is not set
+
+	/* Read-modify-writes of the configuration are served from the shadow */
+	if (RADIO_ShadowIsCached(reg) && (regShadowValid[reg / 32] & (1UL << (reg % 32))))
+	{
+		return regShadow[reg];
+	}
+
 	HAL_SPICSAssert();
 	HAL_SPISend(reg);
 	readValue = HAL_SPISend(0xFF);
 	HAL_SPICSDeassert();
+
+	if (RADIO_ShadowIsCached(reg))
+	{
+		regShadow[reg] = readValue;
+		regShadowValid[reg / 32] |= (1UL << (reg % 32));
+	}
+	else if ((REG_OPMODE == reg) && (regShadowLora != ((readValue & 0x80) != 0)))
+	{
+		RADIO_ShadowInvalidate();
+		regShadowLora = ((readValue & 0x80) != 0);
+	}
+
 	return readValue;
 }
 
+/** 
+ * \brief This function is used to write consecutive radio registers. The
+ * leading registers whose shadow already holds the value are skipped, the
+ * others are written in a single SPI burst. The last register is written
+ * whenever any is, as settings like the frequency take effect on it
+ * \param[in] reg First radio register to be written
+ * \param[in] values Values to be written into the radio registers
+ * \param[in] length Number of registers to be written
+ */
+void RADIO_RegisterBurstWrite(uint8_t reg, const uint8_t *values, uint8_t length)
+{
+	uint8_t first = 0;
+	uint8_t addr;
+
+	while ((first < length) && RADIO_ShadowIsCached(reg + first) &&
+		(regShadowValid[(reg + first) / 32] & (1UL << ((reg + first) % 32))) &&
+		(regShadow[reg + first] == values[first]))
+	{
+		first++;
+	}
+	if (first == length)
+	{
+		return;
+	}
+
+	for (uint8_t i = first; i < length; i++)
+	{
+		addr = reg + i;
+		if (RADIO_ShadowIsCached(addr))
+		{
+			regShadow[addr] = values[i];
+			regShadowValid[addr / 32] |= (1UL << (addr % 32));
+		}
+	}
+
+	HAL_SPICSAssert();
+	HAL_SPISend(REG_WRITE_CMD | (reg + first));
+	HAL_SPIBurst(&values[first], NULL, length - first);
+	HAL_SPICSDeassert();
+}
+
+/** 
+ * \brief This function forgets the shadow of the radio registers, so that
+ * they are read from and written to the radio again
+ */
+void RADIO_ShadowInvalidate(void)
+{
+	memset(regShadowValid, 0, sizeof(regShadowValid));
+	/* The radio comes out of reset in FSK mode, so the LoRa registers are
+	 * only cached once the LoRa mode is seen */
+	regShadowLora = false;
+}
+
+/*
+ * \brief This function checks if a register is held in the shadow
+ * \param[in] reg Radio register
+ * \retval true if the register only changes when it is written
+ */
+static bool RADIO_ShadowIsCached(uint8_t reg)
+{
+	uint32_t mask = shadowCommonMask[reg / 32];
+
+	if (regShadowLora)
+	{
+		mask |= shadowLoraMask[reg / 32];
+	}
+
+	return ((mask & (1UL << (reg % 32))) != 0);
+}
+
 /** 
  * \brief This function is used to  write a stream of data into the Radio Frame buffer
  * \param[in] FIFO offset to be written to
@@ -380,11 +526,7 @@ void RADIO_FrameWrite(uint8_t offset, uint8_t* buffer, uint8_t bufferLen)
 {
     HAL_SPICSAssert();
     HAL_SPISend(REG_WRITE_CMD | offset);
-
-    for (uint8_t i = 0; i < bufferLen; i++)
-    {
-	    HAL_SPISend(buffer[i]);
-    }
+    HAL_SPIBurst(buffer, NULL, bufferLen);
     HAL_SPICSDeassert();
 
 }
@@ -399,10 +541,7 @@ void RADIO_FrameRead(uint8_t offset, uint8_t* buffer, uint8_t bufferLen)
 {
     HAL_SPICSAssert();
     HAL_SPISend(offset);
-    for (uint8_t i = 0; i < bufferLen; i++)
-    {
-	    buffer[i] = HAL_SPISend(0xFF);
-    }
+    HAL_SPIBurst(NULL, buffer, bufferLen);
     HAL_SPICSDeassert();
 }
 
@@ -800,6 +939,55 @@ static uint8_t HAL_SPISend(uint8_t data)
 	return ((uint8_t)read_val);
 }
 
+/*
+ * \brief This function is used to transfer a stream of bytes in a single SPI burst.
+ * The SERCOM registers are polled directly so that the next byte is loaded
+ * while the previous one is shifted out, instead of setting up a transfer per byte
+ * \param[in] txData Data to be written, NULL to send dummy bytes
+ * \param[out] rxData Buffer for the data read, NULL to discard it
+ * \param[in] length Number of bytes to be transferred
+ */
+static void HAL_SPIBurst(const uint8_t *txData, uint8_t *rxData, uint8_t length)
+{
+	uint8_t txCount = 0;
+	uint8_t rxCount = 0;
+	uint8_t rxByte;
+
+	/* Flush out any unread data from the previous transfer */
+	while (SERCOM4_REGS->SPIM.SERCOM_INTFLAG & SERCOM_SPIM_INTFLAG_RXC_Msk)
+	{
+		rxByte = SERCOM4_REGS->SPIM.SERCOM_DATA;
+	}
+	SERCOM4_REGS->SPIM.SERCOM_STATUS |= (uint16_t)SERCOM_SPIM_STATUS_BUFOVF_Msk;
+	SERCOM4_REGS->SPIM.SERCOM_INTFLAG |= (uint8_t)SERCOM_SPIM_INTFLAG_ERROR_Msk;
+
+	while (rxCount < length)
+	{
+		/* At most two bytes are in flight, so the receiver never overflows */
+		if ((txCount < length) && ((uint8_t)(txCount - rxCount) < 2) &&
+			(SERCOM4_REGS->SPIM.SERCOM_INTFLAG & SERCOM_SPIM_INTFLAG_DRE_Msk))
+		{
+			SERCOM4_REGS->SPIM.SERCOM_DATA = (NULL != txData) ? txData[txCount] : 0xFF;
+			txCount++;
+		}
+
+		if (SERCOM4_REGS->SPIM.SERCOM_INTFLAG & SERCOM_SPIM_INTFLAG_RXC_Msk)
+		{
+			rxByte = SERCOM4_REGS->SPIM.SERCOM_DATA;
+			if (NULL != rxData)
+			{
+				rxData[rxCount] = rxByte;
+			}
+			rxCount++;
+		}
+	}
+
+	/* Make sure no data is pending in the shift register */
+	while ((SERCOM4_REGS->SPIM.SERCOM_INTFLAG & SERCOM_SPIM_INTFLAG_TXC_Msk) == 0)
+	{
+	}
+}
+
 /**
  * \brief This function sets the interrupt handler for given DIO interrupt
  *
@@ -927,7 +1115,9 @@ RadioClockSources_t HAL_GetRadioClkSrc(void)
 }
 
 /**
- * \brief This function Powering up the TCXO oscillator
+ * \brief This function Powering up the TCXO oscillator. The oscillator is
+ *        stable after HAL_GetRadioClkStabilizationDelay, the radio layer
+ *        waits for it.
  *
  * \param[in] None
  * \param[out] None
@@ -935,7 +1125,6 @@ RadioClockSources_t HAL_GetRadioClkSrc(void)
 void HAL_TCXOPowerOn(void)
 {
 #ifdef TCXO_ENABLE
-	delay_ms(RADIO_CLK_STABILITATION_DELAY);
     TCXO_PWR_PIN_Set();
 #endif
 }
@@ -52,6 +52,9 @@ extern "C" {
 #define REG_FIFO_ADDRESS	  0
 #define REG_WRITE_CMD        0x80
 
+/* 32 bit words of the radio register shadow, one bit per register */
+#define RADIO_SHADOW_WORDS	  4
+
 /***************************************** TYPES ******************************/
 typedef void (*DioInterruptHandler_t)(void);
 
@@ -112,6 +115,23 @@ void RADIO_RegisterWrite(uint8_t reg, uint8_t value);
  */
 uint8_t RADIO_RegisterRead(uint8_t reg);
 
+/** 
+ * \brief This function is used to write consecutive radio registers. The
+ * leading registers whose shadow already holds the value are skipped, the
+ * others are written in a single SPI burst. The last register is written
+ * whenever any is, as settings like the frequency take effect on it
+ * \param[in] reg First radio register to be written
+ * \param[in] values Values to be written into the radio registers
+ * \param[in] length Number of registers to be written
+ */
+void RADIO_RegisterBurstWrite(uint8_t reg, const uint8_t *values, uint8_t length);
+
+/** 
+ * \brief This function forgets the shadow of the radio registers, so that
+ * they are read from and written to the radio again
+ */
+void RADIO_ShadowInvalidate(void);
+
 /** 
  * \brief This function is used to  write a stream of data into the Radio Frame buffer
  * \param[in] FIFO offset to be written to
@@ -243,7 +263,9 @@ RadioClockSources_t HAL_GetRadioClkSrc(void);
 uint8_t HAL_GetRadioClkStabilizationDelay(void);
 
 /**
- * \brief This function Powering up the TCXO oscillator
+ * \brief This function Powering up the TCXO oscillator. The oscillator is
+ *        stable after HAL_GetRadioClkStabilizationDelay, the radio layer
+ *        waits for it.
  *
  * \param[in] None
  * \param[out] None
@@ -817,6 +817,42 @@ StackRetStatus_t LORAWAN_SetAttr(LorawanAttributes_t attrType, void *attrValue);
 */
 StackRetStatus_t LORAWAN_GetAttr(LorawanAttributes_t attrType, void *attrInput, void *attrOutput);
 
+/**
+ * @Summary
+    LORAWAN Get Time On Air
+ * @Description
+    This function returns the time on air of an uplink carrying the given application
+    payload at the current data rate, including the LoRaWAN headers, the pending MAC
+    commands and the MIC. It can be used to check the airtime before LORAWAN_Send.
+ * @Preconditions
+    None
+ * @Param
+    length - length of the application payload in bytes
+ * @Returns
+    The time on air in microseconds.
+ * @Example
+ *  uint32_t toa = LORAWAN_GetTimeOnAir(sizeof(appData));
+*/
+uint32_t LORAWAN_GetTimeOnAir(uint8_t length);
+
+/**
+ * @Summary
+    LORAWAN Get Uplink Device Command Count
+ * @Description
+    This function returns the number of commands sent to the secure element (ECC608)
+    by the last completed uplink transaction, from LORAWAN_Send to the transaction
+    complete callback. It shows whether the per-frame crypto still goes over I2C.
+ * @Preconditions
+    None
+ * @Param
+    None
+ * @Returns
+    The number of secure element commands, 0 when no secure element is used.
+ * @Example
+ *  uint32_t cmds = LORAWAN_GetUplinkDeviceCommandCount();
+*/
+uint32_t LORAWAN_GetUplinkDeviceCommandCount(void);
+
 /**
  * @Summary
     LoRaWAN Set Callback Bit mask function.
@@ -59,6 +59,18 @@ extern "C" {
 #define APP_EUI_SLOT                (9)
 #define DEV_EUI_SLOT                (10)
 
+/* Typical execution time (ms) of the ECC608 commands issued by the
+ * asynchronous SAL functions, the response is first polled after it */
+#define SAL_ECC_AES_EXEC_TIME_MS    (27)
+#define SAL_ECC_KDF_EXEC_TIME_MS    (165)
+#define SAL_ECC_RANDOM_EXEC_TIME_MS (23)
+#define SAL_ECC_WRITE_EXEC_TIME_MS  (45)
+#define SAL_ECC_READ_EXEC_TIME_MS   (5)
+#define SAL_ECC_NONCE_EXEC_TIME_MS  (20)
+#define SAL_ECC_GENDIG_EXEC_TIME_MS (25)
+/* Time (ms) after which an unanswered ECC608 command is given up */
+#define SAL_ECC_MAX_EXEC_TIME_MS    (500)
+
 
 //DOM-IGNORE-BEGIN
 #ifdef __cplusplus
@@ -49,7 +49,7 @@ extern "C" {
 // Includes swtimer specific configurations
 //------------------------------------------------------------------------------
 // Maximum number of SW timers
-#define TOTAL_NUMBER_OF_SW_TIMERS   (25)    
+#define TOTAL_NUMBER_OF_SW_TIMERS   (26)    
 
 // Maximum number of SWTimer Timestamps
 #define TOTAL_NUMBER_SW_TIMESTAMPS  (2)
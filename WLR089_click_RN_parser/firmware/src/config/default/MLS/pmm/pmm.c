@@ -51,6 +51,8 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /* Other required headers */
 #include "atomic.h"
 #include "system_task_manager.h"
+#include "pds_interface.h"
+#include "sal.h"
 
 /************************************************************************/
 /*                   Prototypes section                                 */
@@ -98,7 +100,14 @@ PMM_Status_t PMM_Sleep(PMM_SleepReq_t *req)
 
     if ( req && (PMM_STATE_ACTIVE == pmmState) )
     {
-        canSleep = SYSTEM_ReadyToSleep();
+        if ( SLEEP_MODE_BACKUP == req->sleep_mode )
+        {
+            /* RAM is lost in BACKUP, so PDS items waiting for their quiet
+             * period (frame counters included) are written beforehand */
+            PDS_Flush();
+        }
+
+        canSleep = SYSTEM_ReadyToSleep() && PDS_ReadyToSleep();
         canSleep = canSleep && validateSleepDuration( req->sleepTimeMs );
 
         if ( false == canSleep )
@@ -122,13 +131,15 @@ PMM_Status_t PMM_Sleep(PMM_SleepReq_t *req)
             }
         }
 
-        if ( canSleep && SYSTEM_ReadyToSleep() )
+        if ( canSleep && SYSTEM_ReadyToSleep() && PDS_ReadyToSleep() )
         {
             /* Start of sleep preparation */
             SystemTimerSuspend();
             SleepTimerStart( MS_TO_SLEEP_TICKS( sysSleepTime - PMM_WAKEUPTIME_MS ), PMM_Wakeup );
             pmmState = PMM_STATE_SLEEP;
             sleepReq = req;
+            /* Key material cached by the SAL is not kept across sleep */
+            SAL_ClearSessionKeyCache();
             /* End of sleep preparation */
 
             /* Put the system to sleep */
@@ -39,6 +39,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "lorawan_radio.h"
 #include "lorawan_mcast.h"
 #include "aes_engine.h"
+#include "aes_block.h"
 #include "radio_interface.h"
 #include "sw_timer.h"
 #include "lorawan_task_handler.h"
@@ -86,6 +87,29 @@ volatile RadioCallbackID_t callbackBackup;
 extern uint8_t radioBuffer[];
 static const uint8_t FskSyncWordBuff[3] = {0xC1, 0x94, 0xC1};
 
+/* LoRa chip time in us for BW_125KHZ, BW_250KHZ and BW_500KHZ, the symbol
+ * time is the chip time shifted left by the spreading factor */
+static const uint8_t loraChipTimeUs[] = {8, 4, 2};
+
+/* Secure element commands counted when the current uplink was accepted,
+ * and the number of commands issued by the last completed uplink */
+static uint32_t uplinkDeviceCmdBase;
+static uint32_t uplinkDeviceCmdCount;
+
+/* Join accept decrypted and authenticated in the background, the secure
+ * element takes tens of ms per AES block. The radio buffer is handed back
+ * before that is over, so the frame is kept here */
+static struct
+{
+    uint8_t buffer[SIZE_JOIN_ACCEPT_WITH_CFLIST];
+    /* 0 when no join accept is pending, LORAWAN_Reset and LORAWAN_Join
+     * drop a pending one this way */
+    uint8_t length;
+    /* Number of bytes after the MHDR decrypted so far */
+    uint8_t decoded;
+    uint8_t mic[AES_BLOCKSIZE];
+} joinAcceptRx;
+
 /* LoRaWAN Spec 1.0.2 section 5.8 for TxParamSetupReq MAC command defines EIRP values. These values are stored in below array */
 static const uint8_t maxEIRPTable[] = {8,10,12,13,14,16,18,20,21,24,26,27,29,30,33,36};
 
@@ -108,6 +132,18 @@ static void PrepareSessionKeys (uint8_t* sessionKey, uint8_t* joinNonce, uint8_t
 
 static void ComputeSessionKeys (JoinAccept_t *joinAcceptBuffer);
 
+static void AppSessionKeyDerived (SalStatus_t sal_status);
+
+static void NwkSessionKeyDerived (SalStatus_t sal_status);
+
+static void NwkSessionKeyRead (SalStatus_t sal_status);
+
+static void AppSessionKeyRead (SalStatus_t sal_status);
+
+static void JoinAcceptBlockDecrypted (SalStatus_t sal_status);
+
+static void JoinAcceptMicComputed (SalStatus_t sal_status);
+
 static void IncludeMacCommandsResponse (uint8_t* macCommandsBuffer, uint16_t* pBufferIndex, uint8_t bIncludeInFopts );
 
 static void CheckFlags (Hdr_t* hdr);
@@ -143,6 +179,8 @@ static void lorawanADR(FCtrl_t *fCtrl);
 
 static StackRetStatus_t checkRxPacketPayloadLen(uint8_t bufferLength, Hdr_t *hdr);
 
+static uint32_t LorawanGetRxFcnt(FCnt_t *fCnt, uint16_t rxFcnt);
+
 
 /*********************************************************************//**
 \brief  This function calls the respective callback function of the
@@ -196,6 +234,17 @@ void LORAWAN_Init(AppDataCb_t appdata, JoinResponseCb_t joindata) // this functi
         RADIO_Init();
         status = RADIO_SetAttr(RADIO_CALLBACK, (void *)&radioCallback);
 
+        // The timers start a radio operation when they expire, the radio
+        // powers its TCXO on ahead of them
+        RADIO_SetClockUser(loRa.joinAccept1TimerId);
+        RADIO_SetClockUser(loRa.joinAccept2TimerId);
+        RADIO_SetClockUser(loRa.receiveWindow1TimerId);
+        RADIO_SetClockUser(loRa.receiveWindow2TimerId);
+        RADIO_SetClockUser(loRa.ackTimeoutTimerId);
+        RADIO_SetClockUser(loRa.automaticReplyTimerId);
+        RADIO_SetClockUser(loRa.unconfirmedRetransmisionTimerId);
+        RADIO_SetClockUser(loRa.transmissionErrorTimerId);
+
         srand (RADIO_ReadRandom ());  // for the loRa random function we need a seed that is obtained from the radio
 
     }
@@ -219,6 +268,22 @@ void LORAWAN_Init(AppDataCb_t appdata, JoinResponseCb_t joindata) // this functi
         mac_filemarks.itemListAddr = pds_mac_fid2_item_list;
         mac_filemarks.fIDcb = Lorawan_Pds_fid2_CB;
         PDS_RegFile(PDS_FILE_MAC_02_IDX,mac_filemarks);
+
+        /* Frame counters change with every frame, they are appended to the
+         * PDS counter journal instead of rewriting their files. A counter
+         * that cannot be journalled is still stored, with its file */
+        if (PDS_OK != PDS_REG_COUNTER(PDS_MAC_FCNT_UP))
+        {
+            SYS_ASSERT_ERROR(ASSERT_MAC_PDSREGCOUNTER_FAIL);
+        }
+        if (PDS_OK != PDS_REG_COUNTER(PDS_MAC_FCNT_DOWN))
+        {
+            SYS_ASSERT_ERROR(ASSERT_MAC_PDSREGCOUNTER_FAIL);
+        }
+        if (PDS_OK != PDS_REG_COUNTER(PDS_MAC_MCAST_FCNT_DWN))
+        {
+            SYS_ASSERT_ERROR(ASSERT_MAC_PDSREGCOUNTER_FAIL);
+        }
     }
 
     {
@@ -252,6 +317,9 @@ StackRetStatus_t LORAWAN_Reset (IsmBand_t ismBand)
 
     loRa.stackVersion.value = STACK_VERSION_VALUE;
 
+    SAL_ClearSessionKeyCache();
+    joinAcceptRx.length = 0;
+
     loRa.syncWord = MAC_LORA_MODULATION_SYNCWORD;
     RADIO_SetAttr(LORA_SYNC_WORD,(void *)&(loRa.syncWord));
 
@@ -316,8 +384,6 @@ StackRetStatus_t LORAWAN_Reset (IsmBand_t ismBand)
         RADIO_SetAttr(PABOOST,(void *)&paBoost);
     }
 
-    RADIO_GetAttr(RADIO_CLOCK_STABLE_DELAY, &loRa.radioClkStableDelay);
-
     if(loRa.featuresSupported & LBT_SUPPORT)
     {
         LorawanLBTParams_t LorawanLBTParams;
@@ -355,7 +421,8 @@ StackRetStatus_t LORAWAN_Reset (IsmBand_t ismBand)
       LorawanLinkCheckConfigure (DISABLED); // disable the link check mechanism
     LorawanMcastInit();
     
-    LORAWAN_SetAttr(TEST_MODE_ENABLE, TestModeEnabled);
+    bool testModeEnabled = TestModeEnabled;
+    LORAWAN_SetAttr(TEST_MODE_ENABLE, &testModeEnabled);
     return status;
 }
 
@@ -411,6 +478,9 @@ StackRetStatus_t LORAWAN_Join(ActivationType_t activationTypeNew)
             {
                 LORAREG_SetAttr(REG_JOIN_ENABLE_ALL,NULL);
             }
+            /* Session keys of the previous join are not valid anymore */
+            SAL_ClearSessionKeyCache();
+            joinAcceptRx.length = 0;
             /* set the states and flags accordingly */
             loRa.macStatus.networkJoined = 0;
             loRa.lorawanMacStatus.joining = true;
@@ -525,6 +595,7 @@ StackRetStatus_t LORAWAN_Send (LorawanSendReq_t *lorasendreq)
 
 
     loRa.isTransactionDone = false;
+    uplinkDeviceCmdBase = SAL_GetDeviceCommandCount();
 
     /* Post task to LORAWAN handler to send Join req*/
     LORAWAN_PostTask(LORAWAN_TX_TASK_ID);
@@ -850,7 +921,7 @@ void LorawanGetChAndInitiateRadioTransmit(void)
         }
         else
         {
-            SwTimerStart(loRa.transmissionErrorTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)TransmissionErrorCallback, NULL);
+            SwTimerStart(loRa.transmissionErrorTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT), SW_TIMEOUT_RELATIVE, (void *)TransmissionErrorCallback, NULL);
         }
     }
     else
@@ -864,7 +935,7 @@ void LorawanGetChAndInitiateRadioTransmit(void)
             {
                 minim = minim + 20;
             }
-            SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
+            SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
 
         }
         else if(loRa.featuresSupported & LBT_SUPPORT)
@@ -874,13 +945,13 @@ void LorawanGetChAndInitiateRadioTransmit(void)
             {
                 minim = minim + 1;
             }
-           SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
+           SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
         }
         else
         {
             if (loRa.lorawanMacStatus.ackRequiredFromNextDownlinkMessage == DISABLED)
             {
-                SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
+                SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
             }
             else
             {
@@ -959,7 +1030,7 @@ void UnconfirmedTransmissionCallback (void)
                 loRa.macStatus.macState = RETRANSMISSION_DELAY;
             }
 
-            SwTimerStart(loRa.transmissionErrorTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)TransmissionErrorCallback, NULL);
+            SwTimerStart(loRa.transmissionErrorTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT), SW_TIMEOUT_RELATIVE, (void *)TransmissionErrorCallback, NULL);
         }
     }
     else
@@ -983,7 +1054,7 @@ void UnconfirmedTransmissionCallback (void)
             }
         }
 
-        SwTimerStart(loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
+        SwTimerStart(loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
 
     }
 }
@@ -1045,7 +1116,7 @@ void UpdateRetransmissionAckTimeoutState (void)
     {
         loRa.macStatus.macState = RETRANSMISSION_DELAY;
     }
-    SwTimerStart(loRa.ackTimeoutTimerId, MS_TO_US(loRa.protocolParameters.retransmitTimeout - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)AckRetransmissionCallback, NULL);
+    SwTimerStart(loRa.ackTimeoutTimerId, MS_TO_US(loRa.protocolParameters.retransmitTimeout), SW_TIMEOUT_RELATIVE, (void *)AckRetransmissionCallback, NULL);
 }
 
 void UpdateJoinSuccessState(void)
@@ -1093,6 +1164,7 @@ void UpdateReceiveWindow2Parameters (uint32_t frequency, uint8_t dataRate)
 {
     loRa.receiveWindow2Parameters.dataRate = dataRate;
     loRa.receiveWindow2Parameters.frequency = frequency;
+    RADIO_PrepareFrequency(frequency);
    if ((loRa.edClass == CLASS_C) || (loRa.edClass == CLASS_B))
    {
       UpdateReceiveWindowCParameters(frequency , dataRate);
@@ -1213,7 +1285,7 @@ static void HandleAutoReplyFromRxDone(void)
                 minim = minim + 20;
             }
             loRa.macStatus.macState = RETRANSMISSION_DELAY;
-            SwTimerStart (loRa.automaticReplyTimerId, MS_TO_US(minim - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)AutomaticReplyCallback, NULL);
+            SwTimerStart (loRa.automaticReplyTimerId, MS_TO_US(minim), SW_TIMEOUT_RELATIVE, (void *)AutomaticReplyCallback, NULL);
 
         }
         else if(loRa.featuresSupported & LBT_SUPPORT)
@@ -1224,7 +1296,7 @@ static void HandleAutoReplyFromRxDone(void)
             {
                 minim = minim + 1;
             }
-            SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
+            SwTimerStart (loRa.unconfirmedRetransmisionTimerId, MS_TO_US(minim), SW_TIMEOUT_RELATIVE, (void *)UnconfirmedTransmissionCallback, NULL);
 
         }
     }
@@ -1266,7 +1338,6 @@ static void LorawanNotifyAppOnRxdone(Hdr_t *hdr, uint8_t *packet, uint8_t frmPay
 static StackRetStatus_t ProcessUnicastRxPacket(uint8_t* buffer, uint8_t bufferLength, Hdr_t *hdr)
 {
     uint8_t frmPayloadLength;
-    uint8_t bufferIndex;
     uint8_t fPort = 0;
     uint8_t *appskey = loRa.activationParameters.applicationSessionKeyRam;
     uint8_t *nwkskey = loRa.activationParameters.networkSessionKeyRam;
@@ -1320,11 +1391,10 @@ static StackRetStatus_t ProcessUnicastRxPacket(uint8_t* buffer, uint8_t bufferLe
         fPort = *(buffer++);
 
         frmPayloadLength = bufferLength - 8 - hdr->members.fCtrl.fOptsLen - sizeof (extractedMic); //frmPayloadLength includes port
-        bufferIndex = 16 + 8 + hdr->members.fCtrl.fOptsLen + sizeof (fPort);
 
         if (fPort != 0)
         {
-            sal_status = EncryptFRMPayload (buffer, frmPayloadLength - 1, 1, loRa.fCntDown.value, appskey, SAL_APPS_KEY, bufferIndex, radioBuffer, loRa.activationParameters.deviceAddress.value);
+            sal_status = EncryptFRMPayload (buffer, frmPayloadLength - 1, 1, loRa.fCntDown.value, appskey, SAL_APPS_KEY, 0, buffer, loRa.activationParameters.deviceAddress.value);
             if (SAL_SUCCESS != sal_status)
             {
                 SetReceptionNotOkState();
@@ -1338,7 +1408,7 @@ static StackRetStatus_t ProcessUnicastRxPacket(uint8_t* buffer, uint8_t bufferLe
             if(hdr->members.fCtrl.fOptsLen == 0)
             {
                 // Decrypt port 0 payload
-                sal_status = EncryptFRMPayload (buffer, frmPayloadLength - 1, 1, loRa.fCntDown.value, nwkskey, SAL_NWKS_KEY, bufferIndex, radioBuffer, loRa.activationParameters.deviceAddress.value);
+                sal_status = EncryptFRMPayload (buffer, frmPayloadLength - 1, 1, loRa.fCntDown.value, nwkskey, SAL_NWKS_KEY, 0, buffer, loRa.activationParameters.deviceAddress.value);
                 if (SAL_SUCCESS != sal_status)
                 {
                     SetReceptionNotOkState();
@@ -1498,6 +1568,28 @@ static StackRetStatus_t ProcessUnicastRxPacket(uint8_t* buffer, uint8_t bufferLe
     return LORAWAN_SUCCESS;
 }
 
+/*********************************************************************//**
+\brief  Derives the 32-bit frame counter of a received downlink from its
+        16-bit FCnt field, without updating the stored counter
+\param[in]  fCnt   - last accepted downlink frame counter
+\param[in]  rxFcnt - 16-bit frame counter of the received frame
+\return     32-bit frame counter to be used for MIC and decryption
+*************************************************************************/
+static uint32_t LorawanGetRxFcnt(FCnt_t *fCnt, uint16_t rxFcnt)
+{
+    FCnt_t candidate;
+
+    candidate.value = fCnt->value;
+    if (rxFcnt < candidate.members.valueLow)
+    {
+        //Frame counter rolled over
+        candidate.members.valueHigh++;
+    }
+    candidate.members.valueLow = rxFcnt;
+
+    return candidate.value;
+}
+
 StackRetStatus_t LorawanProcessFcntDown(Hdr_t *hdr, bool isMulticast)
 {
     if (hdr->members.fCnt >= loRa.fCntDown.members.valueLow)
@@ -1543,115 +1635,35 @@ StackRetStatus_t LORAWAN_RxDone (uint8_t *buffer, uint8_t bufferLength)
 {
     uint32_t computedMic, extractedMic;
     Mhdr_t mhdr;
-    uint8_t temp;
     uint8_t groupId;
-    uint32_t fcntDown_temp;
+    uint32_t rxFcnt;
     SalStatus_t sal_status = SAL_SUCCESS;
-    uint32_t jNonce;
 
     if (loRa.macStatus.macPause == DISABLED)
     {
         mhdr.value = buffer[0];
         if ((mhdr.bits.mType == FRAME_TYPE_JOIN_ACCEPT) && (loRa.activationParameters.activationType == 0) && (loRa.lorawanMacStatus.joining == 1))
         {
-             temp = bufferLength - 1; //MHDR not encrypted
-             while (temp > 0)
-             {
-                 //Decode message
-                 sal_status = SAL_AESEncode (&buffer[bufferLength - temp], SAL_APP_KEY, loRa.activationParameters.applicationKey);
-                 if (SAL_SUCCESS != sal_status)
-                 {
-                     SetJoinFailState(sal_status);
-                     SetReceptionNotOkState();
-                     return LORAWAN_RXPKT_ENCRYPTION_FAILED;
-                 }
-
-                 if (temp > AES_BLOCKSIZE)
-                 {
-                     temp -= AES_BLOCKSIZE;
-                 }
-                 else
-                 {
-                     temp = 0;
-                 }
-             }
-
-            //verify MIC
-            computedMic = ComputeMic (loRa.activationParameters.applicationKey, buffer, bufferLength - sizeof(extractedMic));
-            extractedMic = ExtractMic (buffer, bufferLength);
-            if (extractedMic != computedMic)
+            // MHDR followed by whole AES blocks, with or without CFList
+            if (((bufferLength != SIZE_JOIN_ACCEPT_WITH_CFLIST) && (bufferLength != (SIZE_JOIN_ACCEPT_WITH_CFLIST - AES_BLOCKSIZE))) || (0 != joinAcceptRx.length))
             {
-                if ((loRa.macStatus.macState == RX2_OPEN) || ((loRa.macStatus.macState == RX1_OPEN) && (loRa.rx2DelayExpired)))
-                {
-                    SetJoinFailState(LORAWAN_MIC_ERROR);
-                }
                 SetReceptionNotOkState();
                 return LORAWAN_INVALID_PARAMETER;
             }
 
-            // if the join request message was received during receive window 1, receive window 2 should not open any more, so its timer will be stopped
-            if (loRa.macStatus.macState == RX1_OPEN)
-            {
-                SwTimerStop (loRa.joinAccept2TimerId);
-            }
-
-            JoinAccept_t *joinAccept;
-            joinAccept = (JoinAccept_t*)buffer;
-
-            if (loRa.joinNonceType == JOIN_NONCE_INCREMENTAL)
-            {
-                jNonce = 0x00000000 | ((uint32_t) joinAccept->members.joinNonce[0]);
-                jNonce |= (uint32_t) ((uint32_t) joinAccept->members.joinNonce[1]) << 8;
-                jNonce |= (uint32_t) ((uint32_t) joinAccept->members.joinNonce[2]) << 16;
-
-                if (MAC_JOINNONCE != loRa.joinNonce)
-                {
-                    if (jNonce <= loRa.joinNonce)
-                    {
-                        SetJoinFailState(LORAWAN_JOIN_NONCE_ERROR);
-                        return LORAWAN_JOIN_NONCE_ERROR;
-                    }
-                }
-                loRa.joinNonce = jNonce;
-                PDS_STORE(PDS_MAC_JOIN_NONCE);
-            }
-
-            loRa.activationParameters.deviceAddress.value = joinAccept->members.deviceAddress.value; //device address is saved
-            PDS_STORE(PDS_MAC_DEV_ADDR);
-            UpdateReceiveDelays (joinAccept->members.rxDelay & LAST_NIBBLE); //receive delay 1 and receive delay 2 are updated according to the rxDelay field from the join accept message
-
-            UpdateDLSettings(joinAccept->members.DLSettings.bits.rx2DataRate, joinAccept->members.DLSettings.bits.rx1DROffset);
-
-            /* Reset the flag before checking whether CFList contains CHMask */
-            loRa.joinAcceptChMaskReceived = false;
+            memcpy(joinAcceptRx.buffer, buffer, bufferLength);
+            joinAcceptRx.length = bufferLength;
+            joinAcceptRx.decoded = 0;
 
-            UpdateCfList (bufferLength, joinAccept);
-
-            ComputeSessionKeys (joinAccept); //for activation by personalization, the network and application session keys are computed
-
-            if (loRa.cryptoDeviceEnabled)
-            {
-                sal_status = SAL_Read(SAL_NWKS_KEY, (uint8_t *)&loRa.activationParameters.networkSessionKeyRam);
-                if (SAL_SUCCESS != sal_status)
-                {
-                    SetJoinFailState(sal_status);
-                    SetReceptionNotOkState();
-                    return LORAWAN_SKEY_READ_FAILED;
-                }
-                sal_status = SAL_Read(SAL_APPS_KEY, (uint8_t *)&loRa.activationParameters.applicationSessionKeyRam);
-                if (SAL_SUCCESS != sal_status)
-                {
-                    SetJoinFailState(sal_status);
-                    SetReceptionNotOkState();
-                    return LORAWAN_SKEY_READ_FAILED;
-                }
-            }
-            else
+            //Decode message, the join accept is processed further once it is decrypted
+            sal_status = SAL_AESEncodeAsync (&joinAcceptRx.buffer[1], SAL_APP_KEY, loRa.activationParameters.applicationKey, JoinAcceptBlockDecrypted);
+            if (SAL_SUCCESS != sal_status)
             {
-                memcpy(loRa.activationParameters.applicationSessionKeyRam, loRa.activationParameters.applicationSessionKeyRom, 16);
-                memcpy(loRa.activationParameters.networkSessionKeyRam, loRa.activationParameters.networkSessionKeyRom, 16);
+                joinAcceptRx.length = 0;
+                SetJoinFailState(sal_status);
+                SetReceptionNotOkState();
+                return LORAWAN_RXPKT_ENCRYPTION_FAILED;
             }
-            UpdateJoinSuccessState();
 
             return LORAWAN_SUCCESS;
         }
@@ -1699,7 +1711,6 @@ StackRetStatus_t LORAWAN_RxDone (uint8_t *buffer, uint8_t bufferLength)
                 if (LORAWAN_SUCCESS == LorawanMcastValidateHdr(hdr, mhdr.bits.mType, *((uint8_t *)(buffer + LORAWAN_FHDR_SIZE_WITHOUT_FOPTS)),&groupId))
                 {
                     isMcastpkt = true;
-                    nwkskey = loRa.mcastParams.activationParams[groupId].mcastNwkSKey;
                     devAddr = loRa.mcastParams.activationParams[groupId].mcastDevAddr.value;
                 }
                 else
@@ -1716,53 +1727,29 @@ StackRetStatus_t LORAWAN_RxDone (uint8_t *buffer, uint8_t bufferLength)
                 }
             }
 
+            /* Only a candidate frame counter is derived here. The stored
+             * counters (and PDS) are updated once the MIC has been verified,
+             * so that forged or foreign frames are rejected without side effects */
             if ( false == isMcastpkt )
-            {   // fcntDn validation
-                fcntDown_temp = loRa.fCntDown.value;
-                StackRetStatus_t fCntStatus = LorawanProcessFcntDown(hdr, isMcastpkt);
-                if (LORAWAN_SUCCESS != fCntStatus)
-                {
-                    return fCntStatus;
-                }
-                AssembleEncryptionBlock (1,(uint32_t)loRa.fCntDown.value, bufferLength - sizeof (computedMic), 0x49, devAddr);
+            {
+                rxFcnt = LorawanGetRxFcnt(&loRa.fCntDown, hdr->members.fCnt);
             }
             else
             {
-                FCnt_t * mcastfcnt = & loRa.mcastParams.activationParams[groupId].mcastFCntDown;
-
-                fcntDown_temp = mcastfcnt->value;
-
-                if ( hdr->members.fCnt >= mcastfcnt->members.valueLow )
-                {
-                    /*
-                    * 16-bit fcnt received in frame is >= the mcastfcnt.valueLow
-                    */
-                    mcastfcnt->members.valueLow = hdr->members.fCnt;
-
-                    // update PDS
-                }
-                else
-                {
-                    /*
-                    * 16-bit fcnt received in frame is < mcastfcnt.valueHigh
-                    */
-                    mcastfcnt->members.valueHigh++;
-                    mcastfcnt->members.valueLow = hdr->members.fCnt;
-
-                    // update PDS
-                }
-                AssembleEncryptionBlock (1, mcastfcnt->value, bufferLength - sizeof (computedMic), 0x49, devAddr);
+                rxFcnt = LorawanGetRxFcnt(&loRa.mcastParams.activationParams[groupId].mcastFCntDown, hdr->members.fCnt);
             }
+            AssembleEncryptionBlock (1, rxFcnt, bufferLength - sizeof (computedMic), 0x49, devAddr);
 
-            memcpy (&radioBuffer[0], aesBuffer, sizeof (aesBuffer));
-            memcpy (&radioBuffer[16], buffer, bufferLength-sizeof(computedMic));
+            /* The radio reserves AES_BLOCKSIZE bytes in front of the received
+             * frame, so B0 is placed there and the MIC is computed in place */
+            memcpy (buffer - AES_BLOCKSIZE, aesBuffer, sizeof (aesBuffer));
             if(isMcastpkt)
             {
-                SAL_AESCmac(nwkskey, SAL_MCAST_NWKS_KEY, aesBuffer, &radioBuffer[0], bufferLength - sizeof(computedMic) + sizeof (aesBuffer));
+                LorawanMcastComputeCmac(groupId, aesBuffer, buffer - AES_BLOCKSIZE, bufferLength - sizeof(computedMic) + sizeof (aesBuffer));
             }
             else
             {
-                SAL_AESCmac(nwkskey, SAL_NWKS_KEY, aesBuffer, &radioBuffer[0], bufferLength - sizeof(computedMic) + sizeof (aesBuffer));
+                SAL_AESCmac(nwkskey, SAL_NWKS_KEY, aesBuffer, buffer - AES_BLOCKSIZE, bufferLength - sizeof(computedMic) + sizeof (aesBuffer));
             }
 
             memcpy(&computedMic, aesBuffer, sizeof(computedMic));
@@ -1781,14 +1768,6 @@ StackRetStatus_t LORAWAN_RxDone (uint8_t *buffer, uint8_t bufferLength)
                 if (AppPayload.AppData != NULL)
                 {
                     loRa.lorawanMacStatus.syncronization = 0; //clear the synchronization flag, because if the user will send a packet in the callback there is no need to send an empty packet
-                    if ( true == isMcastpkt )
-                    {
-                        loRa.mcastParams.activationParams[groupId].mcastFCntDown.value = fcntDown_temp;
-                    }
-                    else
-                    {
-                        loRa.fCntDown.value = fcntDown_temp;
-                    }
                     /* Transaction complete Event */
                     UpdateTransactionCompleteCbParams(LORAWAN_MIC_ERROR);
 
@@ -1797,6 +1776,19 @@ StackRetStatus_t LORAWAN_RxDone (uint8_t *buffer, uint8_t bufferLength)
                 return LORAWAN_INVALID_PARAMETER;
             }
 
+            if ( false == isMcastpkt )
+            {   // fcntDn validation
+                StackRetStatus_t fCntStatus = LorawanProcessFcntDown(hdr, isMcastpkt);
+                if (LORAWAN_SUCCESS != fCntStatus)
+                {
+                    return fCntStatus;
+                }
+            }
+            else
+            {
+                loRa.mcastParams.activationParams[groupId].mcastFCntDown.value = rxFcnt;
+            }
+
             if (false == isMcastpkt)
             {
                 ProcessUnicastRxPacket(buffer, bufferLength, hdr);
@@ -2896,6 +2888,7 @@ static void UpdateCfList (uint8_t bufferLength, JoinAccept_t *joinAccept)
                         if (LORAREG_ValidateAttr (TX_FREQUENCY,&val_update_freqTx) == LORAWAN_SUCCESS)
                         {
                             LORAREG_SetAttr(FREQUENCY,&val_update_freqTx);
+                            RADIO_PrepareFrequency(frequency);
 
                             LORAREG_SetAttr(DATA_RANGE,&val_update_drange);
 
@@ -2965,28 +2958,195 @@ static void PrepareSessionKeys (uint8_t* sessionKey, uint8_t* joinNonce, uint8_t
 
 }
 
+static void JoinAcceptBlockDecrypted (SalStatus_t sal_status)
+{
+    if (0 == joinAcceptRx.length)
+    {
+        // Dropped while the block was being decrypted
+        return;
+    }
+
+    if (SAL_SUCCESS == sal_status)
+    {
+        joinAcceptRx.decoded += AES_BLOCKSIZE;
+        if (joinAcceptRx.decoded < (joinAcceptRx.length - 1))
+        {
+            sal_status = SAL_AESEncodeAsync (&joinAcceptRx.buffer[1 + joinAcceptRx.decoded], SAL_APP_KEY, loRa.activationParameters.applicationKey, JoinAcceptBlockDecrypted);
+        }
+        else
+        {
+            //verify MIC
+            sal_status = SAL_AESCmacAsync (loRa.activationParameters.applicationKey, SAL_APP_KEY, joinAcceptRx.mic, joinAcceptRx.buffer, joinAcceptRx.length - sizeof(uint32_t), JoinAcceptMicComputed);
+        }
+    }
+
+    if (SAL_SUCCESS != sal_status)
+    {
+        joinAcceptRx.length = 0;
+        SetJoinFailState(sal_status);
+        SetReceptionNotOkState();
+    }
+}
+
+static void JoinAcceptMicComputed (SalStatus_t sal_status)
+{
+    uint32_t computedMic, extractedMic;
+    uint32_t jNonce;
+    JoinAccept_t *joinAccept;
+    uint8_t bufferLength = joinAcceptRx.length;
+
+    if (0 == bufferLength)
+    {
+        // Dropped while the MIC was being computed
+        return;
+    }
+    joinAcceptRx.length = 0;
+
+    if (SAL_SUCCESS != sal_status)
+    {
+        SetJoinFailState(sal_status);
+        SetReceptionNotOkState();
+        return;
+    }
+
+    memcpy(&computedMic, joinAcceptRx.mic, sizeof(computedMic));
+    extractedMic = ExtractMic (joinAcceptRx.buffer, bufferLength);
+    if (extractedMic != computedMic)
+    {
+        if ((loRa.macStatus.macState == RX2_OPEN) || ((loRa.macStatus.macState == RX1_OPEN) && (loRa.rx2DelayExpired)))
+        {
+            SetJoinFailState(LORAWAN_MIC_ERROR);
+        }
+        SetReceptionNotOkState();
+        return;
+    }
+
+    // if the join request message was received during receive window 1, receive window 2 should not open any more, so its timer will be stopped
+    if (loRa.macStatus.macState == RX1_OPEN)
+    {
+        SwTimerStop (loRa.joinAccept2TimerId);
+    }
+
+    joinAccept = (JoinAccept_t*)joinAcceptRx.buffer;
+
+    if (loRa.joinNonceType == JOIN_NONCE_INCREMENTAL)
+    {
+        jNonce = 0x00000000 | ((uint32_t) joinAccept->members.joinNonce[0]);
+        jNonce |= (uint32_t) ((uint32_t) joinAccept->members.joinNonce[1]) << 8;
+        jNonce |= (uint32_t) ((uint32_t) joinAccept->members.joinNonce[2]) << 16;
+
+        if (MAC_JOINNONCE != loRa.joinNonce)
+        {
+            if (jNonce <= loRa.joinNonce)
+            {
+                SetJoinFailState(LORAWAN_JOIN_NONCE_ERROR);
+                return;
+            }
+        }
+        loRa.joinNonce = jNonce;
+        PDS_STORE(PDS_MAC_JOIN_NONCE);
+    }
+
+    loRa.activationParameters.deviceAddress.value = joinAccept->members.deviceAddress.value; //device address is saved
+    PDS_STORE(PDS_MAC_DEV_ADDR);
+    UpdateReceiveDelays (joinAccept->members.rxDelay & LAST_NIBBLE); //receive delay 1 and receive delay 2 are updated according to the rxDelay field from the join accept message
+
+    UpdateDLSettings(joinAccept->members.DLSettings.bits.rx2DataRate, joinAccept->members.DLSettings.bits.rx1DROffset);
+
+    /* Reset the flag before checking whether CFList contains CHMask */
+    loRa.joinAcceptChMaskReceived = false;
+
+    UpdateCfList (bufferLength, joinAccept);
+
+    /* Session keys are derived in the background, the join completes
+     * once both of them are available */
+    ComputeSessionKeys (joinAccept);
+}
+
 static void ComputeSessionKeys (JoinAccept_t *joinAcceptBuffer)
 {
     SalStatus_t sal_status = SAL_SUCCESS;
+
+    /* Both blocks are prepared now, since the join accept buffer is not
+     * guaranteed to stay valid while the keys are being derived */
     PrepareSessionKeys(loRa.activationParameters.applicationSessionKeyRom, joinAcceptBuffer->members.joinNonce, joinAcceptBuffer->members.networkId);
     loRa.activationParameters.applicationSessionKeyRom[0] = 0x02; // used for Application Session Key
-    sal_status = SAL_DeriveSessionKey(loRa.activationParameters.applicationSessionKeyRom, SAL_APP_KEY, loRa.activationParameters.applicationKey, SAL_APPS_KEY);
+    PrepareSessionKeys(loRa.activationParameters.networkSessionKeyRom, joinAcceptBuffer->members.joinNonce, joinAcceptBuffer->members.networkId);
+    loRa.activationParameters.networkSessionKeyRom[0] = 0x01; // used for Network Session Key
+
+    sal_status = SAL_DeriveSessionKeyAsync(loRa.activationParameters.applicationSessionKeyRom, SAL_APP_KEY, loRa.activationParameters.applicationKey, SAL_APPS_KEY, AppSessionKeyDerived);
     if (SAL_SUCCESS != sal_status)
     {
         SetJoinFailState(sal_status);
         SetReceptionNotOkState();
     }
-    PDS_STORE(PDS_MAC_APP_SKEY);
+}
 
-    PrepareSessionKeys(loRa.activationParameters.networkSessionKeyRom, joinAcceptBuffer->members.joinNonce, joinAcceptBuffer->members.networkId);
-    loRa.activationParameters.networkSessionKeyRom[0] = 0x01; // used for Network Session Key
-    sal_status = SAL_DeriveSessionKey(loRa.activationParameters.networkSessionKeyRom, SAL_APP_KEY, loRa.activationParameters.applicationKey, SAL_NWKS_KEY);
+static void AppSessionKeyDerived (SalStatus_t sal_status)
+{
+    if (SAL_SUCCESS == sal_status)
+    {
+        PDS_STORE(PDS_MAC_APP_SKEY);
+        sal_status = SAL_DeriveSessionKeyAsync(loRa.activationParameters.networkSessionKeyRom, SAL_APP_KEY, loRa.activationParameters.applicationKey, SAL_NWKS_KEY, NwkSessionKeyDerived);
+    }
+
+    if (SAL_SUCCESS != sal_status)
+    {
+        SetJoinFailState(sal_status);
+        SetReceptionNotOkState();
+    }
+}
+
+static void NwkSessionKeyDerived (SalStatus_t sal_status)
+{
     if (SAL_SUCCESS != sal_status)
     {
         SetJoinFailState(sal_status);
         SetReceptionNotOkState();
+        return;
     }
     PDS_STORE(PDS_MAC_NWK_SKEY);
+
+    if (loRa.cryptoDeviceEnabled)
+    {
+        /* Session keys are read back from the secure element in the background */
+        sal_status = SAL_ReadAsync(SAL_NWKS_KEY, (uint8_t *)&loRa.activationParameters.networkSessionKeyRam, NwkSessionKeyRead);
+        if (SAL_SUCCESS != sal_status)
+        {
+            SetJoinFailState(sal_status);
+            SetReceptionNotOkState();
+        }
+        return;
+    }
+
+    memcpy(loRa.activationParameters.applicationSessionKeyRam, loRa.activationParameters.applicationSessionKeyRom, 16);
+    memcpy(loRa.activationParameters.networkSessionKeyRam, loRa.activationParameters.networkSessionKeyRom, 16);
+    UpdateJoinSuccessState();
+}
+
+static void NwkSessionKeyRead (SalStatus_t sal_status)
+{
+    if (SAL_SUCCESS == sal_status)
+    {
+        sal_status = SAL_ReadAsync(SAL_APPS_KEY, (uint8_t *)&loRa.activationParameters.applicationSessionKeyRam, AppSessionKeyRead);
+    }
+
+    if (SAL_SUCCESS != sal_status)
+    {
+        SetJoinFailState(sal_status);
+        SetReceptionNotOkState();
+    }
+}
+
+static void AppSessionKeyRead (SalStatus_t sal_status)
+{
+    if (SAL_SUCCESS != sal_status)
+    {
+        SetJoinFailState(sal_status);
+        SetReceptionNotOkState();
+        return;
+    }
+    UpdateJoinSuccessState();
 }
 
 //Based on the last packet received, this function checks the flags and updates the state accordingly
@@ -3092,35 +3252,38 @@ static uint32_t ComputeMic ( uint8_t *key, uint8_t* buffer, uint8_t bufferLength
 SalStatus_t EncryptFRMPayload (uint8_t* buffer, uint8_t bufferLength, uint8_t dir, uint32_t frameCounter, uint8_t* key, uint8_t key_type, uint16_t macBufferIndex, uint8_t* bufferToBeEncrypted, uint32_t devAddr)
 {
     SalStatus_t sal_status = SAL_SUCCESS;
-    uint8_t k = 0, i = 0, j = 0;
+    uint8_t ctrBlock[AES_BLOCKSIZE];
+    uint8_t blockLength;
+    uint8_t i = 1;
 
-    k = bufferLength / AES_BLOCKSIZE;
-    for (i = 1; i <= k; i++)
+    /* The counter block only differs in its last byte between consecutive
+     * blocks, so it is assembled once. The output may overlap the input
+     * (in-place decryption), since every byte is read before it is written */
+    AssembleEncryptionBlock (dir, frameCounter, 0, 0x01, devAddr);
+    memcpy (ctrBlock, aesBuffer, sizeof (ctrBlock));
+
+    while (bufferLength > 0)
     {
-        AssembleEncryptionBlock (dir, frameCounter, i, 0x01, devAddr);
+        memcpy (aesBuffer, ctrBlock, sizeof (ctrBlock));
+        aesBuffer[AES_BLOCKSIZE - 1] = i;
         sal_status = SAL_AESEncode(aesBuffer, SAL_APPS_KEY, key);
         if (SAL_SUCCESS != sal_status )
         {
             return sal_status;
         }
-        for (j = 0; j < AES_BLOCKSIZE; j++)
-        {
-            bufferToBeEncrypted[macBufferIndex++] = aesBuffer[j] ^ buffer[AES_BLOCKSIZE*(i-1) + j];
-        }
-    }
 
-    if ( (bufferLength % AES_BLOCKSIZE) != 0 )
-    {
-        AssembleEncryptionBlock (dir, frameCounter, i, 0x01, devAddr);
-        sal_status = SAL_AESEncode(aesBuffer, SAL_APPS_KEY, key);
-        if (SAL_SUCCESS != sal_status )
+        blockLength = (bufferLength > AES_BLOCKSIZE) ? AES_BLOCKSIZE : bufferLength;
+        if (AES_BLOCKSIZE == blockLength)
         {
-            return sal_status;
+            AESBlockXor(&bufferToBeEncrypted[macBufferIndex], aesBuffer, &buffer[AES_BLOCKSIZE*(i-1)]);
         }
-        for (j = 0; j < (bufferLength % AES_BLOCKSIZE); j++)
+        else
         {
-            bufferToBeEncrypted[macBufferIndex++] = aesBuffer[j] ^ buffer[(AES_BLOCKSIZE*k) + j];
+            AESBlockXorPartial(&bufferToBeEncrypted[macBufferIndex], aesBuffer, &buffer[AES_BLOCKSIZE*(i-1)], blockLength);
         }
+        macBufferIndex += blockLength;
+        bufferLength -= blockLength;
+        i++;
     }
 
     return sal_status;
@@ -3130,6 +3293,7 @@ SalStatus_t EncryptFRMPayload (uint8_t* buffer, uint8_t bufferLength, uint8_t di
 void UpdateTransactionCompleteCbParams(StackRetStatus_t status)
 {
      loRa.isTransactionDone = true;
+     uplinkDeviceCmdCount = SAL_GetDeviceCommandCount() - uplinkDeviceCmdBase;
 
     if ((AppPayload.AppData != NULL) && (loRa.evtmask & LORAWAN_EVT_TRANSACTION_COMPLETE) && (loRa.appHandle != NULL))
     {
@@ -3268,6 +3432,10 @@ StackRetStatus_t LorawanSetFrequency (uint8_t channelId, uint32_t frequencyNew)
     val_update_freqTx.frequencyNew = frequencyNew;
 
     result = LORAREG_SetAttr(FREQUENCY,&val_update_freqTx);
+    if (LORAWAN_SUCCESS == result)
+    {
+        RADIO_PrepareFrequency(frequencyNew);
+    }
 
     return result;
 }
@@ -4526,8 +4694,8 @@ void LORAWAN_TxDone(void *param)
                 {
                     uint32_t timeout1 = (uint32_t) (loRa.protocolParameters.joinAcceptDelay1 + rxWindowOffset1);
                     uint32_t timeout2 = (uint32_t) (loRa.protocolParameters.joinAcceptDelay2 + rxWindowOffset2);
-                    SwTimerStart(loRa.joinAccept1TimerId, MS_TO_US(timeout1 - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow1Callback, NULL);
-                    SwTimerStart(loRa.joinAccept2TimerId, MS_TO_US(timeout2 - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow2Callback, NULL);
+                    SwTimerStart(loRa.joinAccept1TimerId, MS_TO_US(timeout1), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow1Callback, NULL);
+                    SwTimerStart(loRa.joinAccept2TimerId, MS_TO_US(timeout2), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow2Callback, NULL);
                     if(loRa.featuresSupported & JOIN_BACKOFF_SUPPORT)
                     {
                     loRa.joinreqinfo.joinReqTimeOnAir= localParam.TX.timeOnAir;
@@ -4550,8 +4718,8 @@ void LORAWAN_TxDone(void *param)
                 {
                     uint32_t timeout1 = (uint32_t) (loRa.protocolParameters.receiveDelay1 + rxWindowOffset1);
                     uint32_t timeout2 = (uint32_t) (loRa.protocolParameters.receiveDelay2 + rxWindowOffset2);
-                    SwTimerStart(loRa.receiveWindow1TimerId, MS_TO_US(timeout1 - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow1Callback, NULL);
-                    SwTimerStart(loRa.receiveWindow2TimerId, MS_TO_US(timeout2 - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow2Callback, NULL);
+                    SwTimerStart(loRa.receiveWindow1TimerId, MS_TO_US(timeout1), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow1Callback, NULL);
+                    SwTimerStart(loRa.receiveWindow2TimerId, MS_TO_US(timeout2), SW_TIMEOUT_RELATIVE, (void *)LorawanReceiveWindow2Callback, NULL);
                     if (CLASS_C == loRa.edClass)
                     {
                         loRa.enableRxcWindow = true;
@@ -4675,7 +4843,7 @@ void LorawanCheckAndDoRetryOnTimeout(void)
             if (CLASS_A == loRa.edClass)
             {
                 loRa.macStatus.macState = RETRANSMISSION_DELAY;
-                SwTimerStart(loRa.ackTimeoutTimerId, MS_TO_US(loRa.protocolParameters.retransmitTimeout - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)AckRetransmissionCallback, NULL);
+                SwTimerStart(loRa.ackTimeoutTimerId, MS_TO_US(loRa.protocolParameters.retransmitTimeout), SW_TIMEOUT_RELATIVE, (void *)AckRetransmissionCallback, NULL);
             }
             else if (CLASS_C == loRa.edClass)
             {
@@ -4813,7 +4981,7 @@ static void TransmissionErrorCallback (void)
     if (false == isTxDone)
     {
         /* keep retrying forever */
-        SwTimerStart(loRa.transmissionErrorTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT - loRa.radioClkStableDelay), SW_TIMEOUT_RELATIVE, (void *)TransmissionErrorCallback, NULL);
+        SwTimerStart(loRa.transmissionErrorTimerId, MS_TO_US(TRANSMISSION_ERROR_TIMEOUT), SW_TIMEOUT_RELATIVE, (void *)TransmissionErrorCallback, NULL);
     }
 }
 
@@ -5038,6 +5206,11 @@ static void radioCallback(RadioCallbackID_t callback, void *param)
 
     case RADIO_RX_DONE_CALLBACK:
     case RADIO_RX_ERROR_CALLBACK:
+        /* The frame is already in RAM and the radio is asleep, so it is
+           handled in the radio task without another MAC task hop */
+        LORAWAN_RxDone(((RadioCallbackParam_t *)param)->RX.buffer, ((RadioCallbackParam_t *)param)->RX.bufferLength);
+        break;
+
     case RADIO_RX_TIMEOUT_CALLBACK:
         /* callbackBackup is assumed to stay the same after MAC context switch */
         LORAWAN_PostTask(LORAWAN_RX_TASK_ID);
@@ -5204,14 +5377,12 @@ static void handleTransmissionTimeoutCallback(void)
     \cr          - Coding rate of the transmitted packet
     \length      - Length of payload in bytes to be transmitted in packet
 \return
-    'uint32_t' Time-on-Air of packet for the given payload length
+    'uint32_t' Time-on-Air of packet in us for the given payload length
 *************************************************************************/
 static uint32_t calcPacketTimeOnAir(uint8_t datarate, uint8_t preambleLen,
     uint8_t impHdrMode, uint8_t crcOn, uint8_t cr, uint8_t length)
 {
-    bool lowDataRateOptimize = false;
-    double bw, ts, tp, tmpDouble, time = 0.0;
-    uint32_t np;
+    uint32_t time;
     RadioModulation_t modulation;
     RadioDataRate_t sf;
 
@@ -5221,80 +5392,89 @@ static uint32_t calcPacketTimeOnAir(uint8_t datarate, uint8_t preambleLen,
     if (MODULATION_LORA == modulation)
     {
         RadioLoRaBandWidth_t loraBw;
-        RADIO_GetAttr(BANDWIDTH, &loraBw);
-
-        if (( SF_12 == sf && ( BW_125KHZ == loraBw || BW_250KHZ == loraBw ) ) || \
-            ( SF_11 == sf && BW_125KHZ == loraBw ))
-        {
-            lowDataRateOptimize = true;
-        }
+        uint32_t ts, np;
+        int32_t payloadBits;
+        uint8_t symbolBits;
 
         LORAREG_GetAttr(BANDWIDTH_ATTR, &datarate, &loraBw);
 
-        switch (loraBw)
+        if ((BW_125KHZ > loraBw) || (BW_500KHZ < loraBw))
         {
-            case BW_125KHZ:
-            {
-                bw = 125000.0;
-                break;
-            }
-
-            case BW_250KHZ:
-            {
-                bw = 250000.0;
-                break;
-            }
-
-            case BW_500KHZ:
-            {
-                bw = 500000.0;
-                break;
-            }
-
-            default:
-            {
-                bw = 0.0;
-                break;
-            }
+            return 0;
         }
 
         /* Refer: SX1272 data sheet section 4.1.1.7. Time on air */
 
-        /* Compute Ts, time per symbol */
-        ts = 1 / (bw / (1 << sf));
-
-        /* Compute Tpreamble, preamble time-on-air */
-        tp = (preambleLen + 4.25) * ts;
+        /* Compute Ts, time per symbol in us. All the symbol times are
+         * whole multiples of 4 us, so the whole computation is exact */
+        ts = (uint32_t)loraChipTimeUs[loraBw - BW_125KHZ] << sf;
 
-        /* Compute in steps, Npayload, number of panPayloadload snPayloadmbols */
-        tmpDouble  = ((8 * length) - (4 * sf) + 28 + (16 * crcOn) - (impHdrMode ? 20 : 0));
-        tmpDouble /= (4 * (sf - (lowDataRateOptimize ? 2 : 0)));
+        /* Bits carried by a payload symbol, LowDataRateOptimize is set by
+         * the radio when the symbol time exceeds 16 ms */
+        symbolBits = 4 * (sf - ((ts > MS_TO_US(16)) ? 2 : 0));
 
-        /* Ceil this tmpDouble */
-        np = (uint32_t) tmpDouble;
-        if ((tmpDouble - (double)np) > 0.0)
+        /* Compute Npayload, number of payload symbols */
+        payloadBits = (8 * (int32_t)length) - (4 * (int32_t)sf) + 28 + (16 * crcOn) - (impHdrMode ? 20 : 0);
+        np = 0;
+        if (payloadBits > 0)
         {
-            np += 1;
+            np = (((uint32_t)payloadBits + symbolBits - 1) / symbolBits) * (cr + 4);
         }
-
-        np *= (cr + 4);
-        np  = (np > 0) ? np : 0;
         np += 8;
 
         /*
         * Compute Tpacket...
         * The time on air, or packet duration, in simply then the sum of the preamble and payload duration.
-        * Payload duration is then the symbol period multiplied by the number of Payload symbols
+        * Tpreamble is (preambleLen + 4.25) symbols, counted here in quarter symbols
         */
-        time = (tp /* Tpreamble */ + (np /* Npayload */ * ts /* Symbol time */));
-        time = MS_TO_US(1000 * time);
+        time = (((4 * (preambleLen + np)) + 17) * ts) >> 2;
     }
     else
     {
         time = (RADIO_PHY_FSK_PREAMBLE_BYTES_LENGTH + length) * 8 * 20 /* us: time-per-bit in FSK */;
     }
 
-    return (uint32_t) time;
+    return time;
+}
+
+/*********************************************************************//**
+\brief  This function returns the time on air of an uplink carrying the
+        given application payload at the current data rate, including the
+        LoRaWAN headers, the pending MAC commands and the MIC.
+\param  length - Length of the application payload in bytes
+\return 'uint32_t' Time-on-Air of the uplink in us
+*************************************************************************/
+uint32_t LORAWAN_GetTimeOnAir(uint8_t length)
+{
+    uint8_t foptsFlag = false;
+    uint8_t macReplyLen = CountfOptsLength(&foptsFlag);
+    uint16_t phyLen = HDRS_MIC_PORT_MIN_SIZE + length;
+    RadioErrorCodingRate_t cr;
+
+    if (foptsFlag)
+    {
+        phyLen += macReplyLen;
+    }
+    if (phyLen > UINT8_MAX)
+    {
+        phyLen = UINT8_MAX;
+    }
+
+    RADIO_GetAttr(ERROR_CODING_RATE, &cr);
+
+    return calcPacketTimeOnAir(loRa.currentDataRate, RADIO_PHY_PREAMBLE_LENGTH, 0, 1, cr, (uint8_t)phyLen);
+}
+
+/*********************************************************************//**
+\brief  This function returns the number of secure element commands issued
+        between the acceptance of the last uplink by LORAWAN_Send and the
+        completion of its transaction, retransmissions and downlink
+        included.
+\return 'uint32_t' Number of secure element commands, 0 without one
+*************************************************************************/
+uint32_t LORAWAN_GetUplinkDeviceCommandCount(void)
+{
+    return uplinkDeviceCmdCount;
 }
 
 static void lorawanADR(FCtrl_t *fCtrl)
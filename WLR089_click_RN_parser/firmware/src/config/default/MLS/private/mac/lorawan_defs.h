@@ -66,7 +66,10 @@ extern "C" {
 
 #define MAX_FCNT_PDS_UPDATE_VALUE               (1) // Keep this as power of 2. Easy for bit manipulation.
 
+/* Up to 16 groups, see the McAddr index of lorawan_mcast.c */
+#ifndef LORAWAN_MCAST_GROUP_COUNT_SUPPORTED
 #define LORAWAN_MCAST_GROUP_COUNT_SUPPORTED         4
+#endif
 
 #ifdef	__cplusplus
 }
@@ -45,13 +45,48 @@ extern LoRa_t loRa;
 
 #include "lorawan_pds.h"
 
-extern uint8_t radioBuffer[];
-
 /******************* CONSTANT DEFINITIONS *************************************/
-
+#if (FEATURE_DL_MCAST == 1)
+/* Number of slots in the DevAddr index, power of 2 and at least twice
+ * LORAWAN_MCAST_GROUP_COUNT_SUPPORTED to keep the probe sequences short.
+ * The index always keeps an empty slot, which ends every probe sequence */
+#if (LORAWAN_MCAST_GROUP_COUNT_SUPPORTED <= 2)
+#define LORAWAN_MCAST_INDEX_SIZE        (4)
+#elif (LORAWAN_MCAST_GROUP_COUNT_SUPPORTED <= 4)
+#define LORAWAN_MCAST_INDEX_SIZE        (8)
+#elif (LORAWAN_MCAST_GROUP_COUNT_SUPPORTED <= 8)
+#define LORAWAN_MCAST_INDEX_SIZE        (16)
+#elif (LORAWAN_MCAST_GROUP_COUNT_SUPPORTED <= 16)
+#define LORAWAN_MCAST_INDEX_SIZE        (32)
+#else
+#error "Multicast index supports up to 16 groups, LORAWAN_MCAST_GROUP_COUNT_SUPPORTED is too large"
+#endif
+#define LORAWAN_MCAST_INDEX_EMPTY       (0xFF)
+
+#define LORAWAN_MCAST_INDEX_HASH(addr)  ((uint8_t)((addr) ^ ((addr) >> 8) ^ ((addr) >> 16) ^ ((addr) >> 24)) & (LORAWAN_MCAST_INDEX_SIZE - 1))
+#endif /* #if (FEATURE_DL_MCAST == 1) */
 
 /****************************** VARIABLES *************************************/
+#if (FEATURE_DL_MCAST == 1)
+/* Per group context cached at configuration time, so that the per frame
+ * cost does not depend on the number of configured groups */
+typedef struct _LorawanMcastGroupCtx_t
+{
+    /* CMAC subkeys derived from McNwkSKey */
+    uint8_t cmacK1[LORAWAN_SESSIONKEY_LENGTH];
+    uint8_t cmacK2[LORAWAN_SESSIONKEY_LENGTH];
+} LorawanMcastGroupCtx_t;
+
+/* Open addressed McAddr -> groupId index of the enabled groups */
+static uint8_t mcastIndex[LORAWAN_MCAST_INDEX_SIZE];
+static LorawanMcastGroupCtx_t mcastGroupCtx[LORAWAN_MCAST_GROUP_COUNT_SUPPORTED];
+#endif /* #if (FEATURE_DL_MCAST == 1) */
 
+/*********************** LOCAL FUNCTION PROTOTYPES ****************************/
+#if (FEATURE_DL_MCAST == 1)
+static void LorawanMcastUpdateGroupCtx(uint8_t groupId);
+static bool LorawanMcastFcntInWindow(LorawanMcastActivationParams_t *group, uint32_t fCnt);
+#endif /* #if (FEATURE_DL_MCAST == 1) */
 
 /*********************** FUNCTION DEFINITIONS *********************************/
 
@@ -76,6 +111,57 @@ void LorawanMcastInit(void)
     }
        loRa.receiveWindowCParameters.dataRate = loRa.receiveWindow2Parameters.dataRate;
        loRa.receiveWindowCParameters.frequency = loRa.receiveWindow2Parameters.frequency;
+    LorawanMcastRebuildIndex();
+#endif /* #if (FEATURE_DL_MCAST == 1) */
+}
+
+/*********************************************************************//**
+\brief  Rebuilds the McAddr index and the cached per group contexts from
+        loRa.mcastParams. Must be called whenever a group address, key
+        or the group mask changes, including after a PDS restore
+*************************************************************************/
+void LorawanMcastRebuildIndex(void)
+{
+#if (FEATURE_DL_MCAST == 1)
+    uint8_t slot;
+
+    memset(mcastIndex, LORAWAN_MCAST_INDEX_EMPTY, sizeof(mcastIndex));
+
+    for(uint8_t i = 0; i < LORAWAN_MCAST_GROUP_COUNT_SUPPORTED; i++)
+    {
+        LorawanMcastUpdateGroupCtx(i);
+
+        if(0 == (loRa.mcastParams.mcastGroupMask & (0x01 << i)))
+        {
+            continue;
+        }
+
+        slot = LORAWAN_MCAST_INDEX_HASH(loRa.mcastParams.activationParams[i].mcastDevAddr.value);
+        while (LORAWAN_MCAST_INDEX_EMPTY != mcastIndex[slot])
+        {
+            slot = (slot + 1) & (LORAWAN_MCAST_INDEX_SIZE - 1);
+        }
+        mcastIndex[slot] = i;
+    }
+#endif /* #if (FEATURE_DL_MCAST == 1) */
+}
+
+/*********************************************************************//**
+\brief  Computes the CMAC of a received multicast frame using the
+        subkeys cached for the group
+\param[in]  groupId - multicast group the frame was matched to
+\param[out] output  - 16 bytes CMAC value
+\param[in]  input   - B0 block followed by the frame without MIC
+\param[in]  size    - length of input
+\return     SAL_SUCCESS, if the CMAC is computed
+*************************************************************************/
+SalStatus_t LorawanMcastComputeCmac(uint8_t groupId, uint8_t *output, uint8_t *input, uint16_t size)
+{
+#if (FEATURE_DL_MCAST == 1)
+    return SAL_AESCmacWithSubkeys(loRa.mcastParams.activationParams[groupId].mcastNwkSKey, SAL_MCAST_NWKS_KEY,
+                mcastGroupCtx[groupId].cmacK1, mcastGroupCtx[groupId].cmacK2, output, input, size);
+#else /* #if (FEATURE_DL_MCAST == 1) */
+    return SAL_FAILURE;
 #endif /* #if (FEATURE_DL_MCAST == 1) */
 }
 
@@ -119,6 +205,7 @@ StackRetStatus_t LorawanMcastEnable(bool enable, uint8_t groupId)
             PDS_STORE(PDS_MAC_MCAST_SUPPORTED_GROUP_CNTR);
 
         }
+        LorawanMcastRebuildIndex();
     }
 #endif /* #if (FEATURE_DL_MCAST == 1) */
     return status;
@@ -151,26 +238,27 @@ StackRetStatus_t LorawanMcastValidateHdr(Hdr_t *hdr, uint8_t mType, uint8_t fPor
         else
             fail
     */
-    for(uint8_t i = 0; i < LORAWAN_MCAST_GROUP_COUNT_SUPPORTED; i++)
+    uint8_t slot = LORAWAN_MCAST_INDEX_HASH(hdr->members.devAddr.value);
+    uint8_t i;
+
+    /* Only enabled groups are present in the index */
+    for (uint8_t probe = 0; probe < LORAWAN_MCAST_INDEX_SIZE; probe++)
     {
-        /* Check whether the MCAST group is enabled.
-         * if not continue
-         */
-        if(0 == (loRa.mcastParams.mcastGroupMask & (0x01 << i)))
+        i = mcastIndex[slot];
+        if (LORAWAN_MCAST_INDEX_EMPTY == i)
         {
-            continue;
+            break;
         }
-        /* If MCAST is enable, compare the Dev address*/
-        if ((hdr->members.devAddr.value == loRa.mcastParams.activationParams[i].mcastDevAddr.value) &&
-            ((CLASS_B | CLASS_C) & loRa.edClass)) //check for ED is either Class C or B
+
+        if (hdr->members.devAddr.value == loRa.mcastParams.activationParams[i].mcastDevAddr.value)
         {
             /*Fport Should not be Zero
              Fopts length should be Zero
              The ACK and ADRACKReq bits must be zero
              The MType field must carry the value for Unconfirmed Data Down.*/
 
-            if (!
-                ((fPort == 0) ||
+            if (((CLASS_B | CLASS_C) & loRa.edClass) && //check for ED is either Class C or B
+                !((fPort == 0) ||
                 (hdr->members.fCtrl.fOptsLen != 0) ||
                 (hdr->members.fCtrl.ack != 0) ||
                 (hdr->members.fCtrl.adrAckReq != 0) ||
@@ -180,6 +268,9 @@ StackRetStatus_t LorawanMcastValidateHdr(Hdr_t *hdr, uint8_t mType, uint8_t fPor
                 *groupId = i;
             }
         }
+        /* Groups sharing an McAddr are probed in groupId order, the last
+         * valid one is taken as the linear scan did */
+        slot = (slot + 1) & (LORAWAN_MCAST_INDEX_SIZE - 1);
     }
 #else /* #if (FEATURE_DL_MCAST == 1) */
     status = LORAWAN_INVALID_PARAMETER;
@@ -202,7 +293,6 @@ StackRetStatus_t LorawanMcastProcessPkt(uint8_t* buffer, uint8_t bufferLength, H
     SalStatus_t sal_status = SAL_SUCCESS;
 #if (FEATURE_DL_MCAST == 1)
     uint8_t frmPayloadLength;
-    uint8_t bufferIndex;
     uint8_t *packet;
     uint32_t extractedMic;
     uint8_t fPort;
@@ -213,31 +303,12 @@ StackRetStatus_t LorawanMcastProcessPkt(uint8_t* buffer, uint8_t bufferLength, H
     buffer += (LORAWAN_FHDR_SIZE_WITHOUT_FOPTS + sizeof(fPort));
     frmPayloadLength = bufferLength - LORAWAN_FHDR_SIZE_WITHOUT_FOPTS - sizeof (extractedMic); //frmPayloadLength includes port
 
-    bufferIndex = 16 + LORAWAN_FHDR_SIZE_WITHOUT_FOPTS + sizeof (fPort);
-
-    if (group->mcastFCntDownMin.value < group->mcastFCntDownMax.value)
-    {
-        /* there is no wraparound of counter i.e., min <= cur < max */
-        canProcessMcastPacket = (group->mcastFCntDownMin.value <= group->mcastFCntDown.value);
-        canProcessMcastPacket = canProcessMcastPacket && (group->mcastFCntDown.value < group->mcastFCntDownMax.value);
-    }
-    else /* counter will wraparound eventually */
-    {
-        /* if following is true then counter has not wrapped around yet */
-        canProcessMcastPacket = (group->mcastFCntDownMin.value <= group->mcastFCntDown.value);
-
-        if (false == canProcessMcastPacket) /* counter has wrapped around */
-        {
-            /* counter is still within the max value */
-            canProcessMcastPacket = (group->mcastFCntDown.value < group->mcastFCntDownMax.value);
-        }
-    }
+    canProcessMcastPacket = LorawanMcastFcntInWindow(group, group->mcastFCntDown.value);
 
     if (canProcessMcastPacket)
     {
-        group->mcastFCntDown.members.valueLow = hdr->members.fCnt;
         PDS_STORE(PDS_MAC_MCAST_FCNT_DWN);
-        sal_status = EncryptFRMPayload (buffer, frmPayloadLength-1, 1, loRa.mcastParams.activationParams[groupId].mcastFCntDown.value, loRa.mcastParams.activationParams[groupId].mcastAppSKey, SAL_MCAST_APPS_KEY, bufferIndex, radioBuffer, loRa.mcastParams.activationParams[groupId].mcastDevAddr.value);
+        sal_status = EncryptFRMPayload (buffer, frmPayloadLength-1, 1, loRa.mcastParams.activationParams[groupId].mcastFCntDown.value, loRa.mcastParams.activationParams[groupId].mcastAppSKey, SAL_MCAST_APPS_KEY, 0, buffer, loRa.mcastParams.activationParams[groupId].mcastDevAddr.value);
         if (SAL_SUCCESS != sal_status)
         {
             /* Transaction complete Event */
@@ -294,6 +365,7 @@ StackRetStatus_t LorawanAddMcastAddr(uint32_t mcast_devaddr, uint8_t groupId)
         PDS_STORE(PDS_MAC_MCAST_DEV_ADDR);
         loRa.mcastParams.activationParams[groupId].mcastKeysMask.mcastDeviceAddress = 1;
         PDS_STORE(PDS_MAC_MCAST_KEYS);
+        LorawanMcastRebuildIndex();
         result = LORAWAN_SUCCESS;
     }
     return result;
@@ -346,6 +418,7 @@ StackRetStatus_t LorawanAddMcastNwkskey(uint8_t * nwkSkey, uint8_t groupId)
         PDS_STORE(PDS_MAC_MCAST_NWK_SKEY);
         loRa.mcastParams.activationParams[groupId].mcastKeysMask.mcastNetworkSessionKey = 1;
         PDS_STORE(PDS_MAC_MCAST_KEYS);
+        LorawanMcastUpdateGroupCtx(groupId);
         result = LORAWAN_SUCCESS;
     }
     return result;
@@ -464,3 +537,39 @@ StackRetStatus_t LorawanAddMcastPeriodicity(uint8_t periodicity, uint8_t groupId
     }
     return result;
 }
+
+#if (FEATURE_DL_MCAST == 1)
+/*********************************************************************//**
+\brief  Updates the cached context of a group from its McNwkSKey
+\param[in]  groupId - multicast group to update
+*************************************************************************/
+static void LorawanMcastUpdateGroupCtx(uint8_t groupId)
+{
+    SAL_AESCmacSubkeys(loRa.mcastParams.activationParams[groupId].mcastNwkSKey, SAL_MCAST_NWKS_KEY,
+                mcastGroupCtx[groupId].cmacK1, mcastGroupCtx[groupId].cmacK2);
+}
+
+/*********************************************************************//**
+\brief  Checks a downlink frame counter against the FCnt window of a group
+\param[in]  group - multicast group parameters
+\param[in]  fCnt  - 32-bit frame counter to check
+\return     true, if the frame counter is within [min, max)
+*************************************************************************/
+static bool LorawanMcastFcntInWindow(LorawanMcastActivationParams_t *group, uint32_t fCnt)
+{
+    bool inWindow;
+
+    if (group->mcastFCntDownMin.value < group->mcastFCntDownMax.value)
+    {
+        /* there is no wraparound of counter i.e., min <= cur < max */
+        inWindow = (group->mcastFCntDownMin.value <= fCnt) && (fCnt < group->mcastFCntDownMax.value);
+    }
+    else /* counter will wraparound eventually */
+    {
+        /* either the counter has not wrapped around yet or it is still within the max value */
+        inWindow = (group->mcastFCntDownMin.value <= fCnt) || (fCnt < group->mcastFCntDownMax.value);
+    }
+
+    return inWindow;
+}
+#endif /* #if (FEATURE_DL_MCAST == 1) */
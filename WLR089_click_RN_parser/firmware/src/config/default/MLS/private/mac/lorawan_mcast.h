@@ -44,6 +44,25 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 *************************************************************************/
 void LorawanMcastInit(void);
 
+/*********************************************************************//**
+\brief	Rebuilds the McAddr index and the cached per group contexts.
+        Called whenever a group address, key or the group mask changes
+
+\return					- none.
+*************************************************************************/
+void LorawanMcastRebuildIndex(void);
+
+/*********************************************************************//**
+\brief	Computes the CMAC of a received multicast frame using the
+        subkeys cached for the group
+\param[in]  groupId - multicast group the frame was matched to
+\param[out] output  - 16 bytes CMAC value
+\param[in]  input   - B0 block followed by the frame without MIC
+\param[in]  size    - length of input
+\return	    SAL_SUCCESS, if the CMAC is computed
+*************************************************************************/
+SalStatus_t LorawanMcastComputeCmac(uint8_t groupId, uint8_t *output, uint8_t *input, uint16_t size);
+
 /*********************************************************************//**
 \brief	Check if the incoming packet is a multicast group the device
         supports
@@ -35,6 +35,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "lorawan_private.h"
 extern LoRa_t loRa;
 #include "lorawan_pds.h"
+#include "lorawan_mcast.h"
 
 /* PDS MAC Item declaration */
 
@@ -261,6 +262,8 @@ const ItemMap_t pds_mac_fid2_item_list[] = {
 
 void Lorawan_Pds_fid1_CB(void)
 {
+    /* Multicast groups are restored from this file */
+    LorawanMcastRebuildIndex();
     //loRa.mcastParams.activationParams.mcastFCntDown.value += MAX_FCNT_PDS_UPDATE_VALUE;
     //loRa.fCntUp.value += MAX_FCNT_PDS_UPDATE_VALUE;
 }
@@ -368,7 +368,11 @@ typedef struct _LorawanMcastParams_t
 {
 	/** number of mcast groups - currently 1 */
 	uint8_t numSupportedMcastGroups;
+#if (LORAWAN_MCAST_GROUP_COUNT_SUPPORTED > 8)
+	uint16_t mcastGroupMask;
+#else
 	uint8_t mcastGroupMask;
+#endif
 	/** activation parameters for multicast downlink packet processing */
 	/* TODO : change below to array when multiple mcast groups are supported */
 	LorawanMcastActivationParams_t activationParams[LORAWAN_MCAST_GROUP_COUNT_SUPPORTED];
@@ -477,7 +481,6 @@ typedef struct _Lora
 	ecrConfig_t ecrConfig;
 	LinkAdrResp_t linkAdrResp;
 	bool retransmission;
-	uint8_t radioClkStableDelay;
 	uint8_t maxFcntPdsUpdateValue;
 	bool cryptoDeviceEnabled;
     DevTime_t devTime;
@@ -59,6 +59,7 @@ extern "C" {
 
 void LORAWAN_TxDone(void *param);
 
+/* buffer must be preceded by AES_BLOCKSIZE bytes of headroom, the MIC is computed in place */
 StackRetStatus_t LORAWAN_RxDone (uint8_t *buffer, uint8_t bufferLength);
 
 void LORAWAN_RxTimeout (void);
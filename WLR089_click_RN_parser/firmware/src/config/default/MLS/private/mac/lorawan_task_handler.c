@@ -263,23 +263,10 @@ SYSTEM_TaskStatus_t LORAWAN_JoinReqHandler(void)
  ******************************************************************************/
 SYSTEM_TaskStatus_t LORAWAN_RxHandler(void)
 {
+	/* The received frames are handed over by the radio callback, only the
+	   timeouts are deferred to this task */
 	switch(callbackBackup)
 	{
-		case RADIO_RX_DONE_CALLBACK:
-		case RADIO_RX_ERROR_CALLBACK:
-		{
-			uint8_t *data;
-			uint16_t dataLen;
-
-			/* Buffer length is not checked as it can be 0 for error case */
-			RADIO_GetData(&data, &dataLen);
-			if (NULL != data)
-			{
-				LORAWAN_RxDone(data, dataLen);
-			}
-		}
-		break;
-
 		case RADIO_RX_TIMEOUT_CALLBACK:
 		{
 			LORAWAN_RxTimeout();
@@ -51,41 +51,45 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /************************************************************************/
 
 /************************************************************************/
-/*  Global variables                                                    */
+/*  Static variables                                                    */
 /************************************************************************/
+static volatile RadioLBTScanState_t lbtScanState = LBT_SCAN_IDLE;
 
 /************************************************************************/
 /*  Extern variables                                                    */
 /************************************************************************/
-extern volatile RadioEvents_t       radioEvents;
 extern volatile RadioCallbackMask_t radioCallbackMask;
 
 /************************************************************************/
 /*  Static functions                                                    */
 /************************************************************************/
+static void Radio_LBTSampleTimeout(void *param);
+static void Radio_LBTScanDone(bool channelFree);
 
 /************************************************************************/
 /*  Function Definitions                                                */
 /************************************************************************/
 /*********************************************************************//**
-\brief	This function sets up the radio for scan.
- 
+\brief	This function sets up the radio for scan and starts the sample
+		timer. The samples are then taken by RADIO_ScanHandler and the
+		transmission is resumed by RADIO_TxHandler once the channel is
+		found free.
+
 \param 	- none
-\return	- returns the success or failure of a task
+\return	- none
 *************************************************************************/
-SYSTEM_TaskStatus_t RADIO_ScanHandler(void)
+void Radio_LBTScanStart(void)
 {
-
-    Radio_SetClockInput();
 	// Turn on the RF switch.
 	Radio_EnableRfControl(RADIO_RFCTRL_RX);
-	uint32_t local;
-	//Radio_WriteConfiguration(4);
+
+	//Write the center frequency of the channel to be check for RSSI
 	Radio_WriteFrequency(radioConfiguration.frequency);
 	radioConfiguration.lbt.lbtChannelRSSI = 0;
-	
-	Radio_WriteMode(MODE_SLEEP, MODULATION_FSK, 1);
-	
+	radioConfiguration.lbt.lbtRssiSamplesCount = 0;
+
+	Radio_WriteMode(MODE_SLEEP, MODULATION_FSK, 0);
+
 	// Mask all interrupts
 #ifdef ENABLE_DIO0
 	HAL_DisbleDIO0Interrupt();
@@ -107,30 +111,125 @@ SYSTEM_TaskStatus_t RADIO_ScanHandler(void)
 #endif /* ENABLE_DIO5 */
 	/* Write Bandwidth as 200KHz to read RSSI throughout channel bandwidth */
 	RADIO_RegisterWrite(REG_FSK_RXBW, FSKBW_200_0KHZ);
-	
+
+	/* Non blocking switch, the first sample is taken once the receiver has settled */
 	Radio_WriteMode(MODE_RXCONT, MODULATION_FSK, 0);
 
-	// Time needed for Radio to be ready to take RSSI measurements
-	local = MS_TO_US(9U);
-	SwTimerStart(radioConfiguration.lbt.lbtScanTimerId, local, SW_TIMEOUT_RELATIVE, (void *)Radio_LBTScanTimeout, NULL);
-	
-	return SYSTEM_TASK_SUCCESS;
+	lbtScanState = LBT_SCAN_RUNNING;
+	if (LORAWAN_SUCCESS != SwTimerTickStart(RADIO_LBT_RX_SETUP_TIME, (void *)Radio_LBTSampleTimeout))
+	{
+		// The channel cannot be sampled, it is not used
+		Radio_LBTScanDone(false);
+	}
+}
+
+/*********************************************************************//**
+\brief	This function stops an ongoing scan and puts the radio to sleep.
+		A wait for the oscillator is not stopped, see Radio_ClockWaitStop.
+
+\param 	- none
+\return	- none
+*************************************************************************/
+void Radio_LBTScanStop(void)
+{
+	radioClearTask(RADIO_SCAN_TASK_ID);
+	if (LBT_SCAN_RUNNING == lbtScanState)
+	{
+		// The tick timer is only the scan's while it runs
+		SwTimerTickStop();
+		Radio_WriteMode(MODE_SLEEP, MODULATION_FSK, 0);
+		Radio_DisableRfControl(RADIO_RFCTRL_RX);
+	}
+	lbtScanState = LBT_SCAN_IDLE;
 }
 
 /*********************************************************************//**
-\brief	This function is triggered by the scan done event and it sets up
-		the radio for scanning.
+\brief	This function tells whether the last scan found the channel free.
+		The result is consumed, so that the next transmission scans again.
+
+\param 	- none
+\return	- true if the channel is free for the transmission
+*************************************************************************/
+bool Radio_LBTIsChannelFree(void)
+{
+	bool channelFree = (LBT_SCAN_CHANNEL_FREE == lbtScanState);
+
+	if (channelFree)
+	{
+		lbtScanState = LBT_SCAN_IDLE;
+	}
+	return channelFree;
+}
+
+/*********************************************************************//**
+\brief	This function takes one RSSI sample of the scan. The scan ends
+		as soon as a sample is above lbtThreshold, or after
+		lbtNumOfSamples samples below it.
 
 \param 	- none
 \return	- returns the success or failure of a task
 *************************************************************************/
-SYSTEM_TaskStatus_t radioScanDoneHandler(void)
+SYSTEM_TaskStatus_t RADIO_ScanHandler(void)
+{
+	int16_t instRSSI;
+
+	if (LBT_SCAN_RUNNING != lbtScanState)
+	{
+		return SYSTEM_TASK_SUCCESS;
+	}
+
+	/* Read the channel Instantaneous RSSI value */
+	Radio_ReadFSKRssi(&instRSSI);
+	radioConfiguration.lbt.lbtRssiSamplesCount++;
+	if ((1 == radioConfiguration.lbt.lbtRssiSamplesCount) || (instRSSI > radioConfiguration.lbt.lbtChannelRSSI))
+	{
+		radioConfiguration.lbt.lbtChannelRSSI = instRSSI;
+	}
+
+	if (instRSSI > radioConfiguration.lbt.params.lbtThreshold)
+	{
+		Radio_LBTScanDone(false);
+	}
+	else if (radioConfiguration.lbt.lbtRssiSamplesCount >= radioConfiguration.lbt.params.lbtNumOfSamples)
+	{
+		Radio_LBTScanDone(true);
+	}
+	else if (LORAWAN_SUCCESS != SwTimerTickStart(radioConfiguration.lbt.lbtScanTimeout, (void *)Radio_LBTSampleTimeout))
+	{
+		Radio_LBTScanDone(false);
+	}
+
+	return SYSTEM_TASK_SUCCESS;
+}
+
+/*********************************************************************//**
+\brief	This function is the callback function of the LBT sample timer.
+		It is called from the timer interrupt, the sample is taken by
+		the scan task.
+
+\param param - not used.
+\return      - none
+*************************************************************************/
+static void Radio_LBTSampleTimeout(void *param)
+{
+	(void)param;
+	radioPostTask(RADIO_SCAN_TASK_ID);
+}
+
+/*********************************************************************//**
+\brief	This function ends the scan. The transmission is started if the
+		channel is free, otherwise the upper layer is informed that the
+		channel is busy.
+
+\param channelFree - true if all the samples were below lbtThreshold.
+\return            - none
+*************************************************************************/
+static void Radio_LBTScanDone(bool channelFree)
 {
-	radioEvents.LbtScanDoneEvent = 0;
 	RadioCallbackParam_t RadioCallbackParam;
 
 	Radio_WriteMode(MODE_SLEEP, MODULATION_FSK, 0);
-	
+
 #ifdef ENABLE_DIO0
 	HAL_EnableDIO0Interrupt();
 #endif /* ENABLE_DIO0 */
@@ -152,16 +251,18 @@ SYSTEM_TaskStatus_t radioScanDoneHandler(void)
 
 	// Turning off the RF switch now.
 	Radio_DisableRfControl(RADIO_RFCTRL_RX);
-	//Powering Off the Oscillator after putting TRX to sleep
-	Radio_ResetClockInput();
-	
-	if (radioConfiguration.lbt.lbtChannelRSSI < radioConfiguration.lbt.params.lbtThreshold)
+
+	if (channelFree)
 	{
-		RadioSetState(RADIO_STATE_TX);
+		lbtScanState = LBT_SCAN_CHANNEL_FREE;
 		RADIO_TxHandler();
 	}
 	else
 	{
+		lbtScanState = LBT_SCAN_IDLE;
+		//Powering Off the Oscillator after putting TRX to sleep
+		Radio_ResetClockInput();
+
 		RadioCallbackParam.status = ERR_CHANNEL_BUSY;
 		RadioSetState(RADIO_STATE_IDLE);
 		if (1 == radioCallbackMask.BitMask.radioTxDoneCallback)
@@ -172,42 +273,6 @@ SYSTEM_TaskStatus_t radioScanDoneHandler(void)
 			}
 		}
 	}
-	
-	return SYSTEM_TASK_SUCCESS;
-}
-
-/*********************************************************************//**
-\brief	This function is the callback function for LBT scan timer 
-        timeout.
-
-\param time - not used.
-\return     - none
-*************************************************************************/
-void Radio_LBTScanTimeout(uint8_t time)
-{	
-	(void)time;
-	int16_t tempRssi;
-	radioConfiguration.lbt.lbtRssiSamplesCount++;
-	if (radioConfiguration.lbt.lbtRssiSamplesCount <= radioConfiguration.lbt.params.lbtNumOfSamples)
-	{
-		Radio_ReadFSKRssi(&tempRssi);
-		radioConfiguration.lbt.lbtRssiSamples += (tempRssi * radioConfiguration.lbt.lbtRssiSamplesCount);
-		SwTimerStart(radioConfiguration.lbt.lbtScanTimerId, radioConfiguration.lbt.lbtScanTimeout, SW_TIMEOUT_RELATIVE, (void *)Radio_LBTScanTimeout, NULL);
-	}
-	else
-	{
-		radioEvents.LbtScanDoneEvent = 1;
-		// Here we are dividing the weighted radioConfiguration.lbt.lbtRssiSamples by the sum of their weights to calculate the weighted average.
-		// Since the weights increment linearly like 1, 2, 3 and so on we can use the sum of n natural numbers formula n=(n*(n+1))/2 to calculate the total weights added.
-		// Here n is radioConfiguration.lbt.lbtRssiSamplesCount and since it is pre incremented in line #264 we use n=(n*(n-1))/2.
-		// So radioConfiguration.lbt.lbtRssiSamples/(((radioConfiguration.lbt.lbtRssiSamplesCount*(radioConfiguration.lbt.lbtRssiSamplesCount-1)))/2) is
-		// (radioConfiguration.lbt.lbtRssiSamples*2)/((radioConfiguration.lbt.lbtRssiSamplesCount*(radioConfiguration.lbt.lbtRssiSamplesCount-1)))
-		// optimizing to (radioConfiguration.lbt.lbtRssiSamples<<1)/((radioConfiguration.lbt.lbtRssiSamplesCount*(radioConfiguration.lbt.lbtRssiSamplesCount-1)))
-		radioConfiguration.lbt.lbtChannelRSSI = (radioConfiguration.lbt.lbtRssiSamples<<1)/((uint16_t)(radioConfiguration.lbt.lbtRssiSamplesCount*(radioConfiguration.lbt.lbtRssiSamplesCount-1)));
-		radioConfiguration.lbt.lbtRssiSamplesCount = 0;
-		radioConfiguration.lbt.lbtRssiSamples = 0;
-		radioPostTask(RADIO_TX_DONE_TASK_ID);
-	}
 }
 
 /*#endif LBT*/
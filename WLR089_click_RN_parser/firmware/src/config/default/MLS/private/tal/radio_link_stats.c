@@ -0,0 +1,270 @@
+/**
+* \file  radio_link_stats.c
+*
+* \brief This is the Radio link statistics source file which contains the received
+*		frame statistics of the channels and data rates for SX1276
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+
+
+
+
+/************************************************************************/
+/*  Includes                                                            */
+/************************************************************************/
+#include "radio_link_stats.h"
+#include "radio_driver_SX1276.h"
+#include "radio_interface.h"
+#include <string.h>
+
+/************************************************************************/
+/*  Static variables                                                    */
+/************************************************************************/
+static uint32_t                     channelFrequency[RADIO_LINK_STATS_CHANNELS];
+static RadioLinkStats_t             channelStats[RADIO_LINK_STATS_CHANNELS];
+static RadioLinkStats_t             rateStats[RADIO_LINK_STATS_RATES];
+
+/************************************************************************/
+/*  Static functions                                                    */
+/************************************************************************/
+static void Radio_LinkStatsAccount(RadioLinkStats_t *stats, RadioLinkEvent_t event);
+static uint8_t Radio_LinkStatsChannel(uint32_t frequency);
+
+/************************************************************************/
+/*  Function Definitions                                                */
+/************************************************************************/
+/*********************************************************************//**
+\brief	This function accounts a reception event to the statistics of the
+		current channel and of the current spreading factor and bandwidth.
+		For received frames the packet RSSI and SNR shall be updated first.
+
+\param event	- The reception event.
+\return			- none
+*************************************************************************/
+void Radio_LinkStatsUpdate(RadioLinkEvent_t event)
+{
+	uint8_t index;
+
+	if ((MODULATION_LORA != radioConfiguration.modulation) ||
+		(SF_7 > radioConfiguration.dataRate) || (SF_12 < radioConfiguration.dataRate) ||
+		(BW_125KHZ > radioConfiguration.bandWidth) || (BW_500KHZ < radioConfiguration.bandWidth))
+	{
+		return;
+	}
+
+	index = Radio_LinkStatsChannel(radioConfiguration.frequency);
+	Radio_LinkStatsAccount(&channelStats[index], event);
+
+	index = ((radioConfiguration.dataRate - SF_7) * (BW_500KHZ - BW_125KHZ + 1)) + (radioConfiguration.bandWidth - BW_125KHZ);
+	Radio_LinkStatsAccount(&rateStats[index], event);
+}
+
+/*********************************************************************//**
+\brief	This function reads the statistics of a channel.
+
+\param index		- The entry, from 0 to RADIO_LINK_STATS_CHANNELS - 1.
+\param frequency	- The frequency of the channel.
+\param stats		- The statistics of the channel.
+\return				- false if the entry is not used.
+*************************************************************************/
+bool RADIO_GetChannelLinkStats(uint8_t index, uint32_t *frequency, RadioLinkStats_t *stats)
+{
+	if ((RADIO_LINK_STATS_CHANNELS <= index) || (0 == channelFrequency[index]))
+	{
+		return false;
+	}
+
+	*frequency = channelFrequency[index];
+	memcpy(stats, &channelStats[index], sizeof(RadioLinkStats_t));
+
+	return true;
+}
+
+/*********************************************************************//**
+\brief	This function reads the statistics of a spreading factor and
+		bandwidth.
+
+\param index	- The entry, from 0 to RADIO_LINK_STATS_RATES - 1.
+\param sf		- The spreading factor.
+\param bw		- The bandwidth.
+\param stats	- The statistics of the spreading factor and bandwidth.
+\return			- false if nothing was received with them.
+*************************************************************************/
+bool RADIO_GetRateLinkStats(uint8_t index, RadioDataRate_t *sf, RadioLoRaBandWidth_t *bw, RadioLinkStats_t *stats)
+{
+	if (RADIO_LINK_STATS_RATES <= index)
+	{
+		return false;
+	}
+	if ((0 == rateStats[index].rxCount) && (0 == rateStats[index].crcErrorCount) && (0 == rateStats[index].rxTimeoutCount))
+	{
+		return false;
+	}
+
+	*sf = (RadioDataRate_t)(SF_7 + (index / (BW_500KHZ - BW_125KHZ + 1)));
+	*bw = (RadioLoRaBandWidth_t)(BW_125KHZ + (index % (BW_500KHZ - BW_125KHZ + 1)));
+	memcpy(stats, &rateStats[index], sizeof(RadioLinkStats_t));
+
+	return true;
+}
+
+/*********************************************************************//**
+\brief	This function estimates a percentile of the SNR from the histogram
+		of the statistics, at the resolution of a bin.
+
+\param stats	- The statistics.
+\param percent	- The percentile, from 1 to 100.
+\return			- The lower bound of the bin holding the percentile in dB,
+				  RADIO_LINK_STATS_SNR_NONE if no frame was received.
+*************************************************************************/
+int8_t RADIO_GetLinkStatsSnrPercentile(RadioLinkStats_t *stats, uint8_t percent)
+{
+	uint32_t total = 0;
+	uint32_t target;
+	uint8_t bin;
+
+	for (bin = 0; bin < RADIO_LINK_STATS_SNR_BINS; bin++)
+	{
+		total += stats->snrHistogram[bin];
+	}
+	if (0 == total)
+	{
+		return RADIO_LINK_STATS_SNR_NONE;
+	}
+
+	// Rank of the percentile, rounded up, among the frames counted
+	target = ((total * percent) + 99) / 100;
+	total = 0;
+	for (bin = 0; bin < (RADIO_LINK_STATS_SNR_BINS - 1); bin++)
+	{
+		total += stats->snrHistogram[bin];
+		if (total >= target)
+		{
+			break;
+		}
+	}
+
+	return (int8_t)(RADIO_LINK_STATS_SNR_MIN + (((int8_t)bin - 1) * RADIO_LINK_STATS_SNR_STEP));
+}
+
+/*********************************************************************//**
+\brief	This function finds the entry of a channel. The entries are probed
+		from the 100 kHz grid slot of the frequency onwards, so that two
+		channels of the same slot, e.g. 867.9 MHz and 869.525 MHz, get
+		entries of their own. A new channel takes the first free entry, or
+		the entry of its slot once all of them are used.
+
+\param frequency	- The frequency of the channel.
+\return				- The entry of the channel.
+*************************************************************************/
+static uint8_t Radio_LinkStatsChannel(uint32_t frequency)
+{
+	uint8_t index = (frequency / 100000) % RADIO_LINK_STATS_CHANNELS;
+
+	for (uint8_t probe = 0; probe < RADIO_LINK_STATS_CHANNELS; probe++)
+	{
+		if (channelFrequency[index] == frequency)
+		{
+			return index;
+		}
+		if (0 == channelFrequency[index])
+		{
+			break;
+		}
+		index = (index + 1) % RADIO_LINK_STATS_CHANNELS;
+	}
+
+	// With all the entries used the probe ends back at the slot
+	channelFrequency[index] = frequency;
+	memset(&channelStats[index], 0, sizeof(RadioLinkStats_t));
+
+	return index;
+}
+
+/*********************************************************************//**
+\brief	This function accounts a reception event to statistics.
+
+\param stats	- The statistics.
+\param event	- The reception event.
+\return			- none
+*************************************************************************/
+static void Radio_LinkStatsAccount(RadioLinkStats_t *stats, RadioLinkEvent_t event)
+{
+	int16_t rssi;
+	uint8_t bin;
+
+	if (RADIO_LINK_RX_TIMEOUT == event)
+	{
+		if (UINT16_MAX != stats->rxTimeoutCount)
+		{
+			stats->rxTimeoutCount++;
+		}
+		return;
+	}
+
+	if (RADIO_LINK_CRC_ERROR == event)
+	{
+		if (UINT16_MAX != stats->crcErrorCount)
+		{
+			stats->crcErrorCount++;
+		}
+		return;
+	}
+
+	// The average starts from the first packet RSSI
+	rssi = radioConfiguration.packetRSSI * 16;
+	if (0 == stats->rxCount)
+	{
+		stats->rssiAverage = rssi;
+	}
+	else
+	{
+		stats->rssiAverage += (rssi - stats->rssiAverage) / (1 << RADIO_LINK_STATS_RSSI_SHIFT);
+	}
+	if (UINT16_MAX != stats->rxCount)
+	{
+		stats->rxCount++;
+	}
+
+	if (RADIO_LINK_STATS_SNR_MIN > radioConfiguration.packetSNR)
+	{
+		bin = 0;
+	}
+	else
+	{
+		bin = ((radioConfiguration.packetSNR - RADIO_LINK_STATS_SNR_MIN) / RADIO_LINK_STATS_SNR_STEP) + 1;
+		if (RADIO_LINK_STATS_SNR_BINS <= bin)
+		{
+			bin = RADIO_LINK_STATS_SNR_BINS - 1;
+		}
+	}
+	if (UINT16_MAX != stats->snrHistogram[bin])
+	{
+		stats->snrHistogram[bin]++;
+	}
+}
+
+// EOL
@@ -56,8 +56,8 @@ static SYSTEM_TaskStatus_t (*radioTaskHandlers[RADIO_TASKS_COUNT])(void) = {
     RADIO_RxDoneHandler,
     RADIO_TxHandler,
     RADIO_RxHandler,
-	RADIO_ScanHandler
-    /* , RADIO_SleepHandler */
+	RADIO_ScanHandler,
+	RADIO_SleepHandler
 };
 
 /******************************************************************************
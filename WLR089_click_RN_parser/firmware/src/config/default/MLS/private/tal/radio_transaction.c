@@ -37,8 +37,10 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "radio_get_set.h"
 #include "radio_driver_hal.h"
 #include "radio_lbt.h"
+#include "radio_link_stats.h"
 #include "sw_timer.h"
 #include "sys.h"
+#include <string.h>
 
 /************************************************************************/
 /*  Static variables                                                    */
@@ -47,8 +49,28 @@ static uint8_t                      txBufferLen;
 static uint8_t                      *transmitBufferPtr = NULL;
 static uint64_t                     timeOnAir;
 static uint16_t                     rxWindowSize;
-
-static int16_t                      instRSSI;
+static RadioRxFrame_t               rxQueue[RADIO_RX_QUEUE_SIZE];
+static volatile uint8_t             rxQueueIn;
+static volatile uint8_t             rxQueueOut;
+static volatile uint8_t             rxQueueCount;
+// The LoRa receiver listens continuously with the settings of rxSettings,
+// from its request and across the frames it receives
+static volatile bool                rxRearmed;
+static RadioRxSettings_t            rxSettings;
+// The receiver was stopped by the last frame of the queue, the state goes
+// back to idle when the frames are handed over
+static volatile bool                rxEnded;
+// A frame is being handed over to the upper layer
+static bool                         rxDelivering;
+static uint16_t                     rxDropCount;
+// The TCXO is powered and usable by the radio from clockReadyTime
+static volatile bool                clockOn;
+static uint64_t                     clockReadyTime;
+// The tick timer waits for the oscillator, see Radio_ClockStable
+static volatile bool                clockWaitPending;
+// SW timers of the upper layer that start a radio operation
+static uint8_t                      clockUsers[RADIO_CLOCK_USERS];
+static uint8_t                      clockUserCount;
 
 /************************************************************************/
 /*  Global variables                                                    */
@@ -61,10 +83,23 @@ uint8_t radioBuffer[RADIO_BUFFER_SIZE];
 /************************************************************************/
 /* Static Fuctions                                                      */
 /************************************************************************/
-static void Radio_ReadPktRssi(void);
-static bool Radio_IsChannelFree(void);
-static void Radio_EnableInterruptLines(void);
-static void Radio_DisableInterruptLines(void);
+static void Radio_SetPktRssi(uint8_t snrValue, uint8_t rssiValue);
+static void Radio_RxQueueFlush(void);
+static void Radio_FSKReadFifo(bool payloadReady);
+static void Radio_RxQueueRelease(void);
+static void Radio_RxQueueDeliver(void);
+static void Radio_RxQueueDrain(void);
+static void Radio_RxDropped(uint8_t count);
+static void Radio_RxSettingsGet(RadioRxSettings_t *settings);
+static void Radio_StopReceive(void);
+static bool Radio_ClockStable(void);
+static void Radio_WaitClockStable(void);
+static void Radio_ClockStableTimeout(void *param);
+static void Radio_ClockWaitStop(void);
+static void Radio_ClockHoldTimeout(void *param);
+static void Radio_ClockOn(void);
+static uint32_t Radio_ClockNextUse(void);
+static void Radio_ClockSchedule(void);
 
 /************************************************************************/
 /* Implementations                                                      */
@@ -143,6 +178,7 @@ RadioError_t RADIO_TransmitCW(void)
 		
 		//Power On the Oscillator before putting the radio to transmit state
 		Radio_SetClockInput();
+		Radio_WaitClockStable();
         radioConfiguration.modulation = MODULATION_LORA;
 
         // Since we're interested in a transmission, rxWindowSize is irrelevant.
@@ -223,7 +259,9 @@ void RADIO_InitDefaultAttributes(void)
     radioConfiguration.rxBw = FSKBW_50_0KHZ;
     radioConfiguration.afcBw = FSKBW_83_3KHZ;
     radioConfiguration.dataBufferLen = 0;
-    radioConfiguration.dataBuffer = &radioBuffer[16];
+    rxRearmed = false;
+    rxEnded = false;
+    Radio_RxQueueFlush();
 	radioConfiguration.lbt.lbtChannelRSSI = 0;
 	radioConfiguration.lbt.lbtIrqFlagsBackup = 0;
 	radioConfiguration.lbt.lbtRssiSamples = 0;
@@ -260,14 +298,10 @@ void RADIO_InitDefaultAttributes(void)
         {
 			retVal = SwTimerCreate(&radioConfiguration.watchdogTimerId);
 		}
-/*#ifdef LBT*/
         if (LORAWAN_SUCCESS == retVal)
         {
-			retVal = SwTimerCreate(&radioConfiguration.lbt.lbtScanTimerId);
+			retVal = SwTimerCreate(&radioConfiguration.clockHoldTimerId);
 		}
-		
-
-/*#endif*/ // LBT
         if (LORAWAN_SUCCESS == retVal)
         {
 
@@ -284,8 +318,10 @@ void RADIO_InitDefaultAttributes(void)
         SwTimerStop(radioConfiguration.timeOnAirTimerId);
         SwTimerStop(radioConfiguration.fskRxWindowTimerId);
         SwTimerStop(radioConfiguration.watchdogTimerId);
+        SwTimerStop(radioConfiguration.clockHoldTimerId);
+		Radio_ClockWaitStop();
 /*#ifdef LBT*/
-		SwTimerStop(radioConfiguration.lbt.lbtScanTimerId);
+		Radio_LBTScanStop();
 /*#endif*/ // LBT
     }
 
@@ -299,6 +335,7 @@ void RADIO_InitDefaultAttributes(void)
 
 	//Power On the Oscillator before putting the radio to standby state
     Radio_SetClockInput();
+    Radio_WaitClockStable();
 
     // Perform image and RSSI calibration. This also puts the radio in FSK mode.
     // In order to perform image and RSSI calibration, we need the radio in
@@ -357,9 +394,16 @@ RadioError_t RADIO_Transmit(RadioTransmitParam_t *param)
 	/*          current behavior of the code because timers are not			*/
 	/*          separated for Rx and Tx, they are reused.					*/
 	/************************************************************************/
+	// The frames received so far are handed over before the receiver stops
+	Radio_RxQueueDrain();
+
     if (RADIO_STATE_IDLE != RADIO_GetState())
     {
-        return ERR_RADIO_BUSY;
+		if (false == Radio_RxPreemptible())
+		{
+			return ERR_RADIO_BUSY;
+		}
+		Radio_StopReceive();
     }
 
     // Make sure the watchdog won't trigger MAC functions erroneously
@@ -380,6 +424,11 @@ RadioError_t RADIO_Transmit(RadioTransmitParam_t *param)
 		radioPostTask(RADIO_TX_TASK_ID);
 	}
 
+	//Power on the Oscillator before putting the radio to transmit state.
+	//This is done once per frame: the TX task is posted again by the tick
+	//timer and by the LBT scan, which must not push the ready time back
+	Radio_SetClockInput();
+
 	return ERR_NONE;
 }
 
@@ -398,7 +447,21 @@ RadioError_t RADIO_Receive(RadioReceiveParam_t *param)
     {
         if (RADIO_STATE_IDLE != RADIO_GetState())
         {
-            return ERR_RADIO_BUSY;
+			RadioRxSettings_t settings;
+
+			Radio_RxSettingsGet(&settings);
+			if ((true == rxRearmed) && (0 == param->rxWindowSize) &&
+				(0 == memcmp(&settings, &rxSettings, sizeof(settings))))
+			{
+				// The receiver already listens with these settings
+				return ERR_NONE;
+			}
+			else if (false == Radio_RxPreemptible())
+			{
+				return ERR_RADIO_BUSY;
+			}
+			// The queued frames are kept for the upper layer
+			Radio_StopReceive();
         }
 		
 		// Make sure the watchdog won't trigger MAC functions erroneously
@@ -411,6 +474,11 @@ RadioError_t RADIO_Receive(RadioReceiveParam_t *param)
         rxWindowSize = param->rxWindowSize;
         RadioSetState(RADIO_STATE_RX);
         radioPostTask(RADIO_RX_TASK_ID);
+
+		// A continuous LoRa receiver goes on listening across the frames, a
+		// new request with the same settings leaves it running
+		rxRearmed = (0 == rxWindowSize) && (MODULATION_LORA == radioConfiguration.modulation);
+		Radio_RxSettingsGet(&rxSettings);
 		
 		//Power On the Oscillator before putting the radio to receive
 		Radio_SetClockInput();
@@ -419,46 +487,75 @@ RadioError_t RADIO_Receive(RadioReceiveParam_t *param)
     } 
     else /* RECEIVE_STOP */
     {
+		// The frames received so far are handed over before the receiver
+		// stops
+		Radio_RxQueueDrain();
+
 		if (RADIO_STATE_IDLE == RADIO_GetState())
 		{
 			return ERR_NONE;
 		}
-        else if (RADIO_STATE_RX != RADIO_GetState())
+        else if ((RADIO_STATE_RX != RADIO_GetState()) && (RADIO_STATE_IDLE != RADIO_GetState()))
         {
             return ERR_INVALID_REQ;
         } 
 
-        // Make sure the watchdog won't trigger MAC functions erroneously
-        SwTimerStop(radioConfiguration.watchdogTimerId);
-        if (MODULATION_FSK == radioConfiguration.modulation)
-        {
-            SwTimerStop(radioConfiguration.fskRxWindowTimerId);
-        }
+        Radio_StopReceive();
+    }
 
-        /************************************************************************/
-        /*  Note :	This is an example where we need to stop the reception      */
-		/*			but if i call RADIO_SetAttr it executes only if the			*/
-		/*			radio is in RADIO_STATE_IDLE, so we don't call that.		*/
-		/*			This means that if something must be set or get				*/
-		/*			internally within RADIO layer we directly access			*/
-		/*			the static functions.										*/
-        /************************************************************************/ 
-        Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
-		//Powering Off the Oscillator after putting TRX to sleep
-		Radio_ResetClockInput();
+    return ERR_NONE;
+}
 
-        // RxBuffer is released
-        RadioSetState(RADIO_STATE_IDLE);
-        radioClearTask(RADIO_RX_TASK_ID);
-        radioClearTask(RADIO_RX_DONE_TASK_ID);
+/*********************************************************************//**
+\brief	This function stops the reception. The frames still waiting for
+		the upper layer are handed over by the RADIO_RxDoneHandler.
+*************************************************************************/
+static void Radio_StopReceive(void)
+{
+    // Make sure the watchdog won't trigger MAC functions erroneously
+    SwTimerStop(radioConfiguration.watchdogTimerId);
+    if (MODULATION_FSK == radioConfiguration.modulation)
+    {
+        SwTimerStop(radioConfiguration.fskRxWindowTimerId);
     }
+    // Nor a pending oscillator or scan tick
+    Radio_ClockWaitStop();
+    Radio_LBTScanStop();
+
+    /************************************************************************/
+    /*  Note :	This is an example where we need to stop the reception      */
+    /*			but if i call RADIO_SetAttr it executes only if the			*/
+    /*			radio is in RADIO_STATE_IDLE, so we don't call that.		*/
+    /*			This means that if something must be set or get				*/
+    /*			internally within RADIO layer we directly access			*/
+    /*			the static functions.										*/
+    /************************************************************************/ 
+    Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+    //Powering Off the Oscillator after putting TRX to sleep
+    Radio_ResetClockInput();
 
-    return ERR_NONE;
+    RadioSetState(RADIO_STATE_IDLE);
+    radioClearTask(RADIO_RX_TASK_ID);
+    rxRearmed = false;
+    rxEnded = false;
+}
+
+/*********************************************************************//**
+\brief	This function tells whether the receiver may be stopped or
+		restarted by a new request although the state is RX: it listens
+		continuously, or it was stopped by a frame not handed over yet.
+
+\return	- true if the receiver may be stopped or restarted.
+*************************************************************************/
+bool Radio_RxPreemptible(void)
+{
+	return (RADIO_STATE_RX == RADIO_GetState()) && ((true == rxRearmed) || (true == rxEnded));
 }
 
 /*********************************************************************//**
 \brief	This function handles the payload transfer of bytes from buffer
-		to FIFO. 
+		to FIFO. It is called before the transmitter is started, so the
+		FifoEmpty interrupt cannot run concurrently with it.
 
 \param[in] buffer Pointer to the data to be written into the frame buffer
 \param[in] bufferLen Length of the data to be written
@@ -466,8 +563,6 @@ RadioError_t RADIO_Receive(RadioReceiveParam_t *param)
 *************************************************************************/
 void Radio_FSKTxPayloadHandler(uint8_t *buffer, uint8_t bufferLen)
 {
-
-	system_enter_critical_section();
 	if (radioConfiguration.fskPayloadIndex == 0)
 	{
 		if (bufferLen != 0)
@@ -500,8 +595,6 @@ void Radio_FSKTxPayloadHandler(uint8_t *buffer, uint8_t bufferLen)
 			}
 		}
 	}
-	system_leave_critical_section();
-	
 }
 
 /*********************************************************************//**
@@ -515,33 +608,19 @@ SYSTEM_TaskStatus_t RADIO_TxHandler(void)
 {
     uint8_t regValue;
 	
-	//Power on the Oscillator before putting the radio to transmit state
-	Radio_SetClockInput();
+	if (false == Radio_ClockStable())
+	{
+		/* The task is posted again once the oscillator is stable */
+		return SYSTEM_TASK_SUCCESS;
+	}
 		
     SwTimerStop(radioConfiguration.timeOnAirTimerId);
 	
-	if (true == radioConfiguration.lbt.params.lbtTransmitOn)
+	if ((true == radioConfiguration.lbt.params.lbtTransmitOn) && (false == Radio_LBTIsChannelFree()))
 	{
-		if (Radio_IsChannelFree() == false)
-		{
-			// Turning off the RF switch now.
-			Radio_DisableRfControl(RADIO_RFCTRL_RX);
-			//Powering Off the Oscillator after putting TRX to sleep
-			Radio_ResetClockInput();
-			
-			RadioCallbackParam_t RadioCallbackParam;
-			RadioCallbackParam.status = ERR_CHANNEL_BUSY;
-			RadioSetState(RADIO_STATE_IDLE);
-			if (1 == radioCallbackMask.BitMask.radioTxDoneCallback)
-			{
-				if (radioConfiguration.radioCallback)
-				{
-					radioConfiguration.radioCallback(RADIO_TX_DONE_CALLBACK, (void *) &(RadioCallbackParam));
-					return SYSTEM_TASK_SUCCESS;
-
-				}
-			}
-		}		
+		/* The scan task calls back RADIO_TxHandler once the channel is found free */
+		Radio_LBTScanStart();
+		return SYSTEM_TASK_SUCCESS;
 	}
 	
 	// Turn on the RF switch.
@@ -576,10 +655,11 @@ SYSTEM_TaskStatus_t RADIO_TxHandler(void)
         
 		radioConfiguration.fskPayloadIndex = 0;
         RADIO_FrameWrite(REG_FIFO, &txBufferLen, 1);
-        if (txBufferLen > RADIO_TX_FIFO_LEVEL)
+        // The length byte takes the first FIFO entry
+        if (txBufferLen > (RADIO_TX_FIFO_LEVEL - 1))
         {
-            RADIO_FrameWrite(REG_FIFO, transmitBufferPtr, RADIO_TX_FIFO_LEVEL);
-            radioConfiguration.fskPayloadIndex += RADIO_TX_FIFO_LEVEL;
+            RADIO_FrameWrite(REG_FIFO, transmitBufferPtr, RADIO_TX_FIFO_LEVEL - 1);
+            radioConfiguration.fskPayloadIndex = RADIO_TX_FIFO_LEVEL - 1;
         }
         else
         {
@@ -629,6 +709,12 @@ SYSTEM_TaskStatus_t RADIO_TxHandler(void)
 *************************************************************************/
 SYSTEM_TaskStatus_t RADIO_RxHandler(void)
 {
+	if (false == Radio_ClockStable())
+	{
+		/* The task is posted again once the oscillator is stable */
+		return SYSTEM_TASK_SUCCESS;
+	}
+
 	// Turn on the RF switch.
 	Radio_EnableRfControl(RADIO_RFCTRL_RX); 
 
@@ -690,6 +776,11 @@ SYSTEM_TaskStatus_t RADIO_RxHandler(void)
     if (0 == rxWindowSize)
     {
         Radio_WriteMode(MODE_RXCONT, radioConfiguration.modulation, 0);
+        if (true == rxRearmed)
+        {
+            // The settings may have been changed since the request
+            Radio_RxSettingsGet(&rxSettings);
+        }
     }
     else
     {
@@ -747,9 +838,6 @@ SYSTEM_TaskStatus_t RADIO_TxDoneHandler(void)
         radioEvents.FskTxDoneEvent = 0;
         RadioCallbackParam.TX.timeOnAir = (uint32_t) timeOnAir;
 		RadioCallbackParam.status = ERR_NONE;
-        Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
-		//Powering Off the Oscillator after putting TRX to sleep
-		Radio_ResetClockInput();
 		RadioSetState(RADIO_STATE_IDLE);
 		// clearing fsk playload index
 		radioConfiguration.fskPayloadIndex = 0;
@@ -761,12 +849,6 @@ SYSTEM_TaskStatus_t RADIO_TxDoneHandler(void)
 			}
         }
     }
-/*#ifdef LBT*/
-	else if (1 == radioEvents.LbtScanDoneEvent)
-	{
-		radioScanDoneHandler();		
-	}
-/*#endif*/ //LBT
     return SYSTEM_TASK_SUCCESS;
 }
 
@@ -783,6 +865,7 @@ SYSTEM_TaskStatus_t RADIO_RxDoneHandler(void)
     if ((1 == radioEvents.RxWatchdogTimoutEvent))
     {
         radioEvents.RxWatchdogTimoutEvent = 0;
+        Radio_LinkStatsUpdate(RADIO_LINK_RX_TIMEOUT);
         Radio_WriteMode(MODE_STANDBY, radioConfiguration.modulation, 1);
         Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
 		//Power off the Oscillator after putting TRX to sleep
@@ -804,6 +887,7 @@ SYSTEM_TaskStatus_t RADIO_RxDoneHandler(void)
     {
         radioEvents.LoraRxTimoutEvent = 0;
         radioEvents.FskRxTimoutEvent = 0;
+        Radio_LinkStatsUpdate(RADIO_LINK_RX_TIMEOUT);
         Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
 		//Power off the Oscillator after putting TRX to sleep
 		Radio_ResetClockInput();
@@ -822,35 +906,12 @@ SYSTEM_TaskStatus_t RADIO_RxDoneHandler(void)
     }
     else if (1 == radioEvents.LoraRxDoneEvent)
     {
-        radioEvents.LoraRxDoneEvent = 0;
-
-        radioConfiguration.dataBufferLen = RADIO_RegisterRead(REG_LORA_RXNBBYTES);
-        RADIO_RegisterWrite(REG_LORA_FIFOADDRPTR, 0x00);
-        RADIO_FrameRead(REG_FIFO_ADDRESS,radioConfiguration.dataBuffer,radioConfiguration.dataBufferLen);
-		Radio_ReadPktRssi();
-
-        Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
-		//Power off the Oscillator after putting TRX to sleep
-		Radio_ResetClockInput();
-        RadioCallbackParam.RX.buffer = radioConfiguration.dataBuffer;
-        RadioCallbackParam.RX.bufferLength = radioConfiguration.dataBufferLen;
-		RadioCallbackParam.status = ERR_NONE;
-        RadioSetState(RADIO_STATE_IDLE);
-        if (1 == radioCallbackMask.BitMask.radioRxDoneCallback)
-        {
-			if (radioConfiguration.radioCallback)
-			{
-				radioConfiguration.radioCallback(RADIO_RX_DONE_CALLBACK, (void *) &(RadioCallbackParam));
-			}
-        }
+        Radio_RxQueueDeliver();
     }
     else if (1 == radioEvents.FskRxDoneEvent)
     {
         radioEvents.FskRxDoneEvent = 0;
         radioConfiguration.packetSNR = -128;
-        Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
-		//Power off the Oscillator after putting TRX to sleep
-		Radio_ResetClockInput();
         RadioCallbackParam.RX.buffer = radioConfiguration.dataBuffer;
         RadioCallbackParam.RX.bufferLength = radioConfiguration.dataBufferLen;
 		//Clear the FSK index variables
@@ -869,11 +930,6 @@ SYSTEM_TaskStatus_t RADIO_RxDoneHandler(void)
     {
         radioEvents.RxError = 0;
 
-        RADIO_FrameRead(REG_FIFO_ADDRESS,radioConfiguration.dataBuffer,radioConfiguration.dataBufferLen);
-
-        Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
-		//Power off the Oscillator after putting TRX to sleep
-		Radio_ResetClockInput();
         RadioCallbackParam.RX.buffer = radioConfiguration.dataBuffer;
         RadioCallbackParam.RX.bufferLength = radioConfiguration.dataBufferLen;
 		//Clear the FSK index variables
@@ -901,6 +957,10 @@ SYSTEM_TaskStatus_t RADIO_RxDoneHandler(void)
 void Radio_WatchdogTimeout(uint8_t time)
 {
     (void)time;
+
+	// A pending oscillator or scan tick must not resume the aborted operation
+	Radio_ClockWaitStop();
+	Radio_LBTScanStop();
 	
     if (RADIO_STATE_RX == RADIO_GetState())
     {
@@ -948,14 +1008,12 @@ void RADIO_RxTimeout(void)
 *************************************************************************/
 void RADIO_FSKSyncAddr(void)
 {
-	system_enter_critical_section();
 	if (MODULATION_FSK == radioConfiguration.modulation)
 	{
 		//Clear the FSK length and index variables
 		radioConfiguration.dataBufferLen = 0;
 		radioConfiguration.fskPayloadIndex = 0;
 	}
-	system_leave_critical_section();            
 }
 
 /*********************************************************************//**
@@ -967,30 +1025,7 @@ void RADIO_FSKSyncAddr(void)
 *************************************************************************/
 void RADIO_FSKFifoLevel(void)
 {
-	system_enter_critical_section();
-	// The following code will be executed if radioConfiguration.dataBufferLen, radioConfiguration.fskPayloadIndex are not zero and if they are not equal
-	if (!((radioConfiguration.dataBufferLen == radioConfiguration.fskPayloadIndex) && (radioConfiguration.dataBufferLen != 0) && (radioConfiguration.fskPayloadIndex != 0)))
-	{
-		if (radioConfiguration.dataBufferLen == 0)
-		{
-			RADIO_FrameRead(REG_FIFO_ADDRESS,(uint8_t *)&radioConfiguration.dataBufferLen, 1);
-		}
-		if ((uint8_t)(radioConfiguration.dataBufferLen - radioConfiguration.fskPayloadIndex) < RADIO_RX_FIFO_LEVEL)
-		{
-			RADIO_FrameRead(REG_FIFO_ADDRESS, radioConfiguration.dataBuffer + radioConfiguration.fskPayloadIndex, radioConfiguration.dataBufferLen - radioConfiguration.fskPayloadIndex);
-			radioConfiguration.fskPayloadIndex = radioConfiguration.dataBufferLen;
-		}
-		else if ((uint8_t)(radioConfiguration.dataBufferLen - radioConfiguration.fskPayloadIndex) > RADIO_RX_FIFO_LEVEL)
-		{
-			RADIO_FrameRead(REG_FIFO_ADDRESS, radioConfiguration.dataBuffer + radioConfiguration.fskPayloadIndex, RADIO_RX_FIFO_LEVEL);
-			radioConfiguration.fskPayloadIndex += RADIO_RX_FIFO_LEVEL;
-		}
-		// intentionally omitted handling the condition "if(radioConfiguration.dataBufferLen == RADIO_RX_FIFO_LEVEL) and 
-		// if(radioConfiguration.dataBufferLen - radioConfiguration.fskPayloadIndex == RADIO_RX_FIFO_LEVEL)"
-		// because emptying the frame buffer here will prevent "Payload ready" interrupt from being fired.
-	}
-	system_leave_critical_section();
-
+	Radio_FSKReadFifo(false);
 }
 
 /*********************************************************************//**
@@ -1057,10 +1092,14 @@ void RADIO_TxDone(void)
     RADIO_RegisterWrite(REG_LORA_IRQFLAGS, 1 << SHIFT3);
     if ((RADIO_GetState() == RADIO_STATE_TX) || (0 == radioEvents.RxWatchdogTimoutEvent))
     {
+        timeOnAir = US_TO_MS(SwTimerGetTime() - timeOnAir);
+
+        Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+		//Powering Off the Oscillator after putting TRX to sleep
+		Radio_ResetClockInput();
+
         radioEvents.LoraTxDoneEvent = 1;
         radioPostTask(RADIO_TX_DONE_TASK_ID);
-       
-        timeOnAir = US_TO_MS(SwTimerGetTime() - timeOnAir);
     }
 }
 
@@ -1087,8 +1126,13 @@ void RADIO_FSKPacketSent(void)
         if ((RADIO_GetState() == RADIO_STATE_TX) || (0 == radioEvents.RxWatchdogTimoutEvent))
         {
 			timeOnAir =  US_TO_MS(SwTimerGetTime() - timeOnAir);
-			radioPostTask(RADIO_TX_DONE_TASK_ID);
+
+			Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+			//Powering Off the Oscillator after putting TRX to sleep
+			Radio_ResetClockInput();
+
             radioEvents.FskTxDoneEvent = 1;
+			radioPostTask(RADIO_TX_DONE_TASK_ID);
         }
     }
 }
@@ -1102,8 +1146,14 @@ void RADIO_FSKPacketSent(void)
 *************************************************************************/
 void RADIO_RxDone(void)
 {
+    uint8_t rxStatus[REG_LORA_HOPCHANNEL - REG_LORA_FIFORXCURRENTADDR + 1];
     uint8_t crc, irqFlags;
-    irqFlags = RADIO_RegisterRead(REG_LORA_IRQFLAGS);
+    RadioRxFrame_t *frame;
+
+    // Frame start address, IRQ flags, frame length, packet SNR and RSSI and
+    // CRC info are read with a single burst
+    RADIO_FrameRead(REG_LORA_FIFORXCURRENTADDR, rxStatus, sizeof(rxStatus));
+    irqFlags = rxStatus[REG_LORA_IRQFLAGS - REG_LORA_FIFORXCURRENTADDR];
     // Clear RxDone interrupt (also CRC error and ValidHeader interrupts, if
     // they exist)
     RADIO_RegisterWrite(REG_LORA_IRQFLAGS, (1 << SHIFT6) | (1 << SHIFT5) | (1 << SHIFT4));
@@ -1112,28 +1162,55 @@ void RADIO_RxDone(void)
     {
         // Make sure the watchdog won't trigger MAC functions erroneously.
         SwTimerStop(radioConfiguration.watchdogTimerId);
-	
-		// Turning off the RF switch now.
-		Radio_DisableRfControl(RADIO_RFCTRL_RX);
 
-        // Read CRC info from received packet header
-        crc = RADIO_RegisterRead(REG_LORA_HOPCHANNEL);
-        if ((0 == radioConfiguration.crcOn) || ((0 == (irqFlags & (1 << SHIFT5))) && (0 != (crc & (1 << SHIFT6)))))
+        if (RADIO_RX_QUEUE_SIZE == rxQueueCount)
         {
-            // ValidHeader and RxDone are set from the initial if condition.
-            // We get here either if CRC doesn't need to be set (crcOn == 0) OR
-            // if it is present in the header and it checked out.
+            // No free buffer, the frame is dropped. The radio only gets
+            // here if it was restarted before the MAC released a buffer.
+            Radio_RxDropped(1);
+            return;
+        }
 
-            // Radio did not go to standby automatically. Will need to be set
-            // later on.
-            radioEvents.LoraRxDoneEvent = 1;
-            radioPostTask(RADIO_RX_DONE_TASK_ID);
-        } 
+        // Read the frame right away into the free buffer, so that the radio
+        // can go on before the frame is handed over to the upper layer.
+        // In continuous reception the frames follow each other in the FIFO.
+        frame = &rxQueue[rxQueueIn];
+        frame->length = rxStatus[REG_LORA_RXNBBYTES - REG_LORA_FIFORXCURRENTADDR];
+        frame->snrValue = rxStatus[REG_LORA_PKTSNRVALUE - REG_LORA_FIFORXCURRENTADDR];
+        frame->rssiValue = rxStatus[REG_LORA_PKTRSSIVALUE - REG_LORA_FIFORXCURRENTADDR];
+        RADIO_RegisterWrite(REG_LORA_FIFOADDRPTR, rxStatus[0]);
+        RADIO_FrameRead(REG_FIFO_ADDRESS, &frame->buffer[RADIO_RX_HEADROOM], frame->length);
+
+        // CRC info from received packet header
+        crc = rxStatus[REG_LORA_HOPCHANNEL - REG_LORA_FIFORXCURRENTADDR];
+        // ValidHeader and RxDone are set from the initial if condition.
+        // The frame is good either if CRC doesn't need to be set (crcOn == 0)
+        // OR if it is present in the header and it checked out.
+        frame->crcError = !((0 == radioConfiguration.crcOn) || ((0 == (irqFlags & (1 << SHIFT5))) && (0 != (crc & (1 << SHIFT6)))));
+
+        rxQueueIn = (rxQueueIn + 1) % RADIO_RX_QUEUE_SIZE;
+        rxQueueCount++;
+        radioConfiguration.dataBuffer = &rxQueue[rxQueueIn].buffer[RADIO_RX_HEADROOM];
+
+        if ((0 == rxWindowSize) && (rxQueueCount < RADIO_RX_QUEUE_SIZE))
+        {
+            // Continuous reception: the radio keeps listening while the
+            // frame waits for the MAC
+            rxRearmed = true;
+        }
         else
         {
-            radioEvents.RxError = 1;
-            radioPostTask(RADIO_RX_DONE_TASK_ID);
+            // Turning off the RF switch now.
+            Radio_DisableRfControl(RADIO_RFCTRL_RX);
+            Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+            //Power off the Oscillator after putting TRX to sleep
+            Radio_ResetClockInput();
+            rxRearmed = false;
+            rxEnded = true;
         }
+
+        radioEvents.LoraRxDoneEvent = 1;
+        radioPostTask(RADIO_RX_DONE_TASK_ID);
     }
 }
 
@@ -1161,29 +1238,13 @@ void RADIO_FSKPayloadReady(void)
                 SwTimerStop(radioConfiguration.watchdogTimerId);
                 SwTimerStop(radioConfiguration.fskRxWindowTimerId);
 
-				system_enter_critical_section();
-				// The following code will be executed if radioConfiguration.dataBufferLen, radioConfiguration.fskPayloadIndex are not zero and if they are not equal
-				if (!( (radioConfiguration.dataBufferLen == radioConfiguration.fskPayloadIndex) && (radioConfiguration.dataBufferLen != 0) && (radioConfiguration.fskPayloadIndex != 0) ))
-				{
-					if (radioConfiguration.dataBufferLen == 0)
-					{
-						RADIO_FrameRead(REG_FIFO_ADDRESS,(uint8_t *)&radioConfiguration.dataBufferLen, 1);
-					}
-					if (radioConfiguration.fskPayloadIndex == 0)
-					{
-						RADIO_FrameRead(REG_FIFO_ADDRESS,radioConfiguration.dataBuffer,radioConfiguration.dataBufferLen);
-						radioConfiguration.fskPayloadIndex = radioConfiguration.dataBufferLen;
-					}
-					else if ((radioConfiguration.dataBufferLen - radioConfiguration.fskPayloadIndex) > 0)
-					{
-						RADIO_FrameRead(REG_FIFO_ADDRESS,radioConfiguration.dataBuffer+radioConfiguration.fskPayloadIndex,radioConfiguration.dataBufferLen-radioConfiguration.fskPayloadIndex);
-						radioConfiguration.fskPayloadIndex = radioConfiguration.dataBufferLen;
-					}
-				}	
-				system_leave_critical_section();			
+				Radio_FSKReadFifo(true);
 
 				// Turning off the RF switch now.
 				Radio_DisableRfControl(RADIO_RFCTRL_RX);
+				Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+				//Power off the Oscillator after putting TRX to sleep
+				Radio_ResetClockInput();
                 radioEvents.FskRxDoneEvent = 1;
                 radioPostTask(RADIO_RX_DONE_TASK_ID);
             } 
@@ -1191,6 +1252,10 @@ void RADIO_FSKPayloadReady(void)
             {
                 // This error handing did not exist before for FSK
                 // Previously a packet with CRC error in FSK will be dropped
+                Radio_FSKReadFifo(true);
+                Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+                //Power off the Oscillator after putting TRX to sleep
+                Radio_ResetClockInput();
                 radioEvents.RxError = 1;
                 radioPostTask(RADIO_RX_DONE_TASK_ID);
             }
@@ -1200,10 +1265,12 @@ void RADIO_FSKPayloadReady(void)
             // Make sure the watchdog won't trigger MAC functions erroneously
             SwTimerStop(radioConfiguration.watchdogTimerId);
             SwTimerStop(radioConfiguration.fskRxWindowTimerId);
-			RADIO_FrameRead(REG_FIFO_ADDRESS,(uint8_t *)&radioConfiguration.dataBufferLen, 1);
-			RADIO_FrameRead(REG_FIFO_ADDRESS,radioConfiguration.dataBuffer,radioConfiguration.dataBufferLen);
+			Radio_FSKReadFifo(true);
 			// Turning off the RF switch now.
 			Radio_DisableRfControl(RADIO_RFCTRL_RX);
+			Radio_WriteMode(MODE_SLEEP, radioConfiguration.modulation, 0);
+			//Power off the Oscillator after putting TRX to sleep
+			Radio_ResetClockInput();
             radioEvents.FskRxDoneEvent = 1;
             radioPostTask(RADIO_RX_DONE_TASK_ID);
         }
@@ -1219,12 +1286,34 @@ void RADIO_FSKPayloadReady(void)
 *************************************************************************/
 RadioError_t RADIO_GetData(uint8_t **data, uint16_t *dataLen)
 {
-	*data = radioConfiguration.dataBuffer;
-	*dataLen = radioConfiguration.dataBufferLen;
+	if (0 != rxQueueCount)
+	{
+		// The LoRa frame being handed over to the MAC
+		*data = &rxQueue[rxQueueOut].buffer[RADIO_RX_HEADROOM];
+		*dataLen = rxQueue[rxQueueOut].length;
+	}
+	else
+	{
+		*data = radioConfiguration.dataBuffer;
+		*dataLen = radioConfiguration.dataBufferLen;
+	}
 
 	return ERR_NONE;
 }
 
+/*********************************************************************//**
+\brief	This function reads the number of LoRa frames dropped because no
+		receive buffer was free, or because the radio was reset before
+		they were handed over. It saturates at UINT16_MAX.
+
+\param   - none
+\return  - The number of dropped frames.
+*************************************************************************/
+uint16_t RADIO_GetRxDropCount(void)
+{
+	return rxDropCount;
+}
+
 /*********************************************************************//**
 \brief This function is to set RF front End Control.
 
@@ -1285,35 +1374,72 @@ void Radio_DisableRfControl(bool type)
 *************************************************************************/
 void Radio_SetClockInput(void)
 {
-	uint8_t tcxoOn;
 	if (TCXO == radioConfiguration.clockSource)
 	{
-		tcxoOn = RADIO_RegisterRead(REG_TCXO);
-		// Set TcxoInputOn bit (bit 4) to One
-		RADIO_RegisterWrite(REG_TCXO, tcxoOn | (1 << SHIFT4));
-		HAL_TCXOPowerOn();
+		// The oscillator may still be on from the previous operation, or
+		// powered on ahead of this one. Then it is only waited for until
+		// clockReadyTime
+		radioClearTask(RADIO_SLEEP_TASK_ID);
+		SwTimerStop(radioConfiguration.clockHoldTimerId);
+		if (false == clockOn)
+		{
+			Radio_ClockOn();
+		}
 	}
     //else if XTAL is a source it will be powered on by default
 
 }
 
 /*********************************************************************//**
-\brief	This function power off the clock source of Radio
+\brief	This function registers a SW timer of the upper layer that starts
+		a radio operation when it expires. The TCXO is powered on
+		clockStabilizationDelay ahead of it, so that the operation starts
+		without waiting, and it is kept on until it if it expires within
+		RADIO_CLOCK_HOLD_THRESHOLD.
+
+\param timerId	- The SW timer.
+\return			- ERR_OUT_OF_RANGE if RADIO_CLOCK_USERS timers are
+				  registered already.
+*************************************************************************/
+RadioError_t RADIO_SetClockUser(uint8_t timerId)
+{
+	for (uint8_t i = 0; i < clockUserCount; i++)
+	{
+		if (timerId == clockUsers[i])
+		{
+			return ERR_NONE;
+		}
+	}
+	if (RADIO_CLOCK_USERS <= clockUserCount)
+	{
+		return ERR_OUT_OF_RANGE;
+	}
+	clockUsers[clockUserCount++] = timerId;
+	return ERR_NONE;
+}
+
+/*********************************************************************//**
+\brief	This function releases the clock source of Radio
 *************************************************************************/
 void Radio_ResetClockInput(void)
 {
-	if (TCXO == radioConfiguration.clockSource)
+	if ((TCXO == radioConfiguration.clockSource) && (true == clockOn))
 	{
-		HAL_TCXOPowerOff();
+		// Decided once the upper layer has scheduled the next operation
+		radioPostTask(RADIO_SLEEP_TASK_ID);
 	}
 }
 
 /*********************************************************************//**
-\brief	This function reads the packetRSSI value from Radio register
+\brief	This function computes the packetSNR and packetRSSI values from
+		the Radio registers
+
+\param snrValue  - The value of REG_LORA_PKTSNRVALUE.
+\param rssiValue - The value of REG_LORA_PKTRSSIVALUE.
 *************************************************************************/
-static void Radio_ReadPktRssi(void)
+static void Radio_SetPktRssi(uint8_t snrValue, uint8_t rssiValue)
 {
-	radioConfiguration.packetSNR = RADIO_RegisterRead(REG_LORA_PKTSNRVALUE);
+	radioConfiguration.packetSNR = snrValue;
 	if (radioConfiguration.packetSNR & 0x80)
 	{
 		radioConfiguration.packetSNR = ((~ radioConfiguration.packetSNR + 1) & 0xFF) >> 2;
@@ -1324,7 +1450,7 @@ static void Radio_ReadPktRssi(void)
 		radioConfiguration.packetSNR = (radioConfiguration.packetSNR & 0xFF) >> 2;
 	}
 	
-	int16_t pktrssi = RADIO_RegisterRead(REG_LORA_PKTRSSIVALUE);
+	int16_t pktrssi = rssiValue;
 	
 	if (radioConfiguration.packetSNR < 0)
 	{
@@ -1352,107 +1478,442 @@ static void Radio_ReadPktRssi(void)
 }
 
 /*********************************************************************//**
-\brief	This function checks whether the configured channel is free 
-		by reading the RSSI at a particular frequency and comparing 
-		that with lbtThreshold
+\brief	This function empties the queue of received frames. The radio
+		receives the next frame in the first buffer.
 *************************************************************************/
-static bool Radio_IsChannelFree(void)
+static void Radio_RxQueueFlush(void)
 {
-	uint16_t lbtScanPeriod = radioConfiguration.lbt.params.lbtScanPeriod;
-	
-	//50uS for reading a single RSSI sample
-	radioConfiguration.lbt.params.lbtNumOfSamples = MS_TO_US(lbtScanPeriod) / 50;
+	system_enter_critical_section();
+	Radio_RxDropped(rxQueueCount);
+	rxQueueIn = 0;
+	rxQueueOut = 0;
+	rxQueueCount = 0;
+	radioConfiguration.dataBuffer = &rxQueue[0].buffer[RADIO_RX_HEADROOM];
+	system_leave_critical_section();
+}
 
-	//Power on the Oscillator before putting the radio to receive state
-	Radio_SetClockInput();
-	
-	// Turn on the RF switch.
-	Radio_EnableRfControl(RADIO_RFCTRL_RX);
+/*********************************************************************//**
+\brief	This function gives the buffer of the frame handed over to the
+		MAC back to the radio. The next frame of the queue, if any, is
+		handed over by the next run of the RADIO_RxDoneHandler.
+*************************************************************************/
+static void Radio_RxQueueRelease(void)
+{
+	system_enter_critical_section();
+	if (0 != rxQueueCount)
+	{
+		rxQueueOut = (rxQueueOut + 1) % RADIO_RX_QUEUE_SIZE;
+		rxQueueCount--;
+	}
+	if (0 == rxQueueCount)
+	{
+		radioEvents.LoraRxDoneEvent = 0;
+	}
+	else
+	{
+		radioPostTask(RADIO_RX_DONE_TASK_ID);
+	}
+	system_leave_critical_section();
+}
 
-	//Write the center frequency of the channel to be check for RSSI
-	Radio_WriteFrequency(radioConfiguration.frequency);
-	radioConfiguration.lbt.lbtChannelRSSI = 0;
-	
-	Radio_WriteMode(MODE_SLEEP, MODULATION_FSK, BLOCKING_REQ);
-	
-	/* Disable all the interrupt line before putting Radio to RX to avoid  unwanted interrupts */
-	Radio_DisableInterruptLines();
-	
-	/* Write Bandwidth as 200KHz to read RSSI throughout channel bandwidth */
-	RADIO_RegisterWrite(REG_FSK_RXBW, FSKBW_200_0KHZ);
-	
-	/* Put radio to RX Continuous mode */
-	Radio_WriteMode(MODE_RXCONT, MODULATION_FSK, BLOCKING_REQ);
-	
-	/* Check the channel freeness for lbtScanPeriod */
-	for(uint8_t i = 0; i < radioConfiguration.lbt.params.lbtNumOfSamples; i++) 
+/*********************************************************************//**
+\brief	This function hands the oldest frame of the queue over to the
+		upper layer and gives its buffer back to the radio. The radio may
+		already be receiving the next frame.
+*************************************************************************/
+static void Radio_RxQueueDeliver(void)
+{
+	RadioCallbackParam_t RadioCallbackParam;
+	RadioRxFrame_t *frame = &rxQueue[rxQueueOut];
+
+	if (0 == rxQueueCount)
+	{
+		return;
+	}
+
+	Radio_SetPktRssi(frame->snrValue, frame->rssiValue);
+	Radio_LinkStatsUpdate(frame->crcError ? RADIO_LINK_CRC_ERROR : RADIO_LINK_RX_DONE);
+	RadioCallbackParam.RX.buffer = &frame->buffer[RADIO_RX_HEADROOM];
+	RadioCallbackParam.RX.bufferLength = frame->length;
+	RadioCallbackParam.status = ERR_NONE;
+	if (true == rxEnded)
+	{
+		// The receiver is off, the upper layer may start the next operation
+		rxEnded = false;
+		RadioSetState(RADIO_STATE_IDLE);
+	}
+
+	rxDelivering = true;
+	if (false == frame->crcError)
+	{
+		if (1 == radioCallbackMask.BitMask.radioRxDoneCallback)
+		{
+			if (radioConfiguration.radioCallback)
+			{
+				radioConfiguration.radioCallback(RADIO_RX_DONE_CALLBACK, (void *) &(RadioCallbackParam));
+			}
+		}
+	}
+	else if (1 == radioCallbackMask.BitMask.radioRxErrorCallback)
+	{
+		if (radioConfiguration.radioCallback)
+		{
+			radioConfiguration.radioCallback(RADIO_RX_ERROR_CALLBACK, (void *) &(RadioCallbackParam));
+		}
+	}
+	rxDelivering = false;
+
+	// The upper layer is done with the frame
+	Radio_RxQueueRelease();
+}
+
+/*********************************************************************//**
+\brief	This function hands all the frames of the queue over to the upper
+		layer before the receiver is stopped or restarted. Called from the
+		callback of a frame, it does nothing: the upper layer is not
+		entered again and the rest of the queue is handed over by the
+		RADIO_RxDoneHandler.
+*************************************************************************/
+static void Radio_RxQueueDrain(void)
+{
+	if (false == rxDelivering)
+	{
+		while (0 != rxQueueCount)
+		{
+			Radio_RxQueueDeliver();
+		}
+	}
+}
+
+/*********************************************************************//**
+\brief	This function accounts frames dropped before they were handed over
+		to the upper layer.
+
+\param count	- The number of frames.
+*************************************************************************/
+static void Radio_RxDropped(uint8_t count)
+{
+	if ((UINT16_MAX - rxDropCount) < count)
+	{
+		rxDropCount = UINT16_MAX;
+	}
+	else
+	{
+		rxDropCount += count;
+	}
+}
+
+/*********************************************************************//**
+\brief	This function reads the settings a LoRa reception is started with.
+
+\param settings	- The settings.
+*************************************************************************/
+static void Radio_RxSettingsGet(RadioRxSettings_t *settings)
+{
+	// Cleared first so that the settings can be compared with memcmp
+	memset(settings, 0, sizeof(*settings));
+	settings->frequency = radioConfiguration.frequency;
+	settings->preambleLen = radioConfiguration.preambleLen;
+	settings->frequencyHopPeriod = radioConfiguration.frequencyHopPeriod;
+	settings->syncWordLoRa = radioConfiguration.syncWordLoRa;
+	settings->crcOn = radioConfiguration.crcOn;
+	settings->iqInverted = radioConfiguration.iqInverted;
+	settings->implicitHeaderMode = radioConfiguration.implicitHeaderMode;
+	settings->errorCodingRate = radioConfiguration.errorCodingRate;
+	settings->modulation = radioConfiguration.modulation;
+	settings->dataRate = radioConfiguration.dataRate;
+	settings->bandWidth = radioConfiguration.bandWidth;
+}
+
+/*********************************************************************//**
+\brief	This function drains the FSK FIFO into the receive buffer. It is
+		only called from the DIO interrupts, which share the EIC vector
+		and do not preempt each other, so the length and index are owned
+		by it while the receiver runs and no critical section is needed.
+		Each call reads its bytes with a single SPI burst.
+
+\param payloadReady	- true to read the rest of the payload, false for
+						  a FifoLevel chunk.
+\return				- none
+*************************************************************************/
+static void Radio_FSKReadFifo(bool payloadReady)
+{
+	uint8_t length = radioConfiguration.dataBufferLen;
+	uint8_t index = radioConfiguration.fskPayloadIndex;
+	uint8_t count;
+
+	if ((0 == length) && (false == payloadReady))
+	{
+		// The FIFO holds more than RADIO_RX_FIFO_LEVEL bytes, the length
+		// byte is read with the payload head into the buffer headroom
+		RADIO_FrameRead(REG_FIFO_ADDRESS, radioConfiguration.dataBuffer - 1, RADIO_RX_FIFO_LEVEL);
+		length = radioConfiguration.dataBuffer[-1];
+		index = (length < (RADIO_RX_FIFO_LEVEL - 1)) ? length : (RADIO_RX_FIFO_LEVEL - 1);
+		count = 0;
+	}
+	else
+	{
+		if (0 == length)
+		{
+			RADIO_FrameRead(REG_FIFO_ADDRESS, &length, 1);
+		}
+		count = length - index;
+		if (false == payloadReady)
+		{
+			// The last byte is left for PayloadReady, which is cleared
+			// as soon as the FIFO is empty
+			if (count > RADIO_RX_FIFO_LEVEL)
+			{
+				count = RADIO_RX_FIFO_LEVEL;
+			}
+			else if (0 != count)
+			{
+				count--;
+			}
+		}
+	}
+
+	if (0 != count)
+	{
+		RADIO_FrameRead(REG_FIFO_ADDRESS, radioConfiguration.dataBuffer + index, count);
+		index += count;
+	}
+	radioConfiguration.fskPayloadIndex = index;
+	radioConfiguration.dataBufferLen = length;
+}
+
+/*********************************************************************//**
+\brief	This function decides on the TCXO after a radio operation, once
+		the upper layer has scheduled the next one, see
+		Radio_ClockSchedule.
+
+\param 	- none
+\return	- returns the success or failure of a task
+*************************************************************************/
+SYSTEM_TaskStatus_t RADIO_SleepHandler(void)
+{
+	if ((false == clockOn) || (RADIO_STATE_IDLE != RADIO_GetState()) || (true == rxRearmed))
+	{
+		return SYSTEM_TASK_SUCCESS;
+	}
+
+	Radio_ClockSchedule();
+
+	return SYSTEM_TASK_SUCCESS;
+}
+
+/*********************************************************************//**
+\brief	This function is the callback of the clock hold timer, which
+		expires when the TCXO must be powered on ahead of the next radio
+		use, or just after a use it was kept on for. The decision is
+		taken again from the timers of the upper layer.
+
+\param param	- not used.
+\return			- none
+*************************************************************************/
+static void Radio_ClockHoldTimeout(void *param)
+{
+	(void)param;
+	if ((RADIO_STATE_IDLE == RADIO_GetState()) && (false == rxRearmed))
+	{
+		Radio_ClockSchedule();
+	}
+}
+
+/*********************************************************************//**
+\brief	This function powers the TCXO on, it is stable from
+		clockReadyTime.
+
+\param 	- none
+\return	- none
+*************************************************************************/
+static void Radio_ClockOn(void)
+{
+	uint8_t tcxoOn;
+
+	tcxoOn = RADIO_RegisterRead(REG_TCXO);
+	// Set TcxoInputOn bit (bit 4) to One
+	RADIO_RegisterWrite(REG_TCXO, tcxoOn | (1 << SHIFT4));
+	HAL_TCXOPowerOn();
+	clockOn = true;
+	clockReadyTime = SwTimerGetTime() + MS_TO_US(radioConfiguration.clockStabilizationDelay);
+}
+
+/*********************************************************************//**
+\brief	This function returns the time to the next radio use, the first
+		expiry of the timers registered with RADIO_SetClockUser.
+
+\param 	- none
+\return	- the time in us, SWTIMER_INVALID_TIMEOUT if none is running
+*************************************************************************/
+static uint32_t Radio_ClockNextUse(void)
+{
+	uint32_t nextUse = SWTIMER_INVALID_TIMEOUT;
+
+	for (uint8_t i = 0; i < clockUserCount; i++)
+	{
+		if (SwTimerIsRunning(clockUsers[i]))
+		{
+			uint32_t remaining = SwTimerReadValue(clockUsers[i]);
+
+			if (remaining < nextUse)
+			{
+				nextUse = remaining;
+			}
+		}
+	}
+	return nextUse;
+}
+
+/*********************************************************************//**
+\brief	This function keeps the TCXO on until the next radio use if it
+		comes within RADIO_CLOCK_HOLD_THRESHOLD, or too soon to power it
+		off and on again. Otherwise the TCXO is powered off and the clock
+		hold timer powers it on again clockStabilizationDelay before the
+		next use. The radio must be idle.
+
+\param 	- none
+\return	- none
+*************************************************************************/
+static void Radio_ClockSchedule(void)
+{
+	uint32_t nextUse = Radio_ClockNextUse();
+	uint32_t warmUp = MS_TO_US(radioConfiguration.clockStabilizationDelay);
+
+	SwTimerStop(radioConfiguration.clockHoldTimerId);
+	if ((SWTIMER_INVALID_TIMEOUT != nextUse) &&
+		((RADIO_CLOCK_HOLD_THRESHOLD >= nextUse) || ((warmUp + SWTIMER_MIN_TIMEOUT) > nextUse)))
+	{
+		if (false == clockOn)
+		{
+			Radio_ClockOn();
+		}
+		// Checked again just after the use, in case it does not come
+		if (LORAWAN_SUCCESS == SwTimerStart(radioConfiguration.clockHoldTimerId, nextUse + SWTIMER_MIN_TIMEOUT, SW_TIMEOUT_RELATIVE, (void *)Radio_ClockHoldTimeout, NULL))
+		{
+			return;
+		}
+	}
+
+	if (true == clockOn)
 	{
-		 /* Read the channel Instantaneous RSSI value */
-		 Radio_ReadFSKRssi(&instRSSI );		 
-
-		 /* Inform the upper layer immediately if Inst RSSI is greater than RSSI Threshold*/
-		 if (instRSSI > radioConfiguration.lbt.params.lbtThreshold)
-		 {
-			 /* Enable all the interrupt lines back */
-			 Radio_EnableInterruptLines();
-			 return false;
-		 }
+		HAL_TCXOPowerOff();
+		clockOn = false;
+	}
+	if (SWTIMER_INVALID_TIMEOUT != nextUse)
+	{
+		SwTimerStart(radioConfiguration.clockHoldTimerId, nextUse - warmUp, SW_TIMEOUT_RELATIVE, (void *)Radio_ClockHoldTimeout, NULL);
+	}
+}
+
+/*********************************************************************//**
+\brief	This function checks that the oscillator is stable. If it is not,
+		the tick timer, or the clock hold timer beyond a tick, posts the
+		task of the current state again once it is, so that the
+		stabilization delay does not block the system.
+
+\param 	- none
+\return	- true if the radio can be used.
+*************************************************************************/
+static bool Radio_ClockStable(void)
+{
+	uint64_t now;
+	uint32_t remaining;
+
+	if (TCXO != radioConfiguration.clockSource)
+	{
+		return true;
+	}
+
+	now = SwTimerGetTime();
+	if (now >= clockReadyTime)
+	{
+		return true;
+	}
+
+	remaining = (uint32_t)(clockReadyTime - now);
+	if (SWTIMER_TICK_MIN_TIMEOUT > remaining)
+	{
+		remaining = SWTIMER_TICK_MIN_TIMEOUT;
+	}
+	if (SWTIMER_MIN_TIMEOUT < remaining)
+	{
+		// Longer than a tick, the clock hold timer is free during an
+		// operation
+		SwTimerStop(radioConfiguration.clockHoldTimerId);
+		if (LORAWAN_SUCCESS == SwTimerStart(radioConfiguration.clockHoldTimerId, remaining, SW_TIMEOUT_RELATIVE, (void *)Radio_ClockStableTimeout, NULL))
+		{
+			return false;
+		}
 	}
-	/* Enable all the interrupt lines back */
-	Radio_EnableInterruptLines();
-	return true;	
+	else if (LORAWAN_SUCCESS == SwTimerTickStart(remaining, (void *)Radio_ClockStableTimeout))
+	{
+		clockWaitPending = true;
+		return false;
+	}
+
+	// No timer, the task is run again until the oscillator is stable
+	Radio_ClockStableTimeout(NULL);
+	return false;
 }
 
 /*********************************************************************//**
-\brief	This function enables all the interrupt line from RADIO
+\brief	This function waits for the oscillator to be stable. It is only
+		used by RADIO_Init and RADIO_TransmitCW, which return with the
+		radio running.
+
+\param 	- none
+\return	- none
 *************************************************************************/
-static void Radio_EnableInterruptLines(void)
+static void Radio_WaitClockStable(void)
 {
-#ifdef ENABLE_DIO0
-	HAL_EnableDIO0Interrupt();
-#endif /* ENABLE_DIO0 */
-#ifdef ENABLE_DIO1
-	HAL_EnableDIO1Interrupt();
-#endif /* ENABLE_DIO1 */
-#ifdef ENABLE_DIO2
-	HAL_EnableDIO2Interrupt();
-#endif /* ENABLE_DIO2 */
-#ifdef ENABLE_DIO3
-	HAL_EnableDIO3Interrupt();
-#endif /* ENABLE_DIO3 */
-#ifdef ENABLE_DIO4
-	HAL_EnableDIO4Interrupt();
-#endif /* ENABLE_DIO4 */
-#ifdef ENABLE_DIO5
-	HAL_EnableDIO5Interrupt();
-#endif /* ENABLE_DIO5 */
+	uint64_t now = SwTimerGetTime();
+
+	if ((TCXO == radioConfiguration.clockSource) && (now < clockReadyTime))
+	{
+		delay_us((uint32_t)(clockReadyTime - now));
+	}
 }
 
 /*********************************************************************//**
-\brief	This function disables all the interrupt line from RADIO to avoid 
-		the unwanted interrupts
+\brief	This function is called by the tick timer when the oscillator is
+		stable, it resumes the pending operation. It is not resumed if the
+		operation was stopped meanwhile.
+
+\param param	- not used.
+\return			- none
 *************************************************************************/
-static void Radio_DisableInterruptLines(void)
+static void Radio_ClockStableTimeout(void *param)
 {
-	// Mask all interrupts
-#ifdef ENABLE_DIO0
-	HAL_DisbleDIO0Interrupt();
-#endif /* ENABLE_DIO0 */
-#ifdef ENABLE_DIO1
-	HAL_DisbleDIO1Interrupt();
-#endif /* ENABLE_DIO1 */
-#ifdef ENABLE_DIO2
-	HAL_DisbleDIO2Interrupt();
-#endif /* ENABLE_DIO2 */
-#ifdef ENABLE_DIO3
-	HAL_DisbleDIO3Interrupt();
-#endif /* ENABLE_DIO3 */
-#ifdef ENABLE_DIO4
-	HAL_DisbleDIO4Interrupt();
-#endif /* ENABLE_DIO4 */
-#ifdef ENABLE_DIO5
-	HAL_DisbleDIO5Interrupt();
-#endif /* ENABLE_DIO5 */	
+	(void)param;
+	clockWaitPending = false;
+	if (RADIO_STATE_RX == RADIO_GetState())
+	{
+		radioPostTask(RADIO_RX_TASK_ID);
+	}
+	else if (RADIO_STATE_TX == RADIO_GetState())
+	{
+		radioPostTask(RADIO_TX_TASK_ID);
+	}
+}
+
+/*********************************************************************//**
+\brief	This function stops a pending wait for the oscillator, and the
+		clock hold timer that times the longer ones. The tick timer is
+		shared with the LBT scan, it is only stopped if the oscillator
+		wait armed it.
+
+\param 	- none
+\return	- none
+*************************************************************************/
+static void Radio_ClockWaitStop(void)
+{
+	if (clockWaitPending)
+	{
+		SwTimerTickStop();
+		clockWaitPending = false;
+	}
+	SwTimerStop(radioConfiguration.clockHoldTimerId);
 }
 
 /* eof radio_transaction.c */
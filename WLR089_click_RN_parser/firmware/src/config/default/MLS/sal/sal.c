@@ -36,6 +36,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 /* AES Headers */
 #include "aes_engine.h"
+#include "aes_block.h"
 
 /* SAL Headers */
 #include "conf_sal.h"
@@ -46,6 +47,8 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #ifdef CRYPTO_DEV_ENABLED
 #include "atca_config.h"
 #include "cryptoauthlib.h"
+#include "host/atca_host.h"
+#include "sw_timer.h"
 #endif
 /**************************************** MACROS******************************/
 
@@ -78,13 +81,108 @@ static uint8_t keyEncryptionKey[32];
 /* Default configuration for an ATECC device on the I2C bus */
 extern ATCAIfaceCfg atecc608_0_init_data;
 
+/* ECC608 command executed in the background by the asynchronous functions */
+typedef struct _SalAsyncOp
+{
+	/* Command packet, holds the response once the command is complete */
+	ATCAPacket packet;
+	/* Destination of the response, NULL if the result stays in the device */
+	uint8_t *output;
+	/* Number of bytes of the response copied to output */
+	uint8_t outputLength;
+	/* Function to be invoked once the command is complete */
+	SalCallback_t callback;
+	/* Time (ms) left to wait for the response */
+	uint16_t timeLeft;
+	/* Set while a command is outstanding */
+	bool busy;
+} SalAsyncOp_t;
+
+static SalAsyncOp_t salAsyncOp;
+
+/* Timer used to resume the outstanding command */
+static uint8_t salAsyncTimerId;
+
+/* Copies of the items read back from ECC608, so that the I2C transactions
+ * (and the KEK rewrite of an encrypted read) happen once per join */
+static uint8_t salItemCache[SAL_ITEMS_NUM][SAL_KEY_LEN];
+/* Bit mask of the valid salItemCache entries, one bit per salItems_t */
+static uint8_t salItemCacheValid;
+
+/* Number of commands sent to ECC608 since SAL_Init */
+static uint32_t salDeviceCommandCount;
+
+/* CMAC computed by SAL_AESCmacAsync with a key stored in ECC608, one AES command per block */
+typedef struct _SalCmacOp
+{
+	/* Subkey L = AES(K, 0) while the subkeys are generated, then the chained value */
+	uint8_t x[AES_DATA_SIZE];
+	/* Last block of the message, padded and combined with its subkey */
+	uint8_t mLast[AES_DATA_SIZE];
+	uint8_t *key;
+	uint8_t *output;
+	uint8_t *input;
+	uint16_t size;
+	/* Number of blocks of the message, and number of them encrypted */
+	uint16_t blocks;
+	uint16_t done;
+	/* Set until L is encrypted */
+	bool subkeys;
+	SalCallback_t callback;
+} SalCmacOp_t;
+
+static SalCmacOp_t salCmacOp;
+
+/* Steps of the encrypted read of SAL_ReadAsync, those of SAL_Read, one ECC608 command each */
+typedef enum _SalReadStep
+{
+	/* New Key Encryption Key, written to KEK_SLOT */
+	SAL_READ_KEK_RANDOM = 0,
+	SAL_READ_KEK_WRITE,
+	/* NumIn of the Nonce command */
+	SAL_READ_NUM_IN_RANDOM,
+	/* Serial number, part of the GenDig digest */
+	SAL_READ_SERIAL_NUMBER,
+	/* TempKey from a random nonce, then from the Key Encryption Key */
+	SAL_READ_NONCE,
+	SAL_READ_GENDIG,
+	/* Slot of the key, encrypted with TempKey */
+	SAL_READ_DATA
+} SalReadStep_t;
+
+typedef struct _SalReadOp
+{
+	/* Response of the last command */
+	uint8_t response[ATCA_BLOCK_SIZE];
+	/* Serial number, SN[4:8] moved right after SN[0:3] */
+	uint8_t serialNum[ATCA_BLOCK_SIZE];
+	/* TempKey of ECC608, computed on the host side */
+	atca_temp_key_t tempKey;
+	uint8_t *key;
+	salItems_t keyType;
+	SalReadStep_t step;
+	SalCallback_t callback;
+} SalReadOp_t;
+
+static SalReadOp_t salReadOp;
+
+/* OtherData of the GenDig command, so that the digest does not depend on SlotConfig.NoMac */
+static const uint8_t salGenDigOtherData[ATCA_WORD_SIZE] = {ATCA_GENDIG, GENDIG_ZONE_DATA, KEK_SLOT, 0};
+
 /**************************FUNCION DEFINITION***********************************/
 /* Function to generate random 32 bytes key and write that to Key Encryption Key Slot */
 static SalStatus_t sal_WriteKeyEncryptionKey(void);
+static SalStatus_t sal_AsyncStart(uint16_t execTime, SalCallback_t callback);
+static void sal_AsyncTimerCallback(void);
+static uint8_t sal_ItemLength(salItems_t key_type);
+static void sal_CmacStep(SalStatus_t status);
+static SalStatus_t sal_ReadIssue(void);
+static SalStatus_t sal_ReadResult(void);
+static void sal_ReadStep(SalStatus_t status);
 #endif
 
 static void sal_GenerateSubkey (uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2);
-static void sal_FillSubKey( uint8_t *source, uint8_t *key, uint8_t size);
+static uint16_t sal_CmacLastBlock (uint8_t* k1, uint8_t* k2, uint8_t* mLast, uint8_t* input, uint16_t size);
 /*************************************IMPLEMENTATION****************************/
  /**
  * \brief This function initializes the security modules like AES, ECC608 (If used)
@@ -103,6 +201,11 @@ SalStatus_t SAL_Init(void)
 	/* Initialize the communication to the ECC608.  
 	   Set the I2C address */
 	atcab_init( &atecc608_0_init_data );
+
+	if (LORAWAN_SUCCESS != SwTimerCreate(&salAsyncTimerId))
+	{
+		sal_status = SAL_FAILURE;
+	}
 #endif /* #ifdef CRYPTO_DEV_ENABLED */
 
    return sal_status;	
@@ -120,6 +223,7 @@ SalStatus_t SAL_Init(void)
  * \return value of type SalStatus_t
  *         SAL_SUCCESS			-- when encryption is successful
  *         SAL_FAILURE			-- when encryption is failed
+ *         SAL_BUSY				-- when an asynchronous request holds the ECC608
  *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
  */
 SalStatus_t SAL_AESEncode(unsigned char* buffer, salItems_t key_type, unsigned char* key)
@@ -144,6 +248,12 @@ SalStatus_t SAL_AESEncode(unsigned char* buffer, salItems_t key_type, unsigned c
 		{
 			/* If the key_type is APP Key, Encryption Should have done inside ECC608,
 			 * since AppKey is not readable from it */
+			if (salAsyncOp.busy)
+			{
+				sal_status = SAL_BUSY;
+				break;
+			}
+			salDeviceCommandCount++;
 			atcab_status = atcab_aes_encrypt(keySlot, APP_KEY_SLOT_BLOCK, buffer, encData);
 			if (atcab_status == ATCA_SUCCESS)
 			{
@@ -195,6 +305,7 @@ SalStatus_t SAL_AESEncode(unsigned char* buffer, salItems_t key_type, unsigned c
  * \return value of type SalStatus_t
  *         SAL_SUCCESS			-- when Session key derivation is successful
  *         SAL_FAILURE			-- when Session key derivation is failed
+ *         SAL_BUSY				-- when an asynchronous request holds the ECC608
  *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
  */
 SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsigned char* key, salItems_t target_key)
@@ -211,6 +322,10 @@ SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsig
 	uint8_t derive_mode    = KDF_MODE_ALG_AES | KDF_MODE_SOURCE_SLOT | KDF_MODE_TARGET_SLOT;
 	uint16_t key_id = (target_slot << 8) | source_slot; //2 Byte key_id denotes Source and Target slot values (Target Slot(1 Byte) | Source Slot (1Byte))
 	uint32_t aes_details = 0;
+	if (salAsyncOp.busy)
+	{
+		return SAL_BUSY;
+	}
 	if (SAL_APP_KEY == src_key)
 	{
 		aes_details = KDF_DETAILS_AES_KEY_LOC_MASK && (1 << APP_KEY_SLOT_BLOCK);
@@ -239,6 +354,9 @@ SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsig
 	 *
 	 * \return ATCA_SUCCESS on success, otherwise an error code.
 	 */
+	 /* The derived key replaces the one read back before */
+	 salItemCacheValid &= ~(1 << target_key);
+	 salDeviceCommandCount++;
 	 atcad_status = atcab_kdf(derive_mode, key_id, aes_details, block, NULL, NULL);
 	
 							
@@ -252,7 +370,124 @@ SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsig
 }
 
 /**
- * \brief This function reads back the keys from ECC608 device using Encrypted Read/Plain read based on key type
+ * \brief This function encrypts the given block of data like SAL_AESEncode, without blocking
+ *        the scheduler while the ECC608 executes the command
+ *
+ * \param[in,out] *buffer -  pointer to block of data to be encrypted, holds the result when
+ *						   the callback is invoked
+ * \param[in]  key_type -  Name of the key which is used to encrypt the data
+ * \param[in]  *key		-  Pointer to the key used for Encryption
+ * \param[in]  callback -  Function invoked with the final status of the request
+ *						   (Note: Without ECC608 it is invoked before this function returns)
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the command could not be issued
+ *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
+ */
+SalStatus_t SAL_AESEncodeAsync(unsigned char* buffer, salItems_t key_type, unsigned char* key, SalCallback_t callback)
+{
+	SalStatus_t sal_status = SAL_SUCCESS;
+
+#ifdef CRYPTO_DEV_ENABLED
+	if (salAsyncOp.busy)
+	{
+		return SAL_BUSY;
+	}
+
+	if (SAL_APP_KEY == key_type)
+	{
+		/* AppKey is not readable, the block is encrypted inside ECC608 */
+		salAsyncOp.packet.param1 = AES_MODE_ENCRYPT | (AES_MODE_KEY_BLOCK_MASK & (APP_KEY_SLOT_BLOCK << AES_MODE_KEY_BLOCK_POS));
+		salAsyncOp.packet.param2 = keySlots[key_type];
+		memcpy(salAsyncOp.packet.data, buffer, AES_DATA_SIZE);
+		salAsyncOp.output = buffer;
+		salAsyncOp.outputLength = AES_DATA_SIZE;
+
+		if (ATCA_SUCCESS != atAES(atcab_get_device_type_ext(_gDevice), &salAsyncOp.packet))
+		{
+			return SAL_FAILURE;
+		}
+
+		return sal_AsyncStart(SAL_ECC_AES_EXEC_TIME_MS, callback);
+	}
+#endif
+	/* Session keys are provided by the upper layer, nothing to wait for */
+	sal_status = SAL_AESEncode(buffer, key_type, key);
+	if (SAL_SUCCESS == sal_status)
+	{
+		callback(sal_status);
+	}
+
+	return sal_status;
+}
+
+/**
+ * \brief This function derives the session key like SAL_DeriveSessionKey, without blocking
+ *        the scheduler while the ECC608 executes the command
+ *
+ * \param[in]  *block		-  pointer to block of data (16 Bytes) used for deriving the session key,
+ *						       must stay valid until the callback is invoked
+ * \param[in]  src_key      -  value of type salItems_t - Name of the key which is used to derive the session key
+ * \param[out]  *key		-  Pointer to the derived key (NwkSKey/AppSKey)
+ * \param[in]  target_key   -  value of type salItems_t - Name of the Derived Session Key (NwkSKey/AppSKey)
+ * \param[in]  callback     -  Function invoked with the final status of the request
+ *						       (Note: Without ECC608 it is invoked before this function returns)
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the command could not be issued
+ */
+SalStatus_t SAL_DeriveSessionKeyAsync(unsigned char* block, salItems_t src_key, unsigned char* key, salItems_t target_key, SalCallback_t callback)
+{
+	SalStatus_t sal_status = SAL_SUCCESS;
+
+#ifndef CRYPTO_DEV_ENABLED
+	sal_status = SAL_DeriveSessionKey(block, src_key, key, target_key);
+	if (SAL_SUCCESS == sal_status)
+	{
+		callback(sal_status);
+	}
+#else
+	uint32_t aes_details = 0;
+
+	if (salAsyncOp.busy)
+	{
+		return SAL_BUSY;
+	}
+
+	/* Same KDF command as issued by SAL_DeriveSessionKey */
+	if (SAL_APP_KEY == src_key)
+	{
+		aes_details = KDF_DETAILS_AES_KEY_LOC_MASK && (1 << APP_KEY_SLOT_BLOCK);
+	}
+	salAsyncOp.packet.param1 = KDF_MODE_ALG_AES | KDF_MODE_SOURCE_SLOT | KDF_MODE_TARGET_SLOT;
+	salAsyncOp.packet.param2 = (keySlots[target_key] << 8) | keySlots[src_key];
+	salAsyncOp.packet.data[0] = aes_details;
+	salAsyncOp.packet.data[1] = aes_details >> 8;
+	salAsyncOp.packet.data[2] = aes_details >> 16;
+	salAsyncOp.packet.data[3] = aes_details >> 24;
+	memcpy(&salAsyncOp.packet.data[KDF_DETAILS_SIZE], block, AES_DATA_SIZE);
+	/* Derived key stays inside ECC608 and replaces the one read back before */
+	salAsyncOp.output = NULL;
+	salItemCacheValid &= ~(1 << target_key);
+	key = key;
+
+	if (ATCA_SUCCESS != atKDF(atcab_get_device_type_ext(_gDevice), &salAsyncOp.packet))
+	{
+		return SAL_FAILURE;
+	}
+
+	sal_status = sal_AsyncStart(SAL_ECC_KDF_EXEC_TIME_MS, callback);
+#endif
+	return sal_status;
+}
+
+/**
+ * \brief This function reads back the keys from ECC608 device using Encrypted Read/Plain read based on key type.
+ *        The items are cached, only the first request after a join goes to ECC608
  *
  * \param[in]  key_type		-  value of type salItems_t - Name of the key which is being read back from ECC608
  * \param[in]  *key			-  Pointer to the key which is read back from ECC608				   
@@ -261,6 +496,7 @@ SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsig
  * \return value of type SalStatus_t
  *         SAL_SUCCESS			-- when the key is successfully read back from ECC608 device
  *         SAL_FAILURE			-- when the read function got failed
+ *         SAL_BUSY				-- when an asynchronous request holds the ECC608
  *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
  */
 SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
@@ -272,6 +508,21 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
 	/* Get the Key slot number based on the Key type parameter */	
 	uint8_t keyId = keySlots[key_type];
 	uint8_t block = 0;
+	/* An encrypted read returns a whole 32 bytes block */
+	uint8_t slotData[ATCA_BLOCK_SIZE];
+
+	if ((key_type < SAL_ITEMS_NUM) && (salItemCacheValid & (1 << key_type)))
+	{
+		memcpy(key, salItemCache[key_type], sal_ItemLength(key_type));
+		return SAL_SUCCESS;
+	}
+
+	/* The ECC608 executes one command at a time */
+	if (salAsyncOp.busy)
+	{
+		return SAL_BUSY;
+	}
+
 	switch(key_type)
 	{
 		case SAL_NWKS_KEY:
@@ -294,9 +545,14 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
 			 *
 			 *  returns ATCA_SUCCESS on success, otherwise an error code.
 			 */
+			/* Random, Write, Random, Read (serial number), Nonce, GenDig and Read */
+			salDeviceCommandCount += 7;
 			sal_WriteKeyEncryptionKey();
 			atcab_random(&nonceIn[0]);
-			status = atcab_read_enc(keyId, block, key, &keyEncryptionKey[0], KEK_SLOT, nonceIn);
+			status = atcab_read_enc(keyId, block, slotData, &keyEncryptionKey[0], KEK_SLOT, nonceIn);
+			memcpy(key, slotData, SAL_KEY_LEN);
+			memset(slotData, 0, sizeof(slotData));
+			memset(keyEncryptionKey, 0, sizeof(keyEncryptionKey));
 			
 		}
 		break;
@@ -316,11 +572,13 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
 			 *
 			 *  \return ATCA_SUCCESS on success, otherwise an error code.
 			 */
+			salDeviceCommandCount++;
 			status = atcab_read_bytes_zone(ATCA_ZONE_DATA, keyId, 0, key, SAL_EUI_LEN);
 		}
 		break;
 		case SAL_DEV_EUI:
 		{
+			salDeviceCommandCount++;
 #if (SERIAL_NUM_AS_DEV_EUI == 1)
 			status = atcab_read_serial_number(key);
 #else
@@ -329,7 +587,7 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
 			uint8_t devEUIascii[16] ;
 			size_t bin_size = SAL_EUI_LEN ;
 			status = atcab_read_bytes_zone(ATCA_ZONE_DATA, DEV_EUI_SLOT, 0, devEUIascii, 16) ;
-			atcab_hex2bin((char*)devEUIascii, strlen((char*)devEUIascii), key, &bin_size) ;
+			atcab_hex2bin((char*)devEUIascii, sizeof(devEUIascii), key, &bin_size) ;
 #endif
 		}
 		break;
@@ -342,6 +600,11 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
 	{
 		sal_status = SAL_FAILURE;
 	}
+	else if (SAL_SUCCESS == sal_status)
+	{
+		memcpy(salItemCache[key_type], key, sal_ItemLength(key_type));
+		salItemCacheValid |= (1 << key_type);
+	}
 	
 #else	
 	/* Keep Compiler Happy */
@@ -351,6 +614,84 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
     return sal_status;
 }
 
+/**
+ * \brief This function reads back an item like SAL_Read, without blocking the scheduler
+ *        while the ECC608 executes the commands of an encrypted read
+ *
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key which is being read back from ECC608
+ * \param[out] *key			-  Pointer to the key which is read back from ECC608, must stay valid until
+ *							   the callback is invoked
+ * \param[in]  callback		-  Function invoked with the final status of the request
+ *							   (Note: It is invoked before this function returns when the item is cached,
+ *							   and for the EUIs, which SAL_Read reads)
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the first command could not be issued
+ *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
+ */
+SalStatus_t SAL_ReadAsync(salItems_t key_type, uint8_t* key, SalCallback_t callback)
+{
+	SalStatus_t sal_status = SAL_SUCCESS;
+
+#ifdef CRYPTO_DEV_ENABLED
+	if ((SAL_APPS_KEY <= key_type) && (SAL_MCAST_NWKS_KEY >= key_type) && !(salItemCacheValid & (1 << key_type)))
+	{
+		if (salAsyncOp.busy)
+		{
+			return SAL_BUSY;
+		}
+
+		salReadOp.keyType = key_type;
+		salReadOp.key = key;
+		salReadOp.callback = callback;
+		salReadOp.step = SAL_READ_KEK_RANDOM;
+
+		return sal_ReadIssue();
+	}
+#endif
+	/* Cached items and EUIs, nothing to wait for */
+	sal_status = SAL_Read(key_type, key);
+	if (SAL_SUCCESS == sal_status)
+	{
+		callback(sal_status);
+	}
+
+	return sal_status;
+}
+
+/**
+ * \brief This function zeroises the session keys cached by SAL_Read, so that they are
+ *        read back from ECC608 again on the next request
+ */
+void SAL_ClearSessionKeyCache(void)
+{
+#ifdef CRYPTO_DEV_ENABLED
+	salItems_t item;
+
+	for (item = SAL_APPS_KEY; item <= SAL_MCAST_NWKS_KEY; item++)
+	{
+		memset(salItemCache[item], 0, SAL_KEY_LEN);
+		salItemCacheValid &= ~(1 << item);
+	}
+#endif
+}
+
+/**
+ * \brief This function returns the number of commands sent to ECC608 since initialization
+ *
+ * \return Number of ECC608 commands, 0 when no crypto device is used
+ */
+uint32_t SAL_GetDeviceCommandCount(void)
+{
+#ifdef CRYPTO_DEV_ENABLED
+	return salDeviceCommandCount;
+#else
+	return 0;
+#endif
+}
+
 /**
  * \brief This function calculates the CMAC value using the key specified
  *
@@ -369,15 +710,155 @@ SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key)
  */
 SalStatus_t SAL_AESCmac(uint8_t* key, salItems_t key_type, uint8_t* output, uint8_t* input, uint16_t size)
 {
-	SalStatus_t sal_status = SAL_SUCCESS;
-	uint16_t n = 0, i = 0, j =0;
-	bool flag = false;
 	uint8_t k1[16], k2[16];
-	uint8_t x[16], y[16], mLast[16], padded[16];
-	uint8_t *ptr = NULL;
 
 	sal_GenerateSubkey(key, key_type, k1, k2);
 
+	return SAL_AESCmacWithSubkeys(key, key_type, k1, k2, output, input, size);
+}
+
+/**
+ * \brief This function calculates the CMAC value like SAL_AESCmac, without blocking the
+ *        scheduler while the ECC608 encrypts the blocks
+ *
+ * \param[in]  *key		    -  Pointer to the key which is used for calculating CMAC value for the given buffer
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key which is used to calculate the CMAC
+ * \param[out] *output		-  Pointer to the 16bytes CMAC value
+ * \param[in]  *input		-  Pointer to the data for which CMAC value is being calculated
+ * \param[in]	size        -  Length of the data for which CMAC value is being calculated
+ * \param[in]  callback		-  Function invoked with the final status of the request
+ *						       (Note: Unless the key is stored in ECC608 it is invoked before this
+ *						       function returns)
+ *
+ * The output and input buffers must stay valid until the callback is invoked.
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the first command could not be issued
+ */
+SalStatus_t SAL_AESCmacAsync(uint8_t* key, salItems_t key_type, uint8_t* output, uint8_t* input, uint16_t size, SalCallback_t callback)
+{
+	SalStatus_t sal_status = SAL_SUCCESS;
+
+#ifdef CRYPTO_DEV_ENABLED
+	if (SAL_APP_KEY == key_type)
+	{
+		if (salAsyncOp.busy)
+		{
+			return SAL_BUSY;
+		}
+
+		salCmacOp.key = key;
+		salCmacOp.output = output;
+		salCmacOp.input = input;
+		salCmacOp.size = size;
+		salCmacOp.callback = callback;
+		salCmacOp.subkeys = true;
+		memset(salCmacOp.x, 0, sizeof(salCmacOp.x));
+
+		return SAL_AESEncodeAsync(salCmacOp.x, key_type, key, sal_CmacStep);
+	}
+#endif
+	/* Session keys are provided by the upper layer, nothing to wait for */
+	sal_status = SAL_AESCmac(key, key_type, output, input, size);
+	if (SAL_SUCCESS == sal_status)
+	{
+		callback(sal_status);
+	}
+
+	return sal_status;
+}
+
+/**
+ * \brief This function generates the CMAC subkeys K1 and K2 for the key specified
+ *
+ * \param[in]  *key		    -  Pointer to the key for which the subkeys are generated
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key
+ *						       (Note: This parameter is used when key is stored in ECC608)
+ * \param[out] *k1			-  Pointer to the 16 bytes K1 subkey
+ * \param[out] *k2			-  Pointer to the 16 bytes K2 subkey
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the subkeys are generated
+ */
+SalStatus_t SAL_AESCmacSubkeys(uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2)
+{
+	sal_GenerateSubkey(key, key_type, k1, k2);
+
+	return SAL_SUCCESS;
+}
+
+/**
+ * \brief This function calculates the CMAC value using the key and its precomputed subkeys
+ *
+ * \param[in]  *key		    -  Pointer to the key which is used for calculating CMAC value for the given buffer
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key which is used to calculate the CMAC
+ *						       (Note: This parameter is used when key is stored in ECC608)
+ * \param[in]  *k1			-  Pointer to the K1 subkey returned by SAL_AESCmacSubkeys for this key
+ * \param[in]  *k2			-  Pointer to the K2 subkey returned by SAL_AESCmacSubkeys for this key
+ * \param[out]  *output		-  Pointer to the 16bytes CMAC value
+ * \param[in]   *input		-  Pointer to the data for which CMAC value is being calculated
+ * \param[in]	size        -  Length of the data for which CMAC value is being calculated
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when CMAC calculation is successful
+ *         other				-- status of the failed block encryption
+ */
+SalStatus_t SAL_AESCmacWithSubkeys(uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2, uint8_t* output, uint8_t* input, uint16_t size)
+{
+	SalStatus_t sal_status = SAL_SUCCESS;
+	uint16_t n = 0, i = 0;
+	uint8_t x[16], y[16], mLast[16];
+
+	n = sal_CmacLastBlock(k1, k2, mLast, input, size);
+
+	memset(x, 0, sizeof(x));
+
+	for (i=0; (i<(n-1)) && (SAL_SUCCESS == sal_status); i++)
+	{
+		AESBlockXor(x, x, &input[i << 4]);
+		sal_status = SAL_AESEncode(x, key_type, key);
+	}
+
+	AESBlockXor(y, x, mLast);
+
+	if (SAL_SUCCESS == sal_status)
+	{
+		sal_status = SAL_AESEncode(y, key_type, key);
+	}
+
+	memcpy(output, y, sizeof(y));
+	
+	return sal_status;
+}
+
+/****************************** PRIVATE FUNCTIONS *****************************/
+static void sal_GenerateSubkey (uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2)
+{
+	uint8_t l[16];
+
+	memset(l, 0, sizeof(l));
+
+	SAL_AESEncode(l, key_type, key);
+
+	// compute k1 and k2 sub-keys
+	AESBlockDouble(k1, l);
+	AESBlockDouble(k2, k1);
+}
+
+/**
+ * \brief Prepares the last block of a CMAC, padded if needed and combined with its subkey
+ *
+ * \return Number of blocks of the message
+ */
+static uint16_t sal_CmacLastBlock (uint8_t* k1, uint8_t* k2, uint8_t* mLast, uint8_t* input, uint16_t size)
+{
+	uint16_t n = 0, i = 0;
+	bool flag = false;
+	uint8_t padded[16];
+	uint8_t *ptr = NULL;
+
 	n = (size + 15) >> 4;
 	if (n == 0)
 	{
@@ -391,12 +872,7 @@ SalStatus_t SAL_AESCmac(uint8_t* key, salItems_t key_type, uint8_t* output, uint
 
 	if ( flag == 1 )
 	{
-		j = 0;
-		for (i=((n-1) << 4); i<(n << 4); i++)
-		{
-			mLast[j] = input[i] ^ k1[j];
-			j++;
-		}
+		AESBlockXor(mLast, &input[(n-1) << 4], k1);
 	}
 	else
 	{
@@ -422,93 +898,337 @@ SalStatus_t SAL_AESCmac(uint8_t* key, salItems_t key_type, uint8_t* output, uint
 		}
 
 		// XOR
-		for (i=0; i<sizeof(mLast); i++)
-		{
-			mLast[i] = padded[i] ^ k2[i];
-		}
+		AESBlockXor(mLast, padded, k2);
 	}
 
-	memset(x, 0, sizeof(x));
+	return n;
+}
+
+#ifdef CRYPTO_DEV_ENABLED
+/**
+ * \brief Returns the number of bytes SAL_Read returns for the given item
+ */
+static uint8_t sal_ItemLength(salItems_t key_type)
+{
+	return ((SAL_JOIN_EUI == key_type) || (SAL_DEV_EUI == key_type)) ? SAL_EUI_LEN : SAL_KEY_LEN;
+}
+
+/**
+ * \brief Sends the command held in salAsyncOp and schedules the first poll of its
+ *		  response after the typical execution time
+ *
+ * \param[in]  execTime	-  Typical execution time (ms) of the command
+ * \param[in]  callback	-  Function invoked once the command is complete
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the command is sent to ECC608
+ *         SAL_FAILURE			-- when the command could not be sent
+ */
+static SalStatus_t sal_AsyncStart(uint16_t execTime, SalCallback_t callback)
+{
+	uint32_t firstPoll = MS_TO_US(execTime);
 
-	for (i=0; i<(n-1); i++)
+	/* Shorter commands are polled once the shortest timer period elapsed */
+	if (firstPoll < SWTIMER_MIN_TIMEOUT)
 	{
-		for (j=0; j<16; j++)
-		{
-			y[j] = x[j] ^ input[(i << 4)+j];
-		}
-		memcpy(x, y, sizeof(y));
-		SAL_AESEncode(x, key_type, key);
+		firstPoll = SWTIMER_MIN_TIMEOUT;
 	}
 
-	for (i=0; i<sizeof(x); i++)
+	salDeviceCommandCount++;
+	if (ATCA_SUCCESS != calib_execute_command_start(&salAsyncOp.packet, _gDevice))
 	{
-		y[i] = x[i] ^ mLast[i];
+		return SAL_FAILURE;
 	}
 
-	SAL_AESEncode(y, key_type, key);
+	if (LORAWAN_SUCCESS != SwTimerStart(salAsyncTimerId, firstPoll, SW_TIMEOUT_RELATIVE, (void *)sal_AsyncTimerCallback, NULL))
+	{
+		calib_execute_command_abort(_gDevice);
+		return SAL_FAILURE;
+	}
 
-	memcpy(output, y, sizeof(y));
-	
-	return sal_status;
+	salAsyncOp.callback = callback;
+	salAsyncOp.timeLeft = SAL_ECC_MAX_EXEC_TIME_MS - execTime;
+	salAsyncOp.busy = true;
+
+	return SAL_SUCCESS;
 }
 
-/****************************** PRIVATE FUNCTIONS *****************************/
-static void sal_GenerateSubkey (uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2)
+/**
+ * \brief Polls the response of the outstanding command. If ECC608 is still busy the
+ *		  poll is repeated after the shortest timer period, otherwise the result is
+ *		  reported through the callback of the request
+ */
+static void sal_AsyncTimerCallback(void)
 {
-	uint8_t i = 0;
-	uint8_t l[16];
-	uint8_t const_Rb[16] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x87};
-
+	SalStatus_t sal_status = SAL_SUCCESS;
+	ATCA_STATUS status;
+	uint16_t interval = US_TO_MS(SWTIMER_MIN_TIMEOUT);
 
-	memset(l, 0, sizeof(l));
+	status = calib_execute_command_poll(&salAsyncOp.packet, _gDevice);
 
-	SAL_AESEncode(l, key_type, key);
+	if (ATCA_RX_NO_RESPONSE == status)
+	{
+		if ((salAsyncOp.timeLeft >= interval) &&
+		    (LORAWAN_SUCCESS == SwTimerStart(salAsyncTimerId, SWTIMER_MIN_TIMEOUT, SW_TIMEOUT_RELATIVE, (void *)sal_AsyncTimerCallback, NULL)))
+		{
+			salAsyncOp.timeLeft -= interval;
+			return;
+		}
+		calib_execute_command_abort(_gDevice);
+	}
 
-	// compute k1 sub-key
-	if ( (l[0] & 0x80) == 0x00 )  // MSB( bufferLocal[0] ) is '0'
+	if (ATCA_SUCCESS == status)
 	{
-		sal_FillSubKey( l, k1, (sizeof(l) ) );
+		if (NULL == salAsyncOp.output)
+		{
+			/* Nothing to return */
+		}
+		else if (salAsyncOp.packet.data[ATCA_COUNT_IDX] >= (ATCA_PACKET_OVERHEAD + salAsyncOp.outputLength))
+		{
+			memcpy(salAsyncOp.output, &salAsyncOp.packet.data[ATCA_RSP_DATA_IDX], salAsyncOp.outputLength);
+		}
+		else
+		{
+			sal_status = SAL_FAILURE;
+		}
 	}
 	else
 	{
-		sal_FillSubKey( l, k1, (sizeof(l) ) );
+		sal_status = SAL_FAILURE;
+	}
 
-		for (i=0; i<sizeof(l); i++)
+	salAsyncOp.busy = false;
+	salAsyncOp.callback(sal_status);
+}
+
+/**
+ * \brief Invoked once a block of SAL_AESCmacAsync is encrypted, encrypts the next one
+ *		  or reports the CMAC value
+ */
+static void sal_CmacStep(SalStatus_t status)
+{
+	uint8_t k1[AES_DATA_SIZE], k2[AES_DATA_SIZE];
+
+	if ((SAL_SUCCESS == status) && salCmacOp.subkeys)
+	{
+		AESBlockDouble(k1, salCmacOp.x);
+		AESBlockDouble(k2, k1);
+		salCmacOp.blocks = sal_CmacLastBlock(k1, k2, salCmacOp.mLast, salCmacOp.input, salCmacOp.size);
+		salCmacOp.done = 0;
+		salCmacOp.subkeys = false;
+		memset(salCmacOp.x, 0, sizeof(salCmacOp.x));
+	}
+	else if (SAL_SUCCESS == status)
+	{
+		salCmacOp.done++;
+	}
+
+	if ((SAL_SUCCESS == status) && (salCmacOp.done < salCmacOp.blocks))
+	{
+		if (salCmacOp.done < (salCmacOp.blocks - 1))
 		{
-			k1[i] ^= const_Rb[i];
+			AESBlockXor(salCmacOp.x, salCmacOp.x, &salCmacOp.input[salCmacOp.done << 4]);
 		}
+		else
+		{
+			AESBlockXor(salCmacOp.x, salCmacOp.x, salCmacOp.mLast);
+		}
+
+		status = SAL_AESEncodeAsync(salCmacOp.x, SAL_APP_KEY, salCmacOp.key, sal_CmacStep);
+		if (SAL_SUCCESS == status)
+		{
+			return;
+		}
+	}
+	else if (SAL_SUCCESS == status)
+	{
+		memcpy(salCmacOp.output, salCmacOp.x, AES_DATA_SIZE);
 	}
 
-	// compute k2 sub-key
-	if ( (k1[0] & 0x80) == 0x00 )   // MSB( k1[0] ) is '0'
+	salCmacOp.callback(status);
+}
+
+/**
+ * \brief Issues the command of the current step of SAL_ReadAsync
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the command is sent to ECC608
+ *         SAL_FAILURE			-- when the command could not be sent
+ */
+static SalStatus_t sal_ReadIssue(void)
+{
+	ATCA_STATUS status = ATCA_SUCCESS;
+	ATCADeviceType deviceType = atcab_get_device_type_ext(_gDevice);
+	uint16_t execTime = SAL_ECC_READ_EXEC_TIME_MS;
+
+	salAsyncOp.output = salReadOp.response;
+	salAsyncOp.outputLength = ATCA_BLOCK_SIZE;
+	salAsyncOp.packet.param2 = 0;
+
+	switch (salReadOp.step)
 	{
-		sal_FillSubKey( k1, k2, (sizeof(l)) );
+		case SAL_READ_KEK_RANDOM:
+		case SAL_READ_NUM_IN_RANDOM:
+		{
+			salAsyncOp.packet.param1 = RANDOM_SEED_UPDATE;
+			status = atRandom(deviceType, &salAsyncOp.packet);
+			execTime = SAL_ECC_RANDOM_EXEC_TIME_MS;
+		}
+		break;
+		case SAL_READ_KEK_WRITE:
+		{
+			salAsyncOp.packet.param1 = ATCA_ZONE_DATA | ATCA_ZONE_READWRITE_32;
+			salAsyncOp.packet.param2 = KEK_SLOT << 3;
+			memcpy(salAsyncOp.packet.data, keyEncryptionKey, sizeof(keyEncryptionKey));
+			status = atWrite(deviceType, &salAsyncOp.packet, false);
+			salAsyncOp.output = NULL;
+			execTime = SAL_ECC_WRITE_EXEC_TIME_MS;
+		}
+		break;
+		case SAL_READ_SERIAL_NUMBER:
+		{
+			salAsyncOp.packet.param1 = ATCA_ZONE_CONFIG | ATCA_ZONE_READWRITE_32;
+			status = atRead(deviceType, &salAsyncOp.packet);
+		}
+		break;
+		case SAL_READ_NONCE:
+		{
+			salAsyncOp.packet.param1 = NONCE_MODE_SEED_UPDATE;
+			memcpy(salAsyncOp.packet.data, nonceIn, NONCE_NUMIN_SIZE);
+			status = atNonce(deviceType, &salAsyncOp.packet);
+			execTime = SAL_ECC_NONCE_EXEC_TIME_MS;
+		}
+		break;
+		case SAL_READ_GENDIG:
+		{
+			salAsyncOp.packet.param1 = GENDIG_ZONE_DATA;
+			salAsyncOp.packet.param2 = KEK_SLOT;
+			memcpy(salAsyncOp.packet.data, salGenDigOtherData, sizeof(salGenDigOtherData));
+			status = atGenDig(deviceType, &salAsyncOp.packet, true);
+			salAsyncOp.output = NULL;
+			execTime = SAL_ECC_GENDIG_EXEC_TIME_MS;
+		}
+		break;
+		case SAL_READ_DATA:
+		{
+			salAsyncOp.packet.param1 = ATCA_ZONE_DATA | ATCA_ZONE_READWRITE_32;
+			salAsyncOp.packet.param2 = keySlots[salReadOp.keyType] << 3;
+			status = atRead(deviceType, &salAsyncOp.packet);
+		}
+		break;
 	}
-	else
+
+	if (ATCA_SUCCESS != status)
 	{
-		sal_FillSubKey( k1, k2, (sizeof(l) ) );
+		return SAL_FAILURE;
+	}
+
+	return sal_AsyncStart(execTime, sal_ReadStep);
+}
+
+/**
+ * \brief Uses the response of the command of the current step of SAL_ReadAsync, as
+ *		  atcab_read_enc does
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the response is valid
+ *         SAL_FAILURE			-- when TempKey could not be computed
+ */
+static SalStatus_t sal_ReadResult(void)
+{
+	ATCA_STATUS status = ATCA_SUCCESS;
+	atca_nonce_in_out_t nonce_params;
+	atca_gen_dig_in_out_t gen_dig_param;
+	uint8_t i;
 
-		for (i=0; i<sizeof(l); i++)
+	switch (salReadOp.step)
+	{
+		case SAL_READ_KEK_RANDOM:
+		{
+			memcpy(keyEncryptionKey, salReadOp.response, sizeof(keyEncryptionKey));
+		}
+		break;
+		case SAL_READ_NUM_IN_RANDOM:
+		{
+			memcpy(nonceIn, salReadOp.response, sizeof(nonceIn));
+		}
+		break;
+		case SAL_READ_SERIAL_NUMBER:
+		{
+			memcpy(salReadOp.serialNum, salReadOp.response, sizeof(salReadOp.serialNum));
+			memmove(&salReadOp.serialNum[4], &salReadOp.serialNum[8], 5);
+		}
+		break;
+		case SAL_READ_NONCE:
 		{
-			k2[i] = k2[i] ^ const_Rb[i];
+			memset(&salReadOp.tempKey, 0, sizeof(salReadOp.tempKey));
+			memset(&nonce_params, 0, sizeof(nonce_params));
+			nonce_params.mode = NONCE_MODE_SEED_UPDATE;
+			nonce_params.num_in = nonceIn;
+			nonce_params.rand_out = salReadOp.response;
+			nonce_params.temp_key = &salReadOp.tempKey;
+			status = atcah_nonce(&nonce_params);
 		}
+		break;
+		case SAL_READ_GENDIG:
+		{
+			memset(&gen_dig_param, 0, sizeof(gen_dig_param));
+			gen_dig_param.key_id = KEK_SLOT;
+			gen_dig_param.is_key_nomac = false;
+			gen_dig_param.sn = salReadOp.serialNum;
+			gen_dig_param.stored_value = keyEncryptionKey;
+			gen_dig_param.zone = GENDIG_ZONE_DATA;
+			gen_dig_param.other_data = salGenDigOtherData;
+			gen_dig_param.temp_key = &salReadOp.tempKey;
+			status = atcah_gen_dig(&gen_dig_param);
+		}
+		break;
+		case SAL_READ_DATA:
+		{
+			for (i = 0; i < SAL_KEY_LEN; i++)
+			{
+				salReadOp.key[i] = salReadOp.response[i] ^ salReadOp.tempKey.value[i];
+			}
+			memcpy(salItemCache[salReadOp.keyType], salReadOp.key, SAL_KEY_LEN);
+			salItemCacheValid |= (1 << salReadOp.keyType);
+		}
+		break;
+		default:
+		break;
 	}
+
+	return (ATCA_SUCCESS == status) ? SAL_SUCCESS : SAL_FAILURE;
 }
 
-static void sal_FillSubKey( uint8_t *source, uint8_t *key, uint8_t size)
+/**
+ * \brief Invoked once the command of a step of SAL_ReadAsync is complete, issues the
+ *		  command of the next step or reports the key
+ */
+static void sal_ReadStep(SalStatus_t status)
 {
-	uint8_t i = 0;
-	uint8_t carry = 0;
-
-	i=size;
+	if (SAL_SUCCESS == status)
+	{
+		status = sal_ReadResult();
+	}
 
-	while(i--)
+	if ((SAL_SUCCESS == status) && (SAL_READ_DATA != salReadOp.step))
 	{
-		key[i] = (source[i] << 1) | carry;
-		carry = !!(source[i] & 0x80);
+		salReadOp.step++;
+		status = sal_ReadIssue();
+		if (SAL_SUCCESS == status)
+		{
+			return;
+		}
 	}
+
+	/* Nothing that leads to the key is kept once the read is over */
+	memset(salReadOp.response, 0, sizeof(salReadOp.response));
+	memset(&salReadOp.tempKey, 0, sizeof(salReadOp.tempKey));
+	memset(keyEncryptionKey, 0, sizeof(keyEncryptionKey));
+
+	salReadOp.callback(status);
 }
+#endif
 
 /**
  * \brief Function to generate random 32 bytes key and write that to Key Encryption Key Slot				   
@@ -70,9 +70,14 @@ typedef enum _SalStatus
 	/* Failure in executing the given request */
 	SAL_FAILURE 			= 0x01,
 	/* Invalid key type is given as input parameter for the particular function */
-	SAL_INVALID_KEY_TYPE	= 0x02
+	SAL_INVALID_KEY_TYPE	= 0x02,
+	/* An asynchronous request is already in progress */
+	SAL_BUSY				= 0x03
 	
 } SalStatus_t;
+
+/* Callback invoked with the final status once an asynchronous request is complete */
+typedef void (*SalCallback_t)(SalStatus_t status);
  
  /**
  * \brief This function initializes the security modules like AES, ECC608 (If used)
@@ -95,6 +100,7 @@ SalStatus_t SAL_Init(void);
  * \return value of type SalStatus_t
  *         SAL_SUCCESS			-- when encryption is successful
  *         SAL_FAILURE			-- when encryption is failed
+ *         SAL_BUSY				-- when an asynchronous request holds the ECC608
  *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
  */
 SalStatus_t SAL_AESEncode(unsigned char* buffer, salItems_t key_type, unsigned char* key);
@@ -115,10 +121,49 @@ SalStatus_t SAL_AESEncode(unsigned char* buffer, salItems_t key_type, unsigned c
  * \return value of type SalStatus_t
  *         SAL_SUCCESS			-- when Session key derivation is successful
  *         SAL_FAILURE			-- when Session key derivation is failed
+ *         SAL_BUSY				-- when an asynchronous request holds the ECC608
  *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
  */
 SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsigned char* key, salItems_t target_key);
 
+/**
+ * \brief This function encrypts the given block of data like SAL_AESEncode, without blocking
+ *        the scheduler while the ECC608 executes the command
+ *
+ * \param[in,out] *buffer -  pointer to block of data to be encrypted, holds the result when
+ *						   the callback is invoked
+ * \param[in]  key_type -  Name of the key which is used to encrypt the data
+ * \param[in]  *key		-  Pointer to the key used for Encryption
+ * \param[in]  callback -  Function invoked with the final status of the request
+ *						   (Note: Without ECC608 it is invoked before this function returns)
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the command could not be issued
+ *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
+ */
+SalStatus_t SAL_AESEncodeAsync(unsigned char* buffer, salItems_t key_type, unsigned char* key, SalCallback_t callback);
+
+/**
+ * \brief This function derives the session key like SAL_DeriveSessionKey, without blocking
+ *        the scheduler while the ECC608 executes the command
+ *
+ * \param[in]  *block		-  pointer to block of data (16 Bytes) used for deriving the session key,
+ *						       must stay valid until the callback is invoked
+ * \param[in]  src_key      -  value of type salItems_t - Name of the key which is used to derive the session key
+ * \param[out]  *key		-  Pointer to the derived key (NwkSKey/AppSKey)
+ * \param[in]  target_key   -  value of type salItems_t - Name of the Derived Session Key (NwkSKey/AppSKey)
+ * \param[in]  callback     -  Function invoked with the final status of the request
+ *						       (Note: Without ECC608 it is invoked before this function returns)
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the command could not be issued
+ */
+SalStatus_t SAL_DeriveSessionKeyAsync(unsigned char* block, salItems_t src_key, unsigned char* key, salItems_t target_key, SalCallback_t callback);
+
 /**
  * \brief This function calculates the CMAC value using the key specified
  *
@@ -138,7 +183,63 @@ SalStatus_t SAL_DeriveSessionKey(unsigned char* block, salItems_t src_key, unsig
 SalStatus_t SAL_AESCmac(uint8_t* key, salItems_t key_type, uint8_t* output, uint8_t* input, uint16_t size);
 
 /**
- * \brief This function reads back the keys from ECC608 device using Encrypted Read
+ * \brief This function calculates the CMAC value like SAL_AESCmac, without blocking the
+ *        scheduler while the ECC608 encrypts the blocks
+ *
+ * \param[in]  *key		    -  Pointer to the key which is used for calculating CMAC value for the given buffer
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key which is used to calculate the CMAC
+ * \param[out] *output		-  Pointer to the 16bytes CMAC value
+ * \param[in]  *input		-  Pointer to the data for which CMAC value is being calculated
+ * \param[in]	size        -  Length of the data for which CMAC value is being calculated
+ * \param[in]  callback		-  Function invoked with the final status of the request
+ *						       (Note: Unless the key is stored in ECC608 it is invoked before this
+ *						       function returns)
+ *
+ * The output and input buffers must stay valid until the callback is invoked.
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the first command could not be issued
+ */
+SalStatus_t SAL_AESCmacAsync(uint8_t* key, salItems_t key_type, uint8_t* output, uint8_t* input, uint16_t size, SalCallback_t callback);
+
+/**
+ * \brief This function generates the CMAC subkeys K1 and K2 for the key specified
+ *
+ * \param[in]  *key		    -  Pointer to the key for which the subkeys are generated
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key
+ *						       (Note: This parameter is used when key is stored in ECC608)
+ * \param[out] *k1			-  Pointer to the 16 bytes K1 subkey
+ * \param[out] *k2			-  Pointer to the 16 bytes K2 subkey
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the subkeys are generated
+ */
+SalStatus_t SAL_AESCmacSubkeys(uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2);
+
+/**
+ * \brief This function calculates the CMAC value using the key and its precomputed subkeys,
+ *        saving the subkey generation for keys which are used for many frames
+ *
+ * \param[in]  *key		    -  Pointer to the key which is used for calculating CMAC value for the given buffer
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key which is used to calculate the CMAC
+ *						       (Note: This parameter is used when key is stored in ECC608)
+ * \param[in]  *k1			-  Pointer to the K1 subkey returned by SAL_AESCmacSubkeys for this key
+ * \param[in]  *k2			-  Pointer to the K2 subkey returned by SAL_AESCmacSubkeys for this key
+ * \param[out]  *output		-  Pointer to the 16bytes CMAC value
+ * \param[in]   *input		-  Pointer to the data for which CMAC value is being calculated
+ * \param[in]	size        -  Length of the data for which CMAC value is being calculated
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when CMAC calculation is successful
+ *         other				-- status of the failed block encryption
+ */
+SalStatus_t SAL_AESCmacWithSubkeys(uint8_t* key, salItems_t key_type, uint8_t* k1, uint8_t* k2, uint8_t* output, uint8_t* input, uint16_t size);
+
+/**
+ * \brief This function reads back the keys from ECC608 device using Encrypted Read.
+ *        The items are cached, only the first request after a join goes to ECC608
  *
  * \param[in]  key_type		-  value of type salItems_t - Name of the key which is being read back from ECC608
  * \param[in]  *key			-  Pointer to the key which is read back from ECC608				   
@@ -147,8 +248,41 @@ SalStatus_t SAL_AESCmac(uint8_t* key, salItems_t key_type, uint8_t* output, uint
  * \return value of type SalStatus_t
  *         SAL_SUCCESS			-- when the key is successfully read back from ECC608 device
  *         SAL_FAILURE			-- when the read function got failed
+ *         SAL_BUSY				-- when an asynchronous request holds the ECC608
  *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
  */
 SalStatus_t SAL_Read(salItems_t key_type, uint8_t* key);
 
+/**
+ * \brief This function reads back an item like SAL_Read, without blocking the scheduler
+ *        while the ECC608 executes the commands of an encrypted read
+ *
+ * \param[in]  key_type		-  value of type salItems_t - Name of the key which is being read back from ECC608
+ * \param[out] *key			-  Pointer to the key which is read back from ECC608, must stay valid until
+ *							   the callback is invoked
+ * \param[in]  callback		-  Function invoked with the final status of the request
+ *							   (Note: It is invoked before this function returns when the item is cached,
+ *							   and for the EUIs, which SAL_Read reads)
+ *
+ * \return value of type SalStatus_t
+ *         SAL_SUCCESS			-- when the request is accepted, callback will be invoked
+ *         SAL_BUSY				-- when another asynchronous request is in progress
+ *         SAL_FAILURE			-- when the first command could not be issued
+ *		   SAL_INVALID_KEY_TYPE -- when invalid key_type is given as input parameter
+ */
+SalStatus_t SAL_ReadAsync(salItems_t key_type, uint8_t* key, SalCallback_t callback);
+
+/**
+ * \brief This function zeroises the session keys cached by SAL_Read, so that they are
+ *        read back from ECC608 again on the next request
+ */
+void SAL_ClearSessionKeyCache(void);
+
+/**
+ * \brief This function returns the number of commands sent to ECC608 since initialization
+ *
+ * \return Number of ECC608 commands, 0 when no crypto device is used
+ */
+uint32_t SAL_GetDeviceCommandCount(void);
+
 #endif  // _SAL_H
\ No newline at end of file
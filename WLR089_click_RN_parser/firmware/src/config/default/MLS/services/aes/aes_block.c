@@ -0,0 +1,89 @@
+/**
+* \file  aes_block.c
+*
+* \brief Operations on 128-bit blocks shared by the CMAC and CTR computations
+*		
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+/**************************************** INCLUDES****************************/
+#include <stdint.h>
+#include "aes_engine.h"
+#include "aes_block.h"
+
+/**************************************** MACROS******************************/
+
+#define AES_BLOCK_WORDS             (BLOCKSIZE / sizeof(uint32_t))
+
+#define AES_BLOCK_IS_ALIGNED(p)     (0 == ((uintptr_t)(p) & (sizeof(uint32_t) - 1)))
+
+/* Last byte of the constant Rb of the CMAC subkey generation (RFC 4493) */
+#define AES_BLOCK_RB                (0x87)
+
+/*************************************IMPLEMENTATION****************************/
+
+void AESBlockXor(uint8_t *out, const uint8_t *a, const uint8_t *b)
+{
+	uint8_t i;
+
+	if (AES_BLOCK_IS_ALIGNED(out) && AES_BLOCK_IS_ALIGNED(a) && AES_BLOCK_IS_ALIGNED(b))
+	{
+		uint32_t *outWord = (uint32_t *)out;
+		const uint32_t *aWord = (const uint32_t *)a;
+		const uint32_t *bWord = (const uint32_t *)b;
+
+		for (i = 0; i < AES_BLOCK_WORDS; i++)
+		{
+			outWord[i] = aWord[i] ^ bWord[i];
+		}
+	}
+	else
+	{
+		AESBlockXorPartial(out, a, b, BLOCKSIZE);
+	}
+}
+
+void AESBlockXorPartial(uint8_t *out, const uint8_t *a, const uint8_t *b, uint8_t length)
+{
+	uint8_t i;
+
+	for (i = 0; i < length; i++)
+	{
+		out[i] = a[i] ^ b[i];
+	}
+}
+
+void AESBlockDouble(uint8_t *out, const uint8_t *in)
+{
+	uint8_t i;
+	/* 0xFF if the most significant bit is set, 0x00 otherwise, without branching */
+	uint8_t rbMask = (uint8_t)(0 - (in[0] >> 7));
+
+	for (i = 0; i < (BLOCKSIZE - 1); i++)
+	{
+		out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+	}
+	out[BLOCKSIZE - 1] = (uint8_t)((in[BLOCKSIZE - 1] << 1) ^ (AES_BLOCK_RB & rbMask));
+}
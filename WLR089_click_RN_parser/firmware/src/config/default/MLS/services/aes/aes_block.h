@@ -0,0 +1,75 @@
+/**
+* \file  aes_block.h
+*
+* \brief Operations on 128-bit blocks shared by the CMAC and CTR computations
+*		
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+
+
+#ifndef _AES_BLOCK_H
+#define _AES_BLOCK_H
+
+#include <stdint.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/************************************* PROTOTYPES*****************************/
+
+/**
+ * \brief XORs two blocks, out = a ^ b. Processed a word at a time when all
+ *        the buffers are word aligned
+ * \param[out] out Resulting block, may be the same as a or b
+ * \param[in] a First block
+ * \param[in] b Second block
+ */
+void AESBlockXor(uint8_t *out, const uint8_t *a, const uint8_t *b);
+
+/**
+ * \brief XORs the first length bytes of two blocks, out = a ^ b
+ * \param[out] out Resulting bytes, may be the same as a or b
+ * \param[in] a First block
+ * \param[in] b Second block
+ * \param[in] length Number of bytes to be processed, at most BLOCKSIZE
+ */
+void AESBlockXorPartial(uint8_t *out, const uint8_t *a, const uint8_t *b, uint8_t length);
+
+/**
+ * \brief Multiplies a block by x in GF(2^128), i.e. shifts it left by one bit
+ *        and XORs Rb into it if the dropped bit was set (CMAC subkey step).
+ *        Runs in constant time with respect to the block content
+ * \param[out] out Resulting block, may be the same as in
+ * \param[in] in Block to be doubled
+ */
+void AESBlockDouble(uint8_t *out, const uint8_t *in);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif  // _AES_BLOCK_H
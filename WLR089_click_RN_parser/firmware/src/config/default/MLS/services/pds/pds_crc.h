@@ -0,0 +1,83 @@
+/**
+* \file  pds_crc.h
+*
+* \brief This is the Pds CRC header file which contains the interface of the
+*	CRC16-CCITT used to protect the PDS rows, journal and index.
+*		
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+
+
+#ifndef _PDS_CRC_H_
+#define _PDS_CRC_H_
+
+/******************************************************************************
+                   Includes section
+******************************************************************************/
+#include <stdint.h>
+
+/******************************************************************************
+                   Defines section
+******************************************************************************/
+/* CRC implementations, from the smallest to the fastest */
+#define PDS_CRC_BITWISE				0	// No table
+#define PDS_CRC_TABLE				1	// 512 byte table
+#define PDS_CRC_SLICE_BY_4			2	// 2 KB of tables, four bytes per step
+
+#ifndef PDS_CRC_IMPL
+#define PDS_CRC_IMPL				PDS_CRC_TABLE
+#endif
+
+/* The tables are kept in flash unless PDS_CRC_TABLE_IN_RAM is defined,
+ * RAM avoids the flash wait states at the cost of RAM */
+#ifdef PDS_CRC_TABLE_IN_RAM
+#define PDS_CRC_TABLE_ATTR
+#else
+#define PDS_CRC_TABLE_ATTR			const
+#endif
+
+/* Initial value of a CRC computation */
+#define PDS_CRC_INIT				(0x0000U)
+
+/******************************************************************************
+                   Prototypes section
+******************************************************************************/
+
+/**************************************************************************//**
+\brief	Continues a CRC16-CCITT computation (reflected, polynomial 0x8408) over
+		more data. Starting from PDS_CRC_INIT, the result does not depend on
+		how the data is split across calls.
+
+\param[in] 	crc - The CRC of the preceding data, or PDS_CRC_INIT.
+\param[in] 	data - The data.
+\param[in] 	length - The amount of data.
+\param[out] uint16_t - The updated 16 bit CRC.
+******************************************************************************/
+uint16_t pdsCrc16Update(uint16_t crc, const uint8_t *data, uint16_t length);
+
+#endif  /* _PDS_CRC_H_ */
+
+/* eof pds_crc.h */
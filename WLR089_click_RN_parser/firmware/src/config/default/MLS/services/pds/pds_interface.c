@@ -38,6 +38,8 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "pds_common.h"
 #include "pds_task_handler.h"
 #include "pds_wl.h"
+#include "pds_journal.h"
+#include "sw_timer.h"
 
 /******************************************************************************
                    Global section
@@ -49,11 +51,20 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 ******************************************************************************/
 #if (ENABLE_PDS == 1)	
 bool isFileSet[PDS_MAX_FILE_IDX];
+PdsStats_t pdsStats;
 static bool pdsUnInitFlag = false;
+static uint8_t pdsFlushTimerId = SWTIMER_INVALID;
+/* Time of the first store since the last flush */
+static uint64_t pdsDirtySince;
 #endif
 PdsFileMarks_t fileMarks[PDS_MAX_FILE_IDX];
 
 
+#if (ENABLE_PDS == 1)
+static void pdsScheduleFlush(void);
+static void pdsFlushTimerCallback(void);
+#endif
+
 /******************************************************************************
                    Implementations section
 ******************************************************************************/
@@ -68,6 +79,18 @@ PdsStatus_t PDS_Init(void)
 {
 #if (ENABLE_PDS == 1)	
 	PdsStatus_t status = pdsWlInit();
+	if (PDS_OK == status)
+	{
+		status = pdsJournalInit();
+	}
+	if (SWTIMER_INVALID == pdsFlushTimerId)
+	{
+		/* Without the timer every store is written right away */
+		if (LORAWAN_SUCCESS != SwTimerCreate(&pdsFlushTimerId))
+		{
+			pdsFlushTimerId = SWTIMER_INVALID;
+		}
+	}
 	pdsUnInitFlag = false;
 	return status;
 #else
@@ -110,9 +133,18 @@ PdsStatus_t PDS_Store(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
 		{
 			if (PDS_MAX_FILE_IDX > pdsFileItemIdx)
 			{
-				*((fileMarks[pdsFileItemIdx].fileMarkListAddr) + item) = PDS_OP_STORE;
-				isFileSet[pdsFileItemIdx] = true;
-				pdsPostTask(PDS_STORE_DELETE_TASK_ID);
+				pdsStats.stores++;
+				if (pdsJournalStore(pdsFileItemIdx, item))
+				{
+					/* Counters are appended to the journal, their file is left as it is */
+					pdsPostTask(PDS_JOURNAL_TASK_ID);
+				}
+				else
+				{
+					*((fileMarks[pdsFileItemIdx].fileMarkListAddr) + item) = PDS_OP_STORE;
+					isFileSet[pdsFileItemIdx] = true;
+					pdsScheduleFlush();
+				}
 			}
 			else
 			{
@@ -141,46 +173,17 @@ PdsStatus_t PDS_Restore(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
 #if (ENABLE_PDS == 1)
 	if (false == pdsUnInitFlag)
 	{
-		PdsMem_t buffer;
-		uint8_t *ptr;
-		ItemMap_t itemInfo;
-		ItemHeader_t itemHeader;
-		uint16_t size;
-		
 		if ((0 != fileMarks[pdsFileItemIdx].numItems) && 				\
 		(0 != fileMarks[pdsFileItemIdx].fileMarkListAddr) &&	\
 		(0 != fileMarks[pdsFileItemIdx].itemListAddr)			\
 		)
 		{
-			memset(&buffer, 0, sizeof(PdsMem_t));
-			memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + (fileMarks[pdsFileItemIdx].numItems - 1)), sizeof(ItemMap_t));
-			size = itemInfo.itemOffset + itemInfo.size + sizeof(ItemHeader_t);
-			status = pdsWlRead(pdsFileItemIdx, &buffer, size);
-			if (status != PDS_OK)
-			{
-				return status;
-			}
-			
-			memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + item), sizeof(ItemMap_t));
-			ptr = ((uint8_t *)&(buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlData));
-			ptr += itemInfo.itemOffset;
-			
-			if (item == itemInfo.itemId)
+			/* The item is copied straight from the NVM */
+			status = pdsWlRestore(pdsFileItemIdx, fileMarks[pdsFileItemIdx].itemListAddr,
+					fileMarks[pdsFileItemIdx].numItems, item);
+			if (PDS_OK == status)
 			{
-				memcpy((void *)(&itemHeader), (void *)(ptr), sizeof(ItemHeader_t));
-				if (false == itemHeader.delete)
-				{
-					ptr += sizeof(ItemHeader_t);
-					memcpy((void *)(itemInfo.ramAddress), (void *)(ptr), itemInfo.size);
-				}
-				else
-				{
-					return PDS_ITEM_DELETED;
-				}
-			}
-			else
-			{
-				return PDS_NOT_FOUND;
+				pdsJournalRestore(pdsFileItemIdx, item);
 			}
 			
 			return status;
@@ -217,7 +220,8 @@ PdsStatus_t PDS_Delete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
 			{
 				*((fileMarks[pdsFileItemIdx].fileMarkListAddr) + item) = PDS_OP_DELETE;
 				isFileSet[pdsFileItemIdx] = true;
-				pdsPostTask(PDS_STORE_DELETE_TASK_ID);
+				pdsStats.stores++;
+				pdsScheduleFlush();
 			}
 			else
 			{
@@ -276,6 +280,7 @@ PdsStatus_t PDS_DeleteAll(void)
 	if (false == pdsUnInitFlag)
 	{
 		pdsWlDeleteAll();
+		pdsJournalDeleteAll();
 	}
 #endif
 	return PDS_OK;
@@ -293,12 +298,6 @@ PdsStatus_t PDS_RestoreAll(void)
 #if (ENABLE_PDS == 1)
 	if (false == pdsUnInitFlag)
 	{
-		uint8_t *ptr;
-		ItemMap_t itemInfo;
-		ItemHeader_t itemHeader;
-		PdsMem_t buffer;
-		uint16_t size;
-		
 		for (uint8_t pdsFileItemIdx = 0; pdsFileItemIdx < PDS_MAX_FILE_IDX; pdsFileItemIdx++)
 		{
 			if ((0 != fileMarks[pdsFileItemIdx].numItems) && 			\
@@ -306,27 +305,16 @@ PdsStatus_t PDS_RestoreAll(void)
 			(0 != fileMarks[pdsFileItemIdx].itemListAddr)			\
 			)
 			{
-				memset(&buffer, 0, sizeof(PdsMem_t));
-				memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + (fileMarks[pdsFileItemIdx].numItems - 1)), sizeof(ItemMap_t));
-				size = itemInfo.itemOffset + itemInfo.size + sizeof(ItemHeader_t);
-				status = pdsWlRead(pdsFileItemIdx, &buffer, size);
+				/* The items are copied straight from the NVM */
+				status = pdsWlRestore(pdsFileItemIdx, fileMarks[pdsFileItemIdx].itemListAddr,
+						fileMarks[pdsFileItemIdx].numItems, PDS_WL_ALL_ITEMS);
 				if (status != PDS_OK)
 				{
 					return status;
 				}
 				
-				for (uint8_t itemIdx = 0; itemIdx < fileMarks[pdsFileItemIdx].numItems; itemIdx++)
-				{
-					memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + itemIdx), sizeof(ItemMap_t));
-					ptr = (uint8_t *)(&(buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlData));
-					ptr += itemInfo.itemOffset;
-					memcpy((void *)(&itemHeader), (void *)(ptr), sizeof(ItemHeader_t));
-					ptr += sizeof(ItemHeader_t);
-					if (false == itemHeader.delete)
-					{
-						memcpy((void *)(itemInfo.ramAddress), (void *)(ptr), itemHeader.size);
-					}
-				}
+				/* The journal holds newer values of the counters than the file */
+				pdsJournalRestore(pdsFileItemIdx, PDS_JOURNAL_ALL_ITEMS);
 				if(fileMarks[pdsFileItemIdx].fIDcb != NULL)
 				{
 					fileMarks[pdsFileItemIdx].fIDcb();
@@ -360,16 +348,136 @@ PdsStatus_t PDS_StoreAll(void)
 				for (uint8_t itemIdx = 0; itemIdx < fileMarks[pdsFileItemIdx].numItems; itemIdx++)
 				{
 					*(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx) = PDS_OP_STORE;
+					/* Journalled items are appended too, so that no older entry overrides them */
+					(void)pdsJournalStore(pdsFileItemIdx, itemIdx);
 				}
 				isFileSet[pdsFileItemIdx] = true;
 			}
 		}
 		pdsPostTask(PDS_STORE_DELETE_TASK_ID);
+		pdsPostTask(PDS_JOURNAL_TASK_ID);
 	}
 #endif	
 	return PDS_OK;
 }
 
+/**************************************************************************//**
+\brief	This function writes all the files marked dirty by PDS_Store and
+		PDS_Delete without waiting for the quiet period.
+
+\param[in] none
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t PDS_Flush(void)
+{
+	PdsStatus_t status = PDS_OK;
+#if (ENABLE_PDS == 1)
+	if (false == pdsUnInitFlag)
+	{
+		if (SWTIMER_INVALID != pdsFlushTimerId)
+		{
+			SwTimerStop(pdsFlushTimerId);
+		}
+		status = pdsFlushAll();
+	}
+#endif
+	return status;
+}
+
+/**************************************************************************//**
+\brief	This function writes all the files marked dirty by PDS_Store and
+		PDS_Delete as one transaction. The files are staged in free rows and
+		published together, a reset before the end keeps all the previous
+		versions. Files whose items are unchanged are not rewritten.
+
+\param[in] replaceAll - true to also delete the stored files that are not
+			marked dirty, e.g. the files of the previous band.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t PDS_Commit(bool replaceAll)
+{
+	PdsStatus_t status = PDS_OK;
+#if (ENABLE_PDS == 1)
+	uint16_t keepFiles = UINT16_MAX;
+
+	if (false == pdsUnInitFlag)
+	{
+		if (SWTIMER_INVALID != pdsFlushTimerId)
+		{
+			SwTimerStop(pdsFlushTimerId);
+		}
+
+		if (replaceAll)
+		{
+			keepFiles = 0;
+			for (uint8_t pdsFileItemIdx = 0; pdsFileItemIdx < PDS_MAX_FILE_IDX; pdsFileItemIdx++)
+			{
+				if (isFileSet[pdsFileItemIdx])
+				{
+					keepFiles |= (1U << pdsFileItemIdx);
+				}
+			}
+		}
+
+		pdsWlStageBegin();
+		status = pdsFlushAll();
+		if (PDS_OK == status)
+		{
+			status = pdsWlStageCommit(keepFiles);
+		}
+		else
+		{
+			pdsWlStageAbort();
+		}
+	}
+#endif
+	return status;
+}
+
+/**************************************************************************//**
+\brief	This function checks if the PDS can be put to sleep, i.e. no row is
+		being programmed in the background.
+
+\param[out] - return true or false
+******************************************************************************/
+bool PDS_ReadyToSleep(void)
+{
+#if (ENABLE_PDS == 1)
+	return !pdsNvmIsBusy();
+#else
+	return true;
+#endif
+}
+
+/**************************************************************************//**
+\brief This function reports the write-back statistics of the PDS.
+
+\param[out] stats - The statistics.
+******************************************************************************/
+void PDS_GetStats(PdsStats_t *stats)
+{
+	memset(stats, 0, sizeof(PdsStats_t));
+#if (ENABLE_PDS == 1)
+	memcpy(stats, &pdsStats, sizeof(PdsStats_t));
+	stats->pending = pdsJournalPendingCount();
+	stats->dirty = 0;
+	for (uint8_t pdsFileItemIdx = 0; pdsFileItemIdx < PDS_MAX_FILE_IDX; pdsFileItemIdx++)
+	{
+		if (isFileSet[pdsFileItemIdx])
+		{
+			stats->dirty++;
+			for (uint8_t itemIdx = 0; itemIdx < fileMarks[pdsFileItemIdx].numItems; itemIdx++)
+			{
+				if (PDS_OP_NONE != *(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx))
+				{
+					stats->pending++;
+				}
+			}
+		}
+	}
+#endif
+}
+
 /**************************************************************************//**
 \brief This function registers a file to the PDS.
 
@@ -395,6 +503,48 @@ PdsStatus_t PDS_RegFile(PdsFileItemIdx_t argFileId, PdsFileMarks_t argFileMarks)
 	return status;
 }
 
+/**************************************************************************//**
+\brief	This function moves a 4 byte item of a registered file to the counter
+		journal. Every store of the item then appends a journal record instead
+		of rewriting the whole file. An item that cannot be registered stays
+		stored in its file.
+
+\param[in] pdsFileItemIdx - The file id of the item.
+\param[in] item - The item id of the item in PDS.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t PDS_RegCounter(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
+{
+	PdsStatus_t status = PDS_OK;
+#if (ENABLE_PDS == 1)
+	if (false == pdsUnInitFlag)
+	{
+		ItemMap_t itemInfo;
+
+		if ((PDS_MAX_FILE_IDX > pdsFileItemIdx) &&					\
+			(item < fileMarks[pdsFileItemIdx].numItems) &&			\
+			(0 != fileMarks[pdsFileItemIdx].itemListAddr)			\
+		   )
+		{
+			memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + item), sizeof(ItemMap_t));
+			if (sizeof(uint32_t) == itemInfo.size)
+			{
+				status = pdsJournalRegItem(pdsFileItemIdx, item, (uint32_t *)itemInfo.ramAddress);
+			}
+			else
+			{
+				status = PDS_ERROR;
+			}
+		}
+		else
+		{
+			status = PDS_INVLIAD_FILE_IDX;
+		}
+	}
+#endif
+	return status;
+}
+
 /**************************************************************************//**
 \brief This function registers a file to the PDS.
 
@@ -420,4 +570,61 @@ PdsStatus_t PDS_UnRegFile(PdsFileItemIdx_t argFileId)
 	return status;
 }
 
+#if (ENABLE_PDS == 1)
+/**************************************************************************//**
+\brief	Restarts the quiet period after a store, so that back to back stores
+		are written together. The write is not delayed beyond
+		PDS_FLUSH_MAX_DELAY_MS after the first store.
+******************************************************************************/
+static void pdsScheduleFlush(void)
+{
+	uint64_t now;
+	uint64_t deadline;
+	uint32_t delay = MS_TO_US(PDS_FLUSH_QUIET_PERIOD_MS);
+
+	if (SWTIMER_INVALID == pdsFlushTimerId)
+	{
+		pdsPostTask(PDS_STORE_DELETE_TASK_ID);
+		return;
+	}
+
+	now = SwTimerGetTime();
+	if (SwTimerIsRunning(pdsFlushTimerId))
+	{
+		deadline = pdsDirtySince + MS_TO_US(PDS_FLUSH_MAX_DELAY_MS);
+		if (now >= deadline)
+		{
+			return;
+		}
+		if ((deadline - now) < delay)
+		{
+			delay = (uint32_t)(deadline - now);
+		}
+		SwTimerStop(pdsFlushTimerId);
+	}
+	else
+	{
+		pdsDirtySince = now;
+	}
+
+	if (SWTIMER_MIN_TIMEOUT > delay)
+	{
+		delay = SWTIMER_MIN_TIMEOUT;
+	}
+
+	if (LORAWAN_SUCCESS != SwTimerStart(pdsFlushTimerId, delay, SW_TIMEOUT_RELATIVE, (void *)pdsFlushTimerCallback, NULL))
+	{
+		pdsPostTask(PDS_STORE_DELETE_TASK_ID);
+	}
+}
+
+/**************************************************************************//**
+\brief	Posts the write of the dirty files once the quiet period has elapsed.
+******************************************************************************/
+static void pdsFlushTimerCallback(void)
+{
+	pdsPostTask(PDS_STORE_DELETE_TASK_ID);
+}
+#endif
+
 /* eof pds_interface.c */
\ No newline at end of file
@@ -64,6 +64,10 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 				PDS_Restore(file, itemNum); \
 				} while(0)
 
+/* Evaluates to the PdsStatus_t of the registration */
+#define PDS_REG_COUNTER(item)			\
+				PDS_RegCounter((PdsFileItemIdx_t)((item) >> 8), (uint8_t)((item) & 0xFF))
+
 #define PDS_FILE_START_OFFSET     	0x00
 
 #define PDS_NVM_VERSION				0x01	
@@ -72,6 +76,16 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 #define PDS_MAGIC					0xa5
 
+/* Quiet period after the last store before the dirty files are written */
+#ifndef PDS_FLUSH_QUIET_PERIOD_MS
+#define PDS_FLUSH_QUIET_PERIOD_MS	(200)
+#endif
+
+/* Longest time a dirty file waits for a quiet period */
+#ifndef PDS_FLUSH_MAX_DELAY_MS
+#define PDS_FLUSH_MAX_DELAY_MS		(2000)
+#endif
+
 /******************************************************************************
                                Types section
 *******************************************************************************/
@@ -143,6 +157,16 @@ typedef struct _PdsFileMarks
 	void         (*fIDcb)(void);
 } PdsFileMarks_t;
 
+/* PDS write-back statistics */
+typedef struct _PdsStats
+{
+	uint16_t pending;	// Item stores and deletes not written yet
+	uint8_t dirty;		// Files waiting to be written
+	uint32_t stores;	// Store and delete requests
+	uint32_t flushes;	// File writes
+	uint32_t errors;	// Journal and file writes that failed and fell back
+} PdsStats_t;
+
 #define PDS_SIZE_OF_ITEM_HDR         sizeof(ItemHeader_t)
 
 /******************************************************************************
@@ -225,6 +249,42 @@ PdsStatus_t PDS_RestoreAll(void);
 ******************************************************************************/
 PdsStatus_t PDS_StoreAll(void);
 
+/**************************************************************************//**
+\brief	This function writes all the files marked dirty by PDS_Store and
+		PDS_Delete without waiting for the quiet period.
+
+\param[in] none
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t PDS_Flush(void);
+
+/**************************************************************************//**
+\brief	This function writes all the files marked dirty by PDS_Store and
+		PDS_Delete as one transaction. The files are staged in free rows and
+		published together, a reset before the end keeps all the previous
+		versions. Files whose items are unchanged are not rewritten.
+
+\param[in] replaceAll - true to also delete the stored files that are not
+			marked dirty, e.g. the files of the previous band.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t PDS_Commit(bool replaceAll);
+
+/**************************************************************************//**
+\brief	This function checks if the PDS can be put to sleep, i.e. no row is
+		being programmed in the background.
+
+\param[out] - return true or false
+******************************************************************************/
+bool PDS_ReadyToSleep(void);
+
+/**************************************************************************//**
+\brief This function reports the write-back statistics of the PDS.
+
+\param[out] stats - The statistics.
+******************************************************************************/
+void PDS_GetStats(PdsStats_t *stats);
+
 /**************************************************************************//**
 \brief This function registers a file to the PDS.
 
@@ -233,6 +293,18 @@ PdsStatus_t PDS_StoreAll(void);
 ******************************************************************************/
 PdsStatus_t PDS_RegFile(PdsFileItemIdx_t argFileId, PdsFileMarks_t argFileMarks);
 
+/**************************************************************************//**
+\brief	This function moves a 4 byte item of a registered file to the counter
+		journal. Every store of the item then appends a journal record instead
+		of rewriting the whole file. An item that cannot be registered stays
+		stored in its file.
+
+\param[in] pdsFileItemIdx - The file id of the item.
+\param[in] item - The item id of the item in PDS.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t PDS_RegCounter(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item);
+
 /**************************************************************************//**
 \brief This function un-registers a file to the PDS.
 
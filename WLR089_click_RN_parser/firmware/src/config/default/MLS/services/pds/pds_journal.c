@@ -0,0 +1,473 @@
+/**
+* \file  pds_journal.c
+*
+* \brief This is the Pds counter journal source file. Frame counters change
+*        with every frame, rewriting their file for each change costs a row
+*        erase. Instead, a record of all of them is programmed to the next
+*        erased page of the journal rows, and they are written to their
+*        files only when the journal moves to the next row.
+*		
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+
+
+
+/******************************************************************************
+                   Includes section
+******************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "pds_interface.h"
+#include "pds_common.h"
+#include "pds_nvm.h"
+#include "pds_journal.h"
+
+#if (ENABLE_PDS == 1)
+/******************************************************************************
+                   Defines section
+******************************************************************************/
+#define PDS_JOURNAL_SLOTS_PER_PAGE  ((EEPROM_PAGE_SIZE) / sizeof(PdsJournalEntry_t))
+#define PDS_JOURNAL_ROW_WORDS       ((EEPROM_ROW_SIZE) / sizeof(uint32_t))
+#define PDS_JOURNAL_PAGE_WORDS      ((EEPROM_PAGE_SIZE) / sizeof(uint32_t))
+#define PDS_JOURNAL_NUM_PAGES       ((PDS_JOURNAL_NUM_ROWS) * (EEPROM_PAGE_PER_ROW))
+/* Item id of the record header in slot 0, the low byte holds the number of items */
+#define PDS_JOURNAL_HEADER_ID       (0x4A00U)
+#define PDS_JOURNAL_HEADER_MASK     (0xFF00U)
+#define PDS_JOURNAL_NO_PAGE         (0xFFU)
+
+#define PDS_JOURNAL_ITEM_ID(file, item)     ((uint16_t)(((file) << 8) | (item)))
+
+/************************************************************************/
+/*  Static variables                                                    */
+/************************************************************************/
+typedef struct _PdsJournalItem
+{
+    uint16_t itemId;
+    uint32_t *ramAddress;
+} PdsJournalItem_t;
+
+static PdsJournalItem_t journalItems[PDS_JOURNAL_MAX_ITEMS];
+static uint8_t journalNumItems;
+/* Bitmap of the journalItems waiting to be appended */
+static uint8_t journalPending;
+/* Page holding the latest record and the page the next record goes to,
+ * both counted over all the journal rows */
+static uint8_t journalLastPage = PDS_JOURNAL_NO_PAGE;
+static uint8_t journalPage;
+static uint32_t journalSeq;
+
+/************************************************************************/
+/*  Extern variables                                                    */
+/************************************************************************/
+extern bool isFileSet[];
+extern PdsFileMarks_t fileMarks[];
+
+/******************************************************************************
+                   Static prototype section
+******************************************************************************/
+static void pdsJournalFillEntry(PdsJournalEntry_t *entry, uint16_t itemId, uint32_t value);
+static bool pdsJournalIsValid(PdsJournalEntry_t *entry);
+static bool pdsJournalIsRecord(PdsJournalEntry_t *entries);
+static bool pdsJournalIsErased(uint32_t *page);
+static PdsStatus_t pdsJournalAppend(bool *compact);
+
+/******************************************************************************
+                   Implementations section
+******************************************************************************/
+
+/**************************************************************************//**
+\brief Initializes the journal by locating the latest record.
+
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsJournalInit(void)
+{
+    uint32_t rowBuf[PDS_JOURNAL_ROW_WORDS];
+    PdsJournalEntry_t *entries;
+    PdsStatus_t status;
+    uint8_t page;
+
+    journalLastPage = PDS_JOURNAL_NO_PAGE;
+    journalPage = 0;
+    journalPending = 0;
+
+    for (uint8_t row = 0; row < PDS_JOURNAL_NUM_ROWS; row++)
+    {
+        status = pdsNvmReadRaw(PDS_JOURNAL_FIRST_ROW + row, rowBuf);
+        if (PDS_OK != status)
+        {
+            return status;
+        }
+
+        /* Torn records fail their CRC, the latest complete one wins */
+        for (uint8_t pageIdx = 0; pageIdx < EEPROM_PAGE_PER_ROW; pageIdx++)
+        {
+            entries = (PdsJournalEntry_t *)&rowBuf[pageIdx * PDS_JOURNAL_PAGE_WORDS];
+            page = (row * EEPROM_PAGE_PER_ROW) + pageIdx;
+            if (pdsJournalIsRecord(entries) &&
+                ((PDS_JOURNAL_NO_PAGE == journalLastPage) || (entries[0].value > journalSeq)))
+            {
+                journalLastPage = page;
+                journalSeq = entries[0].value;
+            }
+        }
+    }
+
+    if (PDS_JOURNAL_NO_PAGE != journalLastPage)
+    {
+        journalPage = (journalLastPage + 1) % PDS_JOURNAL_NUM_PAGES;
+    }
+
+    return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Registers a 4 byte item to be kept in the journal instead of its file.
+
+\param[in] 	pdsFileItemIdx - The file id of the item.
+\param[in] 	item - The item id of the item in the file.
+\param[in] 	ramAddress - The RAM location of the item.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsJournalRegItem(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item, uint32_t *ramAddress)
+{
+    uint16_t itemId = PDS_JOURNAL_ITEM_ID(pdsFileItemIdx, item);
+
+    for (uint8_t i = 0; i < journalNumItems; i++)
+    {
+        if (itemId == journalItems[i].itemId)
+        {
+            journalItems[i].ramAddress = ramAddress;
+            return PDS_OK;
+        }
+    }
+
+    if (PDS_JOURNAL_MAX_ITEMS <= journalNumItems)
+    {
+        return PDS_NOT_ENOUGH_MEMORY;
+    }
+
+    journalItems[journalNumItems].itemId = itemId;
+    journalItems[journalNumItems].ramAddress = ramAddress;
+    journalNumItems++;
+
+    return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Marks a journalled item to be appended by the next pdsJournalFlush.
+
+\param[in] 	pdsFileItemIdx - The file id of the item.
+\param[in] 	item - The item id of the item in the file.
+\param[out] bool - true if the item is journalled, false if it is stored in its file.
+******************************************************************************/
+bool pdsJournalStore(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
+{
+    uint16_t itemId = PDS_JOURNAL_ITEM_ID(pdsFileItemIdx, item);
+
+    for (uint8_t i = 0; i < journalNumItems; i++)
+    {
+        if (itemId == journalItems[i].itemId)
+        {
+            journalPending |= (1 << i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**************************************************************************//**
+\brief	Appends a record with the current value of all the items if any of
+		them is pending. When the record starts a new row, that row is erased
+		first and the items have to be written to their files as well.
+
+\param[out] compact - Set to true if the items have to be written to their files.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsJournalFlush(bool *compact)
+{
+    PdsStatus_t status;
+
+    *compact = false;
+    if (0 == journalPending)
+    {
+        return PDS_OK;
+    }
+
+    status = pdsJournalAppend(compact);
+    if (PDS_OK == status)
+    {
+        journalPending = 0;
+    }
+
+    return status;
+}
+
+/**************************************************************************//**
+\brief	Marks the journalled items to be stored in their files by the next
+		write of the files.
+******************************************************************************/
+void pdsJournalMarkFiles(void)
+{
+    PdsFileItemIdx_t pdsFileItemIdx;
+    uint8_t item;
+
+    for (uint8_t i = 0; i < journalNumItems; i++)
+    {
+        pdsFileItemIdx = (PdsFileItemIdx_t)(journalItems[i].itemId >> 8);
+        item = (uint8_t)(journalItems[i].itemId & 0xFF);
+        *(fileMarks[pdsFileItemIdx].fileMarkListAddr + item) = PDS_OP_STORE;
+        isFileSet[pdsFileItemIdx] = true;
+    }
+}
+
+/**************************************************************************//**
+\brief	Copies the items of the latest journal record to RAM.
+
+\param[in] 	pdsFileItemIdx - The file id of the items.
+\param[in] 	item - The item id, PDS_JOURNAL_ALL_ITEMS for all items of the file.
+******************************************************************************/
+void pdsJournalRestore(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
+{
+    uint32_t rowBuf[PDS_JOURNAL_ROW_WORDS];
+    PdsJournalEntry_t *entries;
+    uint8_t count;
+
+    if ((PDS_JOURNAL_NO_PAGE == journalLastPage) ||
+        (PDS_OK != pdsNvmReadRaw(PDS_JOURNAL_FIRST_ROW + (journalLastPage / EEPROM_PAGE_PER_ROW), rowBuf)))
+    {
+        return;
+    }
+
+    entries = (PdsJournalEntry_t *)&rowBuf[(journalLastPage % EEPROM_PAGE_PER_ROW) * PDS_JOURNAL_PAGE_WORDS];
+    if (!pdsJournalIsRecord(entries))
+    {
+        return;
+    }
+
+    count = (uint8_t)(entries[0].itemId & ~PDS_JOURNAL_HEADER_MASK);
+    for (uint8_t slot = 1; slot <= count; slot++)
+    {
+        if (((entries[slot].itemId >> 8) != pdsFileItemIdx) ||
+            ((PDS_JOURNAL_ALL_ITEMS != item) && ((entries[slot].itemId & 0xFF) != item)))
+        {
+            continue;
+        }
+
+        for (uint8_t i = 0; i < journalNumItems; i++)
+        {
+            if (entries[slot].itemId == journalItems[i].itemId)
+            {
+                memcpy(journalItems[i].ramAddress, &entries[slot].value, sizeof(uint32_t));
+                break;
+            }
+        }
+    }
+}
+
+/**************************************************************************//**
+\brief	Erases the journal rows.
+******************************************************************************/
+void pdsJournalDeleteAll(void)
+{
+    for (uint8_t row = 0; row < PDS_JOURNAL_NUM_ROWS; row++)
+    {
+        pdsNvmErase(PDS_JOURNAL_FIRST_ROW + row);
+    }
+    journalLastPage = PDS_JOURNAL_NO_PAGE;
+    journalPage = 0;
+    journalPending = 0;
+}
+
+/**************************************************************************//**
+\brief	Returns the number of items waiting to be appended.
+******************************************************************************/
+uint8_t pdsJournalPendingCount(void)
+{
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < journalNumItems; i++)
+    {
+        if (journalPending & (1 << i))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**************************************************************************//**
+\brief	Fills a journal slot along with its CRC.
+******************************************************************************/
+static void pdsJournalFillEntry(PdsJournalEntry_t *entry, uint16_t itemId, uint32_t value)
+{
+    entry->value = value;
+    entry->itemId = itemId;
+    entry->crc = pdsNvmCrc((uint8_t *)entry, offsetof(PdsJournalEntry_t, crc));
+}
+
+/**************************************************************************//**
+\brief	Checks the CRC of a journal slot, a torn write fails this check.
+******************************************************************************/
+static bool pdsJournalIsValid(PdsJournalEntry_t *entry)
+{
+    return (entry->crc == pdsNvmCrc((uint8_t *)entry, offsetof(PdsJournalEntry_t, crc)));
+}
+
+/**************************************************************************//**
+\brief	Checks that a page holds a complete record: a valid header followed
+		by as many valid item slots as the header announces.
+******************************************************************************/
+static bool pdsJournalIsRecord(PdsJournalEntry_t *entries)
+{
+    uint8_t count = (uint8_t)(entries[0].itemId & ~PDS_JOURNAL_HEADER_MASK);
+
+    if (!pdsJournalIsValid(&entries[0]) ||
+        (PDS_JOURNAL_HEADER_ID != (entries[0].itemId & PDS_JOURNAL_HEADER_MASK)) ||
+        (PDS_JOURNAL_MAX_ITEMS < count))
+    {
+        return false;
+    }
+
+    for (uint8_t slot = 1; slot <= count; slot++)
+    {
+        if (!pdsJournalIsValid(&entries[slot]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**************************************************************************//**
+\brief	Checks whether a page is still erased.
+******************************************************************************/
+static bool pdsJournalIsErased(uint32_t *page)
+{
+    for (uint8_t word = 0; word < PDS_JOURNAL_PAGE_WORDS; word++)
+    {
+        if (UINT32_MAX != page[word])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**************************************************************************//**
+\brief	Programs a record with the current value of all the items to the next
+		erased page, each page is programmed once between two erases. A row
+		is erased when the first record goes to it, the row holding the
+		latest record is never erased, so that an interrupted append leaves
+		the latest record valid.
+
+\param[out] compact - Set to true if a new row was started.
+******************************************************************************/
+static PdsStatus_t pdsJournalAppend(bool *compact)
+{
+    uint32_t rowBuf[PDS_JOURNAL_ROW_WORDS];
+    uint32_t pageBuf[PDS_JOURNAL_PAGE_WORDS];
+    PdsJournalEntry_t *entries = (PdsJournalEntry_t *)pageBuf;
+    uint32_t value;
+    uint16_t rowId;
+    uint8_t pageIdx;
+    PdsStatus_t status;
+
+    for (uint8_t attempt = 0; attempt < PDS_JOURNAL_NUM_PAGES; attempt++)
+    {
+        rowId = PDS_JOURNAL_FIRST_ROW + (journalPage / EEPROM_PAGE_PER_ROW);
+        pageIdx = journalPage % EEPROM_PAGE_PER_ROW;
+
+        if (0 == pageIdx)
+        {
+            /* Every page since the latest record failed */
+            if ((PDS_JOURNAL_NO_PAGE != journalLastPage) &&
+                ((journalLastPage / EEPROM_PAGE_PER_ROW) == (journalPage / EEPROM_PAGE_PER_ROW)))
+            {
+                return PDS_ERROR;
+            }
+
+            status = pdsNvmErase(rowId);
+            if (PDS_OK != status)
+            {
+                return status;
+            }
+            *compact = true;
+        }
+        else
+        {
+            /* A page torn by a reset or a failed write is not programmed again */
+            status = pdsNvmReadRaw(rowId, rowBuf);
+            if (PDS_OK != status)
+            {
+                return status;
+            }
+            if (!pdsJournalIsErased(&rowBuf[pageIdx * PDS_JOURNAL_PAGE_WORDS]))
+            {
+                journalPage = (journalPage + 1) % PDS_JOURNAL_NUM_PAGES;
+                continue;
+            }
+        }
+
+        memset(pageBuf, UCHAR_MAX, sizeof(pageBuf));
+        pdsJournalFillEntry(&entries[0], PDS_JOURNAL_HEADER_ID | journalNumItems, journalSeq + 1);
+        for (uint8_t i = 0; i < journalNumItems; i++)
+        {
+            memcpy(&value, journalItems[i].ramAddress, sizeof(value));
+            pdsJournalFillEntry(&entries[1 + i], journalItems[i].itemId, value);
+        }
+
+        status = pdsNvmWritePage(rowId, pageIdx, pageBuf);
+        if (PDS_OK == status)
+        {
+            status = pdsNvmReadRaw(rowId, rowBuf);
+        }
+        if ((PDS_OK == status) &&
+            (0 != memcmp(&rowBuf[pageIdx * PDS_JOURNAL_PAGE_WORDS], pageBuf, sizeof(pageBuf))))
+        {
+            status = PDS_ERROR;
+        }
+
+        if (PDS_OK == status)
+        {
+            journalLastPage = journalPage;
+            journalSeq++;
+        }
+        journalPage = (journalPage + 1) % PDS_JOURNAL_NUM_PAGES;
+
+        return status;
+    }
+
+    return PDS_ERROR;
+}
+#endif
+/* eof pds_journal.c */
@@ -0,0 +1,154 @@
+/**
+* \file  pds_journal.h
+*
+* \brief     This is the Pds counter journal header file which contains the
+*	interface of the append-only store for frequently updated counters.
+*		
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+
+
+
+#ifndef _PDS_JOURNAL_H_
+#define _PDS_JOURNAL_H_
+
+/******************************************************************************
+                   Includes section
+******************************************************************************/
+#include <xc.h>
+#include "pds_nvm.h"
+#include "pds_interface.h"
+
+/******************************************************************************
+                   Defines section
+******************************************************************************/
+/* Rows used by the journal, each of their pages holds one record. A row is
+ * erased every EEPROM_PAGE_PER_ROW records: with a record every 5 min, 4
+ * rows last 15 years of the 100k RWWEE cycles, 12 rows 11 years of the 25k
+ * main flash cycles */
+#ifndef PDS_JOURNAL_NUM_ROWS
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+#define PDS_JOURNAL_NUM_ROWS        (12)
+#else
+#define PDS_JOURNAL_NUM_ROWS        (4)
+#endif
+#endif
+/* The journal rows follow the rows of the wear levelled files */
+#define PDS_JOURNAL_FIRST_ROW       (EEPROM_NUM_ROWS)
+/* Maximum number of counters kept in the journal */
+#define PDS_JOURNAL_MAX_ITEMS       (4)
+/* Restores all the journalled items of a file */
+#define PDS_JOURNAL_ALL_ITEMS       (0xFF)
+
+#if ((EEPROM_SIZE + (PDS_JOURNAL_NUM_ROWS * EEPROM_ROW_SIZE)) > PDS_NVM_AREA_SIZE)
+#error "PDS journal rows do not fit into the PDS NVM area"
+#endif
+
+/* A record of all the items in 8 byte slots has to fit into one page */
+#if (((PDS_JOURNAL_MAX_ITEMS) + 1) * 8 > (EEPROM_PAGE_SIZE))
+#error "PDS journal record does not fit into a page, reduce PDS_JOURNAL_MAX_ITEMS"
+#endif
+
+/******************************************************************************
+                               Types section
+*******************************************************************************/
+/* One journal slot. Slot 0 of a record is its header: the value is the
+ * sequence number of the record, the low byte of the item id the number of
+ * item slots following it. A slot with all bits set is free */
+typedef struct _PdsJournalEntry
+{
+    uint32_t value;
+    uint16_t itemId;
+    uint16_t crc;
+} PdsJournalEntry_t;
+
+/******************************************************************************
+                   Prototypes section
+******************************************************************************/
+
+/**************************************************************************//**
+\brief Initializes the journal by locating the latest record.
+
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsJournalInit(void);
+
+/**************************************************************************//**
+\brief	Registers a 4 byte item to be kept in the journal instead of its file.
+
+\param[in] 	pdsFileItemIdx - The file id of the item.
+\param[in] 	item - The item id of the item in the file.
+\param[in] 	ramAddress - The RAM location of the item.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsJournalRegItem(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item, uint32_t *ramAddress);
+
+/**************************************************************************//**
+\brief	Marks a journalled item to be appended by the next pdsJournalFlush.
+
+\param[in] 	pdsFileItemIdx - The file id of the item.
+\param[in] 	item - The item id of the item in the file.
+\param[out] bool - true if the item is journalled, false if it is stored in its file.
+******************************************************************************/
+bool pdsJournalStore(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item);
+
+/**************************************************************************//**
+\brief	Appends a record with the current value of all the items if any of
+		them is pending. When the record starts a new row, that row is erased
+		first and the items have to be written to their files as well.
+
+\param[out] compact - Set to true if the items have to be written to their files.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsJournalFlush(bool *compact);
+
+/**************************************************************************//**
+\brief	Marks the journalled items to be stored in their files by the next
+		write of the files.
+******************************************************************************/
+void pdsJournalMarkFiles(void);
+
+/**************************************************************************//**
+\brief	Copies the items of the latest journal record to RAM.
+
+\param[in] 	pdsFileItemIdx - The file id of the items.
+\param[in] 	item - The item id, PDS_JOURNAL_ALL_ITEMS for all items of the file.
+******************************************************************************/
+void pdsJournalRestore(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item);
+
+/**************************************************************************//**
+\brief	Erases the journal rows.
+******************************************************************************/
+void pdsJournalDeleteAll(void);
+
+/**************************************************************************//**
+\brief	Returns the number of items waiting to be appended.
+******************************************************************************/
+uint8_t pdsJournalPendingCount(void);
+
+#endif  /* _PDS_JOURNAL_H_ */
+
+/* eof pds_journal.h */
@@ -38,23 +38,64 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "pds_common.h"
 #include "pds_task_handler.h"
 #include "pds_wl.h"
+#include "pds_crc.h"
 
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+#define PDS_FLASH_START_ADDRESS     ((uint32_t)(uintptr_t)pdsNvmFlashArea)
+#define PDS_NVM_ROW_ERASE(addr)     NVMCTRL_RowErase(addr)
+#define PDS_NVM_PAGE_WRITE(data, addr)  NVMCTRL_PageWrite(data, addr)
+#else
 #define PDS_FLASH_START_ADDRESS     (NVMCTRL_RWWEEPROM_START_ADDRESS)
+#define PDS_NVM_ROW_ERASE(addr)     NVMCTRL_RWWEEPROM_RowErase(addr)
+#define PDS_NVM_PAGE_WRITE(data, addr)  NVMCTRL_RWWEEPROM_PageWrite(data, addr)
+#endif
 
 #define FLASH_USER_PAGE_ADDRESS     (0x00800000)
 #define NVM_USER_MEMORY             ((volatile uint16_t *)FLASH_USER_PAGE_ADDRESS)
 
+#if (ENABLE_PDS == 1)
+/******************************************************************************
+                               Types section
+*******************************************************************************/
+typedef enum _PdsNvmState
+{
+	PDS_NVM_STATE_IDLE = 0,
+	PDS_NVM_STATE_ERASE,
+	PDS_NVM_STATE_WRITE
+} PdsNvmState_t;
+
+/* The row write in progress */
+typedef struct _PdsNvmWrite
+{
+	volatile PdsNvmState_t state;
+	uint16_t rowId;
+	uint8_t page;
+	PdsStatus_t status;
+	PdsMem_t *buffer;
+	PdsNvmCallback_t callback;
+} PdsNvmWrite_t;
+
 /************************************************************************/
 /*  Static variables                                                    */
 /************************************************************************/
-#if (ENABLE_PDS == 1)
+static PdsNvmWrite_t nvmWrite = {.state = PDS_NVM_STATE_IDLE};
+
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+/* Main flash rows of the PDS. The .pds_flash section is not loaded, so that
+ * programming the application keeps the stored items. It is only accessed
+ * through the NVMCTRL, hence volatile */
+static volatile uint8_t pdsNvmFlashArea[PDS_NVM_AREA_SIZE]
+        __attribute__((section(".pds_flash"), aligned(EEPROM_ROW_SIZE), used));
+#endif
+
 /******************************************************************************
                    Static prototype section
 ******************************************************************************/
 static uint16_t calculate_crc(uint16_t length, uint8_t *data);
-static uint16_t Crc16Ccitt(uint16_t initValue, uint8_t byte);
 static uint32_t nvmLogicalRowToPhysicalAddr(uint16_t logicalRow);
 static inline uint32_t pdsNvmRowStartAddr(uint32_t memAddr);
+static inline void pdsNvmReadyIntEnable(void);
+static void pdsNvmWriteDone(PdsStatus_t status);
 
 /******************************************************************************
                    Implementations section
@@ -69,6 +110,17 @@ static inline uint32_t pdsNvmRowStartAddr(uint32_t memAddr);
 PdsStatus_t pdsNvmInit(void)
 {
 	/* NVMCTRL_Initialize() shall be called before this function */
+	NVMCTRL_REGS->NVMCTRL_INTENCLR = NVMCTRL_INTENCLR_READY_Msk;
+	NVIC_ClearPendingIRQ(NVMCTRL_IRQn);
+	NVIC_EnableIRQ(NVMCTRL_IRQn);
+
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+	/* The area may span two lock regions */
+	NVMCTRL_RegionUnlock(PDS_FLASH_START_ADDRESS);
+	while(NVMCTRL_IsBusy());
+	NVMCTRL_RegionUnlock(PDS_FLASH_START_ADDRESS + PDS_NVM_AREA_SIZE - 1);
+	while(NVMCTRL_IsBusy());
+#endif
 	return PDS_OK;
 }
 
@@ -84,51 +136,145 @@ PdsStatus_t pdsNvmInit(void)
 ******************************************************************************/
 PdsStatus_t pdsNvmWrite(uint16_t rowId, PdsMem_t *buffer, uint16_t size)
 {
-    uint32_t addr;
-    uint32_t *nvmRow;
-	PdsStatus_t status = PDS_OK;
-    uint32_t pageWordLen = ((EEPROM_PAGE_SIZE) / sizeof(uint32_t));
+	PdsStatus_t status = pdsNvmWriteStart(rowId, buffer, size, NULL);
+
+	if (PDS_OK == status)
+	{
+		pdsNvmComplete();
+		status = nvmWrite.status;
+	}
+
+	return status;
+}
+
+/**************************************************************************//**
+\brief	Starts writing a row without waiting for the NVM. The row erase and each
+		page write are issued from the PDS task when the NVMCTRL READY
+		interrupt fires, the row is verified and the callback is called once
+		the last page is programmed. The buffer shall stay valid until then.
+
+\param[in] 	rowId - The row to be written.
+\param[in] 	buffer - The buffer containing data to be written.
+\param[in] 	size - The size of the data in the buffer.
+\param[in] 	callback - Called with the status of the write, may be NULL.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsNvmWriteStart(uint16_t rowId, PdsMem_t *buffer, uint16_t size, PdsNvmCallback_t callback)
+{
+	/* Only one row is programmed at a time */
+	pdsNvmComplete();
 
 	buffer->NVM_Struct.pdsNvmHeader.version = PDS_NVM_VERSION;
 	buffer->NVM_Struct.pdsNvmHeader.size = size;
 	buffer->NVM_Struct.pdsNvmHeader.crc = 
             calculate_crc(buffer->NVM_Struct.pdsNvmHeader.size,
             (uint8_t *)(&(buffer->NVM_Struct.pdsNvmData)));
-	size += sizeof(PdsNvmHeader_t);
-    
-    nvmRow = (uint32_t *)&(buffer->NVM_Mem.pdsNvmMem[0]);
-    
-	addr = pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId));
 
-    while(NVMCTRL_IsBusy());
-    
-    NVMCTRL_RWWEEPROM_RowErase(addr);
-  
+	nvmWrite.rowId = rowId;
+	nvmWrite.page = 0;
+	nvmWrite.buffer = buffer;
+	nvmWrite.callback = callback;
+	nvmWrite.status = PDS_OK;
+	nvmWrite.state = PDS_NVM_STATE_ERASE;
+
     while(NVMCTRL_IsBusy());
 
-    if (NVMCTRL_ERROR_NONE != NVMCTRL_ErrorGet())
-    {
-        status = PDS_ERROR;
-    }
-    else
-    {
-        for (uint8_t i = 0; i < EEPROM_PAGE_PER_ROW; i++)
-        {
-            NVMCTRL_RWWEEPROM_PageWrite(&(nvmRow[i * pageWordLen]), addr);
-            addr += EEPROM_PAGE_SIZE;
-            while(NVMCTRL_IsBusy());
-        }
+    PDS_NVM_ROW_ERASE(pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId)));
+    pdsNvmReadyIntEnable();
 
-        if (NVMCTRL_ERROR_NONE != NVMCTRL_ErrorGet())
-        {
-            status = PDS_ERROR;
-        }
-        else
-        {
-            status = pdsNvmRead(rowId, (PdsMem_t *const)buffer, size);
-        }
-    }
-	return status;
+	return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Issues the next NVM command of the pending asynchronous write, if the
+		previous one has completed.
+
+\param[in] none
+******************************************************************************/
+void pdsNvmStep(void)
+{
+    const uint8_t *nvmRow;
+    uint32_t nvmRead[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+    /* The packed buffer may not be word aligned, the page is programmed
+     * from an aligned copy */
+    uint32_t nvmPage[(EEPROM_PAGE_SIZE) / sizeof(uint32_t)];
+	PdsStatus_t status;
+
+	if (PDS_NVM_STATE_IDLE == nvmWrite.state)
+	{
+		return;
+	}
+
+	/* A step posted by an earlier command, the current one is still running */
+	if (NVMCTRL_IsBusy())
+	{
+		pdsNvmReadyIntEnable();
+		return;
+	}
+
+	if (NVMCTRL_ERROR_NONE != NVMCTRL_ErrorGet())
+	{
+		pdsNvmWriteDone(PDS_ERROR);
+		return;
+	}
+
+	nvmRow = &(nvmWrite.buffer->NVM_Mem.pdsNvmMem[0]);
+	nvmWrite.state = PDS_NVM_STATE_WRITE;
+
+	if (nvmWrite.page < EEPROM_PAGE_PER_ROW)
+	{
+		memcpy(nvmPage, &nvmRow[nvmWrite.page * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE);
+		PDS_NVM_PAGE_WRITE(nvmPage,
+				pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(nvmWrite.rowId)) + (nvmWrite.page * EEPROM_PAGE_SIZE));
+		nvmWrite.page++;
+		pdsNvmReadyIntEnable();
+		return;
+	}
+
+	/* Comparing the row read back is cheaper than recomputing its CRC */
+	status = pdsNvmReadRaw(nvmWrite.rowId, nvmRead);
+	if ((PDS_OK == status) && (0 != memcmp(nvmRead, nvmRow, EEPROM_ROW_SIZE)))
+	{
+		status = PDS_CRC_ERROR;
+	}
+	pdsNvmWriteDone(status);
+}
+
+/**************************************************************************//**
+\brief	Completes the pending asynchronous write by waiting for each of its
+		NVM commands. Returns immediately if no write is pending.
+
+\param[in] none
+******************************************************************************/
+void pdsNvmComplete(void)
+{
+	while (PDS_NVM_STATE_IDLE != nvmWrite.state)
+	{
+		while(NVMCTRL_IsBusy());
+		pdsNvmStep();
+	}
+}
+
+/**************************************************************************//**
+\brief	Checks if an asynchronous write is pending.
+
+\param[out] - return true or false
+******************************************************************************/
+bool pdsNvmIsBusy(void)
+{
+	return (PDS_NVM_STATE_IDLE != nvmWrite.state);
+}
+
+/**************************************************************************//**
+\brief	NVMCTRL interrupt handler. READY is a level interrupt, so it is
+		disabled until the next command is issued.
+
+\param[in] none
+******************************************************************************/
+void NVMCTRL_Handler(void)
+{
+	NVMCTRL_REGS->NVMCTRL_INTENCLR = NVMCTRL_INTENCLR_READY_Msk;
+	pdsPostTask(PDS_NVM_TASK_ID);
 }
 
 /**************************************************************************//**
@@ -145,7 +291,11 @@ PdsStatus_t pdsNvmRead(uint16_t rowId, PdsMem_t *buffer, uint16_t size)
 	uint16_t crc = 0, crc2 = 0;
     uint8_t nvmRow[(EEPROM_ROW_SIZE)];
     
-    while(NVMCTRL_IsBusy());
+    pdsNvmComplete();
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    /* The cache may still hold the lines of a row programmed since */
+    NVMCTRL_CacheInvalidate();
+#endif
  
     NVMCTRL_Read(
             (uint32_t *)&(nvmRow[0]),
@@ -177,6 +327,93 @@ PdsStatus_t pdsNvmRead(uint16_t rowId, PdsMem_t *buffer, uint16_t size)
 	return status;
 }
 
+/**************************************************************************//**
+\brief	Reads a row as it is stored in NVM, without any CRC check.
+
+\param[in] 	rowId - The row to be read.
+\param[out] data - The buffer of EEPROM_ROW_SIZE bytes receiving the row.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsNvmReadRaw(uint16_t rowId, uint32_t *data)
+{
+    while(NVMCTRL_IsBusy());
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    /* The cache may still hold the lines of a row programmed since */
+    NVMCTRL_CacheInvalidate();
+#endif
+
+    NVMCTRL_Read(data, EEPROM_ROW_SIZE,
+            pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId)));
+
+    while(NVMCTRL_IsBusy());
+
+    if (NVMCTRL_ERROR_NONE != NVMCTRL_ErrorGet())
+    {
+        return PDS_ERROR;
+    }
+
+    return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Returns the address a row is readable at, the NVM being memory mapped.
+		The row stays valid until the next write to the NVM.
+
+\param[in] 	rowId - The row.
+\param[out] - The address of the first byte of the row.
+******************************************************************************/
+const uint8_t *pdsNvmRowAddr(uint16_t rowId)
+{
+    pdsNvmComplete();
+    while(NVMCTRL_IsBusy());
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    /* The cache may still hold the lines of a row programmed since */
+    NVMCTRL_CacheInvalidate();
+#endif
+
+    return (const uint8_t *)(uintptr_t)pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId));
+}
+
+/**************************************************************************//**
+\brief	Programs one page of a row without erasing it. Bytes set to 0xFF in
+		data leave the corresponding NVM bytes unchanged, the other ones
+		shall still be erased, see pds_nvm.h.
+
+\param[in] 	rowId - The row to be written.
+\param[in] 	pageIdx - The page within the row.
+\param[in] 	data - The EEPROM_PAGE_SIZE bytes to be programmed.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsNvmWritePage(uint16_t rowId, uint8_t pageIdx, uint32_t *data)
+{
+    uint32_t addr = pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId)) + (pageIdx * EEPROM_PAGE_SIZE);
+
+    pdsNvmComplete();
+
+    PDS_NVM_PAGE_WRITE(data, addr);
+
+    while(NVMCTRL_IsBusy());
+
+    if (NVMCTRL_ERROR_NONE != NVMCTRL_ErrorGet())
+    {
+        return PDS_ERROR;
+    }
+
+    return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Calculates the CRC used by PDS.
+
+\param[in] 	data - The data.
+\param[in] 	length - The amount of data for which CRC is to be calculated.
+\param[out] uint16_t - The calculated 16 bit CRC.
+******************************************************************************/
+uint16_t pdsNvmCrc(uint8_t *data, uint16_t length)
+{
+    return calculate_crc(length, data);
+}
+
 /**************************************************************************//**
 \brief	Will erase the contents of a row.
 
@@ -187,10 +424,10 @@ PdsStatus_t pdsNvmErase(uint16_t rowId)
 {
 	PdsStatus_t status = PDS_OK;
 
-    while(NVMCTRL_IsBusy());
+    pdsNvmComplete();
     
     /* RowErase ALWAYS returns true hence, return value unused */
-    NVMCTRL_RWWEEPROM_RowErase(pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId)));
+    PDS_NVM_ROW_ERASE(pdsNvmRowStartAddr(nvmLogicalRowToPhysicalAddr(rowId)));
     
     while(NVMCTRL_IsBusy());
     
@@ -223,22 +460,6 @@ PdsStatus_t pdsNvmEraseAll(void)
 	return PDS_OK;
 }
 
-/**************************************************************************//**
-\brief	Calculates the CRC in CCITT polynome.
-
-\param[in] 	initValue - The rowId to be erased.
-\param[in] 	byte - The rowId to be erased.
-\param[out] uint16_t - The calculated 16 bit CRC.
-******************************************************************************/
-uint16_t Crc16Ccitt(uint16_t initValue, uint8_t byte)
-{
-  byte ^= initValue & 0xffU;
-  byte ^= byte << 4U;
-
-  return ((((uint16_t)byte << 8) | ((initValue & 0xff00U) >> 8))
-          ^ (uint8_t)(byte >> 4) ^ ((uint16_t)byte << 3));
-}
-
 /**************************************************************************//**
 \brief	Calculates the CRC.
 
@@ -248,12 +469,7 @@ uint16_t Crc16Ccitt(uint16_t initValue, uint8_t byte)
 ******************************************************************************/
 static uint16_t calculate_crc(uint16_t length, uint8_t *data)
 {
-  uint16_t eeprom_crc = 0U;
-  for (uint16_t i = 0; i < length; i++)
-  {
-    eeprom_crc = Crc16Ccitt(eeprom_crc, data[i]);
-  }
-  return eeprom_crc;
+  return pdsCrc16Update(PDS_CRC_INIT, data, length);
 }
 
 /**************************************************************************//**
@@ -277,5 +493,39 @@ static inline uint32_t pdsNvmRowStartAddr(uint32_t memAddr)
 {
     return (memAddr & ~((EEPROM_ROW_SIZE) - 1));
 }
+
+/**************************************************************************//**
+\brief	Enables the NVMCTRL READY interrupt, it fires when the command just
+		issued has completed.
+
+\param[in] none
+******************************************************************************/
+static inline void pdsNvmReadyIntEnable(void)
+{
+	NVMCTRL_REGS->NVMCTRL_INTENSET = NVMCTRL_INTENSET_READY_Msk;
+}
+
+/**************************************************************************//**
+\brief	Ends the pending asynchronous write and reports its status.
+
+\param[in] status - The status of the write.
+******************************************************************************/
+static void pdsNvmWriteDone(PdsStatus_t status)
+{
+	PdsNvmCallback_t callback = nvmWrite.callback;
+
+	NVMCTRL_REGS->NVMCTRL_INTENCLR = NVMCTRL_INTENCLR_READY_Msk;
+	nvmWrite.status = status;
+	nvmWrite.callback = NULL;
+	nvmWrite.state = PDS_NVM_STATE_IDLE;
+
+	if (NULL != callback)
+	{
+		callback(status);
+	}
+
+	/* The PDS tasks held back while the row was programmed can run again */
+	SYSTEM_PostTask(PDS_TASK_ID);
+}
 #endif
 /* eof pds_nvm.c */
@@ -43,10 +43,35 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /******************************************************************************
                    Defines section
 ******************************************************************************/
-/* Default EEPROM Size - 4K Bytes */
+/* NVM holding the PDS rows */
+#define PDS_NVM_BACKEND_RWWEE	0	/* RWWEE memory, the code keeps running while a row is programmed */
+#define PDS_NVM_BACKEND_FLASH	1	/* Main flash rows of the .pds_flash linker section */
+
+#ifndef PDS_NVM_BACKEND
+#define PDS_NVM_BACKEND			PDS_NVM_BACKEND_RWWEE
+#endif
+
+/* Default EEPROM Size - 4K Bytes, 6K Bytes in main flash */
 #ifndef EEPROM_SIZE
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+#define EEPROM_SIZE			6144
+#else
 #define EEPROM_SIZE			4096
 #endif
+#endif
+
+/* Size of the NVM area holding the WL, journal and index rows */
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+#ifndef PDS_NVM_FLASH_SIZE
+/* The WL rows, then 12 journal rows and 2 index rows. The linker places them
+ * at the top of flash, in the PDS_FLASH_LENGTH bytes reserved by
+ * ATSAMR34J18B.ld, 0x2600 with the default EEPROM_SIZE */
+#define PDS_NVM_FLASH_SIZE		((EEPROM_SIZE) + (14 * (NVMCTRL_FLASH_ROWSIZE)))
+#endif
+#define PDS_NVM_AREA_SIZE		(PDS_NVM_FLASH_SIZE)
+#else
+#define PDS_NVM_AREA_SIZE		(NVMCTRL_RWWEEPROM_SIZE)
+#endif
 
 #define EEPROM_PAGE_SIZE        (NVMCTRL_FLASH_PAGESIZE)
 #define EEPROM_PAGE_PER_ROW     ((NVMCTRL_FLASH_ROWSIZE)/(NVMCTRL_FLASH_PAGESIZE))
@@ -57,6 +82,8 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /******************************************************************************
                                Types section
 *******************************************************************************/
+/* Called when an asynchronous row write has completed */
+typedef void (*PdsNvmCallback_t)(PdsStatus_t status);
 
 /******************************************************************************
                    Prototypes section
@@ -82,6 +109,43 @@ PdsStatus_t pdsNvmInit(void);
 ******************************************************************************/
 PdsStatus_t pdsNvmWrite(uint16_t rowId, PdsMem_t *buffer, uint16_t size);
 
+/**************************************************************************//**
+\brief	Starts writing a row without waiting for the NVM. The row erase and each
+		page write are issued from the PDS task when the NVMCTRL READY
+		interrupt fires, the row is verified and the callback is called once
+		the last page is programmed. The buffer shall stay valid until then.
+
+\param[in] 	rowId - The row to be written.
+\param[in] 	buffer - The buffer containing data to be written.
+\param[in] 	size - The size of the data in the buffer.
+\param[in] 	callback - Called with the status of the write, may be NULL.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsNvmWriteStart(uint16_t rowId, PdsMem_t *buffer, uint16_t size, PdsNvmCallback_t callback);
+
+/**************************************************************************//**
+\brief	Issues the next NVM command of the pending asynchronous write, if the
+		previous one has completed.
+
+\param[in] none
+******************************************************************************/
+void pdsNvmStep(void);
+
+/**************************************************************************//**
+\brief	Completes the pending asynchronous write by waiting for each of its
+		NVM commands. Returns immediately if no write is pending.
+
+\param[in] none
+******************************************************************************/
+void pdsNvmComplete(void);
+
+/**************************************************************************//**
+\brief	Checks if an asynchronous write is pending.
+
+\param[out] - return true or false
+******************************************************************************/
+bool pdsNvmIsBusy(void);
+
 /**************************************************************************//**
 \brief	This function will read the contents of NVM and verify the crc.
 
@@ -92,6 +156,51 @@ PdsStatus_t pdsNvmWrite(uint16_t rowId, PdsMem_t *buffer, uint16_t size);
 ******************************************************************************/
 PdsStatus_t pdsNvmRead(uint16_t rowId, PdsMem_t *buffer, uint16_t size);
 
+/**************************************************************************//**
+\brief	Reads a row as it is stored in NVM, without any CRC check.
+
+\param[in] 	rowId - The row to be read.
+\param[out] data - The buffer of EEPROM_ROW_SIZE bytes receiving the row.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsNvmReadRaw(uint16_t rowId, uint32_t *data);
+
+/**************************************************************************//**
+\brief	Returns the address a row is readable at, the NVM being memory mapped.
+		The row stays valid until the next write to the NVM.
+
+\param[in] 	rowId - The row.
+\param[out] - The address of the first byte of the row.
+******************************************************************************/
+const uint8_t *pdsNvmRowAddr(uint16_t rowId);
+
+/**************************************************************************//**
+\brief	Programs one page of a row without erasing it. Bytes set to 0xFF in
+		data leave the corresponding NVM bytes unchanged.
+
+		The NVMCTRL only clears bits and has no ECC, so a page may be
+		programmed again before its row is erased, but each byte is
+		programmed at most once between two erases: every byte not set to
+		0xFF in data shall still be erased. The WL delta records and index
+		slots are appended to erased bytes, a journal record takes a whole
+		erased page.
+
+\param[in] 	rowId - The row to be written.
+\param[in] 	pageIdx - The page within the row.
+\param[in] 	data - The EEPROM_PAGE_SIZE bytes to be programmed.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsNvmWritePage(uint16_t rowId, uint8_t pageIdx, uint32_t *data);
+
+/**************************************************************************//**
+\brief	Calculates the CRC used by PDS.
+
+\param[in] 	data - The data.
+\param[in] 	length - The amount of data for which CRC is to be calculated.
+\param[out] uint16_t - The calculated 16 bit CRC.
+******************************************************************************/
+uint16_t pdsNvmCrc(uint8_t *data, uint16_t length);
+
 /**************************************************************************//**
 \brief	Will erase the contents of a row.
 
@@ -40,6 +40,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "pds_common.h"
 #include "pds_task_handler.h"
 #include "pds_wl.h"
+#include "pds_journal.h"
 #include "atomic.h"
 #include <stdint.h>
 
@@ -52,18 +53,33 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 ******************************************************************************/
 static volatile uint8_t pdsTaskFlags = 0x0000u;
 
+#if (ENABLE_PDS == 1)
+/**************************************************************************//**
+\brief pdsStoreBuffer - The file being written by the store or migrate task, it is
+	programmed one page per task step so it has to outlive the handler.
+******************************************************************************/
+static PdsMem_t pdsStoreBuffer;
+#endif
+
 /************************************************************************/
 /*  Extern variables                                                    */
 /************************************************************************/
 extern bool isFileSet[];
 extern PdsFileMarks_t fileMarks[];
+extern PdsStats_t pdsStats;
 
 /******************************************************************************
                    Prototypes section
 ******************************************************************************/
 #if (ENABLE_PDS == 1)
+static SYSTEM_TaskStatus_t pdsNvmHandler(void);
+static SYSTEM_TaskStatus_t pdsJournalHandler(void);
 static SYSTEM_TaskStatus_t pdsStoreDeleteHandler(void);
-static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buffer);
+static SYSTEM_TaskStatus_t pdsWlMigrateHandler(void);
+static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buffer, bool async, bool rewrite);
+static PdsStatus_t pdsWriteFiles(PdsMem_t *buffer);
+static void pdsClearMarks(PdsFileItemIdx_t pdsFileItemIdx);
+static uint8_t pdsRunnableTasks(void);
 #endif
 
 /**************************************************************************//**
@@ -72,8 +88,12 @@ static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buff
 #if (ENABLE_PDS == 1)
 static SYSTEM_TaskStatus_t (*pdsTaskHandlers[PDS_TASKS_COUNT])(void) = {
 	
-    /* In the order of descending priority */
-    pdsStoreDeleteHandler
+    /* In the order of descending priority. The counters go before the
+     * files, so that no file holds a newer counter than the journal */
+    pdsNvmHandler,
+    pdsJournalHandler,
+    pdsStoreDeleteHandler,
+    pdsWlMigrateHandler
 };
 #endif
 
@@ -117,11 +137,11 @@ SYSTEM_TaskStatus_t PDS_TaskHandler(void)
     printf("\n Starting PDS_TaskHandler() \n");
 #endif
 
-    if (pdsTaskFlags)
+    if (pdsRunnableTasks())
     {
         for (uint16_t taskId = 0; taskId < PDS_TASKS_COUNT; taskId++)
         {
-            if ((1 << taskId) & (pdsTaskFlags))
+            if ((1 << taskId) & pdsRunnableTasks())
             {
 #ifdef UT_D
                 printf("\n pdsTaskFlags : %d \n", pdsTaskFlags);
@@ -137,7 +157,7 @@ SYSTEM_TaskStatus_t PDS_TaskHandler(void)
 
                 pdsTaskHandlers[taskId]();
 
-				if (pdsTaskFlags)
+				if (pdsRunnableTasks())
                 {
                     SYSTEM_PostTask(PDS_TASK_ID);
                 }
@@ -151,6 +171,36 @@ SYSTEM_TaskStatus_t PDS_TaskHandler(void)
 }
 
 #if (ENABLE_PDS == 1)
+/**************************************************************************//**
+\brief	Returns the pending PDS tasks that can run now. While a row is being
+		programmed only the NVM task runs, the others wait for the row.
+
+\param[out] - The PdsTaskIds_t bitmap of the tasks.
+******************************************************************************/
+static uint8_t pdsRunnableTasks(void)
+{
+	if (pdsNvmIsBusy())
+	{
+		return (pdsTaskFlags & PDS_NVM_TASK_ID);
+	}
+
+	return pdsTaskFlags;
+}
+
+/**************************************************************************//**
+\brief	This function issues the next erase or page write of the row being
+		programmed, once the NVMCTRL READY interrupt has signalled the
+		previous one.
+
+\param[out] status - The return status of the function's operation.
+******************************************************************************/
+static SYSTEM_TaskStatus_t pdsNvmHandler(void)
+{
+	pdsNvmStep();
+
+	return SYSTEM_TASK_SUCCESS;
+}
+
 /**************************************************************************//**
 \brief	This function checks if an operation is pending for a file and will
 		initiate store/delete operation.
@@ -162,19 +212,23 @@ static SYSTEM_TaskStatus_t pdsStoreDeleteHandler(void)
 	PdsStatus_t status = SYSTEM_TASK_SUCCESS;
 
 	PdsFileItemIdx_t fileId = PDS_FILE_MAC_01_IDX;
-	PdsMem_t buffer;
 
-	memset(&buffer, 0, sizeof(PdsMem_t));
+	memset(&pdsStoreBuffer, 0, sizeof(PdsMem_t));
 	for (; fileId < PDS_MAX_FILE_IDX; fileId++)
 	{
 		if (true == isFileSet[fileId])
 		{
-			status = pdsStoreDelete(fileId, (uint8_t *)&(buffer));
+			status = pdsStoreDelete(fileId, (uint8_t *)&(pdsStoreBuffer), true, false);
 			if (status != PDS_OK)
 			{
-				// assert;
+				/* The file is rewritten from RAM, e.g. its stored version is corrupted */
+				pdsStats.errors++;
+				memset(&pdsStoreBuffer, 0, sizeof(PdsMem_t));
+				status = pdsStoreDelete(fileId, (uint8_t *)&(pdsStoreBuffer), true, true);
 			}
-			isFileSet[fileId] = false;
+			/* A file that cannot be written stays dirty until the next flush */
+			isFileSet[fileId] = (PDS_OK != status);
+			pdsStats.flushes++;
 			fileId++;
 			break;
 		}
@@ -191,14 +245,170 @@ static SYSTEM_TaskStatus_t pdsStoreDeleteHandler(void)
 	return status;
 }
 
+/**************************************************************************//**
+\brief	This function appends the counters stored since the last run to the
+		journal. When the journal moves to its next row, or cannot be
+		written, the counters are written to their files right away.
+
+\param[out] status - The return status of the function's operation.
+******************************************************************************/
+static SYSTEM_TaskStatus_t pdsJournalHandler(void)
+{
+	bool compact;
+	PdsStatus_t status = pdsJournalFlush(&compact);
+
+	if (PDS_OK != status)
+	{
+		pdsStats.errors++;
+	}
+
+	if ((PDS_OK != status) || compact)
+	{
+		/* Before anything else can change the counters */
+		pdsJournalMarkFiles();
+		memset(&pdsStoreBuffer, 0, sizeof(PdsMem_t));
+		if ((PDS_OK == pdsWriteFiles(&pdsStoreBuffer)) && (PDS_OK != status))
+		{
+			/* The journal no longer holds the latest counters */
+			pdsJournalDeleteAll();
+		}
+	}
+
+	return SYSTEM_TASK_SUCCESS;
+}
+
+/**************************************************************************//**
+\brief	This function moves a file that is never rewritten to a worn row, once
+		the wear spread between the rows has grown too large.
+
+\param[out] status - The return status of the function's operation.
+******************************************************************************/
+static SYSTEM_TaskStatus_t pdsWlMigrateHandler(void)
+{
+	memset(&pdsStoreBuffer, 0, sizeof(PdsMem_t));
+	if (PDS_OK != pdsWlMigrateStart(&pdsStoreBuffer))
+	{
+		/* The file stays in its row, a file that could not be read is
+		 * marked to be rewritten from RAM */
+		pdsStats.errors++;
+	}
+
+	return SYSTEM_TASK_SUCCESS;
+}
+
+/**************************************************************************//**
+\brief Writes the pending counters and all the dirty files right away.
+
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsFlushAll(void)
+{
+	PdsStatus_t status;
+	PdsStatus_t fileStatus;
+	PdsMem_t buffer;
+	bool compact;
+
+	pdsClearTask(PDS_JOURNAL_TASK_ID);
+	pdsClearTask(PDS_STORE_DELETE_TASK_ID);
+
+	/* A file written by the store task is finished first */
+	pdsNvmComplete();
+
+	/* The counters go first, they are what must survive a reset */
+	status = pdsJournalFlush(&compact);
+	if (PDS_OK != status)
+	{
+		pdsStats.errors++;
+	}
+	if ((PDS_OK != status) || compact)
+	{
+		pdsJournalMarkFiles();
+	}
+
+	fileStatus = pdsWriteFiles(&buffer);
+	if ((PDS_OK != status) && (PDS_OK == fileStatus))
+	{
+		/* The counters are in their files, the journal no longer holds the latest */
+		pdsJournalDeleteAll();
+		status = PDS_OK;
+	}
+
+	return (PDS_OK != fileStatus) ? fileStatus : status;
+}
+
+/**************************************************************************//**
+\brief	Marks every item of a file that is not being deleted to be stored, so
+		that the next write of the file rewrites it from RAM.
+
+\param[in] pdsFileItemIdx - The file id.
+******************************************************************************/
+void pdsStoreRetry(PdsFileItemIdx_t pdsFileItemIdx)
+{
+	if ((0 == fileMarks[pdsFileItemIdx].numItems) || (0 == fileMarks[pdsFileItemIdx].fileMarkListAddr))
+	{
+		return;
+	}
+
+	for (uint8_t itemIdx = 0; itemIdx < fileMarks[pdsFileItemIdx].numItems; itemIdx++)
+	{
+		if (PDS_OP_DELETE != *(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx))
+		{
+			*(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx) = PDS_OP_STORE;
+		}
+	}
+	isFileSet[pdsFileItemIdx] = true;
+}
+
+/**************************************************************************//**
+\brief	Writes all the dirty files and waits for their rows. A file that
+		cannot be updated is rewritten from RAM, if that fails too it stays
+		dirty.
+
+\param[in] buffer - The buffer to be used for reading and writing a file.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+static PdsStatus_t pdsWriteFiles(PdsMem_t *buffer)
+{
+	PdsStatus_t status = PDS_OK;
+	PdsStatus_t fileStatus;
+
+	for (PdsFileItemIdx_t fileId = PDS_FILE_MAC_01_IDX; fileId < PDS_MAX_FILE_IDX; fileId++)
+	{
+		if (true == isFileSet[fileId])
+		{
+			memset(buffer, 0, sizeof(PdsMem_t));
+			fileStatus = pdsStoreDelete(fileId, (uint8_t *)buffer, false, false);
+			if (PDS_OK != fileStatus)
+			{
+				pdsStats.errors++;
+				memset(buffer, 0, sizeof(PdsMem_t));
+				fileStatus = pdsStoreDelete(fileId, (uint8_t *)buffer, false, true);
+			}
+			if (PDS_OK != fileStatus)
+			{
+				status = fileStatus;
+			}
+			isFileSet[fileId] = (PDS_OK != fileStatus);
+			pdsStats.flushes++;
+		}
+	}
+
+	return status;
+}
+
 /**************************************************************************//**
 \brief This function stores and deletes the items in a file based on file marks set.
 
 \param[in] pdsFileItemIdx - The file id to look for.
 \param[in] buffer - The buffer to be used for reading and writing a file.
+\param[in] async - true to return once the rewrite of the file is started, the
+			buffer shall then stay valid until the row is programmed.
+\param[in] rewrite - true to write all the items from RAM, ignoring the
+			version of the file stored in NVM.
 \param[out] status - The return status of the function's operation of type PdsStatus_t.
+			The file marks are only cleared if it is PDS_OK.
 ******************************************************************************/
-static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buffer)
+static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buffer, bool async, bool rewrite)
 {
 	PdsStatus_t status = PDS_OK;
 
@@ -206,16 +416,37 @@ static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buff
 	ItemMap_t itemInfo;
 	ItemHeader_t itemHeader;
 	uint16_t size;
+	uint8_t record[PDS_WL_DELTA_MAX_SIZE];
+	uint8_t recordLength = 0;
+	uint8_t itemSize;
+	uint16_t imageSize = 0;
+	bool isDelta;
+	bool changed = false;
 
 	memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + (fileMarks[pdsFileItemIdx].numItems - 1)), sizeof(ItemMap_t));
 	size = itemInfo.itemOffset + itemInfo.size + sizeof(ItemHeader_t);
-	status = pdsWlRead(pdsFileItemIdx, (PdsMem_t *)buffer, size);
+	if (rewrite)
+	{
+		pdsStoreRetry(pdsFileItemIdx);
+		status = PDS_NOT_FOUND;
+	}
+	else
+	{
+		status = pdsWlRead(pdsFileItemIdx, (PdsMem_t *)buffer, size);
+	}
 
 	if ((PDS_OK != status) && (PDS_NOT_FOUND != status))
 	{
 		return status;
 	}
 
+	/* The items of a file already in NVM are appended as one delta record */
+	isDelta = (PDS_OK == status);
+	if (isDelta)
+	{
+		imageSize = ((PdsMem_t *)buffer)->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.size;
+	}
+
 	itemHeader.magic = PDS_MAGIC;
 	itemHeader.version = PDS_FILES_VERSION;
 
@@ -228,29 +459,97 @@ static PdsStatus_t pdsStoreDelete(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *buff
 
 		if (PDS_OP_STORE == *(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx))
 		{
-			*(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx) = PDS_OP_NONE;
 			itemHeader.size = itemInfo.size;
 			itemHeader.itemId = itemInfo.itemId;
 			itemHeader.delete = false;
+			itemSize = sizeof(ItemHeader_t) + itemInfo.size;
+			/* An item stored with the same value does not hit the NVM */
+			if ((itemInfo.itemOffset + itemSize <= imageSize) &&
+				(0 == memcmp(ptr, &itemHeader, sizeof(ItemHeader_t))) &&
+				(0 == memcmp(ptr + sizeof(ItemHeader_t), itemInfo.ramAddress, itemInfo.size)))
+			{
+				continue;
+			}
 			memcpy((void *)(ptr), (void *)&itemHeader, sizeof(ItemHeader_t));
-			ptr += sizeof(ItemHeader_t);
-			memcpy((void *)(ptr), (void *)itemInfo.ramAddress, itemInfo.size);
+			memcpy((void *)(ptr + sizeof(ItemHeader_t)), (void *)itemInfo.ramAddress, itemInfo.size);
 		}
 		else if (PDS_OP_DELETE == *(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx))
 		{
-			*(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx) = PDS_OP_NONE;
 			itemHeader.size = itemInfo.size;
 			itemHeader.itemId = itemInfo.itemId;
 			itemHeader.delete = true;
+			itemSize = sizeof(ItemHeader_t);
+			if ((itemInfo.itemOffset + itemSize <= imageSize) &&
+				(0 == memcmp(ptr, &itemHeader, sizeof(ItemHeader_t))))
+			{
+				continue;
+			}
 			memcpy((void *)(ptr), (void *)&itemHeader, sizeof(ItemHeader_t));
 		}
+		else
+		{
+			continue;
+		}
+		changed = true;
+
+		if (isDelta && ((recordLength + 1 + itemSize) <= sizeof(record)))
+		{
+			record[recordLength] = itemInfo.itemOffset;
+			memcpy(&record[recordLength + 1], ptr, itemSize);
+			recordLength += 1 + itemSize;
+		}
+		else
+		{
+			isDelta = false;
+		}
 	}
 
-	memcpy((void *)&itemInfo, (void *)(fileMarks[pdsFileItemIdx].itemListAddr + fileMarks[pdsFileItemIdx].numItems), sizeof(ItemMap_t));
-	size = itemInfo.itemOffset + itemInfo.size + sizeof(ItemHeader_t);
-	status = pdsWlWrite(pdsFileItemIdx, (PdsMem_t *)buffer, PDS_WL_DATA_SIZE);
+	/* A file found in NVM with none of its items changed is not rewritten */
+	if ((0 != imageSize) && !changed)
+	{
+		pdsClearMarks(pdsFileItemIdx);
+		return PDS_OK;
+	}
+
+	if (isDelta)
+	{
+		status = pdsWlAppend(pdsFileItemIdx, record, recordLength);
+		if (PDS_OK == status)
+		{
+			pdsClearMarks(pdsFileItemIdx);
+			return status;
+		}
+	}
+
+	/* Rewriting the whole file also compacts the delta records of its row */
+	if (async)
+	{
+		status = pdsWlWriteStart(pdsFileItemIdx, (PdsMem_t *)buffer, size);
+	}
+	else
+	{
+		status = pdsWlWrite(pdsFileItemIdx, (PdsMem_t *)buffer, size);
+	}
+
+	if (PDS_OK == status)
+	{
+		pdsClearMarks(pdsFileItemIdx);
+	}
 
 	return status;
 }
+
+/**************************************************************************//**
+\brief	Clears the file marks of a file once it is written.
+
+\param[in] pdsFileItemIdx - The file id.
+******************************************************************************/
+static void pdsClearMarks(PdsFileItemIdx_t pdsFileItemIdx)
+{
+	for (uint8_t itemIdx = 0; itemIdx < fileMarks[pdsFileItemIdx].numItems; itemIdx++)
+	{
+		*(fileMarks[pdsFileItemIdx].fileMarkListAddr + itemIdx) = PDS_OP_NONE;
+	}
+}
 #endif
 /* eof pds_task_handler.c */
@@ -43,14 +43,17 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /******************************************************************************
                    Defines section
 ******************************************************************************/
-#define PDS_TASKS_COUNT               1u
+#define PDS_TASKS_COUNT               4u
 
 /******************************************************************************
                                Types section
 *******************************************************************************/
 typedef enum
 {
-  PDS_STORE_DELETE_TASK_ID = (1 << 0)
+  PDS_NVM_TASK_ID = (1 << 0),
+  PDS_JOURNAL_TASK_ID = (1 << 1),
+  PDS_STORE_DELETE_TASK_ID = (1 << 2),
+  PDS_WL_MIGRATE_TASK_ID = (1 << 3)
 } PdsTaskIds_t;
 
 /******************************************************************************
@@ -72,6 +75,21 @@ void pdsPostTask(PdsTaskIds_t id);
 ******************************************************************************/
 void pdsClearTask(PdsTaskIds_t id);
 
+/**************************************************************************//**
+\brief Writes the pending counters and all the dirty files right away.
+
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsFlushAll(void);
+
+/**************************************************************************//**
+\brief	Marks every item of a file that is not being deleted to be stored, so
+		that the next write of the file rewrites it from RAM.
+
+\param[in] pdsFileItemIdx - The file id.
+******************************************************************************/
+void pdsStoreRetry(PdsFileItemIdx_t pdsFileItemIdx);
+
 #endif  /*_PDS_DRIVER_TASKMANAGER_H*/
 
 /* eof pds_task_handler.h */
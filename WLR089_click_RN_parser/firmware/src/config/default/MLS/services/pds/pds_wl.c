@@ -39,6 +39,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <stdbool.h>
 #include <string.h>
 #include <limits.h>
+#include <stddef.h>
 #include "pds_interface.h"
 #include "pds_common.h"
 #include "pds_task_handler.h"
@@ -50,6 +51,32 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /************************************************************************/
 static RowMap_t rowMap[EEPROM_NUM_ROWS];
 static FileMap_t fileMap[PDS_MAX_FILE_IDX];
+/* First free slot of the index row, UCHAR_MAX if the row has to be rewritten */
+static uint8_t indexSlot = UCHAR_MAX;
+/* The index row in use */
+static uint8_t indexRow = PDS_WL_INDEX_FIRST_ROW;
+/* The row write started by pdsWlWriteStart, the maps are updated once it completes */
+static UpdateFileMap_t pendingWrite;
+static uint16_t pendingDeltaOffset;
+static PdsStatus_t pendingStatus;
+static bool pendingMigrate;
+/* Erase count of each row */
+static uint32_t rowWear[EEPROM_NUM_ROWS];
+/* Min-heap of the free rows ordered by their erase count */
+static uint8_t freeRows[EEPROM_NUM_ROWS];
+static uint8_t freeRowCount;
+/* Generation of the index snapshot, each committed transaction publishes a new one */
+static uint32_t indexGeneration;
+/* The rows written by the transaction in progress are not recorded in the index */
+static bool stageActive;
+static uint32_t stageRows;
+
+#define PDS_WL_INDEX_SLOTS			((EEPROM_ROW_SIZE) / sizeof(PdsWlIndexEntry_t))
+#define PDS_WL_INDEX_SLOTS_PER_PAGE	((EEPROM_PAGE_SIZE) / sizeof(PdsWlIndexEntry_t))
+#define PDS_WL_INDEX_FREE_ID		(UCHAR_MAX)
+/* The header counter holds the number of rows in its low byte, the generation above */
+#define PDS_WL_INDEX_ROWS_MASK		(UCHAR_MAX)
+#define PDS_WL_INDEX_GEN_SHIFT		(8)
 
 /******************************************************************************
                    Static prototype section
@@ -57,6 +84,25 @@ static FileMap_t fileMap[PDS_MAX_FILE_IDX];
 static void pdsUpdateRowMap(void);
 static void pdsUpdateFileMap(UpdateFileMap_t *updateFileMap);
 static uint16_t pdsReturnFreeRowIdx(void);
+static uint16_t pdsWlApplyDeltas(const uint8_t *row, uint8_t *image, uint16_t *validEnd);
+static bool pdsWlIndexLoad(void);
+static PdsStatus_t pdsWlIndexSnapshot(void);
+static void pdsWlIndexAppend(uint16_t rowIdx, uint16_t memId, uint32_t counter);
+static void pdsWlIndexInvalidate(uint8_t row);
+static bool pdsWlIndexIsFree(PdsWlIndexEntry_t *entry);
+static void pdsWlIndexFill(PdsWlIndexEntry_t *entry, uint8_t rowIdx, uint16_t memId, uint32_t counter);
+static bool pdsWlIndexIsValid(PdsWlIndexEntry_t *entry);
+static bool pdsWlIndexIsHeader(PdsWlIndexEntry_t *entry);
+static bool pdsWlIsIndexed(uint8_t rowIdx, uint16_t memId, uint32_t counter);
+static void pdsWlOrphansErase(void);
+static void pdsWlWriteDone(PdsStatus_t status);
+static PdsStatus_t pdsWlWriteRow(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size, uint8_t heapIdx);
+static bool pdsWlIsRowFree(uint8_t rowIdx);
+static void pdsWlFreeRowsBuild(void);
+static void pdsWlFreeRowPush(uint8_t rowIdx);
+static void pdsWlFreeRowRemove(uint8_t heapIdx);
+static void pdsWlEraseCountLoad(void);
+static uint8_t pdsWlStaticRowIdx(void);
 
 /******************************************************************************
                    Implementations section
@@ -76,11 +122,24 @@ PdsStatus_t pdsWlInit(void)
 	{
 		return status;
 	}
+	memset(&rowMap, UCHAR_MAX, EEPROM_NUM_ROWS * sizeof(RowMap_t));
+    memset(&fileMap, UCHAR_MAX, PDS_MAX_FILE_IDX * sizeof(FileMap_t));
+
+	/* The index row spares reading every row, unless it is inconsistent */
+	if (pdsWlIndexLoad())
+	{
+		pdsWlEraseCountLoad();
+		pdsWlOrphansErase();
+		return PDS_OK;
+	}
+
 	PdsMem_t buffer;
 	memset(&rowMap, UCHAR_MAX, EEPROM_NUM_ROWS * sizeof(RowMap_t));
     memset(&fileMap, UCHAR_MAX, PDS_MAX_FILE_IDX * sizeof(FileMap_t));
 	memset(&buffer, 0, sizeof(PdsMem_t));
     UpdateFileMap_t updateFileMap;
+	uint16_t maxRowIdx;
+	uint16_t loserIdx;
 	
     for(uint8_t rowIdx = 0; rowIdx< EEPROM_NUM_ROWS; rowIdx++)
     {
@@ -93,10 +152,33 @@ PdsStatus_t pdsWlInit(void)
             updateFileMap.counter = buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.counter;
             updateFileMap.memId = buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.memId;
             updateFileMap.rowIdx = rowIdx;
+
+			/* Of two rows holding the same version of a file, e.g. a staged
+			 * row left by a reset and the row written after it, the one
+			 * recorded in the index wins */
+			maxRowIdx = fileMap[updateFileMap.memId].maxCounterRowIdx;
+			if ((USHRT_MAX != maxRowIdx) && (rowMap[maxRowIdx].counter == updateFileMap.counter))
+			{
+				loserIdx = rowIdx;
+				if (pdsWlIsIndexed(rowIdx, updateFileMap.memId, updateFileMap.counter) &&
+					!pdsWlIsIndexed(maxRowIdx, updateFileMap.memId, updateFileMap.counter))
+				{
+					rowMap[rowIdx].previousIdx = rowMap[maxRowIdx].previousIdx;
+					fileMap[updateFileMap.memId].maxCounterRowIdx = rowIdx;
+					loserIdx = maxRowIdx;
+				}
+				rowMap[loserIdx].counter = UINT_MAX;
+				rowMap[loserIdx].memId = USHRT_MAX;
+				rowMap[loserIdx].previousIdx = USHRT_MAX;
+				continue;
+			}
             pdsUpdateFileMap(&updateFileMap);
 		}
     }
     pdsUpdateRowMap();
+	(void)pdsWlIndexSnapshot();
+	pdsWlEraseCountLoad();
+	pdsWlOrphansErase();
 	
 	return PDS_OK;
 }
@@ -113,31 +195,170 @@ PdsStatus_t pdsWlInit(void)
 ******************************************************************************/
 PdsStatus_t pdsWlWrite(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size)
 {
-	UpdateFileMap_t updateFileMap;
-	PdsStatus_t status = PDS_OK;
+	PdsStatus_t status = pdsWlWriteStart(pdsFileItemIdx, buffer, size);
+
+	if (PDS_OK == status)
+	{
+		pdsNvmComplete();
+		status = pendingStatus;
+	}
+
+	return status;
+}
+
+/**************************************************************************//**
+\brief	Same as pdsWlWrite but returns once the row write is started. The row
+		and file map are updated when the NVM has programmed the row.
+
+\param[in] 	pdsFileItemIdx - The file id to be written to.
+\param[in] 	buffer - The buffer containing data to be written, it shall stay
+			valid until the row is programmed.
+\param[in] 	size - The size of the data in the buffer.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlWriteStart(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size)
+{
+	pdsNvmComplete();
+
+	/* The least worn free row is on top of the heap */
+	if (EEPROM_NUM_ROWS <= pdsReturnFreeRowIdx())
+	{
+		return PDS_NOT_ENOUGH_MEMORY;
+	}
+
+	pendingMigrate = false;
+	return pdsWlWriteRow(pdsFileItemIdx, buffer, size, 0);
+}
+
+/**************************************************************************//**
+\brief	Moves the file stored in the least worn row to the most worn free row,
+		if the wear spread exceeds PDS_WL_STATIC_MIGRATE_THRESHOLD. Returns
+		once the row write is started.
+
+\param[in] 	buffer - The buffer used to move the file, it shall stay valid
+			until the row is programmed.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlMigrateStart(PdsMem_t *buffer)
+{
+	PdsStatus_t status;
+	PdsFileItemIdx_t pdsFileItemIdx;
+	uint8_t staticRowIdx;
+	uint8_t heapIdx = 0;
+
+	pdsNvmComplete();
+
+	staticRowIdx = pdsWlStaticRowIdx();
+	if ((EEPROM_NUM_ROWS <= staticRowIdx) || (EEPROM_NUM_ROWS <= pdsReturnFreeRowIdx()))
+	{
+		return PDS_OK;
+	}
+
+	/* The file goes to the most worn free row, its own row is left to the
+	 * files that are rewritten often */
+	for (uint8_t idx = 1; idx < freeRowCount; idx++)
+	{
+		if (rowWear[freeRows[idx]] > rowWear[freeRows[heapIdx]])
+		{
+			heapIdx = idx;
+		}
+	}
+
+	pdsFileItemIdx = (PdsFileItemIdx_t)rowMap[staticRowIdx].memId;
+	status = pdsWlRead(pdsFileItemIdx, buffer, EEPROM_ROW_SIZE);
+	if (PDS_OK != status)
+	{
+		/* The next write of the file replaces it from RAM */
+		pdsStoreRetry(pdsFileItemIdx);
+		return status;
+	}
+
+	pendingMigrate = true;
+	return pdsWlWriteRow(pdsFileItemIdx, buffer, buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.size, heapIdx);
+}
+
+/**************************************************************************//**
+\brief	Reports the erase count of the least and the most worn row.
+
+\param[out] minCount - The erase count of the least worn row.
+\param[out] maxCount - The erase count of the most worn row.
+******************************************************************************/
+void pdsWlGetWear(uint32_t *minCount, uint32_t *maxCount)
+{
+	*minCount = UINT32_MAX;
+	*maxCount = 0;
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if (rowWear[rowIdx] < *minCount)
+		{
+			*minCount = rowWear[rowIdx];
+		}
+		if (rowWear[rowIdx] > *maxCount)
+		{
+			*maxCount = rowWear[rowIdx];
+		}
+	}
+}
+
+/**************************************************************************//**
+\brief	Starts writing a file to a free row and takes the row off the heap.
+
+\param[in] 	pdsFileItemIdx - The file id to be written to.
+\param[in] 	buffer - The buffer containing data to be written.
+\param[in] 	size - The size of the data in the buffer.
+\param[in] 	heapIdx - The position of the row in the free row heap.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+static PdsStatus_t pdsWlWriteRow(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size, uint8_t heapIdx)
+{
 	uint32_t counter;
-    uint16_t rowIdx = pdsReturnFreeRowIdx();
+	uint16_t rowIdx = freeRows[heapIdx];
+	uint16_t currentRowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
+
+	pdsWlFreeRowRemove(heapIdx);
+
+	/* A file rebuilt from RAM has no counter, the new row has to supersede the current one */
+	if ((USHRT_MAX != currentRowIdx) &&
+		(buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.counter < rowMap[currentRowIdx].counter))
+	{
+		buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.counter = rowMap[currentRowIdx].counter;
+	}
 	buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.counter++;
 	buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.memId = pdsFileItemIdx;
 	buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.magicNo = PDS_MAGIC;
 	buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.version = PDS_WL_VERSION;
 	buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.size = size;
 	counter = buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.counter;
+	/* The space behind the file image is left erased for delta records */
+	memset(&(buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlData[size]), UCHAR_MAX, PDS_WL_DATA_SIZE - size);
 	size += sizeof(PdsWlHeader_t);
 
-	status = pdsNvmWrite(rowIdx, buffer, size);
-	if (PDS_OK == status)
+	/* The row is erased even if the write fails */
+	rowWear[rowIdx]++;
+	if ((sizeof(PdsNvmHeader_t) + size) <= PDS_WL_ERASE_COUNT_OFFSET)
 	{
-		rowMap[rowIdx].counter = counter;
-		rowMap[rowIdx].memId = pdsFileItemIdx;
-		rowMap[rowIdx].previousIdx = USHRT_MAX;
-		updateFileMap.counter = rowMap[rowIdx].counter;
-		updateFileMap.memId = rowMap[rowIdx].memId;
-		updateFileMap.rowIdx = rowIdx;
-		pdsUpdateFileMap(&updateFileMap);
+		memcpy(&(buffer->NVM_Mem.pdsNvmMem[PDS_WL_ERASE_COUNT_OFFSET]), &rowWear[rowIdx], sizeof(uint32_t));
 	}
-	
-	return status;
+
+	/* The write is recorded before it starts, a torn row is detected at boot.
+	 * A staged row stays unknown to the index until the transaction commits */
+	if (stageActive)
+	{
+		stageRows |= (1UL << rowIdx);
+	}
+	else
+	{
+		pdsWlIndexAppend(rowIdx, pdsFileItemIdx, counter);
+	}
+
+	pendingWrite.counter = counter;
+	pendingWrite.memId = pdsFileItemIdx;
+	pendingWrite.rowIdx = rowIdx;
+	pendingDeltaOffset = sizeof(PdsNvmHeader_t) + size;
+	/* Until the row is programmed no delta record can be appended to the file */
+	fileMap[pdsFileItemIdx].deltaOffset = USHRT_MAX;
+
+	return pdsNvmWriteStart(rowIdx, buffer, size, pdsWlWriteDone);
 }
 
 /**************************************************************************//**
@@ -152,7 +373,12 @@ PdsStatus_t pdsWlWrite(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16
 PdsStatus_t pdsWlRead(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size)
 {
 	PdsStatus_t status = PDS_OK;
-	uint16_t rowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
+	uint16_t rowIdx;
+
+	/* A file being written is read back once its row is complete */
+	pdsNvmComplete();
+
+	rowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
 	if (USHRT_MAX == rowIdx)
 	{
 		return PDS_NOT_FOUND;
@@ -160,10 +386,223 @@ PdsStatus_t pdsWlRead(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_
 	
 	size += sizeof(PdsWlHeader_t);
 	status = pdsNvmRead(rowIdx, buffer, size);
+	if (PDS_OK == status)
+	{
+		fileMap[pdsFileItemIdx].deltaOffset = pdsWlApplyDeltas(&(buffer->NVM_Mem.pdsNvmMem[0]),
+				&(buffer->NVM_Struct.pdsNvmData.WL_Struct.pdsWlData[0]), NULL);
+	}
 	
 	return status;
 }
 
+/**************************************************************************//**
+\brief	Copies the items of a file straight from the NVM to their RAM address.
+		The file image and its delta records are checked in place, then each
+		item is copied once from its latest version.
+
+\param[in] 	pdsFileItemIdx - The file id to be restored.
+\param[in] 	itemList - The items of the file.
+\param[in] 	numItems - The number of items in the list.
+\param[in] 	item - The item to be restored, PDS_WL_ALL_ITEMS for all the items.
+\param[out] status - PDS_ITEM_DELETED or PDS_NOT_FOUND if a single item cannot
+			  be restored, the return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlRestore(PdsFileItemIdx_t pdsFileItemIdx, ItemMap_t *itemList, uint8_t numItems, uint8_t item)
+{
+	const uint8_t *row;
+	const PdsMem_t *mem;
+	const uint8_t *ptr;
+	ItemHeader_t itemHeader;
+	uint16_t imageStart = sizeof(PdsNvmHeader_t) + sizeof(PdsWlHeader_t);
+	uint16_t imageSize;
+	uint16_t deltaEnd;
+	uint16_t src;
+	uint16_t rowIdx;
+	uint8_t itemSize;
+
+	pdsNvmComplete();
+
+	rowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
+	if ((USHRT_MAX == rowIdx) || ((PDS_WL_ALL_ITEMS != item) && (numItems <= item)))
+	{
+		return PDS_NOT_FOUND;
+	}
+
+	row = pdsNvmRowAddr(rowIdx);
+	mem = (const PdsMem_t *)row;
+	if (((sizeof(PdsNvmHeader_t) + mem->NVM_Struct.pdsNvmHeader.size) > EEPROM_ROW_SIZE) ||
+		(mem->NVM_Struct.pdsNvmHeader.crc != pdsNvmCrc((uint8_t *)&(mem->NVM_Struct.pdsNvmData), mem->NVM_Struct.pdsNvmHeader.size)))
+	{
+		return PDS_CRC_ERROR;
+	}
+	imageSize = mem->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.size;
+	(void)pdsWlApplyDeltas(row, NULL, &deltaEnd);
+
+	for (uint8_t itemIdx = 0; itemIdx < numItems; itemIdx++)
+	{
+		if ((PDS_WL_ALL_ITEMS != item) && (itemIdx != item))
+		{
+			continue;
+		}
+		if ((PDS_WL_ALL_ITEMS != item) && (item != itemList[itemIdx].itemId))
+		{
+			return PDS_NOT_FOUND;
+		}
+		/* An item added after the file was stored has no value yet */
+		if ((itemList[itemIdx].itemOffset + sizeof(ItemHeader_t) + itemList[itemIdx].size) > imageSize)
+		{
+			if (PDS_WL_ALL_ITEMS != item)
+			{
+				return PDS_NOT_FOUND;
+			}
+			continue;
+		}
+
+		/* The latest version of the item is in the last record holding it */
+		src = imageStart + itemList[itemIdx].itemOffset;
+		ptr = &row[sizeof(PdsNvmHeader_t) + mem->NVM_Struct.pdsNvmHeader.size];
+		while (ptr < &row[deltaEnd])
+		{
+			const uint8_t *end = ptr + sizeof(PdsWlDeltaHeader_t) + ((const PdsWlDeltaHeader_t *)ptr)->length;
+
+			for (ptr += sizeof(PdsWlDeltaHeader_t); ptr < end; ptr += 1 + itemSize)
+			{
+				memcpy(&itemHeader, ptr + 1, sizeof(ItemHeader_t));
+				itemSize = sizeof(ItemHeader_t) + (itemHeader.delete ? 0 : itemHeader.size);
+				if (*ptr == itemList[itemIdx].itemOffset)
+				{
+					src = (ptr + 1) - row;
+				}
+			}
+		}
+
+		memcpy(&itemHeader, &row[src], sizeof(ItemHeader_t));
+		if (itemHeader.delete)
+		{
+			if (PDS_WL_ALL_ITEMS != item)
+			{
+				return PDS_ITEM_DELETED;
+			}
+			continue;
+		}
+
+		itemSize = (itemHeader.size < itemList[itemIdx].size) ? itemHeader.size : itemList[itemIdx].size;
+		memcpy(itemList[itemIdx].ramAddress, &row[src + sizeof(ItemHeader_t)], itemSize);
+	}
+
+	return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	This function appends a delta record to the row of the file, so that
+		the updated items are stored without erasing a row. pdsWlRead applies
+		the records on top of the file image.
+
+\param[in] 	pdsFileItemIdx - The file id to be written to.
+\param[in] 	record - The payload of the delta record.
+\param[in] 	length - The size of the payload.
+\param[out] status - PDS_NOT_ENOUGH_MEMORY if the record does not fit in the row,
+			  the return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlAppend(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *record, uint8_t length)
+{
+	PdsStatus_t status = PDS_OK;
+	PdsWlDeltaHeader_t deltaHeader;
+	uint32_t rowBuf[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+	uint8_t *row = (uint8_t *)rowBuf;
+	uint16_t rowIdx;
+	uint16_t offset;
+	uint16_t end;
+
+	pdsNvmComplete();
+
+	rowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
+	offset = fileMap[pdsFileItemIdx].deltaOffset;
+	end = offset + sizeof(PdsWlDeltaHeader_t) + length;
+
+	/* A record would change the committed version of the file in place, so
+	 * a transaction rewrites the file instead */
+	if ((USHRT_MAX == rowIdx) || (USHRT_MAX == offset) || (PDS_WL_ERASE_COUNT_OFFSET < end) || stageActive)
+	{
+		return PDS_NOT_ENOUGH_MEMORY;
+	}
+
+	deltaHeader.magic = PDS_MAGIC;
+	deltaHeader.length = length;
+	deltaHeader.crc = pdsNvmCrc(record, length);
+
+	/* Only the pages holding the record are programmed, the rest of the
+	 * page buffer stays erased so that the other bytes remain untouched */
+	memset(rowBuf, UCHAR_MAX, sizeof(rowBuf));
+	memcpy(&row[offset], &deltaHeader, sizeof(PdsWlDeltaHeader_t));
+	memcpy(&row[offset + sizeof(PdsWlDeltaHeader_t)], record, length);
+
+	for (uint8_t page = offset / EEPROM_PAGE_SIZE; (page * EEPROM_PAGE_SIZE < end) && (PDS_OK == status); page++)
+	{
+		status = pdsNvmWritePage(rowIdx, page, &rowBuf[page * (EEPROM_PAGE_SIZE / sizeof(uint32_t))]);
+	}
+
+	/* A record that cannot be appended again is not retried until the file is rewritten */
+	fileMap[pdsFileItemIdx].deltaOffset = USHRT_MAX;
+
+	if (PDS_OK == status)
+	{
+		status = pdsNvmReadRaw(rowIdx, rowBuf);
+	}
+
+	if (PDS_OK == status)
+	{
+		if ((0 == memcmp(&row[offset], &deltaHeader, sizeof(PdsWlDeltaHeader_t))) &&
+			(0 == memcmp(&row[offset + sizeof(PdsWlDeltaHeader_t)], record, length)))
+		{
+			fileMap[pdsFileItemIdx].deltaOffset = end;
+		}
+		else
+		{
+			status = PDS_ERROR;
+		}
+	}
+
+	return status;
+}
+
+/**************************************************************************//**
+\brief	Called by the NVM when the row started by pdsWlWriteStart is programmed,
+		updates the row and file map if the write is successful.
+
+\param[in] status - The status of the row write.
+******************************************************************************/
+static void pdsWlWriteDone(PdsStatus_t status)
+{
+	uint16_t rowIdx = pendingWrite.rowIdx;
+
+	pendingStatus = status;
+	if (PDS_OK == status)
+	{
+		rowMap[rowIdx].counter = pendingWrite.counter;
+		rowMap[rowIdx].memId = pendingWrite.memId;
+		rowMap[rowIdx].previousIdx = USHRT_MAX;
+		pdsUpdateFileMap(&pendingWrite);
+		fileMap[pendingWrite.memId].deltaOffset = pendingDeltaOffset;
+
+		/* Moving a file does not count as traffic that wears the rows */
+		if (!pendingMigrate && (EEPROM_NUM_ROWS > pdsWlStaticRowIdx()))
+		{
+			pdsPostTask(PDS_WL_MIGRATE_TASK_ID);
+		}
+	}
+	else
+	{
+		/* The row is still free */
+		pdsWlFreeRowPush(rowIdx);
+		/* The file is rewritten by the next flush, a moved file is left in its row */
+		if (!pendingMigrate)
+		{
+			pdsStoreRetry((PdsFileItemIdx_t)pendingWrite.memId);
+		}
+	}
+}
+
 /**************************************************************************//**
 \brief	Updates the row map so that the old entries of the file are erased
 		in the row map.
@@ -259,61 +698,758 @@ static void pdsUpdateFileMap(UpdateFileMap_t *updateFileMap)
 ******************************************************************************/
 static uint16_t pdsReturnFreeRowIdx(void)
 {
-    uint8_t rowIdx;
-    bool found = 0;
-    for(rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
-    {
-        if( (UINT_MAX == rowMap[rowIdx].counter) &&
-            (USHRT_MAX == rowMap[rowIdx].previousIdx) &&
-            (USHRT_MAX == rowMap[rowIdx].memId) )
-        {
-            found = 1;
-            break;
-        }
-    }
-
-    if(!found)
+    /* The rows of the older versions of the files are freed lazily. Within a
+     * transaction they hold the committed files and are not reused */
+    if ((0 == freeRowCount) && !stageActive)
     {
         pdsUpdateRowMap();
-        for(rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
-        {
-            if( (UINT_MAX == rowMap[rowIdx].counter) &&
-                (USHRT_MAX == rowMap[rowIdx].previousIdx) &&
-                (USHRT_MAX == rowMap[rowIdx].memId))
-            {
-                break;
-            }
-        }
+        pdsWlFreeRowsBuild();
     }
-	return rowIdx;
+
+	return (0 == freeRowCount) ? EEPROM_NUM_ROWS : freeRows[0];
 }
 
 /**************************************************************************//**
-\brief This function checks if a file is found in the file map.
+\brief	Checks if a row holds neither a file nor an older version of one.
 
+\param[in] 	rowIdx - The row.
 \param[out] - return true or false
 ******************************************************************************/
-bool isFileFound(PdsFileItemIdx_t pdsFileItemIdx)
+static bool pdsWlIsRowFree(uint8_t rowIdx)
 {
-	uint16_t rowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
-	if (USHRT_MAX == rowIdx)
+	return ((UINT_MAX == rowMap[rowIdx].counter) &&
+			(USHRT_MAX == rowMap[rowIdx].previousIdx) &&
+			(USHRT_MAX == rowMap[rowIdx].memId));
+}
+
+/**************************************************************************//**
+\brief	Rebuilds the free row heap from the row map.
+******************************************************************************/
+static void pdsWlFreeRowsBuild(void)
+{
+	freeRowCount = 0;
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
 	{
-		return false;
+		if (pdsWlIsRowFree(rowIdx))
+		{
+			pdsWlFreeRowPush(rowIdx);
+		}
 	}
-	else
+}
+
+/**************************************************************************//**
+\brief	Inserts a row in the free row heap.
+
+\param[in] 	rowIdx - The row.
+******************************************************************************/
+static void pdsWlFreeRowPush(uint8_t rowIdx)
+{
+	uint8_t idx = freeRowCount++;
+	uint8_t parent;
+
+	while (idx > 0)
 	{
-		return true;
+		parent = (idx - 1) / 2;
+		if (rowWear[freeRows[parent]] <= rowWear[rowIdx])
+		{
+			break;
+		}
+		freeRows[idx] = freeRows[parent];
+		idx = parent;
 	}
+	freeRows[idx] = rowIdx;
 }
 
-void pdsWlDeleteAll(void)
+/**************************************************************************//**
+\brief	Removes the row at a position of the free row heap.
+
+\param[in] 	heapIdx - The position in the heap.
+******************************************************************************/
+static void pdsWlFreeRowRemove(uint8_t heapIdx)
 {
-	/* Clear Filemap array */
-	memset(&rowMap, UCHAR_MAX, EEPROM_NUM_ROWS * sizeof(RowMap_t));
-	/* Clear Row Map Array */
-    memset(&fileMap, UCHAR_MAX, PDS_MAX_FILE_IDX * sizeof(FileMap_t));
-	/* Call NVM Erase All */
-	pdsNvmEraseAll();
+	uint8_t rowIdx;
+	uint8_t child;
+	uint8_t parent;
+
+	rowIdx = freeRows[--freeRowCount];
+	if (heapIdx == freeRowCount)
+	{
+		return;
+	}
+
+	/* The last row takes the free position and rises or sinks to its place */
+	while (heapIdx > 0)
+	{
+		parent = (heapIdx - 1) / 2;
+		if (rowWear[freeRows[parent]] <= rowWear[rowIdx])
+		{
+			break;
+		}
+		freeRows[heapIdx] = freeRows[parent];
+		heapIdx = parent;
+	}
+
+	while ((child = (2 * heapIdx) + 1) < freeRowCount)
+	{
+		if (((child + 1) < freeRowCount) && (rowWear[freeRows[child + 1]] < rowWear[freeRows[child]]))
+		{
+			child++;
+		}
+		if (rowWear[rowIdx] <= rowWear[freeRows[child]])
+		{
+			break;
+		}
+		freeRows[heapIdx] = freeRows[child];
+		heapIdx = child;
+	}
+	freeRows[heapIdx] = rowIdx;
+}
+
+/**************************************************************************//**
+\brief	Reads the erase count stored at the end of each row. A row whose count
+		is lost, e.g. after an erase of all the rows, gets the highest count
+		known so that it is not favoured. Then builds the free row heap.
+******************************************************************************/
+static void pdsWlEraseCountLoad(void)
+{
+	uint32_t rowBuf[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+	PdsMem_t *row = (PdsMem_t *)rowBuf;
+	uint32_t maxCount = 0;
+
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		rowWear[rowIdx] = UINT32_MAX;
+		if ((PDS_OK == pdsNvmReadRaw(rowIdx, rowBuf)) &&
+			((sizeof(PdsNvmHeader_t) + row->NVM_Struct.pdsNvmHeader.size) <= PDS_WL_ERASE_COUNT_OFFSET))
+		{
+			memcpy(&rowWear[rowIdx], &(row->NVM_Mem.pdsNvmMem[PDS_WL_ERASE_COUNT_OFFSET]), sizeof(uint32_t));
+		}
+		if ((UINT32_MAX != rowWear[rowIdx]) && (rowWear[rowIdx] > maxCount))
+		{
+			maxCount = rowWear[rowIdx];
+		}
+	}
+
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if (UINT32_MAX == rowWear[rowIdx])
+		{
+			rowWear[rowIdx] = maxCount;
+		}
+	}
+
+	pdsWlFreeRowsBuild();
+}
+
+/**************************************************************************//**
+\brief	Finds the least worn row holding the latest version of a file, if it
+		is worn less than the most worn row by more than
+		PDS_WL_STATIC_MIGRATE_THRESHOLD.
+
+\param[out] - returns the row, or EEPROM_NUM_ROWS if no file has to be moved
+******************************************************************************/
+static uint8_t pdsWlStaticRowIdx(void)
+{
+	uint8_t staticRowIdx = EEPROM_NUM_ROWS;
+	uint32_t maxCount = 0;
+	uint16_t rowIdx;
+
+	for (uint8_t memId = 0; memId < PDS_MAX_FILE_IDX; memId++)
+	{
+		rowIdx = fileMap[memId].maxCounterRowIdx;
+		if ((USHRT_MAX != rowIdx) &&
+			((EEPROM_NUM_ROWS == staticRowIdx) || (rowWear[rowIdx] < rowWear[staticRowIdx])))
+		{
+			staticRowIdx = rowIdx;
+		}
+	}
+
+	for (rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if (rowWear[rowIdx] > maxCount)
+		{
+			maxCount = rowWear[rowIdx];
+		}
+	}
+
+	if ((EEPROM_NUM_ROWS == staticRowIdx) || ((maxCount - rowWear[staticRowIdx]) <= PDS_WL_STATIC_MIGRATE_THRESHOLD))
+	{
+		return EEPROM_NUM_ROWS;
+	}
+
+	return staticRowIdx;
+}
+
+/**************************************************************************//**
+\brief	Applies the delta records stored behind the file image of a row to
+		the image in the buffer.
+
+\param[in] 	row - The row as stored in NVM.
+\param[out] image - The file image the records are applied to, NULL to only
+			  check the records.
+\param[out] validEnd - The row offset behind the last valid record, may be NULL.
+\param[out] - returns the row offset of the first free delta byte, or USHRT_MAX
+			  if a torn record prevents further appends to the row.
+******************************************************************************/
+static uint16_t pdsWlApplyDeltas(const uint8_t *row, uint8_t *image, uint16_t *validEnd)
+{
+	PdsWlDeltaHeader_t deltaHeader;
+	ItemHeader_t itemHeader;
+	const PdsMem_t *mem = (const PdsMem_t *)row;
+	uint16_t imageSize = mem->NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.size;
+	uint16_t offset = sizeof(PdsNvmHeader_t) + mem->NVM_Struct.pdsNvmHeader.size;
+	uint16_t itemSize;
+	const uint8_t *ptr;
+	const uint8_t *end;
+	uint16_t freeOffset = USHRT_MAX;
+
+	while ((offset + sizeof(PdsWlDeltaHeader_t)) <= PDS_WL_ERASE_COUNT_OFFSET)
+	{
+		memcpy(&deltaHeader, &row[offset], sizeof(PdsWlDeltaHeader_t));
+		if ((UCHAR_MAX == deltaHeader.magic) && (UCHAR_MAX == deltaHeader.length) && (USHRT_MAX == deltaHeader.crc))
+		{
+			freeOffset = offset;
+			break;
+		}
+
+		ptr = &row[offset + sizeof(PdsWlDeltaHeader_t)];
+		end = ptr + deltaHeader.length;
+		if ((PDS_MAGIC != deltaHeader.magic) || ((offset + sizeof(PdsWlDeltaHeader_t) + deltaHeader.length) > PDS_WL_ERASE_COUNT_OFFSET) ||
+			(deltaHeader.crc != pdsNvmCrc((uint8_t *)ptr, deltaHeader.length)))
+		{
+			break;
+		}
+
+		/* The entries are checked before any of them is applied */
+		while (ptr < end)
+		{
+			memcpy(&itemHeader, ptr + 1, sizeof(ItemHeader_t));
+			itemSize = sizeof(ItemHeader_t) + (itemHeader.delete ? 0 : itemHeader.size);
+			if ((ptr + 1 + itemSize > end) || ((*ptr + itemSize) > imageSize))
+			{
+				break;
+			}
+			ptr += 1 + itemSize;
+		}
+		if (ptr != end)
+		{
+			break;
+		}
+
+		for (ptr = &row[offset + sizeof(PdsWlDeltaHeader_t)]; (NULL != image) && (ptr < end); ptr += 1 + itemSize)
+		{
+			memcpy(&itemHeader, ptr + 1, sizeof(ItemHeader_t));
+			itemSize = sizeof(ItemHeader_t) + (itemHeader.delete ? 0 : itemHeader.size);
+			memcpy(&image[*ptr], ptr + 1, itemSize);
+		}
+
+		offset += sizeof(PdsWlDeltaHeader_t) + deltaHeader.length;
+	}
+
+	if (NULL != validEnd)
+	{
+		*validEnd = offset;
+	}
+
+	return freeOffset;
+}
+
+/**************************************************************************//**
+\brief This function checks if a file is found in the file map.
+
+\param[out] - return true or false
+******************************************************************************/
+bool isFileFound(PdsFileItemIdx_t pdsFileItemIdx)
+{
+	uint16_t rowIdx;
+
+	pdsNvmComplete();
+
+	rowIdx = fileMap[pdsFileItemIdx].maxCounterRowIdx;
+	if (USHRT_MAX == rowIdx)
+	{
+		return false;
+	}
+	else
+	{
+		return true;
+	}
+}
+
+void pdsWlDeleteAll(void)
+{
+	/* The maps are cleared after the pending row write has updated them */
+	pdsNvmComplete();
+	/* Clear Filemap array */
+	memset(&rowMap, UCHAR_MAX, EEPROM_NUM_ROWS * sizeof(RowMap_t));
+	/* Clear Row Map Array */
+    memset(&fileMap, UCHAR_MAX, PDS_MAX_FILE_IDX * sizeof(FileMap_t));
+	/* Call NVM Erase All */
+	pdsNvmEraseAll();
+	/* The previous index would point to the erased rows */
+	if (PDS_OK != pdsWlIndexSnapshot())
+	{
+		pdsWlIndexInvalidate(indexRow);
+	}
+	/* The erase counts are kept, the rows get them back when rewritten */
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		rowWear[rowIdx]++;
+	}
+	pdsWlFreeRowsBuild();
+}
+
+/**************************************************************************//**
+\brief	Starts a transaction. The files written until pdsWlStageCommit go to
+		free rows without being recorded in the index, so that a reset before
+		the commit keeps the previous version of all of them.
+******************************************************************************/
+void pdsWlStageBegin(void)
+{
+	pdsNvmComplete();
+
+	/* Every row not holding a committed file is made available */
+	pdsUpdateRowMap();
+	pdsWlFreeRowsBuild();
+
+	/* The index has to be usable to hide the staged rows */
+	if (PDS_WL_INDEX_SLOTS <= indexSlot)
+	{
+		(void)pdsWlIndexSnapshot();
+	}
+
+	stageRows = 0;
+	stageActive = true;
+}
+
+/**************************************************************************//**
+\brief	Commits the transaction: a snapshot of the row map taking in the staged
+		rows is written to the other index row, its header being the single
+		marker that publishes all of them. If the snapshot cannot be written
+		the transaction is aborted and the previous index stays in use.
+
+\param[in] 	keepFiles - Bitmap of the files kept, the other files are
+			deleted by the same snapshot and their rows erased.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlStageCommit(uint16_t keepFiles)
+{
+	uint32_t deletedRows = 0;
+
+	pdsNvmComplete();
+
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if ((USHRT_MAX != rowMap[rowIdx].memId) && !(keepFiles & (1U << rowMap[rowIdx].memId)))
+		{
+			deletedRows |= (1UL << rowIdx);
+			fileMap[rowMap[rowIdx].memId].maxCounterRowIdx = USHRT_MAX;
+			fileMap[rowMap[rowIdx].memId].deltaOffset = USHRT_MAX;
+			rowMap[rowIdx].counter = UINT_MAX;
+			rowMap[rowIdx].memId = USHRT_MAX;
+			rowMap[rowIdx].previousIdx = USHRT_MAX;
+		}
+	}
+	pdsUpdateRowMap();
+
+	/* The previous index is only dropped once the new one is complete */
+	if (PDS_OK != pdsWlIndexSnapshot())
+	{
+		pdsWlStageAbort();
+		return PDS_ERROR;
+	}
+	stageActive = false;
+
+	/* The deletions are published, their rows are erased before a scan of
+	 * the rows after a loss of the index could bring the files back */
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if ((deletedRows & (1UL << rowIdx)) && (PDS_OK == pdsNvmErase(rowIdx)))
+		{
+			rowWear[rowIdx]++;
+		}
+	}
+	pdsWlFreeRowsBuild();
+
+	return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Aborts the transaction. The staged rows are erased and the maps are
+		rebuilt from the index, so that the committed files are used again.
+******************************************************************************/
+void pdsWlStageAbort(void)
+{
+	pdsNvmComplete();
+	stageActive = false;
+
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if (stageRows & (1UL << rowIdx))
+		{
+			(void)pdsNvmErase(rowIdx);
+			rowWear[rowIdx]++;
+		}
+	}
+
+	memset(&rowMap, UCHAR_MAX, EEPROM_NUM_ROWS * sizeof(RowMap_t));
+	memset(&fileMap, UCHAR_MAX, PDS_MAX_FILE_IDX * sizeof(FileMap_t));
+	if (pdsWlIndexLoad())
+	{
+		pdsWlFreeRowsBuild();
+	}
+	else
+	{
+		/* With the staged rows erased a scan of the rows finds the committed files */
+		(void)pdsWlInit();
+	}
+}
+
+/**************************************************************************//**
+\brief	Rebuilds the row and file map from the index row. The rows written
+		after the snapshot are read back to check that their write completed.
+
+\param[out] - returns false if the index is inconsistent and a full scan is needed
+******************************************************************************/
+static bool pdsWlIndexLoad(void)
+{
+	uint32_t rowBuf[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+	PdsWlIndexEntry_t *entries = (PdsWlIndexEntry_t *)rowBuf;
+	PdsMem_t buffer;
+	UpdateFileMap_t updateFileMap;
+	uint32_t generation = 0;
+	uint8_t row = UCHAR_MAX;
+	uint8_t staleRow = UCHAR_MAX;
+	uint8_t slot;
+	uint8_t rowIdx;
+
+	/* A snapshot cut by a reset has no header, the previous index is used */
+	for (uint8_t idx = 0; idx < PDS_WL_INDEX_NUM_ROWS; idx++)
+	{
+		if ((PDS_OK != pdsNvmReadRaw(PDS_WL_INDEX_FIRST_ROW + idx, rowBuf)) || !pdsWlIndexIsHeader(&entries[0]))
+		{
+			continue;
+		}
+		if ((UCHAR_MAX == row) || ((entries[0].counter >> PDS_WL_INDEX_GEN_SHIFT) > generation))
+		{
+			staleRow = row;
+			row = PDS_WL_INDEX_FIRST_ROW + idx;
+			generation = entries[0].counter >> PDS_WL_INDEX_GEN_SHIFT;
+		}
+		else
+		{
+			staleRow = PDS_WL_INDEX_FIRST_ROW + idx;
+		}
+	}
+
+	if ((UCHAR_MAX == row) || (PDS_OK != pdsNvmReadRaw(row, rowBuf)))
+	{
+		return false;
+	}
+	indexRow = row;
+
+	for (slot = 1; slot < PDS_WL_INDEX_SLOTS; slot++)
+	{
+		if (pdsWlIndexIsFree(&entries[slot]))
+		{
+			break;
+		}
+
+		rowIdx = entries[slot].rowIdx;
+		if (!pdsWlIndexIsValid(&entries[slot]) || (EEPROM_NUM_ROWS <= rowIdx) ||
+			((slot <= EEPROM_NUM_ROWS) && ((slot - 1) != rowIdx)))
+		{
+			return false;
+		}
+
+		rowMap[rowIdx].counter = entries[slot].counter;
+		rowMap[rowIdx].memId = (PDS_WL_INDEX_FREE_ID == entries[slot].memId) ? USHRT_MAX : entries[slot].memId;
+
+		if (EEPROM_NUM_ROWS < slot)
+		{
+			/* A row write recorded after the snapshot may not have completed */
+			if ((PDS_OK != pdsNvmRead(rowIdx, &buffer, EEPROM_ROW_SIZE)) ||
+				(buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.counter != rowMap[rowIdx].counter) ||
+				(buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader.memId != rowMap[rowIdx].memId))
+			{
+				rowMap[rowIdx].counter = UINT_MAX;
+				rowMap[rowIdx].memId = USHRT_MAX;
+			}
+			else
+			{
+				/* A row holding the same version is older than the recorded one */
+				for (uint8_t other = 0; other < EEPROM_NUM_ROWS; other++)
+				{
+					if ((other != rowIdx) && (rowMap[other].memId == rowMap[rowIdx].memId) &&
+						(rowMap[other].counter == rowMap[rowIdx].counter))
+					{
+						rowMap[other].counter = UINT_MAX;
+						rowMap[other].memId = USHRT_MAX;
+					}
+				}
+			}
+		}
+	}
+
+	/* The snapshot has to be complete */
+	if (EEPROM_NUM_ROWS >= slot)
+	{
+		return false;
+	}
+	indexSlot = slot;
+	indexGeneration = generation;
+
+	/* A reset right after a snapshot leaves the previous index valid */
+	if ((UCHAR_MAX != staleRow) && (PDS_OK != pdsNvmErase(staleRow)))
+	{
+		pdsWlIndexInvalidate(staleRow);
+	}
+
+	for (rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		rowMap[rowIdx].previousIdx = USHRT_MAX;
+		if (USHRT_MAX != rowMap[rowIdx].memId)
+		{
+			updateFileMap.counter = rowMap[rowIdx].counter;
+			updateFileMap.memId = rowMap[rowIdx].memId;
+			updateFileMap.rowIdx = rowIdx;
+			pdsUpdateFileMap(&updateFileMap);
+		}
+	}
+	pdsUpdateRowMap();
+
+	return true;
+}
+
+/**************************************************************************//**
+\brief	Writes a snapshot of the row map to the index row not in use. The
+		header is programmed last, so that an interrupted snapshot is not
+		used, then the previous index row is erased.
+
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+static PdsStatus_t pdsWlIndexSnapshot(void)
+{
+	uint32_t rowBuf[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+	PdsWlIndexEntry_t *entries = (PdsWlIndexEntry_t *)rowBuf;
+	uint8_t row = PDS_WL_INDEX_FIRST_ROW + ((indexRow - PDS_WL_INDEX_FIRST_ROW + 1) % PDS_WL_INDEX_NUM_ROWS);
+	PdsStatus_t status;
+
+	indexSlot = UCHAR_MAX;
+	status = pdsNvmErase(row);
+
+	memset(rowBuf, UCHAR_MAX, sizeof(rowBuf));
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		pdsWlIndexFill(&entries[1 + rowIdx], rowIdx, rowMap[rowIdx].memId, rowMap[rowIdx].counter);
+	}
+
+	for (uint8_t page = 0; (page <= (EEPROM_NUM_ROWS / PDS_WL_INDEX_SLOTS_PER_PAGE)) && (PDS_OK == status); page++)
+	{
+		status = pdsNvmWritePage(row, page, &rowBuf[page * (EEPROM_PAGE_SIZE / sizeof(uint32_t))]);
+	}
+
+	if (PDS_OK == status)
+	{
+		memset(rowBuf, UCHAR_MAX, sizeof(rowBuf));
+		pdsWlIndexFill(&entries[0], PDS_WL_INDEX_HEADER, PDS_WL_VERSION,
+				((indexGeneration + 1) << PDS_WL_INDEX_GEN_SHIFT) | EEPROM_NUM_ROWS);
+		status = pdsNvmWritePage(row, 0, rowBuf);
+	}
+
+	if (PDS_OK != status)
+	{
+		return status;
+	}
+
+	indexGeneration++;
+	indexSlot = 1 + EEPROM_NUM_ROWS;
+	/* Left valid, the previous index would be used if the new one is invalidated */
+	if (PDS_OK != pdsNvmErase(indexRow))
+	{
+		pdsWlIndexInvalidate(indexRow);
+	}
+	indexRow = row;
+
+	return PDS_OK;
+}
+
+/**************************************************************************//**
+\brief	Records a row write in the index row, taking a new snapshot when the
+		row is full. If the record cannot be written the index is
+		invalidated, so that the next boot scans all the rows.
+******************************************************************************/
+static void pdsWlIndexAppend(uint16_t rowIdx, uint16_t memId, uint32_t counter)
+{
+	uint32_t pageBuf[(EEPROM_PAGE_SIZE) / sizeof(uint32_t)];
+	PdsWlIndexEntry_t *entries = (PdsWlIndexEntry_t *)pageBuf;
+
+	if (PDS_WL_INDEX_SLOTS <= indexSlot)
+	{
+		(void)pdsWlIndexSnapshot();
+	}
+
+	memset(pageBuf, UCHAR_MAX, sizeof(pageBuf));
+	if (PDS_WL_INDEX_SLOTS > indexSlot)
+	{
+		pdsWlIndexFill(&entries[indexSlot % PDS_WL_INDEX_SLOTS_PER_PAGE], rowIdx, memId, counter);
+		if (PDS_OK == pdsNvmWritePage(indexRow, indexSlot / PDS_WL_INDEX_SLOTS_PER_PAGE, pageBuf))
+		{
+			indexSlot++;
+			return;
+		}
+	}
+
+	pdsWlIndexInvalidate(indexRow);
+	indexSlot = UCHAR_MAX;
+}
+
+/**************************************************************************//**
+\brief	Makes an index row unusable. The programmed slots cannot be programmed
+		again, so a slot with a wrong CRC is written to the first free one,
+		and a full row is erased.
+
+\param[in] 	row - The index row.
+******************************************************************************/
+static void pdsWlIndexInvalidate(uint8_t row)
+{
+	uint32_t rowBuf[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+	uint32_t pageBuf[(EEPROM_PAGE_SIZE) / sizeof(uint32_t)];
+	PdsWlIndexEntry_t *entries = (PdsWlIndexEntry_t *)rowBuf;
+	uint8_t slot;
+
+	if (PDS_OK != pdsNvmReadRaw(row, rowBuf))
+	{
+		return;
+	}
+
+	for (slot = 0; (slot < PDS_WL_INDEX_SLOTS) && !pdsWlIndexIsFree(&entries[slot]); slot++)
+	{
+	}
+
+	/* A row without header is not used anyway */
+	if (0 == slot)
+	{
+		return;
+	}
+	if (PDS_WL_INDEX_SLOTS == slot)
+	{
+		(void)pdsNvmErase(row);
+		return;
+	}
+
+	entries = (PdsWlIndexEntry_t *)pageBuf;
+	memset(pageBuf, UCHAR_MAX, sizeof(pageBuf));
+	pdsWlIndexFill(&entries[slot % PDS_WL_INDEX_SLOTS_PER_PAGE], PDS_WL_INDEX_HEADER, PDS_WL_INDEX_FREE_ID, 0);
+	entries[slot % PDS_WL_INDEX_SLOTS_PER_PAGE].crc ^= USHRT_MAX;
+	(void)pdsNvmWritePage(row, slot / PDS_WL_INDEX_SLOTS_PER_PAGE, pageBuf);
+}
+
+/**************************************************************************//**
+\brief	Fills an index slot along with its CRC.
+******************************************************************************/
+static void pdsWlIndexFill(PdsWlIndexEntry_t *entry, uint8_t rowIdx, uint16_t memId, uint32_t counter)
+{
+	entry->counter = counter;
+	entry->rowIdx = rowIdx;
+	entry->memId = (USHRT_MAX == memId) ? PDS_WL_INDEX_FREE_ID : (uint8_t)memId;
+	entry->crc = pdsNvmCrc((uint8_t *)entry, offsetof(PdsWlIndexEntry_t, crc));
+}
+
+/**************************************************************************//**
+\brief	Checks if an index slot is still erased.
+******************************************************************************/
+static bool pdsWlIndexIsFree(PdsWlIndexEntry_t *entry)
+{
+	return ((UINT32_MAX == entry->counter) && (PDS_WL_INDEX_FREE_ID == entry->rowIdx) &&
+			(PDS_WL_INDEX_FREE_ID == entry->memId) && (USHRT_MAX == entry->crc));
+}
+
+/**************************************************************************//**
+\brief	Checks the CRC of an index slot.
+******************************************************************************/
+static bool pdsWlIndexIsValid(PdsWlIndexEntry_t *entry)
+{
+	return (entry->crc == pdsNvmCrc((uint8_t *)entry, offsetof(PdsWlIndexEntry_t, crc)));
+}
+
+/**************************************************************************//**
+\brief	Checks that a slot is the header of a complete snapshot of this layout.
+******************************************************************************/
+static bool pdsWlIndexIsHeader(PdsWlIndexEntry_t *entry)
+{
+	return (pdsWlIndexIsValid(entry) && (PDS_WL_INDEX_HEADER == entry->rowIdx) &&
+			(EEPROM_NUM_ROWS == (entry->counter & PDS_WL_INDEX_ROWS_MASK)) && (PDS_WL_VERSION == entry->memId));
+}
+
+/**************************************************************************//**
+\brief	Checks if a version of a file in a row is recorded in one of the index
+		rows, even one whose header is lost.
+
+\param[in] 	rowIdx - The row.
+\param[in] 	memId - The file id held by the row.
+\param[in] 	counter - The counter of the row.
+\param[out] - return true or false
+******************************************************************************/
+static bool pdsWlIsIndexed(uint8_t rowIdx, uint16_t memId, uint32_t counter)
+{
+	uint32_t rowBuf[(EEPROM_ROW_SIZE) / sizeof(uint32_t)];
+	PdsWlIndexEntry_t *entries = (PdsWlIndexEntry_t *)rowBuf;
+
+	for (uint8_t idx = 0; idx < PDS_WL_INDEX_NUM_ROWS; idx++)
+	{
+		if (PDS_OK != pdsNvmReadRaw(PDS_WL_INDEX_FIRST_ROW + idx, rowBuf))
+		{
+			continue;
+		}
+		for (uint8_t slot = 1; slot < PDS_WL_INDEX_SLOTS; slot++)
+		{
+			if (pdsWlIndexIsValid(&entries[slot]) && (rowIdx == entries[slot].rowIdx) &&
+				(memId == entries[slot].memId) && (counter == entries[slot].counter))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/**************************************************************************//**
+\brief	Erases the rows left by a transaction cut by a reset. Such a row is
+		free in the row map but holds a version of a file at least as recent
+		as the one in use, so a scan of the rows after a loss of the index
+		would publish it.
+******************************************************************************/
+static void pdsWlOrphansErase(void)
+{
+	PdsMem_t buffer;
+	PdsWlHeader_t *header = &buffer.NVM_Struct.pdsNvmData.WL_Struct.pdsWlHeader;
+	uint16_t maxRowIdx;
+	bool erased = false;
+
+	for (uint8_t rowIdx = 0; rowIdx < EEPROM_NUM_ROWS; rowIdx++)
+	{
+		if (!pdsWlIsRowFree(rowIdx) || (PDS_OK != pdsNvmRead(rowIdx, &buffer, EEPROM_ROW_SIZE)) ||
+			(PDS_MAX_FILE_IDX <= header->memId))
+		{
+			continue;
+		}
+
+		maxRowIdx = fileMap[header->memId].maxCounterRowIdx;
+		if (((USHRT_MAX == maxRowIdx) || (header->counter >= rowMap[maxRowIdx].counter)) &&
+			(PDS_OK == pdsNvmErase(rowIdx)))
+		{
+			rowWear[rowIdx]++;
+			erased = true;
+		}
+	}
+
+	/* The heap is ordered by the erase counts */
+	if (erased)
+	{
+		pdsWlFreeRowsBuild();
+	}
 }
 
 #endif
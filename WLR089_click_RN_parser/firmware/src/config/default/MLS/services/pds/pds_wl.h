@@ -41,10 +41,42 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include <xc.h>
 #include "pds_nvm.h"
 #include "pds_interface.h"
+#include "pds_journal.h"
 
 /******************************************************************************
                    Defines section
 ******************************************************************************/
+/* Largest payload of a delta record, bigger updates rewrite the file */
+#define PDS_WL_DELTA_MAX_SIZE		(EEPROM_PAGE_SIZE)
+
+/* Restores all the items of a file */
+#define PDS_WL_ALL_ITEMS			(0xFF)
+
+/* Two index rows follow the journal rows. The one with the latest valid
+ * header is in use, the next snapshot is written to the other one */
+#define PDS_WL_INDEX_FIRST_ROW		(PDS_JOURNAL_FIRST_ROW + PDS_JOURNAL_NUM_ROWS)
+#define PDS_WL_INDEX_NUM_ROWS		(2)
+/* rowIdx of the index header slot */
+#define PDS_WL_INDEX_HEADER			(0xFE)
+
+/* Each row ends with the number of times it has been erased */
+#define PDS_WL_ERASE_COUNT_OFFSET	((EEPROM_ROW_SIZE) - sizeof(uint32_t))
+
+/* Wear spread between the rows after which a file that is never rewritten
+ * is moved to a worn row, so that its row takes its share of the writes */
+#ifndef PDS_WL_STATIC_MIGRATE_THRESHOLD
+#define PDS_WL_STATIC_MIGRATE_THRESHOLD	(256)
+#endif
+
+#if (((PDS_WL_INDEX_FIRST_ROW) + (PDS_WL_INDEX_NUM_ROWS)) * (EEPROM_ROW_SIZE) > PDS_NVM_AREA_SIZE)
+#error "PDS index rows do not fit into the PDS NVM area"
+#endif
+
+/* The index row holds a header, a snapshot of the row map in 8 byte slots
+ * and at least one record of a row write */
+#if (((EEPROM_NUM_ROWS) + 2) * 8 > (EEPROM_ROW_SIZE))
+#error "PDS index row cannot hold a snapshot of all the WL rows, reduce EEPROM_SIZE"
+#endif
 
 /******************************************************************************
                                Types section
@@ -59,8 +91,30 @@ typedef struct _RowMap
 typedef struct _FileMap
 {
     uint16_t maxCounterRowIdx;
+    /* Row offset of the first free delta byte, USHRT_MAX if unknown */
+    uint16_t deltaOffset;
 } FileMap_t;
 
+/* One slot of the index row. Slot 0 is the header, slots 1 to EEPROM_NUM_ROWS
+ * hold a snapshot of the row map and the following slots record each row
+ * write before it is started. A slot with all bits set is free */
+typedef struct _PdsWlIndexEntry
+{
+    uint32_t counter;
+    uint8_t rowIdx;
+    uint8_t memId;
+    uint16_t crc;
+} PdsWlIndexEntry_t;
+
+/* Header of a delta record appended behind the file image of a row.
+ * The payload is a list of (image offset, ItemHeader_t, item data) */
+typedef struct _PdsWlDeltaHeader
+{
+    uint8_t magic;
+    uint8_t length;
+    uint16_t crc;
+} PdsWlDeltaHeader_t;
+
 typedef struct _UpdateFileMap
 {
     uint32_t counter;
@@ -92,6 +146,18 @@ PdsStatus_t pdsWlInit(void);
 ******************************************************************************/
 PdsStatus_t pdsWlWrite(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size);
 
+/**************************************************************************//**
+\brief	Same as pdsWlWrite but returns once the row write is started. The row
+		and file map are updated when the NVM has programmed the row.
+
+\param[in] 	pdsFileItemIdx - The file id to be written to.
+\param[in] 	buffer - The buffer containing data to be written, it shall stay
+			valid until the row is programmed.
+\param[in] 	size - The size of the data in the buffer.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlWriteStart(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size);
+
 /**************************************************************************//**
 \brief	This function will find extract the row where the file is stored and 
 		read from NVM.
@@ -103,6 +169,77 @@ PdsStatus_t pdsWlWrite(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16
 ******************************************************************************/
 PdsStatus_t pdsWlRead(PdsFileItemIdx_t pdsFileItemIdx, PdsMem_t *buffer, uint16_t size);
 
+/**************************************************************************//**
+\brief	Copies the items of a file straight from the NVM to their RAM address.
+		The file image and its delta records are checked in place, then each
+		item is copied once from its latest version.
+
+\param[in] 	pdsFileItemIdx - The file id to be restored.
+\param[in] 	itemList - The items of the file.
+\param[in] 	numItems - The number of items in the list.
+\param[in] 	item - The item to be restored, PDS_WL_ALL_ITEMS for all the items.
+\param[out] status - PDS_ITEM_DELETED or PDS_NOT_FOUND if a single item cannot
+			  be restored, the return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlRestore(PdsFileItemIdx_t pdsFileItemIdx, ItemMap_t *itemList, uint8_t numItems, uint8_t item);
+
+/**************************************************************************//**
+\brief	This function appends a delta record to the row of the file, so that
+		the updated items are stored without erasing a row. pdsWlRead applies
+		the records on top of the file image.
+
+\param[in] 	pdsFileItemIdx - The file id to be written to.
+\param[in] 	record - The payload of the delta record.
+\param[in] 	length - The size of the payload.
+\param[out] status - PDS_NOT_ENOUGH_MEMORY if the record does not fit in the row,
+			  the return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlAppend(PdsFileItemIdx_t pdsFileItemIdx, uint8_t *record, uint8_t length);
+
+/**************************************************************************//**
+\brief	Moves the file stored in the least worn row to the most worn free row,
+		if the wear spread exceeds PDS_WL_STATIC_MIGRATE_THRESHOLD. Returns
+		once the row write is started.
+
+\param[in] 	buffer - The buffer used to move the file, it shall stay valid
+			until the row is programmed.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlMigrateStart(PdsMem_t *buffer);
+
+/**************************************************************************//**
+\brief	Starts a transaction. The files written until pdsWlStageCommit go to
+		free rows without being recorded in the index, so that a reset before
+		the commit keeps the previous version of all of them.
+******************************************************************************/
+void pdsWlStageBegin(void);
+
+/**************************************************************************//**
+\brief	Commits the transaction: a snapshot of the row map taking in the staged
+		rows is written to the other index row, its header being the single
+		marker that publishes all of them. If the snapshot cannot be written
+		the transaction is aborted and the previous index stays in use.
+
+\param[in] 	keepFiles - Bitmap of the files kept, the other files are
+			deleted by the same snapshot and their rows erased.
+\param[out] status - The return status of the function's operation of type PdsStatus_t.
+******************************************************************************/
+PdsStatus_t pdsWlStageCommit(uint16_t keepFiles);
+
+/**************************************************************************//**
+\brief	Aborts the transaction. The staged rows are erased and the maps are
+		rebuilt from the index, so that the committed files are used again.
+******************************************************************************/
+void pdsWlStageAbort(void);
+
+/**************************************************************************//**
+\brief	Reports the erase count of the least and the most worn row.
+
+\param[out] minCount - The erase count of the least worn row.
+\param[out] maxCount - The erase count of the most worn row.
+******************************************************************************/
+void pdsWlGetWear(uint32_t *minCount, uint32_t *maxCount);
+
 /**************************************************************************//**
 \brief This function checks if a file is found in the file map.
 
@@ -97,6 +97,9 @@ static uint64_t sysTimeLastKnown = 0UL;
 /* This is the flag to enable/disable compare callback */
 static volatile bool compareCallbackEnabled = false;
 
+/* This is the callback of the tick timer, NULL when it is stopped */
+static void (*volatile tickCallback)(void *) = NULL;
+
 /* These are the variables to run the timer */
 static volatile uint32_t lastCount = 0U;
 static volatile uint32_t currentCount = 0U;
@@ -109,6 +112,14 @@ static volatile uint32_t compareValue = 0U;
 /* HW timer interrupt handler */
 static void hwTimerIrqHandler(TC_COMPARE_STATUS status, uintptr_t context)
 {
+    if (((status & TC_INTFLAG_MC1_Msk) == TC_INTFLAG_MC1_Msk) && (NULL != tickCallback))
+    {
+        void (*callback)(void *) = tickCallback;
+
+        SwTimerTickStop();
+        callback(NULL);
+    }
+
     if ((status & TC_INTFLAG_OVF_Msk) == TC_INTFLAG_OVF_Msk)
     {
         hwTimerOverflowCallback();
@@ -326,6 +337,25 @@ StackRetStatus_t SwTimerStart(uint8_t timerId, uint32_t timerCount,
     return LORAWAN_SUCCESS;
 }
 
+StackRetStatus_t SwTimerTickStart(uint32_t timerCount, void *timerCb)
+{
+    if ((NULL == timerCb) || (timerCount < SWTIMER_TICK_MIN_TIMEOUT) || (timerCount > SWTIMER_MIN_TIMEOUT))
+        return LORAWAN_INVALID_PARAMETER;
+
+    tickCallback = (void (*)(void *)) timerCb;
+    TC0_Compare32bitMatch1Set(TC0_Compare32bitCounterGet() + timerCount);
+    TC0_REGS->COUNT32.TC_INTFLAG = TC_INTFLAG_MC1_Msk;
+    TC0_REGS->COUNT32.TC_INTENSET = TC_INTENSET_MC1_Msk;
+
+    return LORAWAN_SUCCESS;
+}
+
+void SwTimerTickStop(void)
+{
+    TC0_REGS->COUNT32.TC_INTENCLR = TC_INTENCLR_MC1_Msk;
+    tickCallback = NULL;
+}
+
 StackRetStatus_t SwTimerStop(uint8_t timerId)
 {
     bool flags = cpu_irq_save();
@@ -351,6 +381,8 @@ void SystemTimerSuspend(void)
 {
     bool flags = cpu_irq_save();
     hwTimerDisableCompare();
+    /* The tick timer does not survive the TC0 reinitialization at wakeup */
+    SwTimerTickStop();
     sysTimeLastKnown = SwTimerGetTime();
     SwTimerInterrupt();    
     TC0_CompareStop();
@@ -106,6 +106,11 @@ typedef uint64_t SwTimestamp_t;
 */
 #define SWTIMER_MIN_TIMEOUT          (0x2710)
 
+/*
+* The smallest timeout of the tick timer in microseconds
+*/
+#define SWTIMER_TICK_MIN_TIMEOUT     (0x32)
+
 /*
 * The largest timeout in microseconds
 */
@@ -179,6 +184,27 @@ StackRetStatus_t SwTimerCreate(uint8_t *timerId);
 StackRetStatus_t SwTimerStart(uint8_t timerId, uint32_t timerCount,
   SwTimeoutType_t timeoutType, void *timerCb, void *paramCb);
 
+/**************************************************************************//**
+\brief Starts the tick timer
+
+       The tick timer is a single shot timer running on the second compare
+       channel of the hardware timer, for the timeouts shorter than
+       SWTIMER_MIN_TIMEOUT. The callback is invoked from the timer interrupt
+       with a NULL argument.
+
+\param[in] timerCount Timeout in microseconds, up to SWTIMER_MIN_TIMEOUT
+\param[in] timerCb Callback handler invoked upon timer expiry
+
+\return LORAWAN_INVALID_PARAMETER if at least one input parameter in invalid
+        LORAWAN_SUCCESS if the tick timer is successfully started
+******************************************************************************/
+StackRetStatus_t SwTimerTickStart(uint32_t timerCount, void *timerCb);
+
+/**************************************************************************//**
+\brief Stops the tick timer
+******************************************************************************/
+void SwTimerTickStop(void);
+
 /**************************************************************************//**
 \brief Stops a running timer. It stops a running timer with specified timerId
 \param timer_id Timer identifier
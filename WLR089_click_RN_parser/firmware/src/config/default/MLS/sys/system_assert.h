@@ -81,6 +81,7 @@ typedef void(*SystemAssertCb_t)(SystemAssertLevel_t level, uint16_t assertNum);
 #define ASSERT_MAC_RXCALLBACK_RXSTOPFAIL        (ASSERT_MAC_PAUSE_RXSTOPFAIL+1)
 #define ASSERT_MAC_CLASSCRX2TIMEOUT_STATEFAIL   (ASSERT_MAC_RXCALLBACK_RXSTOPFAIL+1)
 #define ASSERT_MAC_CLASSCJOIN_STATEFAIL			(ASSERT_MAC_CLASSCRX2TIMEOUT_STATEFAIL+1)
+#define ASSERT_MAC_PDSREGCOUNTER_FAIL           (ASSERT_MAC_CLASSCJOIN_STATEFAIL+1)
 /* HAL */
 #define ASSERT_HAL_TIMERID_EXHAUSTED            (ASSERT_HAL|1)
 #define ASSERT_HAL_TIMER_START_FAILURE          (ASSERT_HAL|2)
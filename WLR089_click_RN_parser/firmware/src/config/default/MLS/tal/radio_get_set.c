@@ -46,6 +46,14 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /*  Global variables                                                    */
 /************************************************************************/
 
+/* FRF register values of the channel frequencies, the divisions by 15625 are
+ * done once per channel instead of on every TX and RX */
+static RadioFrfCache_t frfCache[RADIO_FRF_CACHE_SIZE];
+/* The entry replaced by the next frequency not found in the cache */
+static uint8_t frfCacheNext;
+/* The entry of the last frequency prepared */
+static uint8_t frfCacheHit;
+
 /************************************************************************/
 /*  Prototypes															*/
 /************************************************************************/
@@ -485,7 +493,35 @@ void RADIO_Init(void)
 
 void Radio_WriteFrequency(uint32_t frequency)
 {
+	RADIO_PrepareFrequency(frequency);
+	RADIO_RegisterBurstWrite(REG_FRFMSB, frfCache[frfCacheHit].frf, sizeof(frfCache[frfCacheHit].frf));
+}
+
+/*********************************************************************//**
+\brief	This function computes the FRF register value of a channel
+		frequency ahead of time, so that switching to the channel for TX
+		or RX only loads the registers.
+
+\param frequency	- The channel frequency.
+\return				- none.
+*************************************************************************/
+
+void RADIO_PrepareFrequency(uint32_t frequency)
+{
+	RadioFrfCache_t *entry;
 	uint32_t num, num_mod;
+
+	for (uint8_t i = 0; i < RADIO_FRF_CACHE_SIZE; i++) {
+		if (frfCache[i].frequency == frequency) {
+			frfCacheHit = i;
+			return;
+		}
+	}
+
+	frfCacheHit = frfCacheNext;
+	entry = &frfCache[frfCacheNext];
+	frfCacheNext = (frfCacheNext + 1) % RADIO_FRF_CACHE_SIZE;
+
 	// Frf = (Fxosc * num) / 2^19
 	// We take advantage of the fact that 32MHz = 15625Hz * 2^11
 	// This simplifies our formula to Frf = (15625Hz * num) / 2^8
@@ -507,9 +543,10 @@ void Radio_WriteFrequency(uint32_t frequency)
 
 	// Now variable num holds the representation of the frequency that needs to
 	// be loaded into the radio chip
-	RADIO_RegisterWrite(REG_FRFMSB, (num >> SHIFT16) & 0xFF);
-	RADIO_RegisterWrite(REG_FRFMID, (num >> SHIFT8) & 0xFF);
-	RADIO_RegisterWrite(REG_FRFLSB, num & 0xFF);
+	entry->frequency = frequency;
+	entry->frf[0] = (num >> SHIFT16) & 0xFF;
+	entry->frf[1] = (num >> SHIFT8) & 0xFF;
+	entry->frf[2] = num & 0xFF;
 }
 
 /*********************************************************************//**
@@ -642,6 +679,7 @@ static void Radio_WritePower(int8_t power)
 void Radio_WriteConfiguration(uint16_t symbolTimeout)
 {
 	uint32_t tempValue;
+	uint8_t modemConfig[3];
 	uint8_t regValue;
 	uint8_t i;
 
@@ -653,15 +691,15 @@ void Radio_WriteConfiguration(uint16_t symbolTimeout)
 	if (MODULATION_LORA == radioConfiguration.modulation) {
 		RADIO_RegisterWrite(0x39, radioConfiguration.syncWordLoRa);
 
-		RADIO_RegisterWrite(REG_LORA_MODEMCONFIG1,
-			(radioConfiguration.bandWidth << SHIFT4) |
-			(radioConfiguration.errorCodingRate << SHIFT1) |
-			(radioConfiguration.implicitHeaderMode & 0x01));
-
-		RADIO_RegisterWrite(REG_LORA_MODEMCONFIG2,
-			(radioConfiguration.dataRate << SHIFT4) |
-			((radioConfiguration.crcOn & 0x01) << SHIFT2) |
-			((symbolTimeout & 0x0300) >> SHIFT8));
+		// MODEMCONFIG1, MODEMCONFIG2 and SYMBTIMEOUTLSB are consecutive
+		modemConfig[0] = (radioConfiguration.bandWidth << SHIFT4) |
+		                 (radioConfiguration.errorCodingRate << SHIFT1) |
+		                 (radioConfiguration.implicitHeaderMode & 0x01);
+		modemConfig[1] = (radioConfiguration.dataRate << SHIFT4) |
+		                 ((radioConfiguration.crcOn & 0x01) << SHIFT2) |
+		                 ((symbolTimeout & 0x0300) >> SHIFT8);
+		modemConfig[2] = symbolTimeout & 0xFF;
+		RADIO_RegisterBurstWrite(REG_LORA_MODEMCONFIG1, modemConfig, sizeof(modemConfig));
 
 
 		// Handle frequency hopping, if necessary
@@ -690,8 +728,6 @@ void Radio_WriteConfiguration(uint16_t symbolTimeout)
 		}
 		RADIO_RegisterWrite(REG_LORA_HOPPERIOD, (uint8_t) tempValue);
 
-		RADIO_RegisterWrite(REG_LORA_SYMBTIMEOUTLSB, (symbolTimeout & 0xFF));
-
 		// If the symbol time is > 16ms, LowDataRateOptimize needs to be set
 		// This long symbol time only happens for SF12&BW125, SF12&BW250
 		// and SF11&BW125 and the following if statement checks for these
@@ -45,6 +45,22 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 
 #define RADIO_DEFAULT_FREQ DEFAULT_CALIBRATION_FREQ
 
+/* Number of channel frequencies whose FRF register value is kept */
+#ifndef RADIO_FRF_CACHE_SIZE
+#define RADIO_FRF_CACHE_SIZE 16
+#endif
+
+/************************************************************************/
+/*  Types                                                               */
+/************************************************************************/
+
+/* FRF register value of a channel frequency */
+typedef struct _RadioFrfCache
+{
+	uint32_t frequency;
+	uint8_t frf[3];
+} RadioFrfCache_t;
+
 /************************************************************************/
 /*  Global variables                                                    */
 /************************************************************************/
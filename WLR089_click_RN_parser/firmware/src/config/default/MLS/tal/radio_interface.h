@@ -374,6 +374,7 @@ typedef struct _RadioConfiguration_t
     uint8_t timeOnAirTimerId;
     uint8_t fskRxWindowTimerId;
     uint8_t watchdogTimerId;
+    uint8_t clockHoldTimerId;
     uint8_t initialized;
     uint8_t regVersion;
     int8_t packetSNR;
@@ -424,6 +425,26 @@ RadioError_t RADIO_GetAttr(RadioAttribute_t attribute, void *value);
 *************************************************************************/
 RadioError_t RADIO_SetAttr(RadioAttribute_t attribute, void *value);
 
+/*********************************************************************//**
+\brief This function computes the FRF register value of a channel
+		frequency ahead of time, so that switching to the channel for TX
+		or RX only loads the registers.
+
+\param frequency - The channel frequency.
+*************************************************************************/
+void RADIO_PrepareFrequency(uint32_t frequency);
+
+/*********************************************************************//**
+\brief This function registers a SW timer that starts a radio operation
+		when it expires. The TCXO is powered on ahead of the operation so
+		that it starts on time, and is kept on between operations close
+		to each other.
+
+\param timerId	- The SW timer.
+\return			- ERR_OUT_OF_RANGE if no more timer can be registered.
+*************************************************************************/
+RadioError_t RADIO_SetClockUser(uint8_t timerId);
+
 /*********************************************************************//**
 \brief The Radio Init initializes the transceiver
 *************************************************************************/
@@ -643,6 +664,16 @@ uint16_t RADIO_ReadRandom(void);
 *************************************************************************/
 RadioError_t RADIO_GetData(uint8_t **data, uint16_t *dataLen);
 
+/*********************************************************************//**
+\brief	This function reads the number of LoRa frames dropped because no
+		receive buffer was free, or because the radio was reset before
+		they were handed over. It saturates at UINT16_MAX.
+
+\param   - none
+\return  - The number of dropped frames.
+*************************************************************************/
+uint16_t RADIO_GetRxDropCount(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -41,31 +41,58 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 ******************************************************************************/
 #include "system_task_manager.h"
 #include "stdint.h"
+#include "stdbool.h"
 
 /******************************************************************************
                    Defines section
 ******************************************************************************/
+/* Time in us for the radio to go from sleep to FSK RX and settle its RSSI
+ * before the first sample of the scan */
+#ifndef RADIO_LBT_RX_SETUP_TIME
+#define RADIO_LBT_RX_SETUP_TIME		(500U)
+#endif
+
+/******************************************************************************
+                   Types section
+******************************************************************************/
+typedef enum _RadioLBTScanState_t
+{
+	LBT_SCAN_IDLE = 0,
+	LBT_SCAN_RUNNING,
+	LBT_SCAN_CHANNEL_FREE
+} RadioLBTScanState_t;
 
 /******************************************************************************
                    Prototypes section
 ******************************************************************************/
 /*********************************************************************//**
-\brief	This function is triggered by the scan done event and it sets up
-		the radio for scanning.
+\brief	This function sets up the radio for scan and starts the sample
+		timer. The samples are then taken by RADIO_ScanHandler and the
+		transmission is resumed by RADIO_TxHandler once the channel is
+		found free.
 
 \param 	- none
-\return	- returns the success or failure of a task
+\return	- none
 *************************************************************************/
-SYSTEM_TaskStatus_t radioScanDoneHandler(void);
+void Radio_LBTScanStart(void);
 
 /*********************************************************************//**
-\brief	This function is the callback function for LBT scan timer 
-        timeout.
+\brief	This function stops an ongoing scan and puts the radio to sleep.
+		A wait for the oscillator is not stopped, see Radio_ClockWaitStop.
 
-\param time - not used.
-\return     - none
+\param 	- none
+\return	- none
+*************************************************************************/
+void Radio_LBTScanStop(void);
+
+/*********************************************************************//**
+\brief	This function tells whether the last scan found the channel free.
+		The result is consumed, so that the next transmission scans again.
+
+\param 	- none
+\return	- true if the channel is free for the transmission
 *************************************************************************/
-void Radio_LBTScanTimeout(uint8_t time);
+bool Radio_LBTIsChannelFree(void);
 
 /*#endif LBT*/
-#endif /* RADIO_LBT_H_ */
\ No newline at end of file
+#endif /* RADIO_LBT_H_ */
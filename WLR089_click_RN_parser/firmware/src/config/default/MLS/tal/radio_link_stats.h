@@ -0,0 +1,136 @@
+/**
+* \file  radio_link_stats.h
+*
+* \brief This is the Radio link statistics header file which contains the received
+*		frame statistics declarations and defines for SX1276
+*
+*/
+/*******************************************************************************
+Copyright (C) 2020-21 released Microchip Technology Inc. and its subsidiaries. 
+
+Microchip licenses to you the right to use, modify, copy and distribute
+Software only when embedded on a Microchip microcontroller or digital signal
+controller that is integrated into your product or third party product
+(pursuant to the sublicense terms in the accompanying license agreement).
+
+You should refer to the license agreement accompanying this Software for
+additional information regarding your rights and obligations.
+
+SOFTWARE AND DOCUMENTATION ARE PROVIDED AS IS WITHOUT WARRANTY OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION, ANY WARRANTY OF
+MERCHANTABILITY, TITLE, NON-INFRINGEMENT AND FITNESS FOR A PARTICULAR PURPOSE.
+IN NO EVENT SHALL MICROCHIP OR ITS LICENSORS BE LIABLE OR OBLIGATED UNDER
+CONTRACT, NEGLIGENCE, STRICT LIABILITY, CONTRIBUTION, BREACH OF WARRANTY, OR
+OTHER LEGAL EQUITABLE THEORY ANY DIRECT OR INDIRECT DAMAGES OR EXPENSES
+INCLUDING BUT NOT LIMITED TO ANY INCIDENTAL, SPECIAL, INDIRECT, PUNITIVE OR
+CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, COST OF PROCUREMENT OF
+SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
+(INCLUDING BUT NOT LIMITED TO ANY DEFENSE THEREOF), OR OTHER SIMILAR 
+*******************************************************************************/
+
+
+
+
+
+#ifndef RADIO_LINK_STATS_H_
+#define RADIO_LINK_STATS_H_
+
+/******************************************************************************
+                   Includes section
+******************************************************************************/
+#include "radio_interface.h"
+#include "stdint.h"
+#include "stdbool.h"
+
+/******************************************************************************
+                   Defines section
+******************************************************************************/
+/* Number of channels tracked. An entry is tagged with the frequency of its
+ * channel and looked up from the 100 kHz grid slot of the frequency onwards.
+ * Once all the entries are used a new channel takes over the entry of its
+ * slot and restarts its statistics */
+#ifndef RADIO_LINK_STATS_CHANNELS
+#define RADIO_LINK_STATS_CHANNELS		(16u)
+#endif
+
+/* One entry per LoRa spreading factor and bandwidth */
+#define RADIO_LINK_STATS_RATES			((SF_12 - SF_7 + 1) * (BW_500KHZ - BW_125KHZ + 1))
+
+/* SNR histogram: the first bin holds the SNRs below RADIO_LINK_STATS_SNR_MIN,
+ * the next ones are RADIO_LINK_STATS_SNR_STEP dB wide, the last one is open */
+#define RADIO_LINK_STATS_SNR_BINS		(8u)
+#define RADIO_LINK_STATS_SNR_MIN		(-16)
+#define RADIO_LINK_STATS_SNR_STEP		(4)
+/* SNR percentile of statistics without any received frame */
+#define RADIO_LINK_STATS_SNR_NONE		(INT8_MIN)
+
+/* Weight of a new packet RSSI in the average is 1 / (1 << shift) */
+#define RADIO_LINK_STATS_RSSI_SHIFT		(3u)
+
+/******************************************************************************
+                   Types section
+******************************************************************************/
+typedef enum _RadioLinkEvent_t
+{
+	RADIO_LINK_RX_DONE = 0,
+	RADIO_LINK_CRC_ERROR,
+	RADIO_LINK_RX_TIMEOUT
+} RadioLinkEvent_t;
+
+/* The counters saturate at UINT16_MAX */
+typedef struct _RadioLinkStats_t
+{
+	uint16_t rxCount;			// Frames received with a good CRC
+	uint16_t crcErrorCount;		// Frames received with a CRC error
+	uint16_t rxTimeoutCount;	// Receive windows without a frame
+	int16_t rssiAverage;		// Moving average of the packet RSSI in 1/16 dBm
+	uint16_t snrHistogram[RADIO_LINK_STATS_SNR_BINS];
+} RadioLinkStats_t;
+
+/******************************************************************************
+                   Prototypes section
+******************************************************************************/
+/*********************************************************************//**
+\brief	This function accounts a reception event to the statistics of the
+		current channel and of the current spreading factor and bandwidth.
+		For received frames the packet RSSI and SNR shall be updated first.
+
+\param event	- The reception event.
+\return			- none
+*************************************************************************/
+void Radio_LinkStatsUpdate(RadioLinkEvent_t event);
+
+/*********************************************************************//**
+\brief	This function reads the statistics of a channel.
+
+\param index		- The entry, from 0 to RADIO_LINK_STATS_CHANNELS - 1.
+\param frequency	- The frequency of the channel.
+\param stats		- The statistics of the channel.
+\return				- false if the entry is not used.
+*************************************************************************/
+bool RADIO_GetChannelLinkStats(uint8_t index, uint32_t *frequency, RadioLinkStats_t *stats);
+
+/*********************************************************************//**
+\brief	This function reads the statistics of a spreading factor and
+		bandwidth.
+
+\param index	- The entry, from 0 to RADIO_LINK_STATS_RATES - 1.
+\param sf		- The spreading factor.
+\param bw		- The bandwidth.
+\param stats	- The statistics of the spreading factor and bandwidth.
+\return			- false if nothing was received with them.
+*************************************************************************/
+bool RADIO_GetRateLinkStats(uint8_t index, RadioDataRate_t *sf, RadioLoRaBandWidth_t *bw, RadioLinkStats_t *stats);
+
+/*********************************************************************//**
+\brief	This function estimates a percentile of the SNR from the histogram
+		of the statistics, at the resolution of a bin.
+
+\param stats	- The statistics.
+\param percent	- The percentile, from 1 to 100.
+\return			- The lower bound of the bin holding the percentile in dB,
+				  RADIO_LINK_STATS_SNR_NONE if no frame was received.
+*************************************************************************/
+int8_t RADIO_GetLinkStatsSnrPercentile(RadioLinkStats_t *stats, uint8_t percent);
+
+#endif /* RADIO_LINK_STATS_H_ */
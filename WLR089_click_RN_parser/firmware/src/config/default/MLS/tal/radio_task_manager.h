@@ -41,7 +41,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 /******************************************************************************
                    Defines section
 ******************************************************************************/
-#define RADIO_TASKS_COUNT               5u
+#define RADIO_TASKS_COUNT               6u
 
 /******************************************************************************
                                Types section
@@ -64,7 +64,7 @@ extern SYSTEM_TaskStatus_t RADIO_RxHandler(void);
 extern SYSTEM_TaskStatus_t RADIO_TxDoneHandler(void);
 extern SYSTEM_TaskStatus_t RADIO_RxDoneHandler(void);
 extern SYSTEM_TaskStatus_t RADIO_ScanHandler(void);
-/* SYSTEM_TaskStatus_t RADIO_SleepHandler(void); */
+extern SYSTEM_TaskStatus_t RADIO_SleepHandler(void);
 
 /**************************************************************************//**
 \brief Set task for RADIO task manager.
@@ -49,13 +49,37 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #define RADIO_FSK_BUFFER_SPACE		64u
 #define RADIO_BUFFER_SIZE			RADIO_LORA_BUFFER_SPACE
 
+// Received frames are stored after this headroom, the MAC builds the MIC
+// block in place in front of the frame and FSK reads the length byte into it
+#define RADIO_RX_HEADROOM			(16u)
+
+// Number of received frames that can wait for the MAC. In continuous
+// reception the radio is re-armed as long as one of them is free.
+#ifndef RADIO_RX_QUEUE_SIZE
+#define RADIO_RX_QUEUE_SIZE			(2u)
+#endif
+
+// The TCXO is kept on after a radio operation if the next radio use, the
+// expiry of a timer given to RADIO_SetClockUser such as a receive window or
+// a retransmission of the MAC, comes within this time in us. Otherwise it is
+// powered off and powered on again clockStabilizationDelay before that use.
+#ifndef RADIO_CLOCK_HOLD_THRESHOLD
+#define RADIO_CLOCK_HOLD_THRESHOLD	(50000u)
+#endif
+
+// Number of SW timers that can be given to RADIO_SetClockUser
+#ifndef RADIO_CLOCK_USERS
+#define RADIO_CLOCK_USERS			(8u)
+#endif
+
 #define RADIO_RFCTRL_RX				(0u)
 #define RADIO_RFCTRL_TX             (1u)
 
-// FIFO Rx FIFO Threshold set to these number of bytes
-#define RADIO_RX_FIFO_LEVEL			(63u)
-// FIFO Tx FIFO Threshold set to these number of bytes
-#define RADIO_TX_FIFO_LEVEL			(32u)
+// FIFO Rx FIFO Threshold set to these number of bytes, half of the 64 byte
+// FIFO so that the other half absorbs the interrupt latency
+#define RADIO_RX_FIFO_LEVEL			(32u)
+// Bytes written on each FifoEmpty interrupt, the whole FIFO
+#define RADIO_TX_FIFO_LEVEL			(64u)
 
 #define NON_BLOCKING_REQ			0
 #define BLOCKING_REQ				1
@@ -82,6 +106,36 @@ typedef struct _RadioEvents_t
 	uint16_t reserved : 6;
 } RadioEvents_t;
 
+/*********************************************************************//**
+\brief	A received frame waiting for the MAC
+*************************************************************************/
+typedef struct _RadioRxFrame_t
+{
+    uint8_t buffer[RADIO_BUFFER_SIZE];
+    uint8_t length;
+    uint8_t snrValue;
+    uint8_t rssiValue;
+    bool crcError;
+} RadioRxFrame_t;
+
+/*********************************************************************//**
+\brief	The settings a continuous LoRa reception was started with
+*************************************************************************/
+typedef struct _RadioRxSettings_t
+{
+    uint32_t frequency;
+    uint16_t preambleLen;
+    uint16_t frequencyHopPeriod;
+    uint8_t syncWordLoRa;
+    uint8_t crcOn;
+    uint8_t iqInverted;
+    uint8_t implicitHeaderMode;
+    RadioErrorCodingRate_t errorCodingRate;
+    RadioModulation_t modulation;
+    RadioDataRate_t dataRate;
+    RadioLoRaBandWidth_t bandWidth;
+} RadioRxSettings_t;
+
 /*********************************************************************//**
 \brief	Possible callback events registration
 *************************************************************************/
@@ -128,6 +182,15 @@ void Radio_RxFSKTimeout(uint8_t time);
 *************************************************************************/
 void RadioSetState(RadioState_t state);
 
+/*********************************************************************//**
+\brief	This function tells whether the receiver may be stopped or
+		restarted by a new request although the state is RX: it listens
+		continuously, or it was stopped by a frame not handed over yet.
+
+\return	- true if the receiver may be stopped or restarted.
+*************************************************************************/
+bool Radio_RxPreemptible(void);
+
 /*********************************************************************//**
 \brief This function is to Set RF front End Control.
 
@@ -150,7 +213,9 @@ void Radio_DisableRfControl(bool type);
 void Radio_SetClockInput(void);
 
 /*********************************************************************//**
-\brief	This function power off/Resets the clock source of Radio
+\brief	This function releases the clock source of Radio. Whether a TCXO
+		is powered off is decided by the RADIO_SleepHandler, from the next
+		radio use.
 
 \param   - None
 \return  - None.
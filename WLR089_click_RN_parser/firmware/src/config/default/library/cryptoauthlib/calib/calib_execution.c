@@ -552,3 +552,127 @@ ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device)
 
     return status;
 }
+
+/** \brief Wakes up device and sends the packet without waiting for the
+ *         command to complete. The response is collected later with
+ *         calib_execute_command_poll(), which lets the caller yield instead
+ *         of blocking for the execution time.
+ *
+ * \param[in] packet  The packet to be sent.
+ * \param[in] device  CryptoAuthentication device to send the command to.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS calib_execute_command_start(ATCAPacket* packet, ATCADevice device)
+{
+    ATCA_STATUS status = ATCA_COMM_FAIL;
+    uint8_t device_address = atcab_get_device_address(device);
+    int retries = atca_iface_get_retries(&device->mIface);
+
+    do
+    {
+        if (ATCA_DEVICE_STATE_ACTIVE != device->device_state)
+        {
+            if (ATCA_SUCCESS == (status = calib_wakeup(device)))
+            {
+                device->device_state = ATCA_DEVICE_STATE_ACTIVE;
+            }
+        }
+
+        /* Send the command packet to the device */
+        if (ATCA_I2C_IFACE == device->mIface.mIfaceCFG->iface_type)
+        {
+            packet->_reserved = 0x03;
+        }
+        else if (ATCA_SWI_IFACE == device->mIface.mIfaceCFG->iface_type)
+        {
+            packet->_reserved = CALIB_SWI_FLAG_CMD;
+        }
+        if (ATCA_RX_NO_RESPONSE == (status = calib_execute_send(device, device_address, (uint8_t*)packet, packet->txsize + 1)))
+        {
+            device->device_state = ATCA_DEVICE_STATE_UNKNOWN;
+        }
+        else
+        {
+            if (ATCA_DEVICE_STATE_ACTIVE != device->device_state)
+            {
+                device->device_state = ATCA_DEVICE_STATE_ACTIVE;
+            }
+            retries = 0;
+        }
+    }
+    while (0 < retries--);
+
+    if (ATCA_SUCCESS != status)
+    {
+        calib_execute_command_abort(device);
+    }
+
+    return status;
+}
+
+/** \brief Tries once to receive the response of a command issued with
+ *         calib_execute_command_start().
+ *
+ * If the device did not answer yet ATCA_RX_NO_RESPONSE is returned and the
+ * device is left active, so the caller may poll again later. Otherwise the
+ * response is checked and the device is put into the idle state.
+ *
+ * \param[out] packet  The data buffer of the packet will contain the response.
+ * \param[in]  device  CryptoAuthentication device the command was sent to.
+ *
+ * \return ATCA_SUCCESS on success, otherwise an error code.
+ */
+ATCA_STATUS calib_execute_command_poll(ATCAPacket* packet, ATCADevice device)
+{
+    ATCA_STATUS status;
+    uint16_t rxsize;
+    uint8_t device_address = atcab_get_device_address(device);
+
+    memset(packet->data, 0, sizeof(packet->data));
+    rxsize = sizeof(packet->data);
+
+    status = calib_execute_receive(device, device_address, packet->data, &rxsize);
+    if ((ATCA_SUCCESS != status) || (0 == rxsize))
+    {
+        // Still executing, the device is left awake for the next poll
+        return ATCA_RX_NO_RESPONSE;
+    }
+
+    do
+    {
+        // Check response size
+        if (rxsize < 4)
+        {
+            status = ATCA_RX_FAIL;
+            break;
+        }
+
+        if ((status = atCheckCrc(packet->data)) != ATCA_SUCCESS)
+        {
+            break;
+        }
+
+        status = isATCAError(packet->data);
+    }
+    while (0);
+
+    calib_execute_command_abort(device);
+
+    return status;
+}
+
+/** \brief Puts the device into the idle state after a command issued with
+ *         calib_execute_command_start() was given up.
+ *
+ * \param[in] device  CryptoAuthentication device the command was sent to.
+ */
+void calib_execute_command_abort(ATCADevice device)
+{
+    // Skip Idle for ECC204 device
+    if (ECC204 != device->mIface.mIfaceCFG->devtype)
+    {
+        (void)calib_idle(device);
+        device->device_state = ATCA_DEVICE_STATE_IDLE;
+    }
+}
@@ -71,6 +71,9 @@ ATCA_STATUS calib_execute_receive(ATCADevice device, uint8_t device_address, uin
 #endif
 
 ATCA_STATUS calib_execute_command(ATCAPacket* packet, ATCADevice device);
+ATCA_STATUS calib_execute_command_start(ATCAPacket* packet, ATCADevice device);
+ATCA_STATUS calib_execute_command_poll(ATCAPacket* packet, ATCADevice device);
+void calib_execute_command_abort(ATCADevice device);
 
 #ifdef __cplusplus
 }
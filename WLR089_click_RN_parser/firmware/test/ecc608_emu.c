@@ -0,0 +1,688 @@
+/**
+* \file  ecc608_emu.c
+*
+* \brief ATECC608 emulator of the host tests. hal_i2c_harmony.c drives it
+*        through sercom1_plib_i2c_api: a transfer completes as it starts,
+*        the bus time is added to the time of radio_emu.c and is_busy()
+*        never holds. The device follows the I2C protocol of the data sheet:
+*        a general call wakes it and the wake status is read, the word
+*        address 0x03 carries a command, 0x00 resets the response address,
+*        0x01 puts it asleep, losing TempKey, and 0x02 idle, keeping it.
+*        Transfers to the device are not acknowledged while it is asleep or
+*        idle and while a command executes.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "ecc608_emu.h"
+#include "radio_emu.h"
+#include "cryptoauthlib.h"
+#include "crypto/hashes/sha2_routines.h"
+
+/* I2C address of ATECC608_0.c, as the plib takes it */
+#define ECC_ADDRESS             (0x59U)
+#define ECC_GENERAL_CALL        (0x00U)
+
+#define ECC_WORD_RESET          (0x00U)
+#define ECC_WORD_SLEEP          (0x01U)
+#define ECC_WORD_IDLE           (0x02U)
+#define ECC_WORD_COMMAND        (0x03U)
+
+#define ECC_OP_READ             (0x02U)
+#define ECC_OP_WRITE            (0x12U)
+#define ECC_OP_GENDIG           (0x15U)
+#define ECC_OP_NONCE            (0x16U)
+#define ECC_OP_RANDOM           (0x1BU)
+#define ECC_OP_AES              (0x51U)
+#define ECC_OP_KDF              (0x56U)
+
+#define ECC_STATUS_SUCCESS      (0x00U)
+#define ECC_STATUS_PARSE        (0x03U)
+#define ECC_STATUS_EXECUTION    (0x0FU)
+#define ECC_STATUS_WAKE         (0x11U)
+#define ECC_STATUS_CRC          (0xFFU)
+
+#define ECC_ZONE_CONFIG         (0x00U)
+#define ECC_ZONE_DATA           (0x02U)
+#define ECC_ZONE_32             (0x80U)
+
+/* Slots of conf_sal.h read encrypted: APPS, NWKS, MCAST_APPS, MCAST_NWKS */
+#define ECC_ENCRYPT_READ_SLOTS  ((1U << 2) | (1U << 3) | (1U << 11) | (1U << 12))
+
+/* Count, opcode, param1, param2, 128 bytes of data and the CRC */
+#define ECC_COMMAND_MAX         (1U + 1U + 1U + 2U + 128U + 2U)
+#define ECC_RESPONSE_MAX        (1U + 32U + 2U)
+
+#define AES_BLOCK               (16U)
+#define AES_ROUNDS              (10U)
+
+/* The MCU side of SERCOM1 */
+static bool plibRead(uint16_t address, uint8_t *data, uint32_t length);
+static bool plibWrite(uint16_t address, uint8_t *data, uint32_t length);
+static bool plibIsBusy(void);
+static SERCOM_I2C_ERROR plibErrorGet(void);
+static bool plibTransferSetup(SERCOM_I2C_TRANSFER_SETUP *setup, uint32_t srcClkFreq);
+
+atca_plib_i2c_api_t sercom1_plib_i2c_api =
+{
+    .read = plibRead,
+    .write = plibWrite,
+    .is_busy = plibIsBusy,
+    .error_get = plibErrorGet,
+    .transfer_setup = plibTransferSetup
+};
+
+typedef enum _EccState
+{
+    ECC_ASLEEP = 0,
+    ECC_IDLE,
+    ECC_AWAKE
+} EccState_t;
+
+static EccEmuStats_t stats;
+static SERCOM_I2C_ERROR lastError;
+
+static EccState_t state;
+static uint8_t config[128];
+static uint8_t slots[ECC_EMU_SLOTS][ECC_EMU_SLOT_SIZE];
+static uint8_t tempKey[32];
+static bool tempKeyValid;
+/* TempKey was last generated by GenDig, an encrypted read may use it */
+static bool tempKeyGenDig;
+static uint32_t rng;
+
+/* Response, and the time it is ready at */
+static uint8_t response[ECC_RESPONSE_MAX];
+static uint8_t responseLength;
+static uint8_t responseIndex;
+static uint64_t readyTime;
+
+static const uint8_t serialNumber[ECC_EMU_SN_SIZE] = {0x01, 0x23, 0x6A, 0x5B, 0x9C, 0x4E, 0x12, 0x7D, 0xEE};
+
+/* AES-128, the S-box computed from its definition */
+static uint8_t sbox[256];
+static uint8_t invSbox[256];
+
+static uint8_t gmul(uint8_t a, uint8_t b)
+{
+    uint8_t product = 0;
+
+    while (b)
+    {
+        if (b & 1)
+        {
+            product ^= a;
+        }
+        a = (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1B : 0x00));
+        b >>= 1;
+    }
+    return product;
+}
+
+static void aesInit(void)
+{
+    for (unsigned x = 0; x < 256; x++)
+    {
+        uint8_t inverse = 0;
+        uint8_t s;
+
+        for (unsigned y = 1; (x != 0) && (y < 256); y++)
+        {
+            if (1 == gmul((uint8_t)x, (uint8_t)y))
+            {
+                inverse = (uint8_t)y;
+                break;
+            }
+        }
+        s = inverse;
+        for (unsigned shift = 1; shift <= 4; shift++)
+        {
+            s ^= (uint8_t)((inverse << shift) | (inverse >> (8 - shift)));
+        }
+        s ^= 0x63;
+        sbox[x] = s;
+        invSbox[s] = (uint8_t)x;
+    }
+}
+
+static void aesExpandKey(const uint8_t *key, uint8_t *roundKeys)
+{
+    uint8_t rcon = 1;
+
+    memcpy(roundKeys, key, AES_BLOCK);
+    for (unsigned i = AES_BLOCK; i < (AES_BLOCK * (AES_ROUNDS + 1)); i += 4)
+    {
+        uint8_t word[4];
+
+        memcpy(word, &roundKeys[i - 4], 4);
+        if (0 == (i % AES_BLOCK))
+        {
+            uint8_t first = word[0];
+
+            word[0] = sbox[word[1]] ^ rcon;
+            word[1] = sbox[word[2]];
+            word[2] = sbox[word[3]];
+            word[3] = sbox[first];
+            rcon = gmul(rcon, 2);
+        }
+        for (unsigned j = 0; j < 4; j++)
+        {
+            roundKeys[i + j] = roundKeys[i - AES_BLOCK + j] ^ word[j];
+        }
+    }
+}
+
+static void aesAddRoundKey(uint8_t *block, const uint8_t *roundKey)
+{
+    for (unsigned i = 0; i < AES_BLOCK; i++)
+    {
+        block[i] ^= roundKey[i];
+    }
+}
+
+/* Row r of the column major state moves left by r columns, right when inverse */
+static void aesSubShift(uint8_t *block, const uint8_t *box, bool inverse)
+{
+    uint8_t state[AES_BLOCK];
+
+    memcpy(state, block, AES_BLOCK);
+    for (unsigned c = 0; c < 4; c++)
+    {
+        for (unsigned r = 0; r < 4; r++)
+        {
+            unsigned from = inverse ? ((c + 4 - r) % 4) : ((c + r) % 4);
+
+            block[(c * 4) + r] = box[state[(from * 4) + r]];
+        }
+    }
+}
+
+static void aesMixColumns(uint8_t *block, const uint8_t *coefficients)
+{
+    for (unsigned c = 0; c < 4; c++)
+    {
+        uint8_t column[4];
+
+        memcpy(column, &block[c * 4], 4);
+        for (unsigned r = 0; r < 4; r++)
+        {
+            block[(c * 4) + r] = gmul(column[0], coefficients[(4 - r) % 4]) ^ gmul(column[1], coefficients[(5 - r) % 4])
+                ^ gmul(column[2], coefficients[(6 - r) % 4]) ^ gmul(column[3], coefficients[(7 - r) % 4]);
+        }
+    }
+}
+
+void eccEmuAesEncrypt(const uint8_t *key, uint8_t *block)
+{
+    static const uint8_t mix[4] = {2, 3, 1, 1};
+    uint8_t roundKeys[AES_BLOCK * (AES_ROUNDS + 1)];
+
+    aesExpandKey(key, roundKeys);
+    aesAddRoundKey(block, roundKeys);
+    for (unsigned round = 1; round <= AES_ROUNDS; round++)
+    {
+        aesSubShift(block, sbox, false);
+        if (round != AES_ROUNDS)
+        {
+            aesMixColumns(block, mix);
+        }
+        aesAddRoundKey(block, &roundKeys[round * AES_BLOCK]);
+    }
+}
+
+void eccEmuAesDecrypt(const uint8_t *key, uint8_t *block)
+{
+    static const uint8_t invMix[4] = {14, 11, 13, 9};
+    uint8_t roundKeys[AES_BLOCK * (AES_ROUNDS + 1)];
+
+    aesExpandKey(key, roundKeys);
+    aesAddRoundKey(block, &roundKeys[AES_ROUNDS * AES_BLOCK]);
+    for (unsigned round = AES_ROUNDS; round > 0; round--)
+    {
+        aesSubShift(block, invSbox, true);
+        aesAddRoundKey(block, &roundKeys[(round - 1) * AES_BLOCK]);
+        if (round != 1)
+        {
+            aesMixColumns(block, invMix);
+        }
+    }
+}
+
+/* CRC-16 of the packets, polynomial 0x8005 fed LSB first */
+static uint16_t eccCrc(const uint8_t *data, uint8_t length)
+{
+    uint16_t crc = 0;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        for (uint8_t shift = 0x01; shift != 0x00; shift <<= 1)
+        {
+            uint8_t dataBit = (data[i] & shift) ? 1 : 0;
+            uint8_t crcBit = (uint8_t)(crc >> 15);
+
+            crc <<= 1;
+            if (dataBit != crcBit)
+            {
+                crc ^= 0x8005;
+            }
+        }
+    }
+    return crc;
+}
+
+static void respond(const uint8_t *data, uint8_t length, uint32_t executionMs)
+{
+    uint16_t crc;
+
+    response[0] = length + 3;
+    memcpy(&response[1], data, length);
+    crc = eccCrc(response, length + 1);
+    response[length + 1] = (uint8_t)crc;
+    response[length + 2] = (uint8_t)(crc >> 8);
+    responseLength = length + 3;
+    responseIndex = 0;
+    readyTime = radioEmuTime() + ((uint64_t)executionMs * 1000U);
+}
+
+static void respondStatus(uint8_t status, uint32_t executionMs)
+{
+    respond(&status, 1, executionMs);
+}
+
+static uint8_t nextRandom(void)
+{
+    /* xorshift32 */
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (uint8_t)rng;
+}
+
+static void commandAes(uint8_t mode, uint16_t keyId, const uint8_t *data, uint8_t dataLength)
+{
+    uint8_t block[AES_BLOCK];
+    uint8_t keyBlock = mode >> 6;
+
+    if ((AES_BLOCK != dataLength) || (keyId >= ECC_EMU_SLOTS) || ((mode & 0x03) > 1))
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    memcpy(block, data, AES_BLOCK);
+    if (mode & 0x01)
+    {
+        eccEmuAesDecrypt(&slots[keyId][keyBlock * AES_BLOCK], block);
+    }
+    else
+    {
+        eccEmuAesEncrypt(&slots[keyId][keyBlock * AES_BLOCK], block);
+    }
+    respond(block, AES_BLOCK, 27);
+}
+
+/* AES algorithm from a slot to a slot, the only mode the SAL uses */
+static void commandKdf(uint8_t mode, uint16_t keyId, const uint8_t *data, uint8_t dataLength)
+{
+    uint8_t source = (uint8_t)keyId;
+    uint8_t target = (uint8_t)(keyId >> 8);
+    uint8_t block[AES_BLOCK];
+
+    if ((0x2A != mode) || (20 != dataLength) || (source >= ECC_EMU_SLOTS) || (target >= ECC_EMU_SLOTS))
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    /* Details: key location within the source slot */
+    memcpy(block, &data[4], AES_BLOCK);
+    eccEmuAesEncrypt(&slots[source][(data[0] & 0x03) * AES_BLOCK], block);
+    memset(slots[target], 0, 32);
+    memcpy(slots[target], block, AES_BLOCK);
+    respondStatus(ECC_STATUS_SUCCESS, 165);
+}
+
+static void commandRandom(void)
+{
+    uint8_t data[32];
+
+    for (unsigned i = 0; i < sizeof(data); i++)
+    {
+        data[i] = nextRandom();
+    }
+    respond(data, sizeof(data), 23);
+}
+
+static void commandWrite(uint8_t zone, uint16_t address, const uint8_t *data, uint8_t dataLength)
+{
+    uint8_t slot = (address >> 3) & 0x0F;
+    uint8_t block = (uint8_t)(address >> 8);
+
+    if ((ECC_ZONE_DATA | ECC_ZONE_32) != zone)
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    if ((32 != dataLength) || ((block * 32U) + 32U > ECC_EMU_SLOT_SIZE))
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    memcpy(&slots[slot][block * 32U], data, 32);
+    respondStatus(ECC_STATUS_SUCCESS, 45);
+}
+
+static void commandRead(uint8_t zone, uint16_t address)
+{
+    uint8_t length = (zone & ECC_ZONE_32) ? 32 : 4;
+    uint8_t offset = (address & 0x07) * 4U;
+    uint8_t data[32];
+
+    if (ECC_ZONE_CONFIG == (zone & 0x03))
+    {
+        unsigned start = (((address >> 3) & 0x03) * 32U) + offset;
+
+        memcpy(data, &config[start], length);
+    }
+    else if (ECC_ZONE_DATA == (zone & 0x03))
+    {
+        uint8_t slot = (address >> 3) & 0x0F;
+        unsigned start = ((address >> 8) * 32U) + offset;
+
+        if ((start + length) > ECC_EMU_SLOT_SIZE)
+        {
+            respondStatus(ECC_STATUS_PARSE, 0);
+            return;
+        }
+        memcpy(data, &slots[slot][start], length);
+        if (ECC_ENCRYPT_READ_SLOTS & (1U << slot))
+        {
+            /* 32 bytes encrypted with the TempKey of a GenDig */
+            if ((32 != length) || !tempKeyValid || !tempKeyGenDig)
+            {
+                respondStatus(ECC_STATUS_EXECUTION, 5);
+                return;
+            }
+            for (unsigned i = 0; i < 32; i++)
+            {
+                data[i] ^= tempKey[i];
+            }
+        }
+    }
+    else
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    respond(data, length, 5);
+}
+
+/* Seed update mode, TempKey from the random number and NumIn */
+static void commandNonce(uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t dataLength)
+{
+    uint8_t message[32 + 20 + 3];
+    uint8_t randOut[32];
+
+    if ((0x00 != mode) || (20 != dataLength))
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    for (unsigned i = 0; i < sizeof(randOut); i++)
+    {
+        randOut[i] = nextRandom();
+    }
+    memcpy(message, randOut, 32);
+    memcpy(&message[32], data, 20);
+    message[52] = ECC_OP_NONCE;
+    message[53] = mode;
+    message[54] = (uint8_t)param2;
+    sw_sha256(message, sizeof(message), tempKey);
+    tempKeyValid = true;
+    tempKeyGenDig = false;
+    respond(randOut, sizeof(randOut), 20);
+}
+
+/* Data zone, TempKey from the key in the slot and the TempKey of a Nonce */
+static void commandGenDig(uint8_t zone, uint16_t keyId, const uint8_t *data, uint8_t dataLength)
+{
+    uint8_t message[32 + 4 + 1 + 2 + 25 + 32];
+
+    if ((ECC_ZONE_DATA != zone) || (keyId >= ECC_EMU_SLOTS) || ((0 != dataLength) && (4 != dataLength)))
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    if (!tempKeyValid)
+    {
+        respondStatus(ECC_STATUS_EXECUTION, 25);
+        return;
+    }
+    memset(message, 0, sizeof(message));
+    memcpy(message, slots[keyId], 32);
+    if (4 == dataLength)
+    {
+        memcpy(&message[32], data, 4);
+    }
+    else
+    {
+        message[32] = ECC_OP_GENDIG;
+        message[33] = zone;
+        message[34] = (uint8_t)keyId;
+        message[35] = (uint8_t)(keyId >> 8);
+    }
+    message[36] = serialNumber[8];
+    message[37] = serialNumber[0];
+    message[38] = serialNumber[1];
+    memcpy(&message[64], tempKey, 32);
+    sw_sha256(message, sizeof(message), tempKey);
+    tempKeyGenDig = true;
+    respondStatus(ECC_STATUS_SUCCESS, 25);
+}
+
+static void command(const uint8_t *packet, uint32_t length)
+{
+    uint16_t crc;
+    uint16_t param2;
+    uint8_t dataLength;
+
+    if ((length < 7) || (packet[0] != length) || (length > ECC_COMMAND_MAX))
+    {
+        respondStatus(ECC_STATUS_PARSE, 0);
+        return;
+    }
+    crc = eccCrc(packet, (uint8_t)(length - 2));
+    if ((packet[length - 2] != (uint8_t)crc) || (packet[length - 1] != (uint8_t)(crc >> 8)))
+    {
+        respondStatus(ECC_STATUS_CRC, 0);
+        return;
+    }
+
+    stats.commands++;
+    param2 = (uint16_t)(packet[3] | (packet[4] << 8));
+    dataLength = (uint8_t)(length - 7);
+    switch (packet[1])
+    {
+    case ECC_OP_AES:
+        commandAes(packet[2], param2, &packet[5], dataLength);
+        break;
+    case ECC_OP_KDF:
+        commandKdf(packet[2], param2, &packet[5], dataLength);
+        break;
+    case ECC_OP_RANDOM:
+        commandRandom();
+        break;
+    case ECC_OP_WRITE:
+        commandWrite(packet[2], param2, &packet[5], dataLength);
+        break;
+    case ECC_OP_READ:
+        commandRead(packet[2], param2);
+        break;
+    case ECC_OP_NONCE:
+        commandNonce(packet[2], param2, &packet[5], dataLength);
+        break;
+    case ECC_OP_GENDIG:
+        commandGenDig(packet[2], param2, &packet[5], dataLength);
+        break;
+    default:
+        respondStatus(ECC_STATUS_PARSE, 0);
+        break;
+    }
+}
+
+static bool deviceAcknowledges(uint16_t address)
+{
+    return (ECC_ADDRESS == address) && (ECC_AWAKE == state) && (radioEmuTime() >= readyTime);
+}
+
+static void busTime(uint32_t length)
+{
+    stats.transfers++;
+    stats.bytes += length + 1;
+    radioEmuElapse((length + 1) * ECC_EMU_BYTE_US);
+}
+
+static bool plibWrite(uint16_t address, uint8_t *data, uint32_t length)
+{
+    busTime(length);
+    lastError = SERCOM_I2C_ERROR_NAK;
+
+    if (ECC_GENERAL_CALL == address)
+    {
+        /* SDA held low long enough, the wake status can be read once
+         * tWHI is over */
+        if (ECC_AWAKE != state)
+        {
+            static const uint8_t wakeStatus = ECC_STATUS_WAKE;
+
+            stats.wakes++;
+            if (ECC_ASLEEP == state)
+            {
+                tempKeyValid = false;
+            }
+            state = ECC_AWAKE;
+            respond(&wakeStatus, 1, 0);
+        }
+        stats.nacks++;
+        return true;
+    }
+    if (!deviceAcknowledges(address) || (0 == length))
+    {
+        stats.nacks++;
+        return true;
+    }
+
+    lastError = SERCOM_I2C_ERROR_NONE;
+    switch (data[0])
+    {
+    case ECC_WORD_RESET:
+        responseIndex = 0;
+        break;
+    case ECC_WORD_SLEEP:
+        state = ECC_ASLEEP;
+        tempKeyValid = false;
+        break;
+    case ECC_WORD_IDLE:
+        state = ECC_IDLE;
+        break;
+    case ECC_WORD_COMMAND:
+        command(&data[1], length - 1);
+        break;
+    default:
+        lastError = SERCOM_I2C_ERROR_NAK;
+        stats.nacks++;
+        break;
+    }
+    return true;
+}
+
+static bool plibRead(uint16_t address, uint8_t *data, uint32_t length)
+{
+    busTime(length);
+    if (!deviceAcknowledges(address))
+    {
+        lastError = SERCOM_I2C_ERROR_NAK;
+        stats.nacks++;
+        return true;
+    }
+
+    lastError = SERCOM_I2C_ERROR_NONE;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        data[i] = (responseIndex < responseLength) ? response[responseIndex++] : 0xFF;
+    }
+    return true;
+}
+
+static bool plibIsBusy(void)
+{
+    return false;
+}
+
+static SERCOM_I2C_ERROR plibErrorGet(void)
+{
+    return lastError;
+}
+
+static bool plibTransferSetup(SERCOM_I2C_TRANSFER_SETUP *setup, uint32_t srcClkFreq)
+{
+    (void)setup;
+    (void)srcClkFreq;
+    return true;
+}
+
+void hal_delay_ms(uint32_t delay)
+{
+    stats.delayMsUs += (uint64_t)delay * 1000U;
+    radioEmuElapse(delay * 1000U);
+}
+
+void hal_delay_us(uint32_t delay)
+{
+    stats.delayUs += delay;
+    radioEmuElapse(delay);
+}
+
+void eccEmuInit(void)
+{
+    if (0 == sbox[0])
+    {
+        aesInit();
+    }
+    memset(config, 0, sizeof(config));
+    memcpy(config, serialNumber, 4);
+    memcpy(&config[8], &serialNumber[4], 5);
+    memset(slots, 0, sizeof(slots));
+    memset(tempKey, 0, sizeof(tempKey));
+    tempKeyValid = false;
+    tempKeyGenDig = false;
+    responseLength = 0;
+    responseIndex = 0;
+    readyTime = 0;
+    lastError = SERCOM_I2C_ERROR_NONE;
+    state = ECC_ASLEEP;
+    rng = 0x6D2B79F5UL;
+    eccEmuResetStats();
+}
+
+const EccEmuStats_t *eccEmuStats(void)
+{
+    return &stats;
+}
+
+void eccEmuResetStats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void eccEmuSetSlot(uint8_t slot, uint8_t offset, const uint8_t *data, uint8_t length)
+{
+    memcpy(&slots[slot][offset], data, length);
+}
+
+const uint8_t *eccEmuSlot(uint8_t slot)
+{
+    return slots[slot];
+}
+
+const uint8_t *eccEmuSerialNumber(void)
+{
+    return serialNumber;
+}
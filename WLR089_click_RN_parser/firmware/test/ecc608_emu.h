@@ -0,0 +1,60 @@
+/**
+* \file  ecc608_emu.h
+*
+* \brief ATECC608 emulator of the host tests, behind the SERCOM1 I2C
+*        interface hal_i2c_harmony.c drives. It answers the wake, sleep
+*        and idle sequences and the commands the SAL issues: AES, KDF,
+*        Random, Write, Read, Nonce and GenDig, the reads of the session
+*        key slots encrypted with TempKey. A command executes for the time
+*        of the data sheet, polls in the meantime are not acknowledged.
+*        Time is the one of radio_emu.c: the I2C clocks a byte every
+*        ECC_EMU_BYTE_US and the delay functions of cryptoauthlib move it
+*        on.
+*/
+#ifndef ECC608_EMU_H
+#define ECC608_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A byte and its acknowledge at the 100 kHz of ATECC608_0.c */
+#define ECC_EMU_BYTE_US         (90U)
+
+#define ECC_EMU_SLOTS           (16U)
+/* Slot 8 is larger, the SAL does not use it */
+#define ECC_EMU_SLOT_SIZE       (72U)
+#define ECC_EMU_SN_SIZE         (9U)
+
+typedef struct _EccEmuStats
+{
+    /* Transfers of the plib, those the device did not acknowledge, and
+     * bytes on the bus, address bytes included */
+    uint32_t transfers;
+    uint32_t nacks;
+    uint32_t bytes;
+    uint32_t wakes;
+    /* Commands received with a valid CRC */
+    uint32_t commands;
+    /* Time spent in hal_delay_ms, where the synchronous functions of
+     * cryptoauthlib wait for the execution, and in hal_delay_us */
+    uint64_t delayMsUs;
+    uint64_t delayUs;
+} EccEmuStats_t;
+
+/* Clears the slots and the stats, the device is asleep */
+void eccEmuInit(void);
+
+const EccEmuStats_t *eccEmuStats(void);
+void eccEmuResetStats(void);
+
+/* Slot contents, the session keys in the first 16 bytes */
+void eccEmuSetSlot(uint8_t slot, uint8_t offset, const uint8_t *data, uint8_t length);
+const uint8_t *eccEmuSlot(uint8_t slot);
+/* SN[0:8] of the configuration zone */
+const uint8_t *eccEmuSerialNumber(void);
+
+/* AES-128 of the emulator, also used by the tests to play the network */
+void eccEmuAesEncrypt(const uint8_t *key, uint8_t *block);
+void eccEmuAesDecrypt(const uint8_t *key, uint8_t *block);
+
+#endif /* ECC608_EMU_H */
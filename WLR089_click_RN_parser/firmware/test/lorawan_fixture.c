@@ -0,0 +1,490 @@
+/**
+* \file  lorawan_fixture.c
+*
+* \brief The whole MAC of the host tests, and the network side of its join.
+*/
+#include <string.h>
+#include "lorawan_fixture.h"
+#include "radio_emu.h"
+#include "ecc608_emu.h"
+#include "radio_driver_hal.h"
+#include "conf_sal.h"
+#include "sal.h"
+#include "pds_interface.h"
+#include "pmm.h"
+#include "sleep.h"
+#include "sleep_timer.h"
+#include "system_task_manager.h"
+#include "lorawan_private.h"
+
+#define MHDR_JOIN_REQUEST       (0x00U)
+#define MHDR_JOIN_ACCEPT        (0x20U)
+#define MHDR_UNCONFIRMED_UP     (0x40U)
+#define MHDR_UNCONFIRMED_DOWN   (0x60U)
+#define DIR_UP                  (0U)
+#define DIR_DOWN                (1U)
+/* MHDR, DevAddr, FCtrl and FCnt of a data frame */
+#define FHDR_SIZE               (1U + 4U + 1U + 2U)
+#define MIC_SIZE                (4U)
+/* DLSettings and RxDelay of the join accepts, RX1 1 s after the uplink */
+#define JOIN_DL_SETTINGS        (0x00U)
+#define JOIN_RX_DELAY           (0x01U)
+#define STEP_US                 (100U)
+#define JOIN_REQUEST_LIMIT_US   (10000000U)
+/* RX1 of the join accept and RX2 of the uplinks, from the transmission */
+#define WINDOW_LIMIT_US         (6000000U)
+#define TRANSACTION_LIMIT_US    (5000000U)
+#define OPMODE_MODE             (0x07U)
+#define OPMODE_TX               (0x03U)
+#define OPMODE_RXCONTINUOUS     (0x05U)
+#define OPMODE_RXSINGLE         (0x06U)
+
+const uint8_t lorawanFixtureAppKey[FIXTURE_KEY_SIZE] =
+{
+    0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C
+};
+const uint8_t lorawanFixtureJoinEui[FIXTURE_EUI_SIZE] = {0x70, 0xB3, 0xD5, 0x7E, 0xD0, 0x00, 0x12, 0x34};
+const uint8_t lorawanFixtureDevEui[FIXTURE_EUI_SIZE] = {0x00, 0x04, 0xA3, 0x0B, 0x00, 0x1A, 0x2B, 0x3C};
+
+/* EU868 channels 3 to 7 of the CFList, in units of 100 Hz */
+static const uint32_t cfListFrequencies[] = {8671000, 8673000, 8675000, 8677000, 8679000};
+
+LorawanFixtureReport_t lorawanFixtureReport;
+
+extern LoRa_t loRa;
+
+static RTC_TIMER32_CALLBACK sleepTimerCallback;
+
+/* The PDS is not part of these tests */
+PdsStatus_t PDS_Store(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
+{
+    (void)pdsFileItemIdx;
+    (void)item;
+    return PDS_OK;
+}
+
+PdsStatus_t PDS_RegFile(PdsFileItemIdx_t argFileId, PdsFileMarks_t argFileMarks)
+{
+    (void)argFileId;
+    (void)argFileMarks;
+    return PDS_OK;
+}
+
+PdsStatus_t PDS_RegCounter(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
+{
+    (void)pdsFileItemIdx;
+    (void)item;
+    return PDS_OK;
+}
+
+PdsStatus_t PDS_UnRegFile(PdsFileItemIdx_t argFileId)
+{
+    (void)argFileId;
+    return PDS_OK;
+}
+
+/* The sleep of PMM_Sleep, which the sleep timer ends at once */
+PdsStatus_t PDS_Flush(void)
+{
+    return PDS_OK;
+}
+
+bool PDS_ReadyToSleep(void)
+{
+    return true;
+}
+
+bool SYSTEM_ReadyToSleep(void)
+{
+    return true;
+}
+
+void SystemTimerSuspend(void)
+{
+}
+
+void SystemTimerSync(uint64_t timeToSync)
+{
+    (void)timeToSync;
+}
+
+void SleepTimerStart(uint32_t sleepTicks, RTC_TIMER32_CALLBACK cb)
+{
+    (void)sleepTicks;
+    sleepTimerCallback = cb;
+}
+
+void SleepTimerStop(void)
+{
+    sleepTimerCallback = NULL;
+}
+
+uint32_t SleepTimerGetElapsedTime(void)
+{
+    return 0;
+}
+
+void HAL_Sleep(HAL_SleepMode_t mode)
+{
+    (void)mode;
+    if (NULL != sleepTimerCallback)
+    {
+        sleepTimerCallback(0, 0);
+    }
+}
+
+static void appData(void *appHandle, appCbParams_t *data)
+{
+    (void)appHandle;
+    lorawanFixtureReport.appEvents++;
+    lorawanFixtureReport.lastEvent = *data;
+    if ((LORAWAN_EVT_RX_DATA_AVAILABLE == data->evt) && (data->param.rxData.dataLength <= FIXTURE_FRAME_MAX))
+    {
+        lorawanFixtureReport.rxFrames++;
+        lorawanFixtureReport.rxLength = data->param.rxData.dataLength;
+        memcpy(lorawanFixtureReport.rxData, data->param.rxData.pData, data->param.rxData.dataLength);
+    }
+}
+
+static void joinResponse(StackRetStatus_t status)
+{
+    lorawanFixtureReport.joinResponses++;
+    lorawanFixtureReport.joinStatus = status;
+}
+
+static void hexEncode(const uint8_t *data, uint8_t length, uint8_t *hex)
+{
+    static const char digits[] = "0123456789ABCDEF";
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        hex[2 * i] = (uint8_t)digits[data[i] >> 4];
+        hex[(2 * i) + 1] = (uint8_t)digits[data[i] & 0x0F];
+    }
+}
+
+void lorawanFixtureBoot(void)
+{
+    uint8_t devEuiHex[2 * FIXTURE_EUI_SIZE];
+    bool cryptoDevice = true;
+
+    radioEmuInit();
+    HAL_RadioInit();
+    eccEmuInit();
+    eccEmuSetSlot(APP_KEY_SLOT, APP_KEY_SLOT_BLOCK * FIXTURE_KEY_SIZE, lorawanFixtureAppKey, FIXTURE_KEY_SIZE);
+    eccEmuSetSlot(APP_EUI_SLOT, 0, lorawanFixtureJoinEui, FIXTURE_EUI_SIZE);
+    hexEncode(lorawanFixtureDevEui, FIXTURE_EUI_SIZE, devEuiHex);
+    eccEmuSetSlot(DEV_EUI_SLOT, 0, devEuiHex, sizeof(devEuiHex));
+
+    (void)SAL_Init();
+    LORAWAN_Init(appData, joinResponse);
+    (void)LORAWAN_Reset(ISM_EU868);
+    (void)LORAWAN_SetAttr(CRYPTODEVICE_ENABLED, &cryptoDevice);
+    radioEmuRunTasks();
+
+    memset(&lorawanFixtureReport, 0, sizeof(lorawanFixtureReport));
+    radioEmuResetStats();
+    eccEmuResetStats();
+}
+
+static void xorBlock(uint8_t *block, const uint8_t *data)
+{
+    for (uint8_t i = 0; i < FIXTURE_KEY_SIZE; i++)
+    {
+        block[i] ^= data[i];
+    }
+}
+
+static void cmacSubkey(uint8_t *key)
+{
+    uint8_t msb = key[0] & 0x80;
+
+    for (uint8_t i = 0; i < (FIXTURE_KEY_SIZE - 1); i++)
+    {
+        key[i] = (uint8_t)((key[i] << 1) | (key[i + 1] >> 7));
+    }
+    key[FIXTURE_KEY_SIZE - 1] = (uint8_t)(key[FIXTURE_KEY_SIZE - 1] << 1);
+    if (msb)
+    {
+        key[FIXTURE_KEY_SIZE - 1] ^= 0x87;
+    }
+}
+
+void lorawanFixtureCmac(const uint8_t *key, const uint8_t *data, uint8_t length, uint8_t *mac)
+{
+    uint8_t subkey[FIXTURE_KEY_SIZE] = {0};
+    uint8_t last[FIXTURE_KEY_SIZE] = {0};
+    uint8_t blocks = (uint8_t)((length + FIXTURE_KEY_SIZE - 1) / FIXTURE_KEY_SIZE);
+    uint8_t lastLength;
+
+    eccEmuAesEncrypt(key, subkey);
+    cmacSubkey(subkey);
+    if (0 == blocks)
+    {
+        blocks = 1;
+    }
+    lastLength = (uint8_t)(length - ((blocks - 1) * FIXTURE_KEY_SIZE));
+    memcpy(last, &data[(blocks - 1) * FIXTURE_KEY_SIZE], lastLength);
+    if (FIXTURE_KEY_SIZE != lastLength)
+    {
+        last[lastLength] = 0x80;
+        cmacSubkey(subkey);
+    }
+    xorBlock(last, subkey);
+
+    memset(mac, 0, FIXTURE_KEY_SIZE);
+    for (uint8_t i = 0; i < (blocks - 1); i++)
+    {
+        xorBlock(mac, &data[i * FIXTURE_KEY_SIZE]);
+        eccEmuAesEncrypt(key, mac);
+    }
+    xorBlock(mac, last);
+    eccEmuAesEncrypt(key, mac);
+}
+
+bool lorawanFixtureTransmit(uint64_t limit, uint8_t *frame, uint8_t *length)
+{
+    while (radioEmuTime() < limit)
+    {
+        radioEmuRunUntil(radioEmuTime() + STEP_US);
+        if (OPMODE_TX == (radioEmuOpMode() & OPMODE_MODE))
+        {
+            return radioEmuLoraTxDone(frame, length);
+        }
+    }
+    return false;
+}
+
+bool lorawanFixtureRunToReceive(uint64_t limit)
+{
+    uint8_t mode;
+
+    while (radioEmuTime() < limit)
+    {
+        radioEmuRunUntil(radioEmuTime() + STEP_US);
+        mode = radioEmuOpMode() & OPMODE_MODE;
+        if ((OPMODE_RXSINGLE == mode) || (OPMODE_RXCONTINUOUS == mode))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool lorawanFixtureJoinRequest(const uint8_t *frame, uint8_t length, uint16_t *devNonce)
+{
+    uint8_t mac[FIXTURE_KEY_SIZE];
+
+    if ((FIXTURE_JOIN_REQUEST_SIZE != length) || (MHDR_JOIN_REQUEST != frame[0]))
+    {
+        return false;
+    }
+    /* EUIs are sent least significant byte first */
+    for (uint8_t i = 0; i < FIXTURE_EUI_SIZE; i++)
+    {
+        if ((frame[1 + i] != lorawanFixtureJoinEui[FIXTURE_EUI_SIZE - 1 - i]) ||
+            (frame[1 + FIXTURE_EUI_SIZE + i] != lorawanFixtureDevEui[FIXTURE_EUI_SIZE - 1 - i]))
+        {
+            return false;
+        }
+    }
+    lorawanFixtureCmac(lorawanFixtureAppKey, frame, (uint8_t)(length - MIC_SIZE), mac);
+    if (0 != memcmp(mac, &frame[length - MIC_SIZE], MIC_SIZE))
+    {
+        return false;
+    }
+    *devNonce = (uint16_t)(frame[17] | (frame[18] << 8));
+    return true;
+}
+
+static void putLe(uint8_t *buffer, uint32_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++)
+    {
+        buffer[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static void sessionKey(uint8_t type, const LorawanFixtureJoin_t *join, uint8_t *key)
+{
+    memset(key, 0, FIXTURE_KEY_SIZE);
+    key[0] = type;
+    putLe(&key[1], join->joinNonce, 3);
+    putLe(&key[4], join->netId, 3);
+    putLe(&key[7], join->devNonce, 2);
+    eccEmuAesEncrypt(lorawanFixtureAppKey, key);
+}
+
+uint8_t lorawanFixtureJoinAccept(LorawanFixtureJoin_t *join, uint8_t *frame)
+{
+    uint8_t mac[FIXTURE_KEY_SIZE];
+    uint8_t length = 0;
+
+    frame[length++] = MHDR_JOIN_ACCEPT;
+    putLe(&frame[length], join->joinNonce, 3);
+    length += 3;
+    putLe(&frame[length], join->netId, 3);
+    length += 3;
+    putLe(&frame[length], join->devAddr, 4);
+    length += 4;
+    frame[length++] = JOIN_DL_SETTINGS;
+    frame[length++] = JOIN_RX_DELAY;
+    if (join->cfList)
+    {
+        for (uint8_t i = 0; i < (sizeof(cfListFrequencies) / sizeof(cfListFrequencies[0])); i++)
+        {
+            putLe(&frame[length], cfListFrequencies[i], 3);
+            length += 3;
+        }
+        /* CFListType, a list of frequencies */
+        frame[length++] = 0;
+    }
+    lorawanFixtureCmac(lorawanFixtureAppKey, frame, length, mac);
+    memcpy(&frame[length], mac, MIC_SIZE);
+    length += MIC_SIZE;
+
+    /* The network decrypts, so that the device encrypts to read it */
+    for (uint8_t i = 1; i < length; i += FIXTURE_KEY_SIZE)
+    {
+        eccEmuAesDecrypt(lorawanFixtureAppKey, &frame[i]);
+    }
+
+    sessionKey(0x01, join, join->nwkSKey);
+    sessionKey(0x02, join, join->appSKey);
+    return length;
+}
+
+bool lorawanFixtureJoin(LorawanFixtureJoin_t *join)
+{
+    uint8_t frame[FIXTURE_JOIN_ACCEPT_MAX];
+    uint8_t length;
+    uint64_t limit;
+    uint8_t joinResponses = lorawanFixtureReport.joinResponses;
+
+    if ((LORAWAN_SUCCESS != LORAWAN_Join(LORAWAN_OTAA)) ||
+        !lorawanFixtureTransmit(radioEmuTime() + JOIN_REQUEST_LIMIT_US, frame, &length) ||
+        !lorawanFixtureJoinRequest(frame, length, &join->devNonce))
+    {
+        return false;
+    }
+    length = lorawanFixtureJoinAccept(join, frame);
+    if (!lorawanFixtureRunToReceive(radioEmuTime() + WINDOW_LIMIT_US) || !radioEmuLoraReceive(frame, length, true))
+    {
+        return false;
+    }
+
+    limit = radioEmuTime() + TRANSACTION_LIMIT_US;
+    while ((joinResponses == lorawanFixtureReport.joinResponses) && (radioEmuTime() < limit))
+    {
+        radioEmuRunUntil(radioEmuTime() + STEP_US);
+    }
+    return (joinResponses != lorawanFixtureReport.joinResponses) && (LORAWAN_SUCCESS == lorawanFixtureReport.joinStatus);
+}
+
+/* MIC of a data frame of LoRaWAN 1.0 */
+static void dataMic(const uint8_t *key, uint8_t dir, uint32_t devAddr, uint32_t fCnt, const uint8_t *frame,
+    uint8_t length, uint8_t *mic)
+{
+    uint8_t message[FIXTURE_KEY_SIZE + FIXTURE_FRAME_MAX] = {0};
+    uint8_t mac[FIXTURE_KEY_SIZE];
+
+    message[0] = 0x49;
+    message[5] = dir;
+    putLe(&message[6], devAddr, 4);
+    putLe(&message[10], fCnt, 4);
+    message[15] = length;
+    memcpy(&message[FIXTURE_KEY_SIZE], frame, length);
+    lorawanFixtureCmac(key, message, (uint8_t)(FIXTURE_KEY_SIZE + length), mac);
+    memcpy(mic, mac, MIC_SIZE);
+}
+
+/* FRMPayload encryption of LoRaWAN 1.0, its own inverse */
+static void dataEncrypt(const uint8_t *key, uint8_t dir, uint32_t devAddr, uint32_t fCnt, uint8_t *payload,
+    uint8_t length)
+{
+    uint8_t block[FIXTURE_KEY_SIZE];
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        if (0 == (i % FIXTURE_KEY_SIZE))
+        {
+            memset(block, 0, sizeof(block));
+            block[0] = 0x01;
+            block[5] = dir;
+            putLe(&block[6], devAddr, 4);
+            putLe(&block[10], fCnt, 4);
+            block[15] = (uint8_t)((i / FIXTURE_KEY_SIZE) + 1);
+            eccEmuAesEncrypt(key, block);
+        }
+        payload[i] ^= block[i % FIXTURE_KEY_SIZE];
+    }
+}
+
+bool lorawanFixtureUplink(const LorawanFixtureJoin_t *join, uint8_t port, const uint8_t *payload, uint8_t length,
+    const uint8_t *downlink, uint8_t downlinkLength)
+{
+    uint8_t data[FIXTURE_FRAME_MAX];
+    LorawanSendReq_t request = {LORAWAN_UNCNF, port, data, length};
+    uint8_t frame[FIXTURE_FRAME_MAX];
+    uint8_t frameLength;
+    uint8_t mic[MIC_SIZE];
+    uint64_t limit;
+
+    memcpy(data, payload, length);
+    if ((LORAWAN_SUCCESS != LORAWAN_Send(&request)) ||
+        !lorawanFixtureTransmit(radioEmuTime() + JOIN_REQUEST_LIMIT_US, frame, &frameLength) ||
+        (frameLength < (FHDR_SIZE + MIC_SIZE)) || (MHDR_UNCONFIRMED_UP != frame[0]))
+    {
+        return false;
+    }
+    dataMic(join->nwkSKey, DIR_UP, join->devAddr, (uint32_t)(frame[6] | (frame[7] << 8)), frame,
+        (uint8_t)(frameLength - MIC_SIZE), mic);
+    if (0 != memcmp(mic, &frame[frameLength - MIC_SIZE], MIC_SIZE))
+    {
+        return false;
+    }
+
+    if (!lorawanFixtureRunToReceive(radioEmuTime() + WINDOW_LIMIT_US))
+    {
+        return false;
+    }
+    if (NULL != downlink)
+    {
+        if (!radioEmuLoraReceive(downlink, downlinkLength, true))
+        {
+            return false;
+        }
+    }
+    else if (!radioEmuLoraRxTimeout() || !lorawanFixtureRunToReceive(radioEmuTime() + WINDOW_LIMIT_US) ||
+        !radioEmuLoraRxTimeout())
+    {
+        return false;
+    }
+
+    limit = radioEmuTime() + TRANSACTION_LIMIT_US;
+    while (!loRa.isTransactionDone && (radioEmuTime() < limit))
+    {
+        radioEmuRunUntil(radioEmuTime() + STEP_US);
+    }
+    return loRa.isTransactionDone;
+}
+
+uint8_t lorawanFixtureDownlink(const LorawanFixtureJoin_t *join, uint32_t fCnt, uint8_t port, const uint8_t *payload,
+    uint8_t length, uint8_t *frame)
+{
+    uint8_t frameLength = 0;
+
+    frame[frameLength++] = MHDR_UNCONFIRMED_DOWN;
+    putLe(&frame[frameLength], join->devAddr, 4);
+    frameLength += 4;
+    /* FCtrl, no FOpts */
+    frame[frameLength++] = 0;
+    putLe(&frame[frameLength], fCnt, 2);
+    frameLength += 2;
+    frame[frameLength++] = port;
+    memcpy(&frame[frameLength], payload, length);
+    dataEncrypt((0 == port) ? join->nwkSKey : join->appSKey, DIR_DOWN, join->devAddr, fCnt, &frame[frameLength], length);
+    frameLength += length;
+    dataMic(join->nwkSKey, DIR_DOWN, join->devAddr, fCnt, frame, frameLength, &frame[frameLength]);
+    return (uint8_t)(frameLength + MIC_SIZE);
+}
@@ -0,0 +1,92 @@
+/**
+* \file  lorawan_fixture.h
+*
+* \brief The whole MAC of the host tests, booted in EU868 on the SX1276
+*        emulator with its keys in the ATECC608 emulator, and the part of
+*        the network server that answers its join requests and its
+*        uplinks. PMM_Sleep runs on a sleep timer that wakes the device as
+*        soon as it sleeps.
+*/
+#ifndef LORAWAN_FIXTURE_H
+#define LORAWAN_FIXTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lorawan.h"
+
+#define FIXTURE_KEY_SIZE            (16U)
+#define FIXTURE_EUI_SIZE            (8U)
+#define FIXTURE_JOIN_REQUEST_SIZE   (23U)
+#define FIXTURE_JOIN_ACCEPT_MAX     (33U)
+#define FIXTURE_FRAME_MAX           (64U)
+
+/* Provisioned in the secure element */
+extern const uint8_t lorawanFixtureAppKey[FIXTURE_KEY_SIZE];
+extern const uint8_t lorawanFixtureJoinEui[FIXTURE_EUI_SIZE];
+extern const uint8_t lorawanFixtureDevEui[FIXTURE_EUI_SIZE];
+
+/* What the MAC reported to the application */
+typedef struct _LorawanFixtureReport
+{
+    uint8_t joinResponses;
+    StackRetStatus_t joinStatus;
+    uint8_t appEvents;
+    appCbParams_t lastEvent;
+    /* Payload of the last downlink handed over */
+    uint8_t rxFrames;
+    uint8_t rxLength;
+    uint8_t rxData[FIXTURE_FRAME_MAX];
+} LorawanFixtureReport_t;
+
+extern LorawanFixtureReport_t lorawanFixtureReport;
+
+/* The join accept of the network, and the session keys it agrees on */
+typedef struct _LorawanFixtureJoin
+{
+    uint16_t devNonce;
+    uint32_t joinNonce;
+    uint32_t netId;
+    uint32_t devAddr;
+    bool cfList;
+    uint8_t nwkSKey[FIXTURE_KEY_SIZE];
+    uint8_t appSKey[FIXTURE_KEY_SIZE];
+} LorawanFixtureJoin_t;
+
+/* Powers both emulators on and provisions the secure element, inits the
+ * SAL and the MAC for EU868 with the crypto device enabled and runs the
+ * tasks the init posted. The stats and the report are cleared */
+void lorawanFixtureBoot(void);
+
+/* AES-CMAC of RFC 4493 */
+void lorawanFixtureCmac(const uint8_t *key, const uint8_t *data, uint8_t length, uint8_t *mac);
+
+/* Runs the MAC up to its transmission, which ends, and returns the frame
+ * sent. False if it does not transmit before limit */
+bool lorawanFixtureTransmit(uint64_t limit, uint8_t *frame, uint8_t *length);
+
+/* Runs the MAC until it listens, false if it does not before limit */
+bool lorawanFixtureRunToReceive(uint64_t limit);
+
+/* Checks a join request of the fixture EUIs and its MIC, returns the
+ * DevNonce */
+bool lorawanFixtureJoinRequest(const uint8_t *frame, uint8_t length, uint16_t *devNonce);
+
+/* Builds the join accept of join, encrypted as the network does, and the
+ * session keys the device must derive from it */
+uint8_t lorawanFixtureJoinAccept(LorawanFixtureJoin_t *join, uint8_t *frame);
+
+/* Joins in RX1 of the first join request with join, which is completed
+ * with the DevNonce and the session keys. False if the join fails */
+bool lorawanFixtureJoin(LorawanFixtureJoin_t *join);
+
+/* Sends an unconfirmed uplink on port and checks its MIC. The network
+ * answers in RX1 with downlink if not NULL, otherwise both windows end
+ * without a frame. False if the transaction does not complete */
+bool lorawanFixtureUplink(const LorawanFixtureJoin_t *join, uint8_t port, const uint8_t *payload, uint8_t length,
+    const uint8_t *downlink, uint8_t downlinkLength);
+
+/* Builds an unconfirmed downlink of the network without FOpts */
+uint8_t lorawanFixtureDownlink(const LorawanFixtureJoin_t *join, uint32_t fCnt, uint8_t port, const uint8_t *payload,
+    uint8_t length, uint8_t *frame);
+
+#endif /* LORAWAN_FIXTURE_H */
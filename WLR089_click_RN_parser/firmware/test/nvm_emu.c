@@ -0,0 +1,391 @@
+/**
+* \file  nvm_emu.c
+*
+* \brief NVMCTRL emulator of the host tests. Commands complete right away
+*        unless a test gives them a duration, a page write only clears bits
+*        as on the real NVM and aborts if it programs a byte already
+*        programmed since the row was erased, and every erase and page write
+*        is counted so that a test can cut the power at any of them. In the
+*        main flash layout the rows must be unlocked before they are written,
+*        and the cache invalidated before they are read back.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "nvm_emu.h"
+#include "system_task_manager.h"
+
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+/* The Makefile places the .pds_flash section of pds_nvm.c there */
+#define NVM_EMU_BASE            (NVM_EMU_FLASH_ADDRESS)
+/* The 256 KB of main flash of the SAM R34 form 16 lock regions */
+#define NVM_EMU_LOCK_REGION     (0x40000U / 16U)
+#else
+#define NVM_EMU_BASE            (NVMCTRL_RWWEEPROM_START_ADDRESS)
+#endif
+
+/* Kept in the shared mapping, behind the NVM */
+typedef struct _NvmEmuShared
+{
+    long ops;
+    uint16_t programs[NVM_EMU_PAGES];
+    uint32_t erases[NVM_EMU_ROWS];
+} NvmEmuShared_t;
+
+nvmctrl_registers_t nvmEmuRegs;
+SysTick_Type nvmEmuSysTick;
+
+static uint8_t *nvmMem;
+static NvmEmuShared_t *nvmShared;
+static long cutAt = -1;
+static NvmEmuCut_t cutMode;
+static long failAt = -1;
+static long failEnd = -1;
+static bool failWrites;
+static NVMCTRL_ERROR nvmError = NVMCTRL_ERROR_NONE;
+static bool pdsTaskPosted;
+static uint32_t eraseTime;
+static uint32_t writeTime;
+static uint64_t now;
+static uint64_t readyAt;
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+static uint32_t unlockedRegions;
+static bool cacheStale;
+#endif
+static uint8_t savedMem[NVM_EMU_SIZE];
+static NvmEmuShared_t savedShared;
+
+extern SYSTEM_TaskStatus_t PDS_TaskHandler(void);
+extern void NVMCTRL_Handler(void);
+
+void nvmEmuInit(void)
+{
+    size_t size = NVM_EMU_SIZE + sizeof(NvmEmuShared_t);
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    /* Replaces the pages the executable loaded the section to */
+    int flags = MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED;
+#else
+    int flags = MAP_SHARED | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE;
+#endif
+    void *addr = mmap((void *)(uintptr_t)NVM_EMU_BASE, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+    if ((MAP_FAILED == addr) || ((uintptr_t)NVM_EMU_BASE != (uintptr_t)addr))
+    {
+        perror("nvm_emu: cannot map the NVM");
+        exit(2);
+    }
+
+    nvmMem = addr;
+    nvmShared = (NvmEmuShared_t *)(nvmMem + NVM_EMU_SIZE);
+    nvmEmuEraseAll();
+}
+
+void nvmEmuEraseAll(void)
+{
+    memset(nvmMem, UINT8_MAX, NVM_EMU_SIZE);
+    memset(nvmShared, 0, sizeof(NvmEmuShared_t));
+}
+
+void nvmEmuSave(void)
+{
+    memcpy(savedMem, nvmMem, sizeof(savedMem));
+    savedShared = *nvmShared;
+}
+
+void nvmEmuLoad(void)
+{
+    memcpy(nvmMem, savedMem, sizeof(savedMem));
+    *nvmShared = savedShared;
+}
+
+void nvmEmuCutAt(long op, NvmEmuCut_t mode)
+{
+    cutAt = (op < 0) ? -1 : (nvmShared->ops + op);
+    cutMode = mode;
+}
+
+void nvmEmuFailAt(long op, long count)
+{
+    failAt = (op < 0) ? -1 : (nvmShared->ops + op);
+    failEnd = failAt + count;
+}
+
+void nvmEmuFailWrites(bool fail)
+{
+    failWrites = fail;
+}
+
+long nvmEmuOpCount(void)
+{
+    return nvmShared->ops;
+}
+
+uint16_t nvmEmuPagePrograms(uint16_t page)
+{
+    return nvmShared->programs[page];
+}
+
+uint32_t nvmEmuRowErases(uint16_t row)
+{
+    return nvmShared->erases[row];
+}
+
+uint8_t *nvmEmuMem(void)
+{
+    return nvmMem;
+}
+
+void nvmEmuRunTasks(void)
+{
+    for (unsigned int run = 0; run < 100000; run++)
+    {
+        if (!nvmEmuRunOne() && !nvmEmuIdleUntil(UINT64_MAX))
+        {
+            return;
+        }
+    }
+
+    fprintf(stderr, "nvm_emu: the PDS tasks do not settle\n");
+    exit(2);
+}
+
+void nvmEmuSetTiming(uint32_t eraseUs, uint32_t writeUs)
+{
+    eraseTime = eraseUs;
+    writeTime = writeUs;
+}
+
+uint64_t nvmEmuTime(void)
+{
+    return now;
+}
+
+bool nvmEmuRunOne(void)
+{
+    if (nvmEmuRegs.NVMCTRL_INTENSET && (now >= readyAt))
+    {
+        nvmEmuRegs.NVMCTRL_INTENSET = 0;
+        NVMCTRL_Handler();
+        return true;
+    }
+    if (pdsTaskPosted)
+    {
+        pdsTaskPosted = false;
+        PDS_TaskHandler();
+        return true;
+    }
+
+    return false;
+}
+
+bool nvmEmuIdleUntil(uint64_t time)
+{
+    if (!nvmEmuRegs.NVMCTRL_INTENSET)
+    {
+        return false;
+    }
+    if (now < readyAt)
+    {
+        now = (time < readyAt) ? time : readyAt;
+    }
+
+    return true;
+}
+
+/* Offset of an address in the emulated NVM */
+static uint32_t nvmOffset(uint32_t address, uint32_t length)
+{
+    uint32_t offset = address - NVM_EMU_BASE;
+
+    if ((address < NVM_EMU_BASE) || ((offset + length) > NVM_EMU_SIZE))
+    {
+        fprintf(stderr, "nvm_emu: access out of the " NVM_EMU_LAYOUT " at 0x%08x\n", (unsigned int)address);
+        abort();
+    }
+
+    return offset;
+}
+
+/* Counts a command, returns false if it fails. A power cut ends the process.
+ * programs counts the page writes that changed the page, NULL for an erase */
+static bool nvmCommand(uint8_t *dst, const uint8_t *src, uint32_t length, uint16_t *programs)
+{
+    long op = nvmShared->ops++;
+    uint32_t done = length;
+
+    if (now < readyAt)
+    {
+        fprintf(stderr, "nvm_emu: command issued while the NVM is busy\n");
+        abort();
+    }
+    readyAt = now + ((NULL == programs) ? eraseTime : writeTime);
+
+    nvmError = NVMCTRL_ERROR_NONE;
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    if (0 == (unlockedRegions & (1UL << ((dst - nvmMem) / NVM_EMU_LOCK_REGION))))
+    {
+        nvmError = NVMCTRL_ERROR_LOCK;
+        return false;
+    }
+    cacheStale = true;
+#endif
+    if (((op >= failAt) && (op < failEnd)) || (failWrites && (NULL != programs)))
+    {
+        nvmError = NVMCTRL_ERROR_PROG;
+        return false;
+    }
+
+    if (op == cutAt)
+    {
+        done = (NVM_EMU_CUT_BEFORE == cutMode) ? 0 : ((NVM_EMU_CUT_TORN == cutMode) ? (length / 4) : length);
+    }
+
+    for (uint32_t idx = 0; idx < done; idx++)
+    {
+        /* Programming only clears bits */
+        dst[idx] = (NULL == programs) ? UINT8_MAX : (dst[idx] & src[idx]);
+    }
+
+    if ((NULL != programs) && (0 != done))
+    {
+        (*programs)++;
+    }
+
+    if (op == cutAt)
+    {
+        _exit(NVM_EMU_POWER_CUT_EXIT);
+    }
+
+    return true;
+}
+
+bool NVMCTRL_Read(uint32_t *data, uint32_t length, const uint32_t address)
+{
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    if (cacheStale)
+    {
+        fprintf(stderr, "nvm_emu: main flash read at 0x%08x through a stale cache\n", (unsigned int)address);
+        abort();
+    }
+#endif
+    memcpy(data, &nvmMem[nvmOffset(address, length)], length);
+    nvmError = NVMCTRL_ERROR_NONE;
+    return true;
+}
+
+static bool nvmPageWrite(uint32_t *data, const uint32_t address)
+{
+    uint32_t offset = nvmOffset(address, NVMCTRL_FLASH_PAGESIZE);
+
+    if (0 != (offset % NVMCTRL_FLASH_PAGESIZE))
+    {
+        fprintf(stderr, "nvm_emu: unaligned page write at 0x%08x\n", (unsigned int)address);
+        abort();
+    }
+
+    /* Each byte is programmed at most once between two erases of its row */
+    for (uint32_t idx = 0; idx < NVMCTRL_FLASH_PAGESIZE; idx++)
+    {
+        if ((UINT8_MAX != ((const uint8_t *)data)[idx]) && (UINT8_MAX != nvmMem[offset + idx]))
+        {
+            fprintf(stderr, "nvm_emu: byte at 0x%08x programmed again since its row was erased\n",
+                (unsigned int)(address + idx));
+            abort();
+        }
+    }
+
+    return nvmCommand(&nvmMem[offset], (const uint8_t *)data, NVMCTRL_FLASH_PAGESIZE,
+            &nvmShared->programs[offset / NVMCTRL_FLASH_PAGESIZE]);
+}
+
+static bool nvmRowErase(uint32_t address)
+{
+    uint32_t offset = nvmOffset(address, NVMCTRL_FLASH_ROWSIZE);
+    uint16_t page = offset / NVMCTRL_FLASH_PAGESIZE;
+
+    offset -= offset % NVMCTRL_FLASH_ROWSIZE;
+    nvmShared->erases[offset / NVMCTRL_FLASH_ROWSIZE]++;
+    for (uint16_t idx = 0; idx < (NVMCTRL_FLASH_ROWSIZE / NVMCTRL_FLASH_PAGESIZE); idx++)
+    {
+        nvmShared->programs[page - (page % (NVMCTRL_FLASH_ROWSIZE / NVMCTRL_FLASH_PAGESIZE)) + idx] = 0;
+    }
+    return nvmCommand(&nvmMem[offset], NULL, NVMCTRL_FLASH_ROWSIZE, NULL);
+}
+
+/* Each layout has its own commands, the other ones reach no PDS row */
+static void nvmCheckLayout(bool flashCommand, uint32_t address)
+{
+    if (flashCommand != (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH))
+    {
+        fprintf(stderr, "nvm_emu: %s command at 0x%08x in the " NVM_EMU_LAYOUT " layout\n",
+            flashCommand ? "main flash" : "RWWEE", (unsigned int)address);
+        abort();
+    }
+}
+
+bool NVMCTRL_RWWEEPROM_PageWrite(uint32_t *data, const uint32_t address)
+{
+    nvmCheckLayout(false, address);
+    return nvmPageWrite(data, address);
+}
+
+bool NVMCTRL_RWWEEPROM_RowErase(uint32_t address)
+{
+    nvmCheckLayout(false, address);
+    return nvmRowErase(address);
+}
+
+bool NVMCTRL_PageWrite(uint32_t *data, const uint32_t address)
+{
+    nvmCheckLayout(true, address);
+    return nvmPageWrite(data, address);
+}
+
+bool NVMCTRL_RowErase(uint32_t address)
+{
+    nvmCheckLayout(true, address);
+    return nvmRowErase(address);
+}
+
+NVMCTRL_ERROR NVMCTRL_ErrorGet(void)
+{
+    return nvmError;
+}
+
+bool NVMCTRL_IsBusy(void)
+{
+    if (now < readyAt)
+    {
+        /* Each poll takes the CPU a microsecond */
+        now++;
+        return true;
+    }
+
+    return false;
+}
+
+void NVMCTRL_RegionUnlock(uint32_t address)
+{
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    unlockedRegions |= 1UL << (nvmOffset(address, 1) / NVM_EMU_LOCK_REGION);
+#else
+    (void)address;
+#endif
+}
+
+void NVMCTRL_CacheInvalidate(void)
+{
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+    cacheStale = false;
+#endif
+}
+
+void SYSTEM_PostTask(SYSTEM_Task_t task)
+{
+    if (PDS_TASK_ID == task)
+    {
+        pdsTaskPosted = true;
+    }
+}
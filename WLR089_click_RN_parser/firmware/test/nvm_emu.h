@@ -0,0 +1,92 @@
+/**
+* \file  nvm_emu.h
+*
+* \brief NVMCTRL emulator of the host tests. The NVM of the PDS, the RWWEE
+*        or with PDS_NVM_BACKEND_FLASH the .pds_flash rows of main flash, is
+*        kept in memory shared by all the processes of a test, so that a
+*        child process can be killed by a power cut in the middle of an NVM
+*        command and the next one boots from what it left behind.
+*/
+#ifndef NVM_EMU_H
+#define NVM_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "definitions.h"
+#include "pds_common.h"
+#include "pds_nvm.h"
+
+/* State of the NVM command hit by a power cut */
+typedef enum _NvmEmuCut
+{
+    NVM_EMU_CUT_BEFORE = 0,     /* The command has not started */
+    NVM_EMU_CUT_TORN,           /* The first quarter of the page is programmed or of the row erased */
+    NVM_EMU_CUT_AFTER,          /* The command has completed */
+    NVM_EMU_CUT_MODES
+} NvmEmuCut_t;
+
+/* Exit code of a process killed by a power cut */
+#define NVM_EMU_POWER_CUT_EXIT      (77)
+
+#define NVM_EMU_SIZE                (PDS_NVM_AREA_SIZE)
+#define NVM_EMU_PAGES               ((NVM_EMU_SIZE) / (NVMCTRL_FLASH_PAGESIZE))
+#define NVM_EMU_ROWS                ((NVM_EMU_SIZE) / (NVMCTRL_FLASH_ROWSIZE))
+
+/* Name of the emulated layout, in the result line of the tests */
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+#define NVM_EMU_LAYOUT              "main flash"
+#else
+#define NVM_EMU_LAYOUT              "RWWEE"
+#endif
+
+/* Maps the emulated NVM and erases it */
+void nvmEmuInit(void);
+
+/* Erases the whole NVM and clears the wear counters */
+void nvmEmuEraseAll(void);
+
+/* Saves the NVM and its wear counters, nvmEmuLoad brings them back */
+void nvmEmuSave(void);
+void nvmEmuLoad(void);
+
+/* Cuts the power at the op-th erase or page write from now, -1 disables */
+void nvmEmuCutAt(long op, NvmEmuCut_t mode);
+
+/* Makes count erases and page writes fail from the op-th one from now, -1 disables */
+void nvmEmuFailAt(long op, long count);
+
+/* Makes every page write fail while set, the erases still complete */
+void nvmEmuFailWrites(bool fail);
+
+/* Number of erases and page writes since nvmEmuInit, over all processes */
+long nvmEmuOpCount(void);
+
+/* Number of times a page has been programmed since its row was erased */
+uint16_t nvmEmuPagePrograms(uint16_t page);
+
+/* Number of times a row has been erased */
+uint32_t nvmEmuRowErases(uint16_t row);
+
+/* Direct access to the emulated NVM, row 0 first */
+uint8_t *nvmEmuMem(void);
+
+/* Runs the posted PDS tasks and NVMCTRL interrupts until none is left */
+void nvmEmuRunTasks(void);
+
+/* Makes the erases and page writes take the given time, they complete
+ * right away by default */
+void nvmEmuSetTiming(uint32_t eraseUs, uint32_t writeUs);
+
+/* Emulated time in us. It advances while the code polls the busy NVM and
+ * while the CPU idles until the NVMCTRL interrupt */
+uint64_t nvmEmuTime(void);
+
+/* Runs the NVMCTRL interrupt if it is due, else one PDS task. Returns false
+ * if there was nothing to run at this time */
+bool nvmEmuRunOne(void);
+
+/* Idles until the pending NVMCTRL interrupt, or until the given time if it
+ * is earlier. Returns false if no interrupt is pending */
+bool nvmEmuIdleUntil(uint64_t time);
+
+#endif /* NVM_EMU_H */
@@ -0,0 +1,84 @@
+/**
+* \file  pds_fixture.c
+*
+* \brief PDS files of the host tests.
+*/
+#include <string.h>
+#include "pds_fixture.h"
+#include "nvm_emu.h"
+
+#define COUNTER_OFFSET(idx)     ((idx) * (PDS_SIZE_OF_ITEM_HDR + sizeof(uint32_t)))
+
+uint32_t fixtureCounters[FIXTURE_COUNTERS];
+uint8_t fixtureBlob[FIXTURE_BLOB_SIZE];
+uint32_t fixtureFile2Counter;
+
+static PdsOperations_t file1Ops[FIXTURE_COUNTERS + 1];
+static PdsOperations_t file2Ops[1];
+
+static ItemMap_t file1Items[FIXTURE_COUNTERS + 1] = {
+    DECLARE_ITEM((uint8_t *)&fixtureCounters[0], PDS_FILE_MAC_01_IDX, 0, sizeof(uint32_t), COUNTER_OFFSET(0)),
+    DECLARE_ITEM((uint8_t *)&fixtureCounters[1], PDS_FILE_MAC_01_IDX, 1, sizeof(uint32_t), COUNTER_OFFSET(1)),
+    DECLARE_ITEM((uint8_t *)&fixtureCounters[2], PDS_FILE_MAC_01_IDX, 2, sizeof(uint32_t), COUNTER_OFFSET(2)),
+    DECLARE_ITEM((uint8_t *)&fixtureCounters[3], PDS_FILE_MAC_01_IDX, 3, sizeof(uint32_t), COUNTER_OFFSET(3)),
+    DECLARE_ITEM((uint8_t *)&fixtureCounters[4], PDS_FILE_MAC_01_IDX, 4, sizeof(uint32_t), COUNTER_OFFSET(4)),
+    DECLARE_ITEM(fixtureBlob, PDS_FILE_MAC_01_IDX, FIXTURE_BLOB_ITEM, FIXTURE_BLOB_SIZE, COUNTER_OFFSET(FIXTURE_COUNTERS)),
+};
+
+static ItemMap_t file2Items[1] = {
+    DECLARE_ITEM((uint8_t *)&fixtureFile2Counter, PDS_FILE_MAC_02_IDX, FIXTURE_FILE2_ITEM, sizeof(uint32_t), 0),
+};
+
+PdsStatus_t pdsFixtureBoot(uint8_t journalCounters)
+{
+    PdsFileMarks_t fileMarks;
+
+    memset(fixtureCounters, 0, sizeof(fixtureCounters));
+    memset(fixtureBlob, 0, sizeof(fixtureBlob));
+    fixtureFile2Counter = 0;
+
+    PDS_Init();
+
+    fileMarks.fileMarkListAddr = file1Ops;
+    fileMarks.numItems = FIXTURE_COUNTERS + 1;
+    fileMarks.itemListAddr = file1Items;
+    fileMarks.fIDcb = NULL;
+    PDS_RegFile(PDS_FILE_MAC_01_IDX, fileMarks);
+
+    fileMarks.fileMarkListAddr = file2Ops;
+    fileMarks.numItems = 1;
+    fileMarks.itemListAddr = file2Items;
+    PDS_RegFile(PDS_FILE_MAC_02_IDX, fileMarks);
+
+    for (uint8_t idx = 0; idx < journalCounters; idx++)
+    {
+        (void)PDS_RegCounter(PDS_FILE_MAC_01_IDX, idx);
+    }
+    if (0 != journalCounters)
+    {
+        (void)PDS_RegCounter(PDS_FILE_MAC_02_IDX, FIXTURE_FILE2_ITEM);
+    }
+
+    return PDS_RestoreAll();
+}
+
+void pdsFixtureFillBlob(uint8_t seed)
+{
+    for (uint8_t idx = 0; idx < FIXTURE_BLOB_SIZE; idx++)
+    {
+        fixtureBlob[idx] = (uint8_t)(seed + (idx * 7));
+    }
+}
+
+bool pdsFixtureBlobIs(uint8_t seed)
+{
+    for (uint8_t idx = 0; idx < FIXTURE_BLOB_SIZE; idx++)
+    {
+        if (fixtureBlob[idx] != (uint8_t)(seed + (idx * 7)))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+/**
+* \file  pds_fixture.h
+*
+* \brief PDS files of the host tests, laid out like the MAC files: a file
+*        of frame counters and a blob, and a file holding one counter.
+*/
+#ifndef PDS_FIXTURE_H
+#define PDS_FIXTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pds_interface.h"
+
+#define FIXTURE_COUNTERS        (5)
+#define FIXTURE_BLOB_SIZE       (32)
+
+/* Items of PDS_FILE_MAC_01_IDX: the counters, then the blob */
+#define FIXTURE_BLOB_ITEM       (FIXTURE_COUNTERS)
+/* PDS_FILE_MAC_02_IDX holds a single counter */
+#define FIXTURE_FILE2_ITEM      (0)
+
+extern uint32_t fixtureCounters[FIXTURE_COUNTERS];
+extern uint8_t fixtureBlob[FIXTURE_BLOB_SIZE];
+extern uint32_t fixtureFile2Counter;
+
+/* Boots the PDS with the RAM items cleared: init, registration of the
+ * files and of journalCounters counters of file 1 plus the counter of
+ * file 2 if journalCounters is not 0, then restore of all the files.
+ * Returns the status of the restore */
+PdsStatus_t pdsFixtureBoot(uint8_t journalCounters);
+
+/* Fills the blob with a pattern derived from seed */
+void pdsFixtureFillBlob(uint8_t seed);
+
+/* Checks the blob against the pattern of seed */
+bool pdsFixtureBlobIs(uint8_t seed);
+
+#endif /* PDS_FIXTURE_H */
@@ -0,0 +1,1179 @@
+/**
+* \file  radio_emu.c
+*
+* \brief SX1276 emulator of the host tests. The radio HAL drives the
+*        registers of stubs/definitions.h: the emulator sees every access
+*        to the SERCOM DATA and INTFLAG registers and to the PORT set,
+*        clear and toggle registers through radioEmuSpiAccess() and
+*        radioEmuPortAccess(). A register write is only known at the next
+*        access, so each access first resolves the previous one. CS edges
+*        delimit the SPI transactions, the reset and TCXO pins are followed
+*        too. The DIO interrupts run the EIC callbacks of the HAL at once,
+*        the tick timer runs in interrupt and the SW timers from the timer
+*        task, as on the target.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "radio_emu.h"
+#include "definitions.h"
+#include "sys.h"
+#include "atomic.h"
+#include "sw_timer.h"
+#include "system_task_manager.h"
+
+/* Pins of the radio HAL */
+#define PIN_CS_GROUP            (1U)
+#define PIN_CS                  (1UL << 31)
+#define PIN_RESET_GROUP         (1U)
+#define PIN_RESET               (1UL << 15)
+#define PIN_TCXO_GROUP          (0U)
+#define PIN_TCXO                (1UL << 9)
+
+/* Value of DATA until the HAL writes it, the low byte is the one read */
+#define SPI_SENTINEL            (0xA5A50000UL)
+#define SPI_RX_BUFFER           (2U)
+
+/* SX1276 registers */
+#define SX_FIFO                 (0x00)
+#define SX_OPMODE               (0x01)
+#define SX_BANK_FIRST           (0x0D)
+#define SX_BANK_LAST            (0x3F)
+#define SX_DIOMAPPING1          (0x40)
+#define SX_VERSION              (0x42)
+#define SX_LORA_FIFOADDRPTR     (0x0D)
+#define SX_LORA_FIFOTXBASEADDR  (0x0E)
+#define SX_LORA_FIFORXBASEADDR  (0x0F)
+#define SX_LORA_RXCURRENTADDR   (0x10)
+#define SX_LORA_IRQFLAGS        (0x12)
+#define SX_LORA_RXNBBYTES       (0x13)
+#define SX_LORA_PKTSNRVALUE     (0x19)
+#define SX_LORA_PKTRSSIVALUE    (0x1A)
+#define SX_LORA_HOPCHANNEL      (0x1C)
+#define SX_LORA_PAYLOADLENGTH   (0x22)
+#define SX_FSK_RSSIVALUE        (0x11)
+#define SX_FSK_FIFOTHRESH       (0x35)
+#define SX_FSK_IMAGECAL         (0x3B)
+#define SX_FSK_IRQFLAGS1        (0x3E)
+#define SX_FSK_IRQFLAGS2        (0x3F)
+
+#define SX_MODEM_LORA           (0x80)
+#define SX_MODE_MASK            (0x07)
+#define SX_MODE_SLEEP           (0)
+#define SX_MODE_STANDBY         (1)
+#define SX_MODE_TX              (3)
+#define SX_MODE_RXCONT          (5)
+#define SX_MODE_RXSINGLE        (6)
+
+#define SX_LORA_IRQ_RXTIMEOUT   (0x80)
+#define SX_LORA_IRQ_RXDONE      (0x40)
+#define SX_LORA_IRQ_CRCERROR    (0x20)
+#define SX_LORA_IRQ_VALIDHEADER (0x10)
+#define SX_LORA_IRQ_TXDONE      (0x08)
+
+#define SX_FSK_IRQ_FIFOFULL     (0x80)
+#define SX_FSK_IRQ_FIFOEMPTY    (0x40)
+#define SX_FSK_IRQ_FIFOLEVEL    (0x20)
+#define SX_FSK_IRQ_FIFOOVERRUN  (0x10)
+#define SX_FSK_IRQ_PACKETSENT   (0x08)
+#define SX_FSK_IRQ_PAYLOADREADY (0x04)
+#define SX_FSK_IRQ_CRCOK        (0x02)
+
+#define SX_FSK_FIFO_SIZE        (64U)
+/* CrcOnPayload of RegHopChannel */
+#define SX_LORA_CRC_ON_PAYLOAD  (0x40)
+/* +8 dB and -97 dBm, in the units of the packet registers */
+#define SX_LORA_PKT_SNR         (8 * 4)
+#define SX_LORA_PKT_RSSI        (60)
+/* Noise floor of the FSK RSSI when no level is scripted */
+#define SX_RSSI_FLOOR_DBM       (-120)
+
+/* The four timers of the radio, and those of the MAC and the SAL when
+ * the tests run them on top */
+#define EMU_SW_TIMERS           (24U)
+#define EMU_SW_TIMESTAMPS       (4U)
+
+sercom_registers_t radioEmuSercom4;
+port_registers_t radioEmuPort;
+
+static RadioEmuStats_t stats;
+static uint64_t now;
+
+/* SERCOM4 and the pins */
+static bool dataPending;
+static uint8_t spiRx[SPI_RX_BUFFER];
+static uint8_t spiRxCount;
+static uint32_t portOut[3];
+static bool csAsserted;
+static bool addressPhase;
+static bool spiWrite;
+static uint8_t spiAddress;
+static bool tcxoOn;
+static uint64_t tcxoOnTime;
+
+/* SX1276, the FSK registers hold the ones shared by both modems */
+static uint8_t fskRegs[0x80];
+static uint8_t loraRegs[0x80];
+static uint8_t loraFifo[256];
+static uint8_t loraRxAddr;
+static uint8_t fskFifo[SX_FSK_FIFO_SIZE];
+static uint8_t fskHead;
+static uint8_t fskCount;
+static bool fskOverrun;
+static bool packetSent;
+static bool payloadReady;
+static bool crcOk;
+static const int16_t *rssiScript;
+static uint8_t rssiCount;
+
+/* EIC */
+static struct
+{
+    EIC_CALLBACK callback;
+    uintptr_t context;
+    bool enabled;
+    bool pending;
+} eic[EIC_PIN_MAX];
+static unsigned isrDepth;
+static bool interruptsOn;
+/* EIC lines of DIO0, DIO1 and DIO2 */
+static const EIC_PIN dioPins[] = {EIC_PIN_0, EIC_PIN_11, EIC_PIN_12};
+
+/* Timers and tasks */
+static struct
+{
+    bool created;
+    bool loaded;
+    uint64_t expiry;
+    SwTimerCallbackFunc_t callback;
+    void *param;
+} swTimers[EMU_SW_TIMERS];
+static SwTimestamp_t swTimestamps[EMU_SW_TIMESTAMPS];
+static uint8_t swTimestampCount;
+static SwTimerCallbackFunc_t tickCallback;
+static uint64_t tickExpiry;
+static uint8_t tickFailures;
+static SYSTEM_Task_t tasksPosted;
+
+extern SYSTEM_TaskStatus_t RADIO_TaskHandler(void);
+/* Linked in by the tests that run the MAC */
+extern SYSTEM_TaskStatus_t LORAWAN_TaskHandler(void) __attribute__((weak));
+
+static void spiSync(void);
+
+static bool sxLora(void)
+{
+    return (0 != (fskRegs[SX_OPMODE] & SX_MODEM_LORA));
+}
+
+static uint8_t sxMode(void)
+{
+    return fskRegs[SX_OPMODE] & SX_MODE_MASK;
+}
+
+static uint8_t *sxBank(uint8_t reg)
+{
+    return (sxLora() && (reg >= SX_BANK_FIRST) && (reg <= SX_BANK_LAST)) ? loraRegs : fskRegs;
+}
+
+/* Power on and reset values */
+static void sxReset(void)
+{
+    memset(fskRegs, 0, sizeof(fskRegs));
+    memset(loraRegs, 0, sizeof(loraRegs));
+    memset(loraFifo, 0, sizeof(loraFifo));
+    fskRegs[SX_OPMODE] = 0x09;
+    fskRegs[0x06] = 0x6C;
+    fskRegs[0x07] = 0x80;
+    fskRegs[0x09] = 0x4F;
+    fskRegs[0x0A] = 0x09;
+    fskRegs[0x0B] = 0x2B;
+    fskRegs[0x0C] = 0x20;
+    fskRegs[SX_FSK_FIFOTHRESH] = 0x8F;
+    fskRegs[SX_VERSION] = 0x12;
+    fskRegs[0x4B] = 0x09;
+    fskRegs[0x4D] = 0x84;
+    loraRegs[SX_LORA_FIFOTXBASEADDR] = 0x80;
+    loraRegs[0x1D] = 0x72;
+    loraRegs[0x1E] = 0x70;
+    loraRegs[0x1F] = 0x64;
+    loraRegs[SX_LORA_PAYLOADLENGTH] = 0x01;
+    loraRegs[0x23] = 0xFF;
+    loraRegs[0x26] = 0x04;
+    loraRegs[0x31] = 0xC3;
+    loraRegs[0x33] = 0x27;
+    loraRegs[0x37] = 0x0A;
+    loraRegs[0x39] = 0x12;
+    loraRxAddr = 0;
+    fskHead = 0;
+    fskCount = 0;
+    fskOverrun = false;
+    packetSent = false;
+    payloadReady = false;
+    crcOk = false;
+}
+
+static void fskFlush(void)
+{
+    fskCount = 0;
+    fskOverrun = false;
+    payloadReady = false;
+    crcOk = false;
+}
+
+static bool fskPush(uint8_t value)
+{
+    if (SX_FSK_FIFO_SIZE == fskCount)
+    {
+        fskOverrun = true;
+        stats.fifoOverruns++;
+        return false;
+    }
+    fskFifo[(fskHead + fskCount) % SX_FSK_FIFO_SIZE] = value;
+    fskCount++;
+    return true;
+}
+
+static uint8_t fskPop(void)
+{
+    uint8_t value = fskFifo[fskHead];
+
+    fskHead = (fskHead + 1) % SX_FSK_FIFO_SIZE;
+    fskCount--;
+    return value;
+}
+
+static bool fskLevel(void)
+{
+    return (fskCount > (fskRegs[SX_FSK_FIFOTHRESH] & 0x3F));
+}
+
+static uint8_t fskIrqFlags2(void)
+{
+    uint8_t flags = 0;
+
+    flags |= (SX_FSK_FIFO_SIZE == fskCount) ? SX_FSK_IRQ_FIFOFULL : 0;
+    flags |= (0 == fskCount) ? SX_FSK_IRQ_FIFOEMPTY : 0;
+    flags |= fskLevel() ? SX_FSK_IRQ_FIFOLEVEL : 0;
+    flags |= fskOverrun ? SX_FSK_IRQ_FIFOOVERRUN : 0;
+    flags |= packetSent ? SX_FSK_IRQ_PACKETSENT : 0;
+    flags |= payloadReady ? SX_FSK_IRQ_PAYLOADREADY : 0;
+    flags |= crcOk ? SX_FSK_IRQ_CRCOK : 0;
+    return flags;
+}
+
+static uint8_t sxFifoRead(void)
+{
+    uint8_t value;
+
+    if (sxLora())
+    {
+        return loraFifo[loraRegs[SX_LORA_FIFOADDRPTR]++];
+    }
+    if (0 == fskCount)
+    {
+        stats.fifoEmptyReads++;
+        return 0;
+    }
+    value = fskPop();
+    if (0 == fskCount)
+    {
+        /* PayloadReady and CrcOk are cleared with the FIFO */
+        payloadReady = false;
+        crcOk = false;
+    }
+    return value;
+}
+
+static void sxSetOpMode(uint8_t value)
+{
+    uint8_t old = fskRegs[SX_OPMODE];
+    uint8_t mode = value & SX_MODE_MASK;
+    uint8_t oldMode = old & SX_MODE_MASK;
+
+    /* The modem can only be changed in sleep mode */
+    if ((SX_MODE_SLEEP != oldMode) && ((value ^ old) & SX_MODEM_LORA))
+    {
+        value = (value & ~SX_MODEM_LORA) | (old & SX_MODEM_LORA);
+    }
+    fskRegs[SX_OPMODE] = value;
+    if ((mode == oldMode) && (0 == ((value ^ old) & SX_MODEM_LORA)))
+    {
+        return;
+    }
+
+    /* The transmitter and the receiver run from the TCXO */
+    if ((mode > SX_MODE_STANDBY) && (!tcxoOn || (now < (tcxoOnTime + RADIO_EMU_TCXO_US))))
+    {
+        stats.unclockedModes++;
+    }
+    if ((SX_MODE_TX == oldMode) && (SX_MODE_TX != mode))
+    {
+        packetSent = false;
+    }
+    if (sxLora())
+    {
+        if (((SX_MODE_RXCONT == mode) || (SX_MODE_RXSINGLE == mode)) &&
+            (SX_MODE_RXCONT != oldMode) && (SX_MODE_RXSINGLE != oldMode))
+        {
+            loraRxAddr = loraRegs[SX_LORA_FIFORXBASEADDR];
+        }
+    }
+    else if ((SX_MODE_RXCONT == mode) && (SX_MODE_RXCONT != oldMode))
+    {
+        fskFlush();
+    }
+}
+
+static uint8_t sxRead(uint8_t reg)
+{
+    stats.regReads[reg]++;
+    if (SX_FIFO == reg)
+    {
+        return sxFifoRead();
+    }
+    if (!sxLora())
+    {
+        switch (reg)
+        {
+            case SX_FSK_RSSIVALUE:
+            {
+                int16_t dbm = SX_RSSI_FLOOR_DBM;
+
+                if (0 != rssiCount)
+                {
+                    dbm = rssiScript[(stats.rssiReads < rssiCount) ? stats.rssiReads : (rssiCount - 1U)];
+                }
+                stats.rssiReads++;
+                return (uint8_t)(-2 * dbm);
+            }
+            case SX_FSK_IMAGECAL:
+                /* The calibration completes at once */
+                return fskRegs[reg] & ~0x20;
+            case SX_FSK_IRQFLAGS2:
+                return fskIrqFlags2();
+            default:
+                break;
+        }
+    }
+    return sxBank(reg)[reg];
+}
+
+static void sxWrite(uint8_t reg, uint8_t value)
+{
+    stats.regWrites[reg]++;
+    if (SX_FIFO == reg)
+    {
+        if (sxLora())
+        {
+            loraFifo[loraRegs[SX_LORA_FIFOADDRPTR]++] = value;
+        }
+        else
+        {
+            (void)fskPush(value);
+        }
+    }
+    else if (SX_OPMODE == reg)
+    {
+        sxSetOpMode(value);
+    }
+    else if (SX_VERSION == reg)
+    {
+        /* Read only */
+    }
+    else if (sxLora() && (SX_LORA_IRQFLAGS == reg))
+    {
+        loraRegs[reg] &= ~value;
+    }
+    else if (!sxLora() && (SX_FSK_IRQFLAGS2 == reg))
+    {
+        /* Clearing FifoOverrun clears the FIFO */
+        if (value & SX_FSK_IRQ_FIFOOVERRUN)
+        {
+            fskFlush();
+        }
+    }
+    else if (!sxLora() && (SX_FSK_IRQFLAGS1 == reg))
+    {
+        /* Flags of the receiver, not emulated */
+    }
+    else
+    {
+        sxBank(reg)[reg] = value;
+    }
+}
+
+/* One byte on the SPI bus, returns the byte on MISO */
+static uint8_t spiClock(uint8_t mosi)
+{
+    uint8_t miso = 0;
+
+    stats.bytes++;
+    now += RADIO_EMU_BYTE_US;
+    if (!csAsserted)
+    {
+        stats.spiErrors++;
+        return 0xFF;
+    }
+
+    if (addressPhase)
+    {
+        addressPhase = false;
+        spiWrite = (0 != (mosi & 0x80));
+        spiAddress = mosi & 0x7F;
+        if (SX_FIFO == spiAddress)
+        {
+            stats.fifoTransactions++;
+        }
+        return 0;
+    }
+
+    if (spiWrite)
+    {
+        sxWrite(spiAddress, mosi);
+    }
+    else
+    {
+        miso = sxRead(spiAddress);
+    }
+    /* The FIFO address does not increment */
+    if (SX_FIFO != spiAddress)
+    {
+        spiAddress = (spiAddress + 1) & 0x7F;
+    }
+    return miso;
+}
+
+static void portSync(void)
+{
+    for (unsigned group = 0; group < 3; group++)
+    {
+        port_group_registers_t *regs = &radioEmuPort.GROUP[group];
+        uint32_t out = regs->PORT_OUT;
+        uint32_t changed;
+
+        out |= regs->OUTSET[0];
+        out &= ~regs->OUTCLR[0];
+        out ^= regs->OUTTGL[0];
+        regs->OUTSET[0] = 0;
+        regs->OUTCLR[0] = 0;
+        regs->OUTTGL[0] = 0;
+        regs->PORT_OUT = out;
+        regs->PORT_IN = out;
+        changed = out ^ portOut[group];
+        portOut[group] = out;
+
+        if ((PIN_CS_GROUP == group) && (changed & PIN_CS))
+        {
+            csAsserted = (0 == (out & PIN_CS));
+            if (csAsserted)
+            {
+                stats.transactions++;
+                addressPhase = true;
+            }
+        }
+        if ((PIN_RESET_GROUP == group) && (changed & PIN_RESET) && (0 == (out & PIN_RESET)))
+        {
+            sxReset();
+        }
+        if ((PIN_TCXO_GROUP == group) && (changed & PIN_TCXO))
+        {
+            tcxoOn = (0 != (out & PIN_TCXO));
+            if (tcxoOn)
+            {
+                stats.tcxoPowerOns++;
+            }
+            else
+            {
+                stats.tcxoOnUs += now - tcxoOnTime;
+            }
+            tcxoOnTime = now;
+        }
+    }
+}
+
+/* Resolves the access to DATA the HAL made last: a write if the HAL
+ * replaced the sentinel, a read otherwise */
+static void spiSync(void)
+{
+    portSync();
+    if (dataPending)
+    {
+        uint32_t data = radioEmuSercom4.SPIM.DATA[0];
+
+        dataPending = false;
+        if (SPI_SENTINEL != (data & 0xFFFF0000UL))
+        {
+            uint8_t miso = spiClock((uint8_t)data);
+
+            if (SPI_RX_BUFFER == spiRxCount)
+            {
+                /* BUFOVF, the byte is lost */
+                stats.spiErrors++;
+            }
+            else
+            {
+                spiRx[spiRxCount++] = miso;
+            }
+        }
+        else if (0 != spiRxCount)
+        {
+            spiRx[0] = spiRx[1];
+            spiRxCount--;
+        }
+        else
+        {
+            stats.spiErrors++;
+        }
+    }
+}
+
+uint8_t radioEmuSpiAccess(uint8_t reg)
+{
+    spiSync();
+    if (RADIO_EMU_SPI_DATA == reg)
+    {
+        radioEmuSercom4.SPIM.DATA[0] = SPI_SENTINEL | ((0 != spiRxCount) ? spiRx[0] : 0);
+        dataPending = true;
+    }
+    else
+    {
+        /* A byte is shifted out as soon as it is written */
+        radioEmuSercom4.SPIM.INTFLAG[0] = SERCOM_SPIM_INTFLAG_DRE_Msk | SERCOM_SPIM_INTFLAG_TXC_Msk |
+            ((0 != spiRxCount) ? SERCOM_SPIM_INTFLAG_RXC_Msk : 0);
+    }
+    return 0;
+}
+
+uint8_t radioEmuPortAccess(void)
+{
+    spiSync();
+    return 0;
+}
+
+bool SERCOM4_SPI_WriteRead(void *pTransmitData, size_t txSize, void *pReceiveData, size_t rxSize)
+{
+    size_t length = (txSize > rxSize) ? txSize : rxSize;
+
+    spiSync();
+    stats.plibTransfers++;
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t miso = spiClock((i < txSize) ? ((uint8_t *)pTransmitData)[i] : 0xFF);
+
+        if (i < rxSize)
+        {
+            ((uint8_t *)pReceiveData)[i] = miso;
+        }
+    }
+    return true;
+}
+
+static void runIsr(EIC_PIN pin)
+{
+    uint64_t start = now;
+
+    isrDepth++;
+    stats.interrupts++;
+    eic[pin].callback(eic[pin].context);
+    spiSync();
+    isrDepth--;
+    if ((now - start) > stats.isrMaxUs)
+    {
+        stats.isrMaxUs = now - start;
+    }
+}
+
+static void eicRaise(EIC_PIN pin)
+{
+    if (eic[pin].enabled && (NULL != eic[pin].callback))
+    {
+        runIsr(pin);
+    }
+    else
+    {
+        eic[pin].pending = true;
+    }
+}
+
+/* An event of the radio, routed to dio if RegDioMapping1 maps it there */
+static void sxDio(uint8_t dio, uint8_t mapping)
+{
+    uint8_t shift = 6 - (2 * dio);
+
+    if (mapping == ((fskRegs[SX_DIOMAPPING1] >> shift) & 0x03))
+    {
+        eicRaise(dioPins[dio]);
+    }
+}
+
+void EIC_CallbackRegister(EIC_PIN pin, EIC_CALLBACK callback, uintptr_t context)
+{
+    eic[pin].callback = callback;
+    eic[pin].context = context;
+}
+
+void EIC_InterruptEnable(EIC_PIN pin)
+{
+    eic[pin].enabled = true;
+    /* An edge latched while disabled interrupts at once */
+    if (eic[pin].pending && (NULL != eic[pin].callback))
+    {
+        eic[pin].pending = false;
+        runIsr(pin);
+    }
+}
+
+void EIC_InterruptDisable(EIC_PIN pin)
+{
+    eic[pin].enabled = false;
+}
+
+bool SYS_INT_Disable(void)
+{
+    bool state = interruptsOn;
+
+    stats.criticalSections++;
+    if (0 != isrDepth)
+    {
+        stats.isrCriticalSections++;
+    }
+    interruptsOn = false;
+    return state;
+}
+
+void SYS_INT_Enable(void)
+{
+    interruptsOn = true;
+}
+
+void SYS_INT_Restore(bool state)
+{
+    interruptsOn = state;
+}
+
+void system_enter_critical_section(void)
+{
+    (void)SYS_INT_Disable();
+}
+
+void system_leave_critical_section(void)
+{
+    SYS_INT_Enable();
+}
+
+/* pmm.c has its own when it is linked in */
+__attribute__((weak)) void PMM_Wakeup(RTC_TIMER32_INT_MASK intCause, uintptr_t context)
+{
+    (void)intCause;
+    (void)context;
+}
+
+void delay_us(uint32_t n)
+{
+    now += n;
+    stats.blockedUs += n;
+}
+
+void delay_ms(uint32_t n)
+{
+    delay_us(n * 1000U);
+}
+
+void SystemBlockingWaitMs(uint32_t ms)
+{
+    delay_ms(ms);
+}
+
+void SYSTEM_PostTask(SYSTEM_Task_t task)
+{
+    tasksPosted |= task & (RADIO_TASK_ID | LORAWAN_TASK_ID);
+}
+
+StackRetStatus_t SwTimerCreate(uint8_t *timerId)
+{
+    for (uint8_t id = 0; id < EMU_SW_TIMERS; id++)
+    {
+        if (!swTimers[id].created)
+        {
+            swTimers[id].created = true;
+            *timerId = id;
+            return LORAWAN_SUCCESS;
+        }
+    }
+    *timerId = SWTIMER_INVALID;
+    return LORAWAN_RESOURCE_UNAVAILABLE;
+}
+
+StackRetStatus_t SwTimerStart(uint8_t timerId, uint32_t timerCount,
+        SwTimeoutType_t timeoutType, void *timerCb, void *paramCb)
+{
+    uint32_t interval = timerCount;
+
+    if ((timerId >= EMU_SW_TIMERS) || !swTimers[timerId].created || swTimers[timerId].loaded)
+    {
+        return LORAWAN_INVALID_REQUEST;
+    }
+    if (SW_TIMEOUT_ABSOLUTE == timeoutType)
+    {
+        interval = timerCount - (uint32_t)now;
+    }
+    if ((interval < SWTIMER_MIN_TIMEOUT) || (interval > SWTIMER_MAX_TIMEOUT))
+    {
+        return LORAWAN_INVALID_PARAMETER;
+    }
+
+    swTimers[timerId].loaded = true;
+    swTimers[timerId].expiry = now + interval;
+    swTimers[timerId].callback = (SwTimerCallbackFunc_t)timerCb;
+    swTimers[timerId].param = paramCb;
+    return LORAWAN_SUCCESS;
+}
+
+StackRetStatus_t SwTimerStop(uint8_t timerId)
+{
+    if (timerId < EMU_SW_TIMERS)
+    {
+        swTimers[timerId].loaded = false;
+    }
+    return LORAWAN_SUCCESS;
+}
+
+bool SwTimerIsRunning(uint8_t timerid)
+{
+    return (timerid < EMU_SW_TIMERS) && swTimers[timerid].loaded;
+}
+
+uint32_t SwTimerReadValue(uint8_t timerId)
+{
+    if ((timerId >= EMU_SW_TIMERS) || !swTimers[timerId].loaded || (swTimers[timerId].expiry <= now))
+    {
+        return 0;
+    }
+    return (uint32_t)(swTimers[timerId].expiry - now);
+}
+
+uint64_t SwTimerGetTime(void)
+{
+    return now;
+}
+
+StackRetStatus_t SwTimerTimestampCreate(uint8_t *timestampId)
+{
+    if (swTimestampCount >= EMU_SW_TIMESTAMPS)
+    {
+        return LORAWAN_RESOURCE_UNAVAILABLE;
+    }
+    *timestampId = swTimestampCount++;
+    return LORAWAN_SUCCESS;
+}
+
+void SwTimerReadTimestamp(uint8_t index, SwTimestamp_t *timestamp)
+{
+    *timestamp = swTimestamps[index];
+}
+
+void SwTimerWriteTimestamp(uint8_t index, SwTimestamp_t *timestamp)
+{
+    swTimestamps[index] = *timestamp;
+}
+
+void SwTimerReset(void)
+{
+    memset(swTimers, 0, sizeof(swTimers));
+    tickCallback = NULL;
+}
+
+uint32_t SwTimerNextExpiryDuration(void)
+{
+    uint32_t duration = SWTIMER_INVALID_TIMEOUT;
+
+    for (uint8_t id = 0; id < EMU_SW_TIMERS; id++)
+    {
+        if (swTimers[id].loaded)
+        {
+            uint32_t left = (swTimers[id].expiry > now) ? (uint32_t)(swTimers[id].expiry - now) : 0;
+
+            if (left < duration)
+            {
+                duration = left;
+            }
+        }
+    }
+    return duration;
+}
+
+StackRetStatus_t SwTimerTickStart(uint32_t timerCount, void *timerCb)
+{
+    if ((NULL == timerCb) || (timerCount < SWTIMER_TICK_MIN_TIMEOUT) || (timerCount > SWTIMER_MIN_TIMEOUT))
+    {
+        return LORAWAN_INVALID_PARAMETER;
+    }
+    if (tickFailures > 0)
+    {
+        tickFailures--;
+        return LORAWAN_INVALID_PARAMETER;
+    }
+    if (NULL != tickCallback)
+    {
+        stats.tickOverwrites++;
+    }
+    tickCallback = (SwTimerCallbackFunc_t)timerCb;
+    tickExpiry = now + timerCount;
+    return LORAWAN_SUCCESS;
+}
+
+void SwTimerTickStop(void)
+{
+    tickCallback = NULL;
+}
+
+void radioEmuInit(void)
+{
+    memset(&radioEmuSercom4, 0, sizeof(radioEmuSercom4));
+    memset(&radioEmuPort, 0, sizeof(radioEmuPort));
+    memset(portOut, 0, sizeof(portOut));
+    memset(eic, 0, sizeof(eic));
+    memset(swTimers, 0, sizeof(swTimers));
+    memset(swTimestamps, 0, sizeof(swTimestamps));
+    swTimestampCount = 0;
+    dataPending = false;
+    spiRxCount = 0;
+    csAsserted = false;
+    addressPhase = false;
+    tcxoOn = false;
+    tcxoOnTime = 0;
+    isrDepth = 0;
+    interruptsOn = true;
+    tickCallback = NULL;
+    tickFailures = 0;
+    tasksPosted = 0;
+    rssiScript = NULL;
+    rssiCount = 0;
+    now = 0;
+    sxReset();
+    radioEmuResetStats();
+}
+
+const RadioEmuStats_t *radioEmuStats(void)
+{
+    spiSync();
+    return &stats;
+}
+
+void radioEmuResetStats(void)
+{
+    spiSync();
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint8_t radioEmuReg(uint8_t reg)
+{
+    spiSync();
+    return sxBank(reg)[reg];
+}
+
+uint8_t radioEmuOpMode(void)
+{
+    spiSync();
+    return fskRegs[SX_OPMODE];
+}
+
+bool radioEmuTcxoOn(void)
+{
+    spiSync();
+    return tcxoOn;
+}
+
+void radioEmuSetRssi(const int16_t *dbm, uint8_t count)
+{
+    rssiScript = dbm;
+    rssiCount = count;
+}
+
+bool radioEmuLoraReceive(const uint8_t *frame, uint8_t length, bool crcValid)
+{
+    uint8_t start = loraRxAddr;
+
+    spiSync();
+    if (!sxLora() || ((SX_MODE_RXCONT != sxMode()) && (SX_MODE_RXSINGLE != sxMode())))
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        loraFifo[(uint8_t)(start + i)] = frame[i];
+    }
+    loraRxAddr = start + length;
+    loraRegs[SX_LORA_RXCURRENTADDR] = start;
+    loraRegs[SX_LORA_RXNBBYTES] = length;
+    loraRegs[SX_LORA_PKTSNRVALUE] = SX_LORA_PKT_SNR;
+    loraRegs[SX_LORA_PKTRSSIVALUE] = SX_LORA_PKT_RSSI;
+    loraRegs[SX_LORA_HOPCHANNEL] = SX_LORA_CRC_ON_PAYLOAD;
+    loraRegs[SX_LORA_IRQFLAGS] |= SX_LORA_IRQ_RXDONE | SX_LORA_IRQ_VALIDHEADER |
+        (crcValid ? 0 : SX_LORA_IRQ_CRCERROR);
+    if (SX_MODE_RXSINGLE == sxMode())
+    {
+        fskRegs[SX_OPMODE] = (fskRegs[SX_OPMODE] & ~SX_MODE_MASK) | SX_MODE_STANDBY;
+    }
+    sxDio(0, 0);
+    return true;
+}
+
+bool radioEmuLoraRxTimeout(void)
+{
+    spiSync();
+    if (!sxLora() || (SX_MODE_RXSINGLE != sxMode()))
+    {
+        return false;
+    }
+
+    loraRegs[SX_LORA_IRQFLAGS] |= SX_LORA_IRQ_RXTIMEOUT;
+    fskRegs[SX_OPMODE] = (fskRegs[SX_OPMODE] & ~SX_MODE_MASK) | SX_MODE_STANDBY;
+    sxDio(1, 0);
+    return true;
+}
+
+bool radioEmuLoraTxDone(uint8_t *frame, uint8_t *length)
+{
+    uint8_t base = loraRegs[SX_LORA_FIFOTXBASEADDR];
+
+    spiSync();
+    if (!sxLora() || (SX_MODE_TX != sxMode()))
+    {
+        return false;
+    }
+
+    *length = loraRegs[SX_LORA_PAYLOADLENGTH];
+    for (uint8_t i = 0; i < *length; i++)
+    {
+        frame[i] = loraFifo[(uint8_t)(base + i)];
+    }
+    loraRegs[SX_LORA_IRQFLAGS] |= SX_LORA_IRQ_TXDONE;
+    fskRegs[SX_OPMODE] = (fskRegs[SX_OPMODE] & ~SX_MODE_MASK) | SX_MODE_STANDBY;
+    sxDio(0, 1);
+    return true;
+}
+
+bool radioEmuFskReceive(const uint8_t *payload, uint8_t length, bool crcValid, uint32_t byteUs)
+{
+    uint64_t start;
+
+    spiSync();
+    if (sxLora() || (SX_MODE_RXCONT != sxMode()))
+    {
+        return false;
+    }
+
+    /* SyncAddress, then the length byte and the payload */
+    sxDio(2, 3);
+    start = now;
+    for (unsigned i = 0; i <= length; i++)
+    {
+        uint64_t arrival = start + ((uint64_t)(i + 1) * byteUs);
+        bool level = fskLevel();
+
+        if (sxLora() || (SX_MODE_RXCONT != sxMode()))
+        {
+            break;
+        }
+        /* The bytes that arrived during an interrupt are caught up */
+        if (now < arrival)
+        {
+            now = arrival;
+        }
+        (void)fskPush((0 == i) ? length : payload[i - 1]);
+
+        if (i == length)
+        {
+            payloadReady = true;
+            crcOk = crcValid;
+            /* DIO0 is served before DIO1 by the EIC */
+            sxDio(0, 0);
+        }
+        if (!level && fskLevel())
+        {
+            sxDio(1, 0);
+        }
+    }
+    return true;
+}
+
+bool radioEmuFskTransmit(uint8_t *payload, uint8_t *length, uint32_t byteUs)
+{
+    uint64_t start;
+    unsigned total = 1;
+
+    spiSync();
+    if (sxLora() || (SX_MODE_TX != sxMode()))
+    {
+        return false;
+    }
+
+    /* The length byte, then the payload */
+    start = now;
+    for (unsigned i = 0; i < total; i++)
+    {
+        uint64_t due = start + ((uint64_t)i * byteUs);
+        uint8_t value;
+
+        if (now < due)
+        {
+            now = due;
+        }
+        if (0 == fskCount)
+        {
+            stats.fifoUnderruns++;
+            break;
+        }
+        value = fskPop();
+        if (0 == i)
+        {
+            *length = value;
+            total = 1U + value;
+        }
+        else
+        {
+            payload[i - 1] = value;
+        }
+        if (0 == fskCount)
+        {
+            /* FifoEmpty, the next byte is due one byte time later */
+            sxDio(1, 1);
+            if (((i + 1) < total) && (now > (due + byteUs)))
+            {
+                stats.fifoUnderruns++;
+            }
+        }
+    }
+
+    /* The last byte is shifted out */
+    if (now < (start + ((uint64_t)total * byteUs)))
+    {
+        now = start + ((uint64_t)total * byteUs);
+    }
+    packetSent = true;
+    sxDio(0, 0);
+    return true;
+}
+
+uint64_t radioEmuTime(void)
+{
+    spiSync();
+    return now;
+}
+
+void radioEmuElapse(uint32_t us)
+{
+    spiSync();
+    now += us;
+}
+
+static void runEnded(uint64_t start)
+{
+    spiSync();
+    if ((now - start) > stats.runMaxUs)
+    {
+        stats.runMaxUs = now - start;
+    }
+}
+
+bool radioEmuRunOne(void)
+{
+    uint64_t start;
+
+    spiSync();
+    start = now;
+    if (tasksPosted & RADIO_TASK_ID)
+    {
+        tasksPosted &= ~RADIO_TASK_ID;
+        RADIO_TaskHandler();
+    }
+    else if ((tasksPosted & LORAWAN_TASK_ID) && (NULL != LORAWAN_TaskHandler))
+    {
+        tasksPosted &= ~LORAWAN_TASK_ID;
+        LORAWAN_TaskHandler();
+    }
+    else
+    {
+        return false;
+    }
+    runEnded(start);
+    return true;
+}
+
+void radioEmuRunTasks(void)
+{
+    while (radioEmuRunOne())
+    {
+    }
+}
+
+bool radioEmuTickArmed(void)
+{
+    return (NULL != tickCallback);
+}
+
+void radioEmuFailTick(uint8_t count)
+{
+    tickFailures = count;
+}
+
+void radioEmuRunUntil(uint64_t time)
+{
+    for (;;)
+    {
+        uint64_t next = UINT64_MAX;
+        int timer = -1;
+
+        radioEmuRunTasks();
+        if ((NULL != tickCallback) && (tickExpiry < next))
+        {
+            next = tickExpiry;
+        }
+        for (uint8_t id = 0; id < EMU_SW_TIMERS; id++)
+        {
+            if (swTimers[id].loaded && (swTimers[id].expiry < next))
+            {
+                next = swTimers[id].expiry;
+                timer = id;
+            }
+        }
+        if ((UINT64_MAX == next) || (next > time))
+        {
+            break;
+        }
+        if (now < next)
+        {
+            now = next;
+        }
+
+        if ((NULL != tickCallback) && (tickExpiry == next))
+        {
+            SwTimerCallbackFunc_t callback = tickCallback;
+
+            /* One shot, from the TC0 interrupt */
+            tickCallback = NULL;
+            isrDepth++;
+            callback(NULL);
+            spiSync();
+            isrDepth--;
+        }
+        else
+        {
+            uint64_t start = now;
+
+            swTimers[timer].loaded = false;
+            if (NULL != swTimers[timer].callback)
+            {
+                swTimers[timer].callback(swTimers[timer].param);
+            }
+            runEnded(start);
+        }
+    }
+    if (now < time)
+    {
+        now = time;
+    }
+}
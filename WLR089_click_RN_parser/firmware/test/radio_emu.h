@@ -0,0 +1,112 @@
+/**
+* \file  radio_emu.h
+*
+* \brief SX1276 emulator of the host tests, behind the SERCOM4, PORT and EIC
+*        of the radio HAL. Every SPI transaction and transfer is counted,
+*        the registers, the LoRa and FSK FIFOs and the DIO interrupts follow
+*        the data sheet closely enough to run the radio layer unchanged.
+*        Time is virtual: the SPI clocks a byte per microsecond, the delay
+*        functions and the idle periods move it on, and the SW timers
+*        expire on it.
+*/
+#ifndef RADIO_EMU_H
+#define RADIO_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* SPI clock of the radio HAL, 8 MHz */
+#define RADIO_EMU_BYTE_US       (1U)
+
+/* Start up time of the TCXO, RADIO_CLK_STABILITATION_DELAY of conf_radio.h */
+#define RADIO_EMU_TCXO_US       (2000U)
+
+/* Bit time of the FSK bit rate the radio layer defaults to, 50 kb/s */
+#define RADIO_EMU_FSK_BYTE_US   (160U)
+
+typedef struct _RadioEmuStats
+{
+    /* SPI: CS assertions, those on the FIFO register, calls of the
+     * peripheral library and bytes clocked, address bytes included */
+    uint32_t transactions;
+    uint32_t fifoTransactions;
+    uint32_t plibTransfers;
+    uint32_t bytes;
+    /* Bytes lost in the receive buffer of the SERCOM, clocked with CS
+     * deasserted, or DATA read with no byte received */
+    uint32_t spiErrors;
+    /* Register accesses, a burst counts each register it goes through */
+    uint16_t regReads[0x80];
+    uint16_t regWrites[0x80];
+    uint32_t rssiReads;
+    /* FSK FIFO: bytes received while full, bytes the transmitter found
+     * missing and reads while empty */
+    uint32_t fifoOverruns;
+    uint32_t fifoUnderruns;
+    uint32_t fifoEmptyReads;
+    /* Critical sections, all of them and those taken in an interrupt */
+    uint32_t criticalSections;
+    uint32_t isrCriticalSections;
+    /* DIO interrupts run, and the longest one */
+    uint32_t interrupts;
+    uint64_t isrMaxUs;
+    /* RX or TX entered before the TCXO was stable */
+    uint32_t unclockedModes;
+    /* Time spent in the delay functions */
+    uint64_t blockedUs;
+    /* Tick timer started again while armed, its first user is lost */
+    uint32_t tickOverwrites;
+    /* TCXO power ups, and the time it was powered */
+    uint32_t tcxoPowerOns;
+    uint64_t tcxoOnUs;
+    /* Longest run of a task or of a SW timer callback, nothing else runs
+     * in the meantime */
+    uint64_t runMaxUs;
+} RadioEmuStats_t;
+
+/* Powers the radio on, clears the stats, the timers and the tasks, and
+ * sets the time back to 0 */
+void radioEmuInit(void);
+
+const RadioEmuStats_t *radioEmuStats(void);
+void radioEmuResetStats(void);
+
+/* Register of the modem selected by RegOpMode, without side effects */
+uint8_t radioEmuReg(uint8_t reg);
+/* Operating mode, the modem in bit 7 */
+uint8_t radioEmuOpMode(void);
+bool radioEmuTcxoOn(void);
+
+/* Channel power returned by the FSK RSSI register, one value per read in
+ * dBm, the last one repeats */
+void radioEmuSetRssi(const int16_t *dbm, uint8_t count);
+
+/* A LoRa frame is received, with or without its CRC valid. The header
+ * has a CRC. Returns false if the radio was not receiving */
+bool radioEmuLoraReceive(const uint8_t *frame, uint8_t length, bool crcOk);
+/* The single reception ends without a frame */
+bool radioEmuLoraRxTimeout(void);
+/* The LoRa transmission ends, the frame sent is copied to frame */
+bool radioEmuLoraTxDone(uint8_t *frame, uint8_t *length);
+
+/* An FSK packet is received, a byte every byteUs after the sync word.
+ * The interrupts run as the bytes arrive */
+bool radioEmuFskReceive(const uint8_t *payload, uint8_t length, bool crcOk, uint32_t byteUs);
+/* The FSK transmitter sends the FIFO, a byte every byteUs, until the
+ * packet is sent. The payload sent is copied to payload */
+bool radioEmuFskTransmit(uint8_t *payload, uint8_t *length, uint32_t byteUs);
+
+uint64_t radioEmuTime(void);
+/* Moves the time on, for the other peripherals of the tests */
+void radioEmuElapse(uint32_t us);
+/* Runs the radio task, or the MAC task if linked in, false if none was
+ * posted */
+bool radioEmuRunOne(void);
+void radioEmuRunTasks(void);
+/* Runs the tasks and the timers, idle in between, up to time */
+void radioEmuRunUntil(uint64_t time);
+bool radioEmuTickArmed(void);
+/* The next count starts of the tick timer fail */
+void radioEmuFailTick(uint8_t count);
+
+#endif /* RADIO_EMU_H */
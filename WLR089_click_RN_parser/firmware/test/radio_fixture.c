@@ -0,0 +1,59 @@
+/**
+* \file  radio_fixture.c
+*
+* \brief Radio layer of the host tests.
+*/
+#include <string.h>
+#include "radio_fixture.h"
+#include "radio_emu.h"
+#include "radio_driver_hal.h"
+
+RadioFixtureEvent_t radioFixtureEvents[FIXTURE_RADIO_EVENTS];
+uint8_t radioFixtureEventCount;
+
+void radioFixtureRecord(RadioCallbackID_t callback, void *param)
+{
+    RadioCallbackParam_t *cbParam = (RadioCallbackParam_t *)param;
+    RadioFixtureEvent_t *event;
+
+    if (radioFixtureEventCount >= FIXTURE_RADIO_EVENTS)
+    {
+        return;
+    }
+    event = &radioFixtureEvents[radioFixtureEventCount++];
+    event->id = callback;
+    event->status = cbParam->status;
+    event->length = 0;
+    event->time = radioEmuTime();
+    if ((RADIO_RX_DONE_CALLBACK == callback) && (NULL != cbParam->RX.buffer))
+    {
+        event->length = cbParam->RX.bufferLength;
+        memcpy(event->buffer, cbParam->RX.buffer, event->length);
+    }
+}
+
+void radioFixtureBoot(void)
+{
+    radioEmuInit();
+    HAL_RadioInit();
+    RADIO_Init();
+    radioEmuRunTasks();
+    (void)RADIO_SetAttr(RADIO_CALLBACK, (void *)radioFixtureRecord);
+
+    memset(radioFixtureEvents, 0, sizeof(radioFixtureEvents));
+    radioFixtureEventCount = 0;
+    radioEmuResetStats();
+}
+
+void radioFixtureLoRa(uint32_t frequency, RadioDataRate_t sf, bool iqInverted)
+{
+    RadioModulation_t modulation = MODULATION_LORA;
+    RadioLoRaBandWidth_t bandwidth = BW_125KHZ;
+    uint8_t iq = iqInverted ? 1 : 0;
+
+    (void)RADIO_SetAttr(MODULATION, &modulation);
+    (void)RADIO_SetAttr(CHANNEL_FREQUENCY, &frequency);
+    (void)RADIO_SetAttr(SPREADING_FACTOR, &sf);
+    (void)RADIO_SetAttr(BANDWIDTH, &bandwidth);
+    (void)RADIO_SetAttr(IQINVERTED, &iq);
+}
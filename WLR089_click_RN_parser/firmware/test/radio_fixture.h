@@ -0,0 +1,44 @@
+/**
+* \file  radio_fixture.h
+*
+* \brief Radio layer of the host tests, booted on the SX1276 emulator, with
+*        a callback that records what the radio reports to the MAC.
+*/
+#ifndef RADIO_FIXTURE_H
+#define RADIO_FIXTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio_interface.h"
+
+#define FIXTURE_RADIO_EVENTS    (8)
+
+/* EU868 channel 0 and the RX2 channel */
+#define FIXTURE_FREQ_868100     (868100000UL)
+#define FIXTURE_FREQ_869525     (869525000UL)
+
+typedef struct _RadioFixtureEvent
+{
+    RadioCallbackID_t id;
+    RadioError_t status;
+    uint8_t buffer[UINT8_MAX];
+    uint8_t length;
+    /* Time of the callback on the emulator */
+    uint64_t time;
+} RadioFixtureEvent_t;
+
+extern RadioFixtureEvent_t radioFixtureEvents[FIXTURE_RADIO_EVENTS];
+extern uint8_t radioFixtureEventCount;
+
+/* The recording callback, for the callbacks of the tests to chain */
+void radioFixtureRecord(RadioCallbackID_t callback, void *param);
+
+/* Powers the emulator on, inits the HAL and the radio layer, registers the
+ * recording callback and runs the tasks the init posted. The stats and
+ * the events are cleared */
+void radioFixtureBoot(void);
+
+/* Sets the LoRa channel of the next transmission or reception, 125 kHz */
+void radioFixtureLoRa(uint32_t frequency, RadioDataRate_t sf, bool iqInverted);
+
+#endif /* RADIO_FIXTURE_H */
@@ -0,0 +1,185 @@
+/**
+* \file  definitions.h
+*
+* \brief Host build stand-in for the Harmony definitions.h. It declares the
+*        NVMCTRL peripheral library, implemented by nvm_emu.c, the SysTick
+*        used by sys.h, and the SERCOM4, PORT and EIC of the radio HAL,
+*        implemented by radio_emu.c.
+*/
+#ifndef DEFINITIONS_H_HOST_STUB
+#define DEFINITIONS_H_HOST_STUB
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* NVMCTRL, as generated for the SAMR34J18B */
+#define NVMCTRL_FLASH_START_ADDRESS        (0x00000000U)
+#define NVMCTRL_FLASH_PAGESIZE             (64U)
+#define NVMCTRL_FLASH_ROWSIZE              (256U)
+/* Out of the way of the host executable, nvm_emu.c maps the RWWEE there */
+#define NVMCTRL_RWWEEPROM_START_ADDRESS    (0x20000000U)
+#define NVMCTRL_RWWEEPROM_SIZE             (0x2000U)
+#define NVMCTRL_RWWEEPROM_PAGESIZE         (64U)
+
+typedef uint16_t NVMCTRL_ERROR;
+#define NVMCTRL_ERROR_NONE                 (0x0U)
+#define NVMCTRL_ERROR_PROG                 (0x4U)
+#define NVMCTRL_ERROR_LOCK                 (0x8U)
+
+#define NVMCTRL_INTENCLR_READY_Msk         (0x1U)
+#define NVMCTRL_INTENSET_READY_Msk         (0x1U)
+
+typedef struct
+{
+    volatile uint8_t NVMCTRL_INTENCLR;
+    volatile uint8_t NVMCTRL_INTENSET;
+} nvmctrl_registers_t;
+
+extern nvmctrl_registers_t nvmEmuRegs;
+#define NVMCTRL_REGS                       (&nvmEmuRegs)
+
+#define NVMCTRL_IRQn                       (0)
+#define NVIC_ClearPendingIRQ(irq)          ((void)(irq))
+#define NVIC_EnableIRQ(irq)                ((void)(irq))
+
+/* SysTick, used by the delay helpers of sys.h */
+typedef struct
+{
+    volatile uint32_t VAL;
+} SysTick_Type;
+
+extern SysTick_Type nvmEmuSysTick;
+#define SysTick                            (&nvmEmuSysTick)
+
+static inline void SYSTICK_TimerPeriodSet(uint32_t period) { (void)period; }
+static inline bool SYSTICK_TimerPeriodHasExpired(void) { return true; }
+
+bool NVMCTRL_Read(uint32_t *data, uint32_t length, const uint32_t address);
+bool NVMCTRL_PageWrite(uint32_t *data, const uint32_t address);
+bool NVMCTRL_RowErase(uint32_t address);
+bool NVMCTRL_RWWEEPROM_PageWrite(uint32_t *data, const uint32_t address);
+bool NVMCTRL_RWWEEPROM_RowErase(uint32_t address);
+NVMCTRL_ERROR NVMCTRL_ErrorGet(void);
+bool NVMCTRL_IsBusy(void);
+void NVMCTRL_RegionUnlock(uint32_t address);
+void NVMCTRL_CacheInvalidate(void);
+
+/* SERCOM4 in SPI master mode, wired to the radio */
+#define SERCOM_SPIM_CTRLA_ENABLE_Msk       (0x2U)
+#define SERCOM_SPIM_INTENCLR_Msk           (0x8FU)
+#define SERCOM_SPIM_INTFLAG_Msk            (0x8FU)
+#define SERCOM_SPIM_INTFLAG_DRE_Msk        (0x1U)
+#define SERCOM_SPIM_INTFLAG_TXC_Msk        (0x2U)
+#define SERCOM_SPIM_INTFLAG_RXC_Msk        (0x4U)
+#define SERCOM_SPIM_INTFLAG_ERROR_Msk      (0x80U)
+#define SERCOM_SPIM_STATUS_BUFOVF_Msk      (0x4U)
+
+/* The registers whose accesses have side effects are one element arrays,
+ * indexed through radioEmuSpiAccess() so that the emulator sees each access */
+#define RADIO_EMU_SPI_INTFLAG              (0U)
+#define RADIO_EMU_SPI_DATA                 (1U)
+
+uint8_t radioEmuSpiAccess(uint8_t reg);
+
+typedef struct
+{
+    volatile uint32_t SERCOM_CTRLA;
+    volatile uint32_t SERCOM_SYNCBUSY;
+    volatile uint8_t SERCOM_INTENCLR;
+    volatile uint8_t INTFLAG[1];
+    volatile uint16_t SERCOM_STATUS;
+    volatile uint32_t DATA[1];
+} sercom_spim_registers_t;
+
+typedef union
+{
+    sercom_spim_registers_t SPIM;
+} sercom_registers_t;
+
+extern sercom_registers_t radioEmuSercom4;
+#define SERCOM4_REGS                       (&radioEmuSercom4)
+#define SERCOM_INTFLAG                     INTFLAG[radioEmuSpiAccess(RADIO_EMU_SPI_INTFLAG)]
+#define SERCOM_DATA                        DATA[radioEmuSpiAccess(RADIO_EMU_SPI_DATA)]
+
+bool SERCOM4_SPI_WriteRead(void *pTransmitData, size_t txSize, void *pReceiveData, size_t rxSize);
+
+/* PORT, the write only set, clear and toggle registers are applied by the
+ * emulator at the next access */
+uint8_t radioEmuPortAccess(void);
+
+typedef struct
+{
+    volatile uint32_t PORT_DIR;
+    volatile uint32_t PORT_DIRCLR;
+    volatile uint32_t PORT_DIRSET;
+    volatile uint32_t PORT_OUT;
+    volatile uint32_t OUTCLR[1];
+    volatile uint32_t OUTSET[1];
+    volatile uint32_t OUTTGL[1];
+    volatile uint32_t PORT_IN;
+    volatile uint8_t PORT_PMUX[16];
+    volatile uint8_t PORT_PINCFG[32];
+} port_group_registers_t;
+
+typedef struct
+{
+    port_group_registers_t GROUP[3];
+} port_registers_t;
+
+extern port_registers_t radioEmuPort;
+#define PORT_REGS                          (&radioEmuPort)
+#define PORT_OUTCLR                        OUTCLR[radioEmuPortAccess()]
+#define PORT_OUTSET                        OUTSET[radioEmuPortAccess()]
+#define PORT_OUTTGL                        OUTTGL[radioEmuPortAccess()]
+
+/* EIC, the DIO lines of the radio */
+typedef enum
+{
+    EIC_PIN_0 = 0,
+    EIC_PIN_1,
+    EIC_PIN_2,
+    EIC_PIN_3,
+    EIC_PIN_4,
+    EIC_PIN_5,
+    EIC_PIN_6,
+    EIC_PIN_7,
+    EIC_PIN_8,
+    EIC_PIN_9,
+    EIC_PIN_10,
+    EIC_PIN_11,
+    EIC_PIN_12,
+    EIC_PIN_13,
+    EIC_PIN_14,
+    EIC_PIN_15,
+    EIC_PIN_MAX
+} EIC_PIN;
+
+typedef void (*EIC_CALLBACK)(uintptr_t context);
+
+void EIC_CallbackRegister(EIC_PIN pin, EIC_CALLBACK callback, uintptr_t context);
+void EIC_InterruptEnable(EIC_PIN pin);
+void EIC_InterruptDisable(EIC_PIN pin);
+
+/* Global interrupts, used by sys.h */
+bool SYS_INT_Disable(void);
+void SYS_INT_Enable(void);
+void SYS_INT_Restore(bool state);
+
+/* Wake up causes of pmm.h, and the sleep timer callback */
+typedef uint32_t RTC_TIMER32_INT_MASK;
+typedef void (*RTC_TIMER32_CALLBACK)(RTC_TIMER32_INT_MASK intCause, uintptr_t context);
+
+/* SERCOM1 in I2C master mode, wired to the ECC608. Its plib interface is
+ * implemented by ecc608_emu.c */
+typedef uint32_t SERCOM_I2C_ERROR;
+#define SERCOM_I2C_ERROR_NONE              (0U)
+#define SERCOM_I2C_ERROR_NAK               (1U)
+
+typedef struct
+{
+    uint32_t clkSpeed;
+} SERCOM_I2C_TRANSFER_SETUP;
+
+#endif /* DEFINITIONS_H_HOST_STUB */
@@ -0,0 +1,12 @@
+/**
+* \file  lora_test_main.h
+*
+* \brief Included by atomic.h in the UT build, the host tests run without
+*        interrupts so the critical sections are empty.
+*/
+#ifndef LORA_TEST_MAIN_H
+#define LORA_TEST_MAIN_H
+
+#include <stdio.h>
+
+#endif /* LORA_TEST_MAIN_H */
@@ -0,0 +1,12 @@
+/**
+* \file  xc.h
+*
+* \brief Host build stand-in for the compiler's device header.
+*/
+#ifndef XC_H_HOST_STUB
+#define XC_H_HOST_STUB
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#endif /* XC_H_HOST_STUB */
@@ -0,0 +1,35 @@
+/**
+* \file  sw_timer_stub.c
+*
+* \brief Software timers of the host tests. No timer can be created, so
+*        the PDS writes every store right away instead of waiting for its
+*        quiet period.
+*/
+#include "sw_timer.h"
+
+StackRetStatus_t SwTimerCreate(uint8_t *timerId)
+{
+    *timerId = SWTIMER_INVALID;
+    return LORAWAN_RESOURCE_UNAVAILABLE;
+}
+
+StackRetStatus_t SwTimerStart(uint8_t timerId, uint32_t timerCount,
+        SwTimeoutType_t timeoutType, void *timerCb, void *paramCb)
+{
+    return LORAWAN_INVALID_PARAMETER;
+}
+
+StackRetStatus_t SwTimerStop(uint8_t timerId)
+{
+    return LORAWAN_INVALID_PARAMETER;
+}
+
+bool SwTimerIsRunning(uint8_t timerid)
+{
+    return false;
+}
+
+uint64_t SwTimerGetTime(void)
+{
+    return 0;
+}
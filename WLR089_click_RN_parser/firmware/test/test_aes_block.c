@@ -0,0 +1,160 @@
+/**
+* \file  test_aes_block.c
+*
+* \brief Host test of the 128-bit block operations of the CMAC and CTR
+*        computations. AESBlockDouble must derive the CMAC subkeys of
+*        RFC 4493, AESBlockXor must give the same result on its word path
+*        and its byte path, in place or not, and AESBlockXorPartial must
+*        only touch the bytes it is given.
+*/
+#include <stdbool.h>
+#include <string.h>
+#include "test_common.h"
+#include "aes_engine.h"
+#include "aes_block.h"
+
+int testFailures;
+
+/* RFC 4493 section 4, subkey generation for the key 2b7e1516 28aed2a6 abf71588 09cf4f3c */
+static const uint8_t rfcL[BLOCKSIZE] =
+{
+    0x7d, 0xf7, 0x6b, 0x0c, 0x1a, 0xb8, 0x99, 0xb3, 0x3e, 0x42, 0xf0, 0x47, 0xb9, 0x1b, 0x54, 0x6f
+};
+static const uint8_t rfcK1[BLOCKSIZE] =
+{
+    0xfb, 0xee, 0xd6, 0x18, 0x35, 0x71, 0x33, 0x66, 0x7c, 0x85, 0xe0, 0x8f, 0x72, 0x36, 0xa8, 0xde
+};
+static const uint8_t rfcK2[BLOCKSIZE] =
+{
+    0xf7, 0xdd, 0xac, 0x30, 0x6a, 0xe2, 0x66, 0xcc, 0xf9, 0x0b, 0xc1, 0x1e, 0xe4, 0x6d, 0x51, 0x3b
+};
+
+/* Room for a block at any of the four offsets from a word boundary, with a
+ * guard byte on each side */
+typedef union _TestBlock
+{
+    uint32_t align;
+    uint8_t bytes[1 + BLOCKSIZE + 3 + 1];
+} TestBlock_t;
+
+#define GUARD                   (0xA5)
+
+static void fillBlock(uint8_t *block, uint8_t seed)
+{
+    for (unsigned i = 0; i < BLOCKSIZE; i++)
+    {
+        block[i] = (uint8_t)(seed * 37U + i * 11U + 1U);
+    }
+}
+
+/* L has its top bit clear, K1 has it set and takes Rb */
+static void checkDouble(void *arg)
+{
+    uint8_t block[BLOCKSIZE];
+
+    (void)arg;
+    AESBlockDouble(block, rfcL);
+    TEST_CHECK(0 == memcmp(block, rfcK1, BLOCKSIZE));
+    AESBlockDouble(block, rfcK1);
+    TEST_CHECK(0 == memcmp(block, rfcK2, BLOCKSIZE));
+
+    /* In place, as the CMAC subkey generation calls it */
+    memcpy(block, rfcL, BLOCKSIZE);
+    AESBlockDouble(block, block);
+    TEST_CHECK(0 == memcmp(block, rfcK1, BLOCKSIZE));
+    AESBlockDouble(block, block);
+    TEST_CHECK(0 == memcmp(block, rfcK2, BLOCKSIZE));
+}
+
+/* Every alignment of the three buffers, the output also in place of a or b */
+static void checkXor(void *arg)
+{
+    static const char *const outNames[] = {"separate", "in a", "in b"};
+    TestBlock_t a, b, out;
+    uint8_t expected[BLOCKSIZE];
+
+    (void)arg;
+    for (unsigned offA = 0; offA < 4; offA++)
+    {
+        for (unsigned offB = 0; offB < 4; offB++)
+        {
+            for (unsigned offOut = 0; offOut < 4; offOut++)
+            {
+                for (unsigned where = 0; where < 3; where++)
+                {
+                    uint8_t *pa = &a.bytes[1 + offA];
+                    uint8_t *pb = &b.bytes[1 + offB];
+                    uint8_t *pout = (0 == where) ? &out.bytes[1 + offOut] : ((1 == where) ? pa : pb);
+
+                    memset(&a, GUARD, sizeof(a));
+                    memset(&b, GUARD, sizeof(b));
+                    memset(&out, GUARD, sizeof(out));
+                    fillBlock(pa, (uint8_t)(offA + 1));
+                    fillBlock(pb, (uint8_t)(offB + 7));
+                    for (unsigned i = 0; i < BLOCKSIZE; i++)
+                    {
+                        expected[i] = pa[i] ^ pb[i];
+                    }
+
+                    AESBlockXor(pout, pa, pb);
+                    if ((0 != memcmp(pout, expected, BLOCKSIZE)) || (GUARD != pout[-1]) || (GUARD != pout[BLOCKSIZE]))
+                    {
+                        testFailures++;
+                        fprintf(stderr, "AESBlockXor: a +%u b +%u out %s +%u wrong\n",
+                            offA, offB, outNames[where], (0 == where) ? offOut : 0);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Every length, the bytes from length on are left as they were */
+static void checkXorPartial(void *arg)
+{
+    TestBlock_t a, b, out;
+
+    (void)arg;
+    for (unsigned offset = 0; offset < 4; offset++)
+    {
+        for (uint8_t length = 0; length <= BLOCKSIZE; length++)
+        {
+            uint8_t *pa = &a.bytes[1 + offset];
+            uint8_t *pb = &b.bytes[1];
+            uint8_t *pout = &out.bytes[1 + ((offset + 1) % 4)];
+            bool ok;
+
+            memset(&out, GUARD, sizeof(out));
+            fillBlock(pa, 3);
+            fillBlock(pb, 5);
+
+            AESBlockXorPartial(pout, pa, pb, length);
+            ok = (GUARD == pout[-1]);
+            for (unsigned i = 0; i <= BLOCKSIZE; i++)
+            {
+                ok = ok && (pout[i] == ((i < length) ? (uint8_t)(pa[i] ^ pb[i]) : GUARD));
+            }
+            if (!ok)
+            {
+                testFailures++;
+                fprintf(stderr, "AESBlockXorPartial: length %u at +%u wrong\n", length, offset);
+            }
+
+            /* In place, as the last partial block of CTR is processed */
+            AESBlockXorPartial(pa, pa, pb, length);
+            for (unsigned i = 0; i < length; i++)
+            {
+                TEST_CHECK(pa[i] == pout[i]);
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    TEST_RUN(checkDouble, NULL);
+    TEST_RUN(checkXor, NULL);
+    TEST_RUN(checkXorPartial, NULL);
+
+    return testDone("test_aes_block");
+}
@@ -0,0 +1,69 @@
+/**
+* \file  test_common.h
+*
+* \brief Checks shared by the host tests. A test program runs its cases in
+*        child processes, so that each one boots from a clean RAM and a
+*        power cut only ends the child.
+*/
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern int testFailures;
+
+#define TEST_CHECK(cond)    do { \
+        if (!(cond)) { \
+            testFailures++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+/* Exit code of a child whose checks failed */
+#define TEST_CHILD_FAILED   (1)
+
+/* Runs fn in a child process and returns its exit code */
+static inline int testFork(void (*fn)(void *), void *arg)
+{
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (0 == pid)
+    {
+        testFailures = 0;
+        fn(arg);
+        fflush(stderr);
+        _exit((0 == testFailures) ? 0 : TEST_CHILD_FAILED);
+    }
+
+    if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status))
+    {
+        fprintf(stderr, "test: child process lost\n");
+        exit(2);
+    }
+
+    return WEXITSTATUS(status);
+}
+
+/* Runs a test case in a child process and counts it as failed if the child fails */
+#define TEST_RUN(fn, arg)   do { \
+        if (0 != testFork(fn, arg)) { \
+            testFailures++; \
+            fprintf(stderr, "%s: %s failed\n", __FILE__, #fn); \
+        } \
+    } while (0)
+
+/* Summary line and exit code of a test program */
+static inline int testDone(const char *name)
+{
+    printf("%s: %s\n", name, (0 == testFailures) ? "PASS" : "FAIL");
+    return (0 == testFailures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif /* TEST_COMMON_H */
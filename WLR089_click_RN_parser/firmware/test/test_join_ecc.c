@@ -0,0 +1,188 @@
+/**
+* \file  test_join_ecc.c
+*
+* \brief Host simulation of an OTAA join with the keys in the ATECC608,
+*        over the radio and ATECC608 emulators. The join accept is
+*        decrypted, authenticated and the session keys derived and read
+*        back in the background: from its reception to the join response
+*        no delay function of cryptoauthlib may run, and no task or timer
+*        callback may run for as long as an AES command executes. The
+*        session keys must be those of the network, with and without
+*        CFList. A join accept with a wrong MIC must not derive them, and
+*        one still being processed when the MAC is reset must be dropped.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "ecc608_emu.h"
+#include "lorawan_fixture.h"
+#include "lorawan_private.h"
+#include "conf_sal.h"
+
+#define JOIN_REQUEST_LIMIT_US   (10000000U)
+/* RX1 of the join accept, JOIN_ACCEPT_DELAY1 of EU868 */
+#define RX1_LIMIT_US            (6000000U)
+#define PROCESSING_LIMIT_US     (2000000U)
+/* The MAC is reset this long after the join accept is received */
+#define DROP_AFTER_US           (30000U)
+/* An AES per block decrypted and authenticated, one for the subkeys of
+ * the MIC, one per block. Without CFList the join accept is a block */
+#define AUTH_COMMANDS           (1U + 1U + 1U)
+#define AUTH_CFLIST_COMMANDS    (2U + 1U + 2U)
+/* Two KDF and seven commands to read each session key back */
+#define KEY_COMMANDS            (2U + (2U * 7U))
+#define AES_EXEC_US             (SAL_ECC_AES_EXEC_TIME_MS * 1000U)
+
+int testFailures;
+
+extern LoRa_t loRa;
+
+typedef enum _Scenario
+{
+    SCENARIO_JOIN = 0,
+    SCENARIO_JOIN_CFLIST,
+    SCENARIO_BAD_MIC,
+    SCENARIO_DROPPED,
+    SCENARIOS
+} Scenario_t;
+
+static const char *const scenarioNames[SCENARIOS] = {"join", "join with CFList", "wrong MIC", "reset while pending"};
+
+typedef struct _JoinResult
+{
+    uint8_t joinResponses;
+    StackRetStatus_t joinStatus;
+    bool joined;
+    bool nwkSKeySlot;
+    bool appSKeySlot;
+    bool nwkSKeyRam;
+    bool appSKeyRam;
+    bool devAddr;
+    uint32_t commands;
+    uint64_t delayMsUs;
+    uint64_t runMaxUs;
+    /* From the reception of the join accept to the join response */
+    uint64_t processingUs;
+} JoinResult_t;
+
+static JoinResult_t *results;
+
+static void runJoin(void *arg)
+{
+    Scenario_t scenario = (Scenario_t)(uintptr_t)arg;
+    JoinResult_t *result = &results[scenario];
+    LorawanFixtureJoin_t join = {0};
+    uint8_t frame[FIXTURE_JOIN_ACCEPT_MAX];
+    uint8_t length;
+    uint64_t received;
+    uint64_t limit;
+    static const uint8_t zero[FIXTURE_KEY_SIZE];
+
+    lorawanFixtureBoot();
+    TEST_CHECK(LORAWAN_SUCCESS == LORAWAN_Join(LORAWAN_OTAA));
+    TEST_CHECK(lorawanFixtureTransmit(radioEmuTime() + JOIN_REQUEST_LIMIT_US, frame, &length));
+    TEST_CHECK(lorawanFixtureJoinRequest(frame, length, &join.devNonce));
+
+    join.joinNonce = 0x000101;
+    join.netId = 0x000013;
+    join.devAddr = 0x260B1234UL;
+    join.cfList = (SCENARIO_JOIN_CFLIST == scenario);
+    length = lorawanFixtureJoinAccept(&join, frame);
+    if (SCENARIO_BAD_MIC == scenario)
+    {
+        frame[length - 1] ^= 0x01;
+    }
+
+    TEST_CHECK(lorawanFixtureRunToReceive(radioEmuTime() + RX1_LIMIT_US));
+    radioEmuResetStats();
+    eccEmuResetStats();
+    received = radioEmuTime();
+    TEST_CHECK(radioEmuLoraReceive(frame, length, true));
+
+    limit = received + PROCESSING_LIMIT_US;
+    if (SCENARIO_DROPPED == scenario)
+    {
+        radioEmuRunUntil(received + DROP_AFTER_US);
+        TEST_CHECK(LORAWAN_SUCCESS == LORAWAN_Reset(ISM_EU868));
+    }
+    while ((0 == lorawanFixtureReport.joinResponses) && (radioEmuTime() < limit))
+    {
+        radioEmuRunUntil(radioEmuTime() + 1000U);
+    }
+    result->processingUs = radioEmuTime() - received;
+    /* Whatever is left of the processing */
+    radioEmuRunUntil(limit);
+
+    result->joinResponses = lorawanFixtureReport.joinResponses;
+    result->joinStatus = lorawanFixtureReport.joinStatus;
+    result->joined = (1 == loRa.macStatus.networkJoined);
+    result->devAddr = (join.devAddr == loRa.activationParameters.deviceAddress.value);
+    if (result->joined)
+    {
+        result->nwkSKeySlot = (0 == memcmp(eccEmuSlot(NWKS_KEY_SLOT), join.nwkSKey, FIXTURE_KEY_SIZE));
+        result->appSKeySlot = (0 == memcmp(eccEmuSlot(APPS_KEY_SLOT), join.appSKey, FIXTURE_KEY_SIZE));
+        result->nwkSKeyRam = (0 == memcmp(loRa.activationParameters.networkSessionKeyRam, join.nwkSKey, FIXTURE_KEY_SIZE));
+        result->appSKeyRam = (0 == memcmp(loRa.activationParameters.applicationSessionKeyRam, join.appSKey, FIXTURE_KEY_SIZE));
+    }
+    else
+    {
+        /* Not derived */
+        result->nwkSKeySlot = (0 == memcmp(eccEmuSlot(NWKS_KEY_SLOT), zero, FIXTURE_KEY_SIZE));
+        result->appSKeySlot = (0 == memcmp(eccEmuSlot(APPS_KEY_SLOT), zero, FIXTURE_KEY_SIZE));
+    }
+    result->commands = eccEmuStats()->commands;
+    result->delayMsUs = eccEmuStats()->delayMsUs;
+    result->runMaxUs = radioEmuStats()->runMaxUs;
+}
+
+static void printResult(Scenario_t scenario)
+{
+    const JoinResult_t *result = &results[scenario];
+
+    printf("test_join_ecc: %-19s %2u ECC608 commands in %7llu us, %llu us waited, longest run %5llu us\n",
+        scenarioNames[scenario], result->commands, (unsigned long long)result->processingUs,
+        (unsigned long long)result->delayMsUs, (unsigned long long)result->runMaxUs);
+}
+
+int main(void)
+{
+    results = mmap(NULL, SCENARIOS * sizeof(JoinResult_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    for (uintptr_t scenario = 0; scenario < SCENARIOS; scenario++)
+    {
+        TEST_RUN(runJoin, (void *)scenario);
+        printResult((Scenario_t)scenario);
+
+        /* Nothing waits for the ECC608 and nothing runs for an AES
+         * command, whatever the join accept */
+        TEST_CHECK(0 == results[scenario].delayMsUs);
+        TEST_CHECK(results[scenario].runMaxUs < AES_EXEC_US);
+    }
+
+    for (Scenario_t scenario = SCENARIO_JOIN; scenario <= SCENARIO_JOIN_CFLIST; scenario++)
+    {
+        TEST_CHECK(1 == results[scenario].joinResponses);
+        TEST_CHECK(LORAWAN_SUCCESS == results[scenario].joinStatus);
+        TEST_CHECK(results[scenario].joined);
+        TEST_CHECK(results[scenario].devAddr);
+        TEST_CHECK(results[scenario].nwkSKeySlot && results[scenario].appSKeySlot);
+        TEST_CHECK(results[scenario].nwkSKeyRam && results[scenario].appSKeyRam);
+        TEST_CHECK((((SCENARIO_JOIN_CFLIST == scenario) ? AUTH_CFLIST_COMMANDS : AUTH_COMMANDS) + KEY_COMMANDS) ==
+            results[scenario].commands);
+    }
+
+    /* Decrypted and authenticated only */
+    TEST_CHECK(!results[SCENARIO_BAD_MIC].joined);
+    TEST_CHECK(0 == results[SCENARIO_BAD_MIC].joinResponses);
+    TEST_CHECK(results[SCENARIO_BAD_MIC].nwkSKeySlot && results[SCENARIO_BAD_MIC].appSKeySlot);
+    TEST_CHECK(AUTH_COMMANDS == results[SCENARIO_BAD_MIC].commands);
+
+    /* The command in progress completes, nothing follows it */
+    TEST_CHECK(!results[SCENARIO_DROPPED].joined);
+    TEST_CHECK(0 == results[SCENARIO_DROPPED].joinResponses);
+    TEST_CHECK(results[SCENARIO_DROPPED].nwkSKeySlot && results[SCENARIO_DROPPED].appSKeySlot);
+    TEST_CHECK(results[SCENARIO_DROPPED].commands < AUTH_COMMANDS);
+
+    return testDone("test_join_ecc");
+}
@@ -0,0 +1,408 @@
+/**
+* \file  test_mcast.c
+*
+* \brief Host test and benchmark of the multicast downlink path. From 1 to
+*        16 groups, with distinct McAddrs, McAddrs falling into the same
+*        slot of the index and groups sharing an McAddr, LorawanMcastValidateHdr
+*        must pick the group the linear scan it replaced picked. The CMAC
+*        computed with the subkeys cached for a group must be the one
+*        SAL_AESCmac computes from the key, itself checked against RFC 4493.
+*        The time per header of the index and of the linear scan is printed
+*        for each number of groups, it does not decide the result.
+*/
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include "test_common.h"
+#include "lorawan.h"
+#include "lorawan_defs.h"
+#include "lorawan_private.h"
+#include "lorawan_mcast.h"
+#include "lorawan_reg_params.h"
+#include "sal.h"
+#include "pds_interface.h"
+
+#define GROUPS                  (LORAWAN_MCAST_GROUP_COUNT_SUPPORTED)
+#define BENCH_FRAMES            (200000UL)
+
+int testFailures;
+
+LoRa_t loRa;
+
+/* Layout of the McAddrs of the groups */
+typedef enum _Layout
+{
+    LAYOUT_DISTINCT = 0,        /* An McAddr per group */
+    LAYOUT_SAME_SLOT,           /* Distinct McAddrs, all in the same slot of the index */
+    LAYOUT_SHARED,              /* Groups sharing an McAddr three by three */
+    LAYOUTS
+} Layout_t;
+
+static const char *const layoutNames[LAYOUTS] = {"distinct", "same slot", "shared"};
+
+static uint32_t seed = 1;
+
+/* The PDS is not part of this test */
+PdsStatus_t PDS_Store(PdsFileItemIdx_t pdsFileItemIdx, uint8_t item)
+{
+    (void)pdsFileItemIdx;
+    (void)item;
+    return PDS_OK;
+}
+
+/* The rest of the MAC is only reached by LorawanMcastProcessPkt and the
+ * frequency and data rate setters, which this test does not run */
+AppData_t AppPayload;
+
+SalStatus_t EncryptFRMPayload(uint8_t* buffer, uint8_t bufferLength, uint8_t dir, uint32_t frameCounter, uint8_t* key,
+    salItems_t key_type, uint16_t macBufferIndex, uint8_t* bufferToBeEncrypted, uint32_t devAddr)
+{
+    return SAL_FAILURE;
+}
+
+void UpdateTransactionCompleteCbParams(StackRetStatus_t status)
+{
+    (void)status;
+}
+
+void UpdateRxDataAvailableCbParams(uint32_t devAddr, uint8_t *pData, uint8_t dataLength, StackRetStatus_t status)
+{
+    (void)devAddr;
+}
+
+void LorawanConfigureRadioForRX2(bool doCallback)
+{
+    (void)doCallback;
+}
+
+StackRetStatus_t LORAREG_ValidateAttr(LorawanRegionalAttributes_t attrType, void *attrInput)
+{
+    return LORAWAN_INVALID_PARAMETER;
+}
+
+static uint32_t nextRandom(void)
+{
+    seed = seed * 1103515245U + 12345U;
+    return (seed >> 16) | (seed << 16);
+}
+
+static void fillRandom(uint8_t *buf, unsigned length)
+{
+    for (unsigned i = 0; i < length; i++)
+    {
+        buf[i] = (uint8_t)nextRandom();
+    }
+}
+
+static uint32_t groupAddr(Layout_t layout, uint8_t group)
+{
+    switch (layout)
+    {
+        case LAYOUT_SAME_SLOT:
+            /* The bytes cancel out in the XOR of the index hash */
+            return 0x26000000U | ((uint32_t)(group + 1) << 8) | (uint32_t)(group + 1) | (0x26U << 16);
+        case LAYOUT_SHARED:
+            return 0x26011000U + (group / 3);
+        default:
+            return 0x26010000U + group * 0x00010307U;
+    }
+}
+
+/* Configures count groups with the given layout, every fourth one left disabled */
+static void configureGroups(Layout_t layout, uint8_t count)
+{
+    uint8_t key[LORAWAN_SESSIONKEY_LENGTH];
+
+    memset(&loRa, 0, sizeof(loRa));
+    loRa.edClass = CLASS_C;
+    loRa.activationParameters.deviceAddress.value = 0x26FFFFFFU;
+    LorawanMcastInit();
+
+    for (uint8_t group = 0; group < count; group++)
+    {
+        TEST_CHECK(LORAWAN_SUCCESS == LorawanAddMcastAddr(groupAddr(layout, group), group));
+        fillRandom(key, sizeof(key));
+        TEST_CHECK(LORAWAN_SUCCESS == LorawanAddMcastNwkskey(key, group));
+        fillRandom(key, sizeof(key));
+        TEST_CHECK(LORAWAN_SUCCESS == LorawanAddMcastAppskey(key, group));
+        if (3 != (group % 4))
+        {
+            TEST_CHECK(LORAWAN_SUCCESS == LorawanMcastEnable(true, group));
+        }
+    }
+}
+
+/* LorawanMcastValidateHdr as it was before the McAddr index */
+static StackRetStatus_t linearValidateHdr(Hdr_t *hdr, uint8_t mType, uint8_t fPort, uint8_t *groupId)
+{
+    StackRetStatus_t status = LORAWAN_INVALID_PARAMETER;
+
+    for (uint8_t i = 0; i < GROUPS; i++)
+    {
+        if (0 == (loRa.mcastParams.mcastGroupMask & (0x01 << i)))
+        {
+            continue;
+        }
+        if ((hdr->members.devAddr.value == loRa.mcastParams.activationParams[i].mcastDevAddr.value) &&
+            ((CLASS_B | CLASS_C) & loRa.edClass))
+        {
+            if (!((fPort == 0) || (hdr->members.fCtrl.fOptsLen != 0) || (hdr->members.fCtrl.ack != 0) ||
+                (hdr->members.fCtrl.adrAckReq != 0) || (mType != FRAME_TYPE_DATA_UNCONFIRMED_DOWN)))
+            {
+                status = LORAWAN_SUCCESS;
+                *groupId = i;
+            }
+        }
+    }
+
+    return status;
+}
+
+/* Header of a frame to addr, variant 0 is a valid multicast frame and the
+ * other ones break one of the rules */
+static void makeHdr(Hdr_t *hdr, uint32_t addr, uint8_t variant, uint8_t *mType, uint8_t *fPort)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->members.devAddr.value = addr;
+    *mType = FRAME_TYPE_DATA_UNCONFIRMED_DOWN;
+    *fPort = 1;
+    switch (variant)
+    {
+        case 1: *fPort = 0; break;
+        case 2: hdr->members.fCtrl.fOptsLen = 1; break;
+        case 3: hdr->members.fCtrl.ack = 1; break;
+        case 4: hdr->members.fCtrl.adrAckReq = 1; break;
+        case 5: *mType = FRAME_TYPE_DATA_CONFIRMED_DOWN; break;
+        default: break;
+    }
+}
+
+#define HDR_VARIANTS            (6)
+
+static void checkAddr(uint32_t addr, Layout_t layout, uint8_t count)
+{
+    Hdr_t hdr;
+    uint8_t mType;
+    uint8_t fPort;
+
+    for (uint8_t variant = 0; variant < HDR_VARIANTS; variant++)
+    {
+        uint8_t groupId = UCHAR_MAX;
+        uint8_t expectedId = UCHAR_MAX;
+        StackRetStatus_t status;
+        StackRetStatus_t expected;
+
+        makeHdr(&hdr, addr, variant, &mType, &fPort);
+        status = LorawanMcastValidateHdr(&hdr, mType, fPort, &groupId);
+        expected = linearValidateHdr(&hdr, mType, fPort, &expectedId);
+        if ((status != expected) || (groupId != expectedId))
+        {
+            testFailures++;
+            fprintf(stderr, "%s, %u groups, McAddr 0x%08X variant %u: %d group %u, the linear scan gives %d group %u\n",
+                layoutNames[layout], count, (unsigned int)addr, variant, status, groupId, expected, expectedId);
+        }
+    }
+}
+
+/* Every McAddr configured and a few others, as class C and as class A */
+static void checkSameGroup(void *arg)
+{
+    (void)arg;
+    for (unsigned layout = 0; layout < LAYOUTS; layout++)
+    {
+        for (uint8_t count = 1; count <= GROUPS; count++)
+        {
+            configureGroups((Layout_t)layout, count);
+            for (uint8_t edClass = CLASS_A; edClass <= CLASS_C; edClass <<= 2)
+            {
+                loRa.edClass = edClass;
+                for (uint8_t group = 0; group <= count; group++)
+                {
+                    checkAddr(groupAddr((Layout_t)layout, group), (Layout_t)layout, count);
+                }
+                for (uint8_t other = 0; other < 8; other++)
+                {
+                    checkAddr(nextRandom(), (Layout_t)layout, count);
+                }
+            }
+        }
+    }
+
+    /* Disabling a group takes it out of the index */
+    configureGroups(LAYOUT_SHARED, GROUPS);
+    for (uint8_t group = 0; group < GROUPS; group++)
+    {
+        TEST_CHECK(LORAWAN_SUCCESS == LorawanMcastEnable(false, group));
+        for (uint8_t other = 0; other < GROUPS; other++)
+        {
+            checkAddr(groupAddr(LAYOUT_SHARED, other), LAYOUT_SHARED, GROUPS);
+        }
+    }
+}
+
+/* RFC 4493 section 4, the AES-CMAC of the four examples */
+static void checkRfcCmac(void *arg)
+{
+    static uint8_t key[16] =
+    {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    static uint8_t message[64] =
+    {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+    static const struct
+    {
+        uint16_t length;
+        uint8_t mac[16];
+    } examples[] =
+    {
+        {0, {0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46}},
+        {16, {0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c}},
+        {40, {0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27}},
+        {64, {0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe}},
+    };
+    uint8_t mac[16];
+
+    (void)arg;
+    for (unsigned i = 0; i < (sizeof(examples) / sizeof(examples[0])); i++)
+    {
+        TEST_CHECK(SAL_SUCCESS == SAL_AESCmac(key, SAL_MCAST_NWKS_KEY, mac, message, examples[i].length));
+        TEST_CHECK(0 == memcmp(mac, examples[i].mac, sizeof(mac)));
+    }
+}
+
+static void compareCmac(uint8_t group)
+{
+    static const uint16_t lengths[] = {0, 1, 15, 16, 17, 31, 32, 33, 48, 63, 64, 255};
+    uint8_t input[255];
+    uint8_t cached[16];
+    uint8_t reference[16];
+
+    for (unsigned i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++)
+    {
+        fillRandom(input, lengths[i]);
+        TEST_CHECK(SAL_SUCCESS == LorawanMcastComputeCmac(group, cached, input, lengths[i]));
+        TEST_CHECK(SAL_SUCCESS == SAL_AESCmac(loRa.mcastParams.activationParams[group].mcastNwkSKey,
+            SAL_MCAST_NWKS_KEY, reference, input, lengths[i]));
+        if (0 != memcmp(cached, reference, sizeof(cached)))
+        {
+            testFailures++;
+            fprintf(stderr, "group %u, %u bytes: the CMAC with the cached subkeys differs\n", group, lengths[i]);
+        }
+    }
+}
+
+/* The subkeys cached for each group follow its McNwkSKey */
+static void checkCachedCmac(void *arg)
+{
+    uint8_t key[LORAWAN_SESSIONKEY_LENGTH];
+
+    (void)arg;
+    configureGroups(LAYOUT_SHARED, GROUPS);
+    for (uint8_t group = 0; group < GROUPS; group++)
+    {
+        compareCmac(group);
+    }
+
+    for (uint8_t group = 0; group < GROUPS; group++)
+    {
+        fillRandom(key, sizeof(key));
+        TEST_CHECK(LORAWAN_SUCCESS == LorawanAddMcastNwkskey(key, group));
+        compareCmac(group);
+    }
+
+    /* As after a PDS restore, the keys change under the cached contexts */
+    for (uint8_t group = 0; group < GROUPS; group++)
+    {
+        fillRandom(loRa.mcastParams.activationParams[group].mcastNwkSKey, LORAWAN_SESSIONKEY_LENGTH);
+    }
+    LorawanMcastRebuildIndex();
+    for (uint8_t group = 0; group < GROUPS; group++)
+    {
+        compareCmac(group);
+    }
+}
+
+static double elapsedNs(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+/* A header to the last enabled group, the worst case of the linear scan */
+static void benchmark(void)
+{
+    static uint8_t input[16 + 64];
+    volatile uint32_t sink = 0;
+    struct timespec start, end;
+    Hdr_t hdr;
+    uint8_t mType;
+    uint8_t fPort;
+    uint8_t groupId;
+    uint8_t mac[16];
+    double indexNs;
+    double linearNs;
+
+    for (uint8_t count = 1; count <= GROUPS; count++)
+    {
+        configureGroups(LAYOUT_DISTINCT, count);
+        makeHdr(&hdr, groupAddr(LAYOUT_DISTINCT, (3 == ((count - 1) % 4)) ? (count - 2) : (count - 1)), 0, &mType, &fPort);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (unsigned long frame = 0; frame < BENCH_FRAMES; frame++)
+        {
+            sink += LorawanMcastValidateHdr(&hdr, mType, fPort, &groupId);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        indexNs = elapsedNs(&start, &end) / BENCH_FRAMES;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (unsigned long frame = 0; frame < BENCH_FRAMES; frame++)
+        {
+            sink += linearValidateHdr(&hdr, mType, fPort, &groupId);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        linearNs = elapsedNs(&start, &end) / BENCH_FRAMES;
+
+        printf("test_mcast: %2u groups, McAddr index %6.1f ns, linear scan %6.1f ns per header\n",
+            count, indexNs, linearNs);
+    }
+
+    /* B0 and a 64 byte frame, with and without the cached subkeys */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned long frame = 0; frame < (BENCH_FRAMES / 100); frame++)
+    {
+        (void)LorawanMcastComputeCmac(0, mac, input, sizeof(input));
+        sink += mac[0];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    indexNs = elapsedNs(&start, &end) / (BENCH_FRAMES / 100);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned long frame = 0; frame < (BENCH_FRAMES / 100); frame++)
+    {
+        (void)SAL_AESCmac(loRa.mcastParams.activationParams[0].mcastNwkSKey, SAL_MCAST_NWKS_KEY, mac, input, sizeof(input));
+        sink += mac[0];
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    linearNs = elapsedNs(&start, &end) / (BENCH_FRAMES / 100);
+
+    printf("test_mcast: CMAC of %u bytes, cached subkeys %.0f ns, SAL_AESCmac %.0f ns\n",
+        (unsigned int)sizeof(input), indexNs, linearNs);
+    (void)sink;
+}
+
+int main(void)
+{
+    (void)SAL_Init();
+
+    TEST_RUN(checkSameGroup, NULL);
+    TEST_RUN(checkRfcCmac, NULL);
+    TEST_RUN(checkCachedCmac, NULL);
+    benchmark();
+
+    return testDone("test_mcast");
+}
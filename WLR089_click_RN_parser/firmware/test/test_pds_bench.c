@@ -0,0 +1,188 @@
+/**
+* \file  test_pds_bench.c
+*
+* \brief Host benchmark of the NVM commands of a typical "mac set" sequence
+*        ended by "mac save". Each set stores its items through PDS_Store
+*        and the PDS task runs before the next command arrives, "mac save"
+*        only acknowledges. The row erases and page writes of each command
+*        are printed next to those of the whole file rewrite a store used to
+*        cost. A single item store must append a delta record without
+*        erasing its row.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "nvm_emu.h"
+#include "pds_fixture.h"
+
+/* The uplink counter of file 1 and the counter of file 2 are journalled */
+#define JOURNAL_COUNTERS        (1)
+#define ITEM_NONE               (0xFF)
+/* A delta record may cross a page boundary */
+#define DELTA_PAGE_WRITES_MAX   (2)
+
+int testFailures;
+
+/* The settings of the fixture files the commands stand for */
+static const struct
+{
+    const char *command;
+    PdsFileItemIdx_t file;
+    uint8_t item;
+} sequence[] =
+{
+    {"mac set devaddr", PDS_FILE_MAC_01_IDX, 1},
+    {"mac set nwkskey", PDS_FILE_MAC_01_IDX, FIXTURE_BLOB_ITEM},
+    {"mac set appskey", PDS_FILE_MAC_01_IDX, FIXTURE_BLOB_ITEM},
+    {"mac set dr", PDS_FILE_MAC_01_IDX, 2},
+    {"mac set adr", PDS_FILE_MAC_01_IDX, 3},
+    {"mac set rxdelay1", PDS_FILE_MAC_01_IDX, 4},
+    {"mac set upctr", PDS_FILE_MAC_01_IDX, 0},
+    {"mac set dnctr", PDS_FILE_MAC_02_IDX, FIXTURE_FILE2_ITEM},
+    {"mac save", PDS_FILE_MAC_01_IDX, ITEM_NONE},
+};
+
+#define SEQUENCE_LENGTH         (sizeof(sequence) / sizeof(sequence[0]))
+
+typedef struct _Cost
+{
+    uint32_t erases;
+    uint32_t writes;
+} Cost_t;
+
+typedef struct _Results
+{
+    Cost_t commands[SEQUENCE_LENGTH];
+    Cost_t rewrite;
+} Results_t;
+
+static Results_t *results;
+
+static uint32_t eraseCount(void)
+{
+    uint32_t erases = 0;
+
+    for (uint16_t row = 0; row < NVM_EMU_ROWS; row++)
+    {
+        erases += nvmEmuRowErases(row);
+    }
+
+    return erases;
+}
+
+/* Runs the PDS task until it is idle and returns the NVM commands it issued */
+static Cost_t runTasks(void)
+{
+    uint32_t erases = eraseCount();
+    long ops = nvmEmuOpCount();
+    Cost_t cost;
+
+    nvmEmuRunTasks();
+    cost.erases = eraseCount() - erases;
+    cost.writes = (uint32_t)(nvmEmuOpCount() - ops) - cost.erases;
+
+    return cost;
+}
+
+static void setupFiles(void *arg)
+{
+    (void)arg;
+    (void)pdsFixtureBoot(JOURNAL_COUNTERS);
+    pdsFixtureFillBlob(1);
+    PDS_StoreAll();
+    nvmEmuRunTasks();
+}
+
+static void runSequence(void *arg)
+{
+    (void)arg;
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+
+    for (unsigned idx = 0; idx < SEQUENCE_LENGTH; idx++)
+    {
+        uint8_t item = sequence[idx].item;
+
+        if (PDS_FILE_MAC_02_IDX == sequence[idx].file)
+        {
+            fixtureFile2Counter = 100 + idx;
+        }
+        else if (FIXTURE_BLOB_ITEM == item)
+        {
+            pdsFixtureFillBlob((uint8_t)(2 + idx));
+        }
+        else if (ITEM_NONE != item)
+        {
+            fixtureCounters[item] = 100 + idx;
+        }
+
+        if (ITEM_NONE != item)
+        {
+            PDS_Store(sequence[idx].file, item);
+        }
+        results->commands[idx] = runTasks();
+    }
+
+    /* The values set reach the NVM */
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK(106 == fixtureCounters[0]);
+    TEST_CHECK(100 == fixtureCounters[1]);
+    TEST_CHECK(pdsFixtureBlobIs(4));
+    TEST_CHECK(107 == fixtureFile2Counter);
+}
+
+/* Every item of file 1 changed, the file is written as a new row image */
+static void rewriteFile(void *arg)
+{
+    (void)arg;
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    for (uint8_t item = 0; item < FIXTURE_COUNTERS; item++)
+    {
+        fixtureCounters[item] = 200 + item;
+        PDS_Store(PDS_FILE_MAC_01_IDX, item);
+    }
+    pdsFixtureFillBlob(200);
+    PDS_Store(PDS_FILE_MAC_01_IDX, FIXTURE_BLOB_ITEM);
+    results->rewrite = runTasks();
+}
+
+int main(void)
+{
+    Cost_t total = {0, 0};
+    unsigned stores = 0;
+
+    nvmEmuInit();
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(setupFiles, NULL);
+    nvmEmuSave();
+    TEST_RUN(runSequence, NULL);
+    nvmEmuLoad();
+    TEST_RUN(rewriteFile, NULL);
+
+    for (unsigned idx = 0; idx < SEQUENCE_LENGTH; idx++)
+    {
+        const Cost_t *cost = &results->commands[idx];
+
+        printf("test_pds_bench: %-16s %u row erases, %u page writes\n", sequence[idx].command,
+            cost->erases, cost->writes);
+        total.erases += cost->erases;
+        total.writes += cost->writes;
+        if (ITEM_NONE != sequence[idx].item)
+        {
+            stores++;
+            TEST_CHECK(0 == cost->erases);
+            TEST_CHECK(DELTA_PAGE_WRITES_MAX >= cost->writes);
+        }
+        else
+        {
+            TEST_CHECK((0 == cost->erases) && (0 == cost->writes));
+        }
+    }
+
+    printf("test_pds_bench: sequence %u row erases, %u page writes, "
+           "%u row erases and %u page writes with a file rewrite per set\n",
+           total.erases, total.writes, stores * results->rewrite.erases, stores * results->rewrite.writes);
+    TEST_CHECK(0 != results->rewrite.erases);
+
+    return testDone("test_pds_bench, " NVM_EMU_LAYOUT);
+}
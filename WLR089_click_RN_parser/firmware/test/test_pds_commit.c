@@ -0,0 +1,205 @@
+/**
+* \file  test_pds_commit.c
+*
+* \brief Host tests of the PDS transactions: a power cut or a failure at any
+*        NVM command of PDS_Commit leaves either all the previous files or
+*        all the committed ones, the deleted files included, and neither a
+*        later loss of the index nor the rows left by the cut change it.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "nvm_emu.h"
+#include "pds_fixture.h"
+#include "pds_common.h"
+#include "pds_wl.h"
+
+#define OLD_VALUE               (1)
+#define NEW_VALUE               (2)
+
+int testFailures;
+
+typedef struct _Progress
+{
+    volatile bool committed;
+} Progress_t;
+
+static Progress_t *progress;
+
+static void setValues(uint32_t value)
+{
+    fixtureCounters[0] = value;
+    pdsFixtureFillBlob((uint8_t)value);
+    fixtureFile2Counter = value;
+}
+
+/* Both files hold the old values */
+static void setupFiles(void *arg)
+{
+    pdsFixtureBoot(0);
+    setValues(OLD_VALUE);
+    PDS_StoreAll();
+    TEST_CHECK(PDS_OK == PDS_Flush());
+}
+
+/* File 1 gets the new values, file 2 is deleted by the same commit */
+static void commitNew(void)
+{
+    pdsFixtureBoot(0);
+    setValues(NEW_VALUE);
+    PDS_Store(PDS_FILE_MAC_01_IDX, 0);
+    PDS_Store(PDS_FILE_MAC_01_IDX, FIXTURE_BLOB_ITEM);
+    progress->committed = (PDS_OK == PDS_Commit(true));
+}
+
+static void commitCut(void *arg)
+{
+    const long *cut = arg;
+
+    nvmEmuCutAt(cut[0], (NvmEmuCut_t)cut[1]);
+    commitNew();
+}
+
+/* A failed commit leaves the old files in use without a reboot */
+static void commitFail(void *arg)
+{
+    nvmEmuFailAt(*(const long *)arg, 1);
+    commitNew();
+    if (!progress->committed)
+    {
+        fixtureCounters[0] = 0;
+        fixtureFile2Counter = 0;
+        (void)PDS_RestoreAll();
+        TEST_CHECK(OLD_VALUE == fixtureCounters[0]);
+        TEST_CHECK(OLD_VALUE == fixtureFile2Counter);
+    }
+}
+
+/* Clears the header CRC of the index row in use, as a failed index write does */
+static void invalidateIndex(void)
+{
+    PdsWlIndexEntry_t *header;
+    PdsWlIndexEntry_t *latest = NULL;
+
+    for (uint8_t idx = 0; idx < PDS_WL_INDEX_NUM_ROWS; idx++)
+    {
+        header = (PdsWlIndexEntry_t *)(nvmEmuMem() + ((PDS_WL_INDEX_FIRST_ROW + idx) * EEPROM_ROW_SIZE));
+        if ((PDS_WL_INDEX_HEADER == header->rowIdx) && (0 != header->crc) &&
+            ((NULL == latest) || (header->counter > latest->counter)))
+        {
+            latest = header;
+        }
+    }
+
+    if (NULL != latest)
+    {
+        latest->crc = 0;
+    }
+}
+
+/* The index is lost right after the commit, before any reboot */
+static void commitLoseIndex(void *arg)
+{
+    commitNew();
+    TEST_CHECK(progress->committed);
+    invalidateIndex();
+}
+
+/* Returns true for the new files, false for the old ones */
+static bool checkAllOrNothing(void)
+{
+    bool isNew;
+
+    (void)pdsFixtureBoot(0);
+    isNew = (NEW_VALUE == fixtureCounters[0]);
+    if (isNew)
+    {
+        TEST_CHECK(pdsFixtureBlobIs(NEW_VALUE));
+        TEST_CHECK(0 == fixtureFile2Counter);
+    }
+    else
+    {
+        TEST_CHECK(OLD_VALUE == fixtureCounters[0]);
+        TEST_CHECK(pdsFixtureBlobIs(OLD_VALUE));
+        TEST_CHECK(OLD_VALUE == fixtureFile2Counter);
+    }
+
+    return isNew;
+}
+
+static void checkAfterCommit(void *arg)
+{
+    bool isNew = checkAllOrNothing();
+
+    TEST_CHECK(!progress->committed || isNew);
+
+    /* A scan of the rows finds the same files */
+    invalidateIndex();
+    TEST_CHECK(isNew == checkAllOrNothing());
+
+    /* The next commit still works */
+    commitNew();
+    TEST_CHECK(progress->committed);
+    TEST_CHECK(checkAllOrNothing());
+}
+
+static void commitOk(void *arg)
+{
+    commitNew();
+    TEST_CHECK(progress->committed);
+}
+
+int main(void)
+{
+    long cut[2];
+    long ops;
+    int status;
+
+    nvmEmuInit();
+    progress = mmap(NULL, sizeof(Progress_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(setupFiles, NULL);
+    nvmEmuSave();
+
+    ops = nvmEmuOpCount();
+    TEST_RUN(commitOk, NULL);
+    ops = nvmEmuOpCount() - ops;
+    TEST_RUN(checkAfterCommit, NULL);
+
+    nvmEmuLoad();
+    TEST_RUN(commitLoseIndex, NULL);
+    TEST_RUN(checkAfterCommit, NULL);
+
+    /* A power cut at every erase and page write of the commit */
+    for (cut[1] = NVM_EMU_CUT_BEFORE; cut[1] < NVM_EMU_CUT_MODES; cut[1]++)
+    {
+        for (cut[0] = 0; cut[0] < ops; cut[0]++)
+        {
+            nvmEmuLoad();
+            progress->committed = false;
+            status = testFork(commitCut, cut);
+            TEST_CHECK(NVM_EMU_POWER_CUT_EXIT == status);
+            if (0 != testFork(checkAfterCommit, NULL))
+            {
+                testFailures++;
+                fprintf(stderr, "  power cut at op %ld, mode %ld\n", cut[0], cut[1]);
+            }
+        }
+    }
+
+    /* A failure of every erase and page write of the commit */
+    for (long op = 0; op < ops; op++)
+    {
+        nvmEmuLoad();
+        progress->committed = false;
+        TEST_CHECK(0 == testFork(commitFail, &op));
+        if (0 != testFork(checkAfterCommit, NULL))
+        {
+            testFailures++;
+            fprintf(stderr, "  failure at op %ld\n", op);
+        }
+    }
+
+    printf("test_pds_commit: %ld power cuts, %ld failures\n", ops * NVM_EMU_CUT_MODES, ops);
+    return testDone("test_pds_commit, " NVM_EMU_LAYOUT);
+}
@@ -0,0 +1,164 @@
+/**
+* \file  test_pds_crc.c
+*
+* \brief Host test of the PDS CRC16. pds_crc.c is built once per
+*        implementation, the bitwise, table and slice-by-4 versions must give
+*        the CRC of a plain bit by bit reference for any data, length,
+*        alignment and split across calls. Their speed on the host is
+*        printed for comparison, it does not decide the result.
+*/
+#include <string.h>
+#include <time.h>
+#include "test_common.h"
+#include "pds_crc.h"
+
+/* Row size of the PDS, the unit the CRC mostly runs over */
+#define ROW_SIZE                (256U)
+#define BENCH_BYTES             (8UL * 1024 * 1024)
+
+int testFailures;
+
+uint16_t pdsCrc16Update_BITWISE(uint16_t crc, const uint8_t *data, uint16_t length);
+uint16_t pdsCrc16Update_TABLE(uint16_t crc, const uint8_t *data, uint16_t length);
+uint16_t pdsCrc16Update_SLICE_BY_4(uint16_t crc, const uint8_t *data, uint16_t length);
+
+typedef uint16_t (*CrcFn_t)(uint16_t crc, const uint8_t *data, uint16_t length);
+
+static const struct
+{
+    const char *name;
+    CrcFn_t fn;
+} impls[] =
+{
+    {"bitwise", pdsCrc16Update_BITWISE},
+    {"table", pdsCrc16Update_TABLE},
+    {"slice-by-4", pdsCrc16Update_SLICE_BY_4},
+};
+
+#define IMPL_COUNT              (sizeof(impls) / sizeof(impls[0]))
+
+static uint8_t data[4 + 2 * ROW_SIZE];
+
+/* CRC16-CCITT, reflected polynomial 0x8408, one bit at a time */
+static uint16_t referenceCrc(uint16_t crc, const uint8_t *buf, size_t length)
+{
+    while (length--)
+    {
+        crc ^= *buf++;
+        for (unsigned bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1U) ? ((crc >> 1) ^ 0x8408U) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void fillData(uint32_t seed)
+{
+    for (size_t i = 0; i < sizeof(data); i++)
+    {
+        seed = seed * 1103515245U + 12345U;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+}
+
+/* The check value of CRC-16/KERMIT, the same CRC started from zero */
+static void checkKnownValue(void *arg)
+{
+    static const uint8_t check[] = "123456789";
+
+    (void)arg;
+    TEST_CHECK(0x2189U == referenceCrc(PDS_CRC_INIT, check, 9));
+    for (unsigned i = 0; i < IMPL_COUNT; i++)
+    {
+        TEST_CHECK(0x2189U == impls[i].fn(PDS_CRC_INIT, check, 9));
+    }
+}
+
+/* Every length up to two rows at every alignment, from any starting CRC */
+static void checkLengths(void *arg)
+{
+    (void)arg;
+    for (uint32_t seed = 1; seed <= 8; seed++)
+    {
+        uint16_t init = (1 == seed) ? PDS_CRC_INIT : (uint16_t)(seed * 0x9E37U);
+
+        fillData(seed);
+        for (unsigned offset = 0; offset < 4; offset++)
+        {
+            for (unsigned length = 0; length <= 2 * ROW_SIZE; length++)
+            {
+                uint16_t ref = referenceCrc(init, &data[offset], length);
+
+                for (unsigned i = 0; i < IMPL_COUNT; i++)
+                {
+                    uint16_t crc = impls[i].fn(init, &data[offset], (uint16_t)length);
+
+                    if (crc != ref)
+                    {
+                        testFailures++;
+                        fprintf(stderr, "%s: offset %u length %u init 0x%04X: 0x%04X, expected 0x%04X\n",
+                            impls[i].name, offset, length, init, crc, ref);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* A row computed in two calls gives the CRC of the whole row */
+static void checkSplits(void *arg)
+{
+    uint16_t ref;
+
+    (void)arg;
+    fillData(42);
+    ref = referenceCrc(PDS_CRC_INIT, data, ROW_SIZE);
+
+    for (unsigned split = 0; split <= ROW_SIZE; split++)
+    {
+        for (unsigned i = 0; i < IMPL_COUNT; i++)
+        {
+            uint16_t crc = impls[i].fn(PDS_CRC_INIT, data, (uint16_t)split);
+
+            crc = impls[i].fn(crc, &data[split], (uint16_t)(ROW_SIZE - split));
+            TEST_CHECK(crc == ref);
+        }
+    }
+}
+
+static void benchmark(void)
+{
+    volatile uint16_t sink = 0;
+
+    fillData(7);
+    for (unsigned i = 0; i < IMPL_COUNT; i++)
+    {
+        struct timespec start, end;
+        uint16_t crc = PDS_CRC_INIT;
+        double ns;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (unsigned long done = 0; done < BENCH_BYTES; done += ROW_SIZE)
+        {
+            crc = impls[i].fn(crc, data, ROW_SIZE);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sink ^= crc;
+
+        ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+        printf("test_pds_crc: %-10s %6.2f ns/byte, %8.0f ns per row\n",
+            impls[i].name, ns / BENCH_BYTES, ns * ROW_SIZE / BENCH_BYTES);
+    }
+    (void)sink;
+}
+
+int main(void)
+{
+    TEST_RUN(checkKnownValue, NULL);
+    TEST_RUN(checkLengths, NULL);
+    TEST_RUN(checkSplits, NULL);
+    benchmark();
+
+    return testDone("test_pds_crc");
+}
@@ -0,0 +1,246 @@
+/**
+* \file  test_pds_journal.c
+*
+* \brief Host tests of the PDS counter journal: every journal page is
+*        programmed once between two erases, the counters reach their
+*        files when the journal moves to the next row, and a power cut at
+*        any NVM command of a store keeps the last or the new value.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "nvm_emu.h"
+#include "pds_fixture.h"
+#include "pds_common.h"
+#include "pds_journal.h"
+
+#define JOURNAL_COUNTERS        (2)
+#define UPDATES                 (13)
+#define FILE2_BASE              (1000)
+#define JOURNAL_FIRST_PAGE      ((PDS_JOURNAL_FIRST_ROW) * (EEPROM_PAGE_PER_ROW))
+#define JOURNAL_PAGES           ((PDS_JOURNAL_NUM_ROWS) * (EEPROM_PAGE_PER_ROW))
+
+int testFailures;
+
+/* Shared with the children: the last update whose store has returned */
+typedef struct _Progress
+{
+    volatile uint32_t acked;
+} Progress_t;
+
+static Progress_t *progress;
+
+static void storeCounters(uint32_t value)
+{
+    fixtureCounters[0] = value;
+    fixtureCounters[1] = value * 2;
+    fixtureFile2Counter = FILE2_BASE + value;
+    PDS_Store(PDS_FILE_MAC_01_IDX, 0);
+    PDS_Store(PDS_FILE_MAC_01_IDX, 1);
+    PDS_Store(PDS_FILE_MAC_02_IDX, FIXTURE_FILE2_ITEM);
+    nvmEmuRunTasks();
+}
+
+static bool journalProgrammedOnce(void)
+{
+    for (uint16_t page = 0; page < JOURNAL_PAGES; page++)
+    {
+        if (nvmEmuPagePrograms(JOURNAL_FIRST_PAGE + page) > 1)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Creates the files with the counters at 0 */
+static void setupFiles(void *arg)
+{
+    pdsFixtureBoot(JOURNAL_COUNTERS);
+    pdsFixtureFillBlob(0x5A);
+    storeCounters(0);
+    PDS_StoreAll();
+    nvmEmuRunTasks();
+}
+
+static void updateCounters(void *arg)
+{
+    pdsFixtureBoot(JOURNAL_COUNTERS);
+    for (uint32_t value = 1; value <= UPDATES; value++)
+    {
+        storeCounters(value);
+        progress->acked = value;
+        TEST_CHECK(journalProgrammedOnce());
+    }
+}
+
+static void updateCountersCut(void *arg)
+{
+    const long *cut = arg;
+
+    pdsFixtureBoot(JOURNAL_COUNTERS);
+    nvmEmuCutAt(cut[0], (NvmEmuCut_t)cut[1]);
+    for (uint32_t value = 1; value <= UPDATES; value++)
+    {
+        storeCounters(value);
+        progress->acked = value;
+    }
+}
+
+/* The counters restored after a cut are the last stored or the ones being
+ * stored, and the journal keeps working from there */
+static void checkAfterCut(void *arg)
+{
+    uint32_t acked = progress->acked;
+    uint32_t restored;
+
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK((fixtureCounters[0] == acked) || (fixtureCounters[0] == (acked + 1)));
+    TEST_CHECK(fixtureCounters[1] == (fixtureCounters[0] * 2));
+    TEST_CHECK(fixtureFile2Counter == (FILE2_BASE + fixtureCounters[0]));
+    TEST_CHECK(pdsFixtureBlobIs(0x5A));
+
+    /* The store after the reboot skips what the cut left behind */
+    restored = fixtureCounters[0];
+    storeCounters(restored + 1);
+    TEST_CHECK(journalProgrammedOnce());
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK((restored + 1) == fixtureCounters[0]);
+    TEST_CHECK(pdsFixtureBlobIs(0x5A));
+    if (0 != testFailures)
+    {
+        fprintf(stderr, "  acked %u, restored %u %u %u\n", (unsigned int)acked, (unsigned int)fixtureCounters[0],
+                (unsigned int)fixtureCounters[1], (unsigned int)fixtureFile2Counter);
+    }
+}
+
+static void checkRestored(void *arg)
+{
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK(UPDATES == fixtureCounters[0]);
+    TEST_CHECK((2 * UPDATES) == fixtureCounters[1]);
+    TEST_CHECK((FILE2_BASE + UPDATES) == fixtureFile2Counter);
+    TEST_CHECK(pdsFixtureBlobIs(0x5A));
+}
+
+/* Without the journal rows the files hold the counters of the last row change */
+static void checkFilesCompacted(void *arg)
+{
+    memset(nvmEmuMem() + (PDS_JOURNAL_FIRST_ROW * EEPROM_ROW_SIZE), UINT8_MAX, PDS_JOURNAL_NUM_ROWS * EEPROM_ROW_SIZE);
+
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK(fixtureCounters[0] > (UPDATES - EEPROM_PAGE_PER_ROW));
+    TEST_CHECK(fixtureCounters[0] <= UPDATES);
+    TEST_CHECK(fixtureFile2Counter == (FILE2_BASE + fixtureCounters[0]));
+}
+
+/* A journal that cannot be written hands the counters to their files */
+static void journalWriteFails(void *arg)
+{
+    PdsStats_t stats;
+
+    pdsFixtureBoot(JOURNAL_COUNTERS);
+    storeCounters(1);
+    nvmEmuFailAt(0, 1);
+    storeCounters(2);
+    PDS_GetStats(&stats);
+    TEST_CHECK(0 != stats.errors);
+    TEST_CHECK(0 == stats.pending);
+}
+
+static void checkAfterFailure(void *arg)
+{
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK(2 == fixtureCounters[0]);
+    TEST_CHECK((FILE2_BASE + 2) == fixtureFile2Counter);
+}
+
+/* When no page can be written the record of the last store is kept */
+static void nvmWritesFail(void *arg)
+{
+    pdsFixtureBoot(JOURNAL_COUNTERS);
+    storeCounters(1);
+    nvmEmuFailWrites(true);
+    for (uint32_t value = 2; value < JOURNAL_PAGES; value++)
+    {
+        storeCounters(value);
+    }
+}
+
+static void checkAfterWritesFail(void *arg)
+{
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+    TEST_CHECK(1 == fixtureCounters[0]);
+    TEST_CHECK((FILE2_BASE + 1) == fixtureFile2Counter);
+    TEST_CHECK(pdsFixtureBlobIs(0x5A));
+}
+
+/* The journal holds PDS_JOURNAL_MAX_ITEMS counters, the others stay in their files */
+static void registrationFails(void *arg)
+{
+    pdsFixtureBoot(PDS_JOURNAL_MAX_ITEMS);
+    TEST_CHECK(PDS_NOT_ENOUGH_MEMORY == PDS_RegCounter(PDS_FILE_MAC_02_IDX, FIXTURE_FILE2_ITEM));
+    TEST_CHECK(PDS_OK == PDS_REG_COUNTER((PDS_FILE_MAC_01_IDX << 8) | 0));
+
+    fixtureFile2Counter = 7;
+    PDS_Store(PDS_FILE_MAC_02_IDX, FIXTURE_FILE2_ITEM);
+    nvmEmuRunTasks();
+}
+
+static void checkRegistrationFallback(void *arg)
+{
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(PDS_JOURNAL_MAX_ITEMS));
+    TEST_CHECK(7 == fixtureFile2Counter);
+}
+
+int main(void)
+{
+    long cut[2];
+    long ops;
+    int status;
+
+    nvmEmuInit();
+    progress = mmap(NULL, sizeof(Progress_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(setupFiles, NULL);
+    nvmEmuSave();
+
+    ops = nvmEmuOpCount();
+    TEST_RUN(updateCounters, NULL);
+    ops = nvmEmuOpCount() - ops;
+    TEST_RUN(checkRestored, NULL);
+    TEST_RUN(checkFilesCompacted, NULL);
+
+    /* A power cut at every erase and page write of the updates */
+    for (cut[1] = NVM_EMU_CUT_BEFORE; cut[1] < NVM_EMU_CUT_MODES; cut[1]++)
+    {
+        for (cut[0] = 0; cut[0] < ops; cut[0]++)
+        {
+            nvmEmuLoad();
+            progress->acked = 0;
+            status = testFork(updateCountersCut, cut);
+            TEST_CHECK(NVM_EMU_POWER_CUT_EXIT == status);
+            if (0 != testFork(checkAfterCut, NULL))
+            {
+                testFailures++;
+                fprintf(stderr, "  power cut at op %ld, mode %ld\n", cut[0], cut[1]);
+            }
+        }
+    }
+
+    nvmEmuLoad();
+    TEST_RUN(journalWriteFails, NULL);
+    TEST_RUN(checkAfterFailure, NULL);
+
+    nvmEmuLoad();
+    TEST_RUN(nvmWritesFail, NULL);
+    TEST_RUN(checkAfterWritesFail, NULL);
+
+    nvmEmuLoad();
+    TEST_RUN(registrationFails, NULL);
+    TEST_RUN(checkRegistrationFallback, NULL);
+
+    printf("test_pds_journal: %ld power cuts\n", ops * NVM_EMU_CUT_MODES);
+    return testDone("test_pds_journal, " NVM_EMU_LAYOUT);
+}
@@ -0,0 +1,164 @@
+/**
+* \file  test_pds_latency.c
+*
+* \brief Host emulation of the RX1 latency during a PDS flush. The NVM
+*        commands take their data sheet time, and the RX1 timer expires at
+*        every point of the flush of both files. The RX1 task waits for the
+*        PDS task step in progress, which must never hold the CPU longer
+*        than a row erase, whereas PDS_Flush holds it for the whole flush.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "nvm_emu.h"
+#include "pds_fixture.h"
+
+/* Worst case row erase and page write times of the SAM R34 NVM */
+#define ROW_ERASE_US            (6000U)
+#define PAGE_WRITE_US           (2500U)
+
+/* Step between two RX1 expiries */
+#define RX1_STEP_US             (250U)
+
+/* A row erase, plus the polls of the CPU around it */
+#define RX1_LATENCY_MAX_US      (ROW_ERASE_US + 100U)
+
+int testFailures;
+
+typedef struct _Results
+{
+    uint64_t flushTime;
+    uint64_t blockingTime;
+    uint64_t latencyMax;
+} Results_t;
+
+static Results_t *results;
+
+static void setupFiles(void *arg)
+{
+    (void)arg;
+    pdsFixtureBoot(0);
+    fixtureCounters[0] = 1;
+    pdsFixtureFillBlob(1);
+    fixtureFile2Counter = 1;
+    PDS_StoreAll();
+    TEST_CHECK(PDS_OK == PDS_Flush());
+}
+
+/* Both files rewritten with new values */
+static void storeNew(void)
+{
+    (void)pdsFixtureBoot(0);
+    nvmEmuSetTiming(ROW_ERASE_US, PAGE_WRITE_US);
+    fixtureCounters[0] = 2;
+    pdsFixtureFillBlob(2);
+    fixtureFile2Counter = 2;
+    PDS_StoreAll();
+}
+
+/* The PDS task runs in the background, the RX1 timer expires rx1Delay us
+ * after the stores */
+static void flushWithRx1(void *arg)
+{
+    uint64_t rx1Delay = *(const uint64_t *)arg;
+    uint64_t start;
+    uint64_t rx1Time;
+    bool rx1Done = false;
+
+    storeNew();
+    start = nvmEmuTime();
+    rx1Time = start + rx1Delay;
+
+    for (;;)
+    {
+        /* The scheduler runs the RX1 task as soon as the running task returns */
+        if (!rx1Done && (nvmEmuTime() >= rx1Time))
+        {
+            uint64_t latency = nvmEmuTime() - rx1Time;
+
+            TEST_CHECK(RX1_LATENCY_MAX_US >= latency);
+            if (latency > results->latencyMax)
+            {
+                results->latencyMax = latency;
+            }
+            rx1Done = true;
+            continue;
+        }
+        if (nvmEmuRunOne())
+        {
+            continue;
+        }
+        if (!nvmEmuIdleUntil(rx1Done ? UINT64_MAX : rx1Time))
+        {
+            break;
+        }
+    }
+
+    if (0 == rx1Delay)
+    {
+        results->flushTime = nvmEmuTime() - start;
+    }
+
+    /* The files were written in full */
+    TEST_CHECK(PDS_OK == pdsFixtureBoot(0));
+    TEST_CHECK(2 == fixtureCounters[0]);
+    TEST_CHECK(pdsFixtureBlobIs(2));
+    TEST_CHECK(2 == fixtureFile2Counter);
+}
+
+/* The same flush done by PDS_Flush, an RX1 expiring meanwhile waits for all of it */
+static void flushBlocking(void *arg)
+{
+    uint64_t start;
+
+    (void)arg;
+    storeNew();
+    start = nvmEmuTime();
+    TEST_CHECK(PDS_OK == PDS_Flush());
+    results->blockingTime = nvmEmuTime() - start;
+}
+
+/* Expires RX1 all along the flush of the stores from the saved NVM */
+static void sweep(const char *name)
+{
+    uint64_t rx1Delay = 0;
+    unsigned int runs = 0;
+
+    memset(results, 0, sizeof(Results_t));
+    nvmEmuLoad();
+    TEST_RUN(flushWithRx1, &rx1Delay);
+    TEST_CHECK(0 != results->flushTime);
+
+    /* RX1 at every point of the flush, and once after it */
+    for (rx1Delay = RX1_STEP_US; rx1Delay <= (results->flushTime + RX1_STEP_US); rx1Delay += RX1_STEP_US)
+    {
+        nvmEmuLoad();
+        TEST_RUN(flushWithRx1, &rx1Delay);
+        runs++;
+    }
+
+    nvmEmuLoad();
+    TEST_RUN(flushBlocking, NULL);
+
+    printf("test_pds_latency: %s, %u RX1 expiries over a %llu us flush, latency at most %llu us "
+           "(%llu us with PDS_Flush)\n", name, runs, (unsigned long long)results->flushTime,
+           (unsigned long long)results->latencyMax, (unsigned long long)results->blockingTime);
+}
+
+int main(void)
+{
+    nvmEmuInit();
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    /* Files written to new rows: row erases and page writes */
+    nvmEmuSave();
+    sweep("new files");
+
+    /* Files updated in place: delta records */
+    nvmEmuLoad();
+    TEST_RUN(setupFiles, NULL);
+    nvmEmuSave();
+    sweep("updated files");
+
+    return testDone("test_pds_latency, " NVM_EMU_LAYOUT);
+}
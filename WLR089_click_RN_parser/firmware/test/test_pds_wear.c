@@ -0,0 +1,129 @@
+/**
+* \file  test_pds_wear.c
+*
+* \brief Host simulation of ten years of PDS wear. A device sends an uplink
+*        every few minutes and stores its frame counter, gets a downlink now
+*        and then and changes its settings once a day. The erases of every
+*        row are counted over the whole period, the most worn row must stay
+*        within the endurance of the NVM, the wear levelled rows within the
+*        static migration threshold of each other, and the files must be
+*        restored intact at the end of every year.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "nvm_emu.h"
+#include "pds_fixture.h"
+#include "pds_common.h"
+#include "pds_journal.h"
+#include "pds_wl.h"
+
+#define YEARS                   (10U)
+#define UPLINK_PERIOD_MIN       (5U)
+#define UPLINKS_PER_DAY         ((24U * 60U) / (UPLINK_PERIOD_MIN))
+#define UPLINKS_PER_YEAR        (365U * (UPLINKS_PER_DAY))
+/* One uplink out of DOWNLINK_PERIOD is answered by a downlink */
+#define DOWNLINK_PERIOD         (8U)
+
+/* Minimum erase cycles of the SAM R34 rows */
+#if (PDS_NVM_BACKEND == PDS_NVM_BACKEND_FLASH)
+#define NVM_ENDURANCE           (25000UL)
+#else
+#define NVM_ENDURANCE           (100000UL)
+#endif
+
+/* Counters of file 1 in the journal: the uplink and the downlink counter */
+#define JOURNAL_COUNTERS        (2)
+#define FCNT_UP                 (0)
+#define FCNT_DOWN               (1)
+
+#define ROWS_USED               ((PDS_WL_INDEX_FIRST_ROW) + (PDS_WL_INDEX_NUM_ROWS))
+
+int testFailures;
+
+typedef struct _Results
+{
+    uint32_t rowErases[ROWS_USED];
+    uint32_t wearMin;
+    uint32_t wearMax;
+} Results_t;
+
+static Results_t *results;
+
+static void simulate(void *arg)
+{
+    uint32_t uplinks = 0;
+    uint32_t downlinks = 0;
+    uint8_t settings = 0;
+
+    (void)arg;
+    (void)pdsFixtureBoot(JOURNAL_COUNTERS);
+    pdsFixtureFillBlob(settings);
+    PDS_StoreAll();
+    nvmEmuRunTasks();
+
+    for (uint32_t year = 0; year < YEARS; year++)
+    {
+        for (uint32_t uplink = 0; uplink < UPLINKS_PER_YEAR; uplink++)
+        {
+            fixtureCounters[FCNT_UP] = ++uplinks;
+            PDS_Store(PDS_FILE_MAC_01_IDX, FCNT_UP);
+            if (0 == (uplinks % DOWNLINK_PERIOD))
+            {
+                fixtureCounters[FCNT_DOWN] = ++downlinks;
+                PDS_Store(PDS_FILE_MAC_01_IDX, FCNT_DOWN);
+            }
+            if (0 == (uplinks % UPLINKS_PER_DAY))
+            {
+                pdsFixtureFillBlob(++settings);
+                PDS_Store(PDS_FILE_MAC_01_IDX, FIXTURE_BLOB_ITEM);
+            }
+            nvmEmuRunTasks();
+        }
+
+        /* A reset at the end of the year restores the latest values */
+        TEST_CHECK(PDS_OK == pdsFixtureBoot(JOURNAL_COUNTERS));
+        TEST_CHECK(uplinks == fixtureCounters[FCNT_UP]);
+        TEST_CHECK(downlinks == fixtureCounters[FCNT_DOWN]);
+        TEST_CHECK(pdsFixtureBlobIs(settings));
+    }
+
+    for (uint16_t row = 0; row < ROWS_USED; row++)
+    {
+        results->rowErases[row] = nvmEmuRowErases(row);
+    }
+    pdsWlGetWear(&results->wearMin, &results->wearMax);
+}
+
+int main(void)
+{
+    uint32_t maxErases = 0;
+    uint16_t maxRow = 0;
+
+    nvmEmuInit();
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(simulate, NULL);
+
+    for (uint16_t row = 0; row < ROWS_USED; row++)
+    {
+        printf("test_pds_wear: row %2u %-7s %8u erases\n", row,
+            (row >= PDS_WL_INDEX_FIRST_ROW) ? "index" : (row >= PDS_JOURNAL_FIRST_ROW) ? "journal" : "file",
+            results->rowErases[row]);
+        if (results->rowErases[row] > maxErases)
+        {
+            maxErases = results->rowErases[row];
+            maxRow = row;
+        }
+    }
+    printf("test_pds_wear: %u years of an uplink every %u min, most worn row %u with %u erases, "
+           "wear levelled rows %u to %u, %lu years to the endurance\n", YEARS, UPLINK_PERIOD_MIN, maxRow,
+           maxErases, results->wearMin, results->wearMax,
+           (0 == maxErases) ? 0UL : (unsigned long)((NVM_ENDURANCE * YEARS) / maxErases));
+
+    TEST_CHECK(0 != maxErases);
+    TEST_CHECK(NVM_ENDURANCE >= maxErases);
+    TEST_CHECK((results->wearMax - results->wearMin) <= PDS_WL_STATIC_MIGRATE_THRESHOLD);
+
+    return testDone("test_pds_wear, " NVM_EMU_LAYOUT);
+}
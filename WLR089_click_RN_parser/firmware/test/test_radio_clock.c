@@ -0,0 +1,240 @@
+/**
+* \file  test_radio_clock.c
+*
+* \brief Host simulation of the TCXO power policy over two class A cycles
+*        without a downlink: an uplink, RX1 1 s and RX2 2 s after it, and a
+*        repetition of the uplink 30 ms after RX2. The window and the
+*        repetition timers are given to RADIO_SetClockUser, as the MAC does.
+*        The TCXO must be powered on ahead of each window so that the
+*        receiver starts as its timer expires, kept on from RX2 to the
+*        repetition, and not kept on for a timer that does not use the
+*        radio. Without the timers given, every operation powers the TCXO
+*        up and waits for it.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "radio_fixture.h"
+#include "sw_timer.h"
+
+#define UPLINK_SIZE             (12U)
+#define UPLINKS                 (2U)
+#define RX_WINDOW_SYMBOLS       (8U)
+#define RX1_DELAY_US            (1000000U)
+#define RX2_DELAY_US            (2000000U)
+#define REPEAT_DELAY_US         (30000U)
+/* Expires within RADIO_CLOCK_HOLD_THRESHOLD of each uplink, without
+ * using the radio */
+#define OTHER_DELAY_US          (15000U)
+#define TX_RUN_US               (4U * RADIO_EMU_TCXO_US)
+/* The standby switch before the FIFO is loaded waits 1 ms */
+#define TX_BLOCKED_US           (1000U)
+/* The receiver is configured over SPI before it is switched on */
+#define WINDOW_SETUP_MAX_US     (100U)
+#define STEP_US                 (100U)
+#define OPMODE_MODE             (0x07)
+#define OPMODE_TX               (0x03)
+#define OPMODE_RXSINGLE         (0x06)
+
+int testFailures;
+
+typedef struct _ClockResult
+{
+    uint32_t powerOns;
+    uint64_t onUs;
+    /* From the expiry of the window timer to the receiver on, for all
+     * the windows, and the longest */
+    uint64_t windowWaitUs;
+    uint64_t windowWaitMaxUs;
+    uint64_t blockedUs;
+} ClockResult_t;
+
+typedef struct _Results
+{
+    ClockResult_t users;
+    ClockResult_t noUsers;
+} Results_t;
+
+static Results_t *results;
+
+/* The part of the MAC that schedules the radio */
+static struct
+{
+    uint8_t rx1TimerId;
+    uint8_t rx2TimerId;
+    uint8_t repeatTimerId;
+    uint8_t otherTimerId;
+    uint8_t window;
+    uint8_t uplinks;
+    uint64_t rx1Expiry;
+    uint64_t rx2Expiry;
+    uint64_t repeatExpiry;
+} mac;
+
+static uint8_t frame[UPLINK_SIZE];
+
+static void windowExpired(void *param)
+{
+    RadioReceiveParam_t receive = {RECEIVE_START, RX_WINDOW_SYMBOLS};
+
+    mac.window = (uint8_t)(uintptr_t)param;
+    TEST_CHECK(ERR_NONE == RADIO_Receive(&receive));
+}
+
+static void repeatExpired(void *param)
+{
+    RadioTransmitParam_t transmit = {UPLINK_SIZE, frame};
+
+    (void)param;
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&transmit));
+}
+
+static void macCallback(RadioCallbackID_t callback, void *param)
+{
+    (void)param;
+    if (RADIO_TX_DONE_CALLBACK == callback)
+    {
+        mac.uplinks++;
+        mac.rx1Expiry = radioEmuTime() + RX1_DELAY_US;
+        mac.rx2Expiry = radioEmuTime() + RX2_DELAY_US;
+        TEST_CHECK(LORAWAN_SUCCESS == SwTimerStart(mac.rx1TimerId, RX1_DELAY_US, SW_TIMEOUT_RELATIVE,
+            (void *)windowExpired, (void *)1));
+        TEST_CHECK(LORAWAN_SUCCESS == SwTimerStart(mac.rx2TimerId, RX2_DELAY_US, SW_TIMEOUT_RELATIVE,
+            (void *)windowExpired, (void *)2));
+        TEST_CHECK(LORAWAN_SUCCESS == SwTimerStart(mac.otherTimerId, OTHER_DELAY_US, SW_TIMEOUT_RELATIVE,
+            NULL, NULL));
+    }
+    else if ((RADIO_RX_TIMEOUT_CALLBACK == callback) && (2 == mac.window) && (mac.uplinks < UPLINKS))
+    {
+        mac.repeatExpiry = radioEmuTime() + REPEAT_DELAY_US;
+        TEST_CHECK(LORAWAN_SUCCESS == SwTimerStart(mac.repeatTimerId, REPEAT_DELAY_US, SW_TIMEOUT_RELATIVE,
+            (void *)repeatExpired, NULL));
+    }
+}
+
+/* Runs up to the expiry of a window timer and until the receiver is on */
+static void runWindow(ClockResult_t *result, uint64_t expiry)
+{
+    uint64_t waitUs;
+
+    radioEmuRunUntil(expiry);
+    while ((OPMODE_RXSINGLE != (radioEmuOpMode() & OPMODE_MODE)) && (radioEmuTime() < (expiry + TX_RUN_US)))
+    {
+        radioEmuRunUntil(radioEmuTime() + STEP_US);
+    }
+    TEST_CHECK(OPMODE_RXSINGLE == (radioEmuOpMode() & OPMODE_MODE));
+
+    waitUs = radioEmuTime() - expiry;
+    result->windowWaitUs += waitUs;
+    if (waitUs > result->windowWaitMaxUs)
+    {
+        result->windowWaitMaxUs = waitUs;
+    }
+
+    TEST_CHECK(radioEmuLoraRxTimeout());
+    radioEmuRunTasks();
+}
+
+static void runCycles(ClockResult_t *result, bool users)
+{
+    RadioTransmitParam_t transmit = {UPLINK_SIZE, frame};
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength;
+    uint64_t start;
+
+    radioFixtureBoot();
+    radioFixtureLoRa(FIXTURE_FREQ_868100, SF_7, false);
+    memset(&mac, 0, sizeof(mac));
+    memset(frame, 0x5A, sizeof(frame));
+    TEST_CHECK(LORAWAN_SUCCESS == SwTimerCreate(&mac.rx1TimerId));
+    TEST_CHECK(LORAWAN_SUCCESS == SwTimerCreate(&mac.rx2TimerId));
+    TEST_CHECK(LORAWAN_SUCCESS == SwTimerCreate(&mac.repeatTimerId));
+    TEST_CHECK(LORAWAN_SUCCESS == SwTimerCreate(&mac.otherTimerId));
+    if (users)
+    {
+        TEST_CHECK(ERR_NONE == RADIO_SetClockUser(mac.rx1TimerId));
+        TEST_CHECK(ERR_NONE == RADIO_SetClockUser(mac.rx2TimerId));
+        TEST_CHECK(ERR_NONE == RADIO_SetClockUser(mac.repeatTimerId));
+        /* Given twice, it is only kept once */
+        TEST_CHECK(ERR_NONE == RADIO_SetClockUser(mac.repeatTimerId));
+    }
+    (void)RADIO_SetAttr(RADIO_CALLBACK, (void *)macCallback);
+    TEST_CHECK(false == radioEmuTcxoOn());
+    radioEmuResetStats();
+
+    start = radioEmuTime();
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&transmit));
+    for (uint8_t uplink = 0; uplink < UPLINKS; uplink++)
+    {
+        if (0 != uplink)
+        {
+            /* From RX2 to the repetition */
+            TEST_CHECK(users == radioEmuTcxoOn());
+            radioEmuRunUntil(mac.repeatExpiry);
+            start = mac.repeatExpiry;
+        }
+        radioEmuRunUntil(start + TX_RUN_US);
+        TEST_CHECK(OPMODE_TX == (radioEmuOpMode() & OPMODE_MODE));
+        TEST_CHECK(radioEmuLoraTxDone(sent, &sentLength));
+        radioEmuRunTasks();
+        TEST_CHECK(uplink + 1 == mac.uplinks);
+
+        /* The other timer is closer than RX1 */
+        TEST_CHECK(false == radioEmuTcxoOn());
+        runWindow(result, mac.rx1Expiry);
+        TEST_CHECK(false == radioEmuTcxoOn());
+        runWindow(result, mac.rx2Expiry);
+    }
+    TEST_CHECK(false == radioEmuTcxoOn());
+    TEST_CHECK(false == SwTimerIsRunning(mac.repeatTimerId));
+
+    result->powerOns = radioEmuStats()->tcxoPowerOns;
+    result->onUs = radioEmuStats()->tcxoOnUs;
+    result->blockedUs = radioEmuStats()->blockedUs;
+    TEST_CHECK(0 == radioEmuStats()->unclockedModes);
+    TEST_CHECK(0 == radioEmuStats()->spiErrors);
+}
+
+static void clockUsers(void *arg)
+{
+    (void)arg;
+    runCycles(&results->users, true);
+}
+
+static void noClockUsers(void *arg)
+{
+    (void)arg;
+    runCycles(&results->noUsers, false);
+}
+
+static void printResult(const char *name, const ClockResult_t *result)
+{
+    printf("test_radio_clock: %-17s %u TCXO power ups, on %6llu us, windows waited %5llu us, %llu us blocked\n",
+        name, result->powerOns, (unsigned long long)result->onUs,
+        (unsigned long long)result->windowWaitUs, (unsigned long long)result->blockedUs);
+}
+
+int main(void)
+{
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(clockUsers, NULL);
+    TEST_RUN(noClockUsers, NULL);
+
+    printResult("timers given", &results->users);
+    printResult("no timers given", &results->noUsers);
+
+    /* Each window starts as its timer expires. The TCXO is powered up for
+     * the first uplink and for each window, the repetition finds it on */
+    TEST_CHECK(results->users.windowWaitMaxUs <= WINDOW_SETUP_MAX_US);
+    TEST_CHECK(((2 * UPLINKS) + 1) == results->users.powerOns);
+    /* Every operation powers the TCXO up, each window waits for it */
+    TEST_CHECK((3 * UPLINKS) == results->noUsers.powerOns);
+    TEST_CHECK((results->noUsers.windowWaitUs - results->users.windowWaitUs) == (2 * UPLINKS * RADIO_EMU_TCXO_US));
+    /* Only the transmissions block, never for the TCXO */
+    TEST_CHECK((UPLINKS * TX_BLOCKED_US) == results->users.blockedUs);
+    TEST_CHECK((UPLINKS * TX_BLOCKED_US) == results->noUsers.blockedUs);
+
+    return testDone("test_radio_clock");
+}
@@ -0,0 +1,164 @@
+/**
+* \file  test_radio_fsk.c
+*
+* \brief Host test of the FSK FIFO handling. Packets of up to 255 bytes are
+*        received and sent at 50 kb/s on the SX1276 emulator, the 64 byte
+*        FIFO filling and draining a byte every 160 us while the DIO
+*        interrupts empty and refill it. No byte may be lost to an overrun
+*        or an underrun, the payload must arrive intact, the interrupts
+*        must not take a critical section, and each FIFO interrupt must move
+*        its bytes with a single SPI transaction.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "radio_fixture.h"
+
+#define STEP_US                 (4U * RADIO_EMU_TCXO_US)
+#define OPMODE_MODEM_AND_MODE   (0x87)
+#define OPMODE_FSK_TX           (0x03)
+#define OPMODE_FSK_RXCONT       (0x05)
+#define RX_FIFO_LEVEL           (32U)
+/* Bytes the FIFO holds above the RX level, the latency an interrupt may
+ * take before the FIFO overruns */
+#define RX_FIFO_MARGIN          (64U - (RX_FIFO_LEVEL))
+
+int testFailures;
+
+/* Below the FIFO level, across a few FIFO levels, and the longest */
+static const uint8_t lengths[] = {20, 100, UINT8_MAX};
+
+#define LENGTHS                 (sizeof(lengths) / sizeof(lengths[0]))
+
+typedef struct _Transfer
+{
+    uint32_t interrupts;
+    uint32_t fifoTransactions;
+    uint64_t isrMaxUs;
+} Transfer_t;
+
+typedef struct _Results
+{
+    Transfer_t rx[LENGTHS];
+    Transfer_t tx[LENGTHS];
+} Results_t;
+
+static Results_t *results;
+
+static void fillPayload(uint8_t *payload, uint8_t length, uint8_t seed)
+{
+    for (uint8_t idx = 0; idx < length; idx++)
+    {
+        payload[idx] = (uint8_t)(seed + (idx * 3U));
+    }
+}
+
+static void bootFsk(void)
+{
+    RadioModulation_t modulation = MODULATION_FSK;
+
+    radioFixtureBoot();
+    TEST_CHECK(ERR_NONE == RADIO_SetAttr(MODULATION, &modulation));
+}
+
+/* The FIFO bytes moved without an overrun or an underrun, in interrupts
+ * free of critical sections */
+static void checkTransfer(Transfer_t *transfer)
+{
+    const RadioEmuStats_t *stats = radioEmuStats();
+
+    transfer->interrupts = stats->interrupts;
+    transfer->fifoTransactions = stats->fifoTransactions;
+    transfer->isrMaxUs = stats->isrMaxUs;
+    TEST_CHECK(0 == stats->fifoOverruns);
+    TEST_CHECK(0 == stats->fifoUnderruns);
+    TEST_CHECK(0 == stats->fifoEmptyReads);
+    TEST_CHECK(0 == stats->isrCriticalSections);
+    TEST_CHECK(0 == stats->spiErrors);
+    TEST_CHECK(0 == stats->unclockedModes);
+}
+
+static void fskReceive(void *arg)
+{
+    unsigned idx = *(unsigned *)arg;
+    uint8_t length = lengths[idx];
+    uint8_t payload[UINT8_MAX];
+    RadioReceiveParam_t param = {RECEIVE_START, 0};
+
+    bootFsk();
+    fillPayload(payload, length, (uint8_t)idx);
+    TEST_CHECK(ERR_NONE == RADIO_Receive(&param));
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(OPMODE_FSK_RXCONT == (radioEmuOpMode() & OPMODE_MODEM_AND_MODE));
+
+    radioEmuResetStats();
+    TEST_CHECK(radioEmuFskReceive(payload, length, true, RADIO_EMU_FSK_BYTE_US));
+    checkTransfer(&results->rx[idx]);
+
+    radioEmuRunTasks();
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_RX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(length == radioFixtureEvents[0].length);
+    TEST_CHECK(0 == memcmp(payload, radioFixtureEvents[0].buffer, length));
+}
+
+static void fskTransmit(void *arg)
+{
+    unsigned idx = *(unsigned *)arg;
+    uint8_t length = lengths[idx];
+    uint8_t payload[UINT8_MAX];
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength = 0;
+    RadioTransmitParam_t param = {length, payload};
+
+    bootFsk();
+    fillPayload(payload, length, (uint8_t)(0x80 + idx));
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&param));
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(OPMODE_FSK_TX == (radioEmuOpMode() & OPMODE_MODEM_AND_MODE));
+
+    radioEmuResetStats();
+    TEST_CHECK(radioEmuFskTransmit(sent, &sentLength, RADIO_EMU_FSK_BYTE_US));
+    checkTransfer(&results->tx[idx]);
+    TEST_CHECK(length == sentLength);
+    TEST_CHECK(0 == memcmp(payload, sent, length));
+
+    radioEmuRunTasks();
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(ERR_NONE == radioFixtureEvents[0].status);
+}
+
+int main(void)
+{
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    for (unsigned idx = 0; idx < LENGTHS; idx++)
+    {
+        TEST_RUN(fskReceive, &idx);
+        TEST_RUN(fskTransmit, &idx);
+    }
+
+    for (unsigned idx = 0; idx < LENGTHS; idx++)
+    {
+        const Transfer_t *rx = &results->rx[idx];
+        const Transfer_t *tx = &results->tx[idx];
+
+        printf("test_radio_fsk: %3u bytes, RX %u interrupts, %u FIFO transactions, longest %3llu us, "
+               "TX %u interrupts, %u FIFO transactions, longest %3llu us\n", lengths[idx], rx->interrupts,
+               rx->fifoTransactions, (unsigned long long)rx->isrMaxUs, tx->interrupts, tx->fifoTransactions,
+               (unsigned long long)tx->isrMaxUs);
+
+        /* SyncAddress reads nothing and every other interrupt one burst,
+         * but the length byte of a packet that never reached the FIFO
+         * level is read on its own */
+        TEST_CHECK((rx->interrupts - 1 + ((lengths[idx] < RX_FIFO_LEVEL) ? 1 : 0)) == rx->fifoTransactions);
+        /* PacketSent writes nothing */
+        TEST_CHECK((tx->interrupts - 1) == tx->fifoTransactions);
+        TEST_CHECK(rx->isrMaxUs < (RX_FIFO_MARGIN * RADIO_EMU_FSK_BYTE_US));
+        TEST_CHECK(tx->isrMaxUs < RADIO_EMU_FSK_BYTE_US);
+    }
+
+    return testDone("test_radio_fsk");
+}
@@ -0,0 +1,224 @@
+/**
+* \file  test_radio_lbt.c
+*
+* \brief Host tests of the listen before talk scan, with the channel power
+*        scripted on the RSSI register of the SX1276 emulator. The scan
+*        takes 10 samples over 5 ms against a -80 dBm threshold, as in
+*        JP923. A busy channel must end the scan at the first sample above
+*        the threshold and report ERR_CHANNEL_BUSY without transmitting. A
+*        free channel must be sampled 10 times, then the frame is sent. The
+*        samples are timed by the tick timer: the task loop must be free
+*        between them and the scan must not wait in the delay functions.
+*        If the tick timer cannot be started the channel is reported busy,
+*        and stopping the scan leaves a wait for the TCXO to its timer.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "radio_fixture.h"
+#include "radio_lbt.h"
+#include "radio_registers_SX1276.h"
+
+#define UPLINK_SIZE             (12U)
+#define SCAN_PERIOD_MS          (5U)
+#define SCAN_SAMPLES            (10U)
+#define SCAN_THRESHOLD_DBM      (-80)
+#define SAMPLE_US               ((SCAN_PERIOD_MS * 1000U) / SCAN_SAMPLES)
+/* The scan starts once the TCXO is stable and the receiver has settled */
+#define SCAN_FIRST_SAMPLE_US    (RADIO_EMU_TCXO_US + RADIO_LBT_RX_SETUP_TIME)
+#define SCAN_TIMEOUT_US         (4U * 1000U * SCAN_PERIOD_MS)
+/* The standby switch before the FIFO is loaded waits 1 ms */
+#define TX_BLOCKED_MAX_US       (1000U)
+/* RegOpMode: FSK receive continuous */
+#define OPMODE_FSK_RXCONT       (0x05)
+#define OPMODE_MODEM_AND_MODE   (0x87)
+
+int testFailures;
+
+typedef struct _ScanResult
+{
+    uint32_t rssiReads;
+    uint64_t callbackUs;
+    uint64_t blockedUs;
+} ScanResult_t;
+
+typedef struct _Results
+{
+    ScanResult_t busy;
+    ScanResult_t free;
+} Results_t;
+
+static Results_t *results;
+
+/* Quiet, then a transmission starts on the third sample */
+static const int16_t busyChannel[] = {-110, -105, -70};
+static const int16_t freeChannel[] = {-112, -95, -108, -81};
+
+static uint8_t frame[UPLINK_SIZE];
+
+/* Boots the radio with LBT on and starts a transmission, returns its time */
+static uint64_t requestUplink(const int16_t *rssi, uint8_t count)
+{
+    RadioLBTParams_t lbt = {SCAN_PERIOD_MS, SCAN_THRESHOLD_DBM, SCAN_SAMPLES, true};
+    RadioTransmitParam_t param = {UPLINK_SIZE, frame};
+    uint64_t start;
+
+    radioFixtureBoot();
+    radioFixtureLoRa(FIXTURE_FREQ_868100, SF_7, false);
+    TEST_CHECK(ERR_NONE == RADIO_SetAttr(RADIO_LBT_PARAMS, &lbt));
+    radioEmuSetRssi(rssi, count);
+    memset(frame, 0xC3, sizeof(frame));
+    radioEmuResetStats();
+
+    start = radioEmuTime();
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&param));
+    return start;
+}
+
+static uint64_t startUplink(const int16_t *rssi, uint8_t count)
+{
+    uint64_t start = requestUplink(rssi, count);
+
+    /* Between the first two samples the radio listens in FSK and the task
+     * loop has nothing to run */
+    radioEmuRunUntil(start + SCAN_FIRST_SAMPLE_US + (SAMPLE_US / 2));
+    TEST_CHECK(OPMODE_FSK_RXCONT == (radioEmuOpMode() & OPMODE_MODEM_AND_MODE));
+    TEST_CHECK(1 == radioEmuStats()->rssiReads);
+    TEST_CHECK(radioEmuTickArmed());
+    TEST_CHECK(false == radioEmuRunOne());
+
+    return start;
+}
+
+static void scanResult(ScanResult_t *result, uint64_t start)
+{
+    const RadioEmuStats_t *stats = radioEmuStats();
+
+    result->rssiReads = stats->rssiReads;
+    result->callbackUs = (radioFixtureEventCount > 0) ? (radioFixtureEvents[0].time - start) : 0;
+    result->blockedUs = stats->blockedUs;
+    TEST_CHECK(0 == stats->spiErrors);
+    TEST_CHECK(0 == stats->unclockedModes);
+    TEST_CHECK(0 == stats->tickOverwrites);
+}
+
+/* The scan could not be timed, nothing was sent */
+static void checkNotSent(uint32_t rssiReads)
+{
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength;
+
+    TEST_CHECK(rssiReads == radioEmuStats()->rssiReads);
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(ERR_CHANNEL_BUSY == radioFixtureEvents[0].status);
+    TEST_CHECK(false == radioEmuLoraTxDone(sent, &sentLength));
+    TEST_CHECK(RADIO_STATE_IDLE == RADIO_GetState());
+    TEST_CHECK(false == radioEmuTickArmed());
+    TEST_CHECK(0 == radioEmuStats()->tickOverwrites);
+}
+
+static void channelBusy(void *arg)
+{
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength;
+    uint64_t start;
+
+    (void)arg;
+    start = startUplink(busyChannel, sizeof(busyChannel) / sizeof(busyChannel[0]));
+    radioEmuRunUntil(start + SCAN_TIMEOUT_US);
+    scanResult(&results->busy, start);
+
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(ERR_CHANNEL_BUSY == radioFixtureEvents[0].status);
+    /* Nothing was loaded or sent */
+    TEST_CHECK(0 == radioEmuStats()->regWrites[REG_FIFO]);
+    TEST_CHECK(false == radioEmuLoraTxDone(sent, &sentLength));
+    TEST_CHECK(RADIO_STATE_IDLE == RADIO_GetState());
+    TEST_CHECK(false == radioEmuTickArmed());
+}
+
+static void channelFree(void *arg)
+{
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength = 0;
+    uint64_t start;
+
+    (void)arg;
+    start = startUplink(freeChannel, sizeof(freeChannel) / sizeof(freeChannel[0]));
+    /* The last sample is taken SCAN_SAMPLES - 1 intervals after the first,
+     * the transmission starts right after it */
+    radioEmuRunUntil(start + SCAN_FIRST_SAMPLE_US + (SCAN_SAMPLES * SAMPLE_US));
+    TEST_CHECK(0 == radioFixtureEventCount);
+    TEST_CHECK(SCAN_SAMPLES == radioEmuStats()->rssiReads);
+
+    TEST_CHECK(radioEmuLoraTxDone(sent, &sentLength));
+    TEST_CHECK(UPLINK_SIZE == sentLength);
+    TEST_CHECK(0 == memcmp(frame, sent, UPLINK_SIZE));
+    radioEmuRunTasks();
+    scanResult(&results->free, start);
+
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(ERR_NONE == radioFixtureEvents[0].status);
+    TEST_CHECK(false == radioEmuTickArmed());
+}
+
+/* The receiver settling time cannot be timed. A scan stop meanwhile
+ * leaves the wait for the TCXO running */
+static void setupTickFails(void *arg)
+{
+    uint64_t start;
+
+    (void)arg;
+    start = requestUplink(freeChannel, sizeof(freeChannel) / sizeof(freeChannel[0]));
+    radioEmuRunUntil(start + (RADIO_EMU_TCXO_US / 2));
+    TEST_CHECK(radioEmuTickArmed());
+    Radio_LBTScanStop();
+    TEST_CHECK(radioEmuTickArmed());
+
+    radioEmuFailTick(1);
+    radioEmuRunUntil(start + SCAN_TIMEOUT_US);
+    checkNotSent(0);
+    TEST_CHECK(0 == radioEmuStats()->blockedUs);
+}
+
+/* The second sample cannot be timed */
+static void sampleTickFails(void *arg)
+{
+    uint64_t start;
+
+    (void)arg;
+    start = startUplink(freeChannel, sizeof(freeChannel) / sizeof(freeChannel[0]));
+    radioEmuFailTick(1);
+    radioEmuRunUntil(start + SCAN_TIMEOUT_US);
+    checkNotSent(2);
+}
+
+int main(void)
+{
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(channelBusy, NULL);
+    TEST_RUN(channelFree, NULL);
+    TEST_RUN(setupTickFails, NULL);
+    TEST_RUN(sampleTickFails, NULL);
+
+    printf("test_radio_lbt: busy channel %2u samples, ERR_CHANNEL_BUSY after %llu us, %llu us blocked\n",
+        results->busy.rssiReads, (unsigned long long)results->busy.callbackUs,
+        (unsigned long long)results->busy.blockedUs);
+    printf("test_radio_lbt: free channel %2u samples, sending %u us after the request, %llu us blocked\n",
+        results->free.rssiReads, SCAN_FIRST_SAMPLE_US + (SCAN_SAMPLES * SAMPLE_US),
+        (unsigned long long)results->free.blockedUs);
+
+    /* The busy scan ends at the third sample */
+    TEST_CHECK(3 == results->busy.rssiReads);
+    TEST_CHECK(results->busy.callbackUs < (SCAN_FIRST_SAMPLE_US + (3 * SAMPLE_US)));
+    TEST_CHECK(0 == results->busy.blockedUs);
+    TEST_CHECK(SCAN_SAMPLES == results->free.rssiReads);
+    TEST_CHECK(results->free.blockedUs <= TX_BLOCKED_MAX_US);
+
+    return testDone("test_radio_lbt");
+}
@@ -0,0 +1,339 @@
+/**
+* \file  test_radio_rx.c
+*
+* \brief Host simulation of the LoRa RX completion path. A downlink ends in
+*        the RX1 window of the SX1276 emulator, the DIO0 interrupt reads the
+*        frame and the time until the radio callback hands it to the MAC is
+*        measured. The radio must be asleep when the interrupt returns, the
+*        first radio task run must deliver the frame without any further
+*        SPI transfer, and in continuous reception two frames received
+*        before the task runs must both be delivered, in order. In class C
+*        the MAC opens the receiver again from the callback of each frame:
+*        with the same settings the receiver must go on listening untouched,
+*        a frame received meanwhile must not be lost, and the frames still
+*        queued when the MAC stops the receiver or transmits must be
+*        delivered.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "radio_fixture.h"
+
+#define DOWNLINK_SIZE           (33U)
+#define RX_WINDOW_SYMBOLS       (8U)
+#define STEP_US                 (4U * RADIO_EMU_TCXO_US)
+#define ISR_TRANSACTIONS_MAX    (7U)
+#define OPMODE_MODE             (0x07)
+#define OPMODE_SLEEP            (0x00)
+#define OPMODE_RXCONT           (0x05)
+#define OPMODE_RXSINGLE         (0x06)
+#define OPMODE_TX               (0x03)
+#define UPLINK_SIZE             (12U)
+
+int testFailures;
+
+typedef struct _Results
+{
+    uint64_t isrUs;
+    uint64_t latencyUs;
+    uint32_t isrTransactions;
+    uint32_t isrBytes;
+} Results_t;
+
+static Results_t *results;
+
+/* The part of the class C MAC that handles the downlinks */
+static struct
+{
+    /* Received while the MAC processes the next frame */
+    const uint8_t *late;
+    uint8_t lateLength;
+    /* Channel of the RXC window */
+    uint32_t frequency;
+    bool transmit;
+    uint8_t frames;
+    RadioError_t status;
+    /* SPI transactions of the last request */
+    uint32_t transactions;
+} mac;
+
+static uint8_t uplink[UPLINK_SIZE];
+
+static void fillFrame(uint8_t *frame, uint8_t length, uint8_t seed)
+{
+    for (uint8_t idx = 0; idx < length; idx++)
+    {
+        frame[idx] = (uint8_t)(seed ^ (idx * 13U));
+    }
+}
+
+static void startReceive(uint16_t windowSize, uint8_t mode)
+{
+    RadioReceiveParam_t param = {RECEIVE_START, windowSize};
+
+    radioFixtureBoot();
+    radioFixtureLoRa(FIXTURE_FREQ_868100, SF_7, true);
+    TEST_CHECK(ERR_NONE == RADIO_Receive(&param));
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(mode == (radioEmuOpMode() & OPMODE_MODE));
+    radioEmuResetStats();
+}
+
+/* Opens the RXC window again after each frame, as LorawanConfigureRadioForRX2
+ * does, or transmits */
+static void classCCallback(RadioCallbackID_t callback, void *param)
+{
+    RadioReceiveParam_t receive = {RECEIVE_START, 0};
+    RadioTransmitParam_t transmit = {UPLINK_SIZE, uplink};
+    uint32_t transactions;
+
+    radioFixtureRecord(callback, param);
+    if (RADIO_RX_DONE_CALLBACK != callback)
+    {
+        return;
+    }
+    mac.frames++;
+    if (NULL != mac.late)
+    {
+        TEST_CHECK(radioEmuLoraReceive(mac.late, mac.lateLength, true));
+        mac.late = NULL;
+    }
+
+    transactions = radioEmuStats()->transactions;
+    if (mac.transmit)
+    {
+        mac.transmit = false;
+        mac.status = RADIO_Transmit(&transmit);
+    }
+    else
+    {
+        radioFixtureLoRa(mac.frequency, SF_7, true);
+        mac.status = RADIO_Receive(&receive);
+    }
+    mac.transactions = radioEmuStats()->transactions - transactions;
+}
+
+static void startClassC(void)
+{
+    startReceive(0, OPMODE_RXCONT);
+    memset(&mac, 0, sizeof(mac));
+    mac.frequency = FIXTURE_FREQ_868100;
+    memset(uplink, 0x5A, sizeof(uplink));
+    (void)RADIO_SetAttr(RADIO_CALLBACK, (void *)classCCallback);
+}
+
+static void checkFrame(uint8_t event, const uint8_t *frame, uint8_t length)
+{
+    TEST_CHECK(RADIO_RX_DONE_CALLBACK == radioFixtureEvents[event].id);
+    TEST_CHECK(length == radioFixtureEvents[event].length);
+    TEST_CHECK(0 == memcmp(frame, radioFixtureEvents[event].buffer, length));
+}
+
+static void rxWindow(void *arg)
+{
+    uint8_t frame[DOWNLINK_SIZE];
+    uint32_t transactions;
+    uint64_t end;
+
+    (void)arg;
+    startReceive(RX_WINDOW_SYMBOLS, OPMODE_RXSINGLE);
+    fillFrame(frame, DOWNLINK_SIZE, 0x21);
+
+    end = radioEmuTime();
+    TEST_CHECK(radioEmuLoraReceive(frame, DOWNLINK_SIZE, true));
+    results->isrUs = radioEmuStats()->isrMaxUs;
+    results->isrTransactions = radioEmuStats()->transactions;
+    results->isrBytes = radioEmuStats()->bytes;
+    transactions = radioEmuStats()->transactions;
+    TEST_CHECK(1 == radioEmuStats()->interrupts);
+    TEST_CHECK(OPMODE_SLEEP == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(0 == radioFixtureEventCount);
+
+    /* The first run of the radio task hands the frame over */
+    TEST_CHECK(radioEmuRunOne());
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(transactions == radioEmuStats()->transactions);
+    TEST_CHECK(RADIO_RX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(ERR_NONE == radioFixtureEvents[0].status);
+    TEST_CHECK(DOWNLINK_SIZE == radioFixtureEvents[0].length);
+    TEST_CHECK(0 == memcmp(frame, radioFixtureEvents[0].buffer, DOWNLINK_SIZE));
+    results->latencyUs = radioFixtureEvents[0].time - end;
+
+    radioEmuRunTasks();
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_STATE_IDLE == RADIO_GetState());
+    TEST_CHECK(0 == radioEmuStats()->spiErrors);
+}
+
+static void rxContinuous(void *arg)
+{
+    uint8_t first[DOWNLINK_SIZE];
+    uint8_t second[DOWNLINK_SIZE - 10];
+
+    (void)arg;
+    startReceive(0, OPMODE_RXCONT);
+    fillFrame(first, sizeof(first), 0x40);
+    fillFrame(second, sizeof(second), 0x90);
+
+    /* The radio goes on listening while the first frame waits */
+    TEST_CHECK(radioEmuLoraReceive(first, sizeof(first), true));
+    TEST_CHECK(OPMODE_RXCONT == (radioEmuOpMode() & OPMODE_MODE));
+    /* The queue is full with the second one */
+    TEST_CHECK(radioEmuLoraReceive(second, sizeof(second), true));
+    TEST_CHECK(OPMODE_SLEEP == (radioEmuOpMode() & OPMODE_MODE));
+
+    radioEmuRunTasks();
+    TEST_CHECK(2 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_RX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(sizeof(first) == radioFixtureEvents[0].length);
+    TEST_CHECK(0 == memcmp(first, radioFixtureEvents[0].buffer, sizeof(first)));
+    TEST_CHECK(RADIO_RX_DONE_CALLBACK == radioFixtureEvents[1].id);
+    TEST_CHECK(sizeof(second) == radioFixtureEvents[1].length);
+    TEST_CHECK(0 == memcmp(second, radioFixtureEvents[1].buffer, sizeof(second)));
+    TEST_CHECK(0 == radioEmuStats()->spiErrors);
+}
+
+static void rxClassC(void *arg)
+{
+    uint8_t frames[5][DOWNLINK_SIZE];
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength;
+    uint32_t transactions;
+
+    (void)arg;
+    startClassC();
+    for (uint8_t idx = 0; idx < 5; idx++)
+    {
+        fillFrame(frames[idx], DOWNLINK_SIZE, (uint8_t)(0x11 * (idx + 1)));
+    }
+
+    /* Opened again with the same settings, the receiver is left as it is */
+    TEST_CHECK(radioEmuLoraReceive(frames[0], DOWNLINK_SIZE, true));
+    transactions = radioEmuStats()->transactions;
+    radioEmuRunTasks();
+    TEST_CHECK(1 == mac.frames);
+    TEST_CHECK(ERR_NONE == mac.status);
+    TEST_CHECK(transactions == radioEmuStats()->transactions);
+    TEST_CHECK(OPMODE_RXCONT == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(RADIO_STATE_RX == RADIO_GetState());
+
+    /* A frame received while the MAC processes the previous one fills the
+     * queue and stops the receiver, which the MAC starts again */
+    mac.late = frames[2];
+    mac.lateLength = DOWNLINK_SIZE;
+    TEST_CHECK(radioEmuLoraReceive(frames[1], DOWNLINK_SIZE, true));
+    radioEmuRunTasks();
+    TEST_CHECK(3 == mac.frames);
+    TEST_CHECK(ERR_NONE == mac.status);
+    TEST_CHECK(0 == mac.transactions);
+    TEST_CHECK(OPMODE_RXCONT == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(RADIO_STATE_RX == RADIO_GetState());
+
+    /* Another channel restarts the receiver */
+    mac.frequency = FIXTURE_FREQ_869525;
+    TEST_CHECK(radioEmuLoraReceive(frames[3], DOWNLINK_SIZE, true));
+    radioEmuRunTasks();
+    TEST_CHECK(4 == mac.frames);
+    TEST_CHECK(ERR_NONE == mac.status);
+    TEST_CHECK(0 != mac.transactions);
+    TEST_CHECK(OPMODE_RXCONT == (radioEmuOpMode() & OPMODE_MODE));
+
+    /* The MAC transmits from the callback of a frame, the frame received
+     * before is still handed over */
+    mac.transmit = true;
+    mac.late = frames[1];
+    TEST_CHECK(radioEmuLoraReceive(frames[4], DOWNLINK_SIZE, true));
+    radioEmuRunTasks();
+    TEST_CHECK(6 == mac.frames);
+    TEST_CHECK(RADIO_STATE_TX == RADIO_GetState());
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(OPMODE_TX == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(radioEmuLoraTxDone(sent, &sentLength));
+    TEST_CHECK(UPLINK_SIZE == sentLength);
+    radioEmuRunTasks();
+
+    TEST_CHECK(7 == radioFixtureEventCount);
+    checkFrame(0, frames[0], DOWNLINK_SIZE);
+    checkFrame(1, frames[1], DOWNLINK_SIZE);
+    checkFrame(2, frames[2], DOWNLINK_SIZE);
+    checkFrame(3, frames[3], DOWNLINK_SIZE);
+    checkFrame(4, frames[4], DOWNLINK_SIZE);
+    checkFrame(5, frames[1], DOWNLINK_SIZE);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[6].id);
+    TEST_CHECK(0 == RADIO_GetRxDropCount());
+    TEST_CHECK(0 == radioEmuStats()->spiErrors);
+}
+
+/* Frames not handed over yet when the MAC stops the receiver or transmits */
+static void rxClassCStop(void *arg)
+{
+    RadioReceiveParam_t stop = {RECEIVE_STOP, 0};
+    RadioReceiveParam_t start = {RECEIVE_START, 0};
+    RadioTransmitParam_t transmit = {UPLINK_SIZE, uplink};
+    uint8_t first[DOWNLINK_SIZE];
+    uint8_t second[DOWNLINK_SIZE];
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength;
+
+    (void)arg;
+    startClassC();
+    fillFrame(first, sizeof(first), 0x33);
+    fillFrame(second, sizeof(second), 0x66);
+
+    /* As the RX1 window of an uplink stops the RXC window */
+    TEST_CHECK(radioEmuLoraReceive(first, sizeof(first), true));
+    TEST_CHECK(ERR_NONE == RADIO_Receive(&stop));
+    TEST_CHECK(1 == radioFixtureEventCount);
+    checkFrame(0, first, sizeof(first));
+    TEST_CHECK(OPMODE_SLEEP == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(RADIO_STATE_IDLE == RADIO_GetState());
+    radioEmuRunTasks();
+    TEST_CHECK(1 == radioFixtureEventCount);
+
+    /* Both frames come before the transmission, the MAC leaves the receiver
+     * listening from the callback and the uplink stops it */
+    TEST_CHECK(ERR_NONE == RADIO_Receive(&start));
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(OPMODE_RXCONT == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(radioEmuLoraReceive(first, sizeof(first), true));
+    TEST_CHECK(radioEmuLoraReceive(second, sizeof(second), true));
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&transmit));
+    TEST_CHECK(3 == radioFixtureEventCount);
+    checkFrame(1, first, sizeof(first));
+    checkFrame(2, second, sizeof(second));
+    TEST_CHECK(RADIO_STATE_TX == RADIO_GetState());
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(OPMODE_TX == (radioEmuOpMode() & OPMODE_MODE));
+    TEST_CHECK(0 == RADIO_GetRxDropCount());
+
+    /* A reset of the radio drops the frames it holds, they are counted */
+    TEST_CHECK(radioEmuLoraTxDone(sent, &sentLength));
+    radioEmuRunTasks();
+    startClassC();
+    TEST_CHECK(radioEmuLoraReceive(second, sizeof(second), true));
+    RADIO_InitDefaultAttributes();
+    TEST_CHECK(1 == RADIO_GetRxDropCount());
+    TEST_CHECK(0 == radioEmuStats()->spiErrors);
+}
+
+int main(void)
+{
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(rxWindow, NULL);
+    TEST_RUN(rxContinuous, NULL);
+    TEST_RUN(rxClassC, NULL);
+    TEST_RUN(rxClassCStop, NULL);
+
+    printf("test_radio_rx: %u byte downlink, DIO0 interrupt %llu us with %u SPI transactions of %u bytes, "
+           "RX done to the MAC in %llu us\n", DOWNLINK_SIZE, (unsigned long long)results->isrUs,
+           results->isrTransactions, results->isrBytes, (unsigned long long)results->latencyUs);
+
+    /* OPMODE read of the DIO dispatch, status burst, IRQ clear, FIFO
+     * pointer, FIFO burst, and the read and write of the sleep switch */
+    TEST_CHECK(ISR_TRANSACTIONS_MAX >= results->isrTransactions);
+    TEST_CHECK(results->latencyUs == results->isrUs);
+
+    return testDone("test_radio_rx");
+}
@@ -0,0 +1,198 @@
+/**
+* \file  test_radio_shadow.c
+*
+* \brief Host test of the register shadow of the radio HAL. A LoRa uplink,
+*        its RX1 window on the same channel with the IQ inverted and its RX2
+*        window at 869.525 MHz SF12 run on the SX1276 emulator. The SPI
+*        transactions of each step are counted for the first cycle after
+*        the init, for a second cycle and for a cycle after a radio reset.
+*        The second cycle must be cheaper and must not read back the
+*        registers it modifies, RX1 must not rewrite the frequency, and the
+*        emulated registers must hold the settings of each step, also after
+*        the reset.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "radio_fixture.h"
+#include "radio_driver_hal.h"
+#include "radio_registers_SX1276.h"
+
+#define UPLINK_SIZE             (23U)
+/* Symbols of the RX windows */
+#define RX_WINDOW_SYMBOLS       (8U)
+/* Time given to each step, the TCXO start up included */
+#define STEP_US                 (4U * RADIO_EMU_TCXO_US)
+#define FXOSC                   (32000000ULL)
+/* RegOpMode: LoRa receive single */
+#define OPMODE_LORA_RXSINGLE    (0x86)
+#define OPMODE_MODEM_AND_MODE   (0x87)
+#define INVERTIQ_RX             (1U << 6)
+
+int testFailures;
+
+typedef enum _Step
+{
+    STEP_UPLINK = 0,
+    STEP_RX1,
+    STEP_RX2,
+    STEPS
+} Step_t;
+
+typedef enum _Cycle
+{
+    CYCLE_COLD = 0,
+    CYCLE_WARM,
+    CYCLE_RESET,
+    CYCLES
+} Cycle_t;
+
+typedef struct _StepCost
+{
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t frfWrites;
+    uint32_t rmwReads;
+} StepCost_t;
+
+typedef struct _Results
+{
+    StepCost_t steps[CYCLES][STEPS];
+} Results_t;
+
+static Results_t *results;
+
+static const char *const stepNames[STEPS] = {"uplink", "RX1", "RX2"};
+static const char *const cycleNames[CYCLES] = {"first cycle", "next cycle", "after reset"};
+
+/* Registers Radio_WriteConfiguration() and the TX and RX handlers modify */
+static const uint8_t rmwRegs[] =
+{
+    REG_PARAMP, REG_OCP, REG_DIOMAPPING2, REG_PADAC,
+    REG_LORA_MODEMCONFIG3, REG_LORA_DETECTOPTIMIZE, REG_LORA_INVERTIQ
+};
+
+static StepCost_t stepCost(void)
+{
+    const RadioEmuStats_t *stats = radioEmuStats();
+    StepCost_t cost;
+
+    cost.transactions = stats->transactions;
+    cost.bytes = stats->bytes;
+    cost.frfWrites = stats->regWrites[REG_FRFMSB] + stats->regWrites[REG_FRFMID] + stats->regWrites[REG_FRFLSB];
+    cost.rmwReads = 0;
+    for (unsigned idx = 0; idx < sizeof(rmwRegs); idx++)
+    {
+        cost.rmwReads += stats->regReads[rmwRegs[idx]];
+    }
+    TEST_CHECK(0 == stats->spiErrors);
+    TEST_CHECK(0 == stats->unclockedModes);
+
+    return cost;
+}
+
+/* The emulated radio is set to the channel */
+static void checkChannel(uint32_t frequency, RadioDataRate_t sf, bool iqInverted)
+{
+    uint32_t frf = (uint32_t)(((uint64_t)frequency << 19) / FXOSC);
+
+    TEST_CHECK(((frf >> 16) & 0xFF) == radioEmuReg(REG_FRFMSB));
+    TEST_CHECK(((frf >> 8) & 0xFF) == radioEmuReg(REG_FRFMID));
+    TEST_CHECK((frf & 0xFF) == radioEmuReg(REG_FRFLSB));
+    TEST_CHECK(sf == (radioEmuReg(REG_LORA_MODEMCONFIG2) >> 4));
+    TEST_CHECK(iqInverted == (0 != (radioEmuReg(REG_LORA_INVERTIQ) & INVERTIQ_RX)));
+}
+
+static void uplink(StepCost_t *cost)
+{
+    uint8_t frame[UPLINK_SIZE];
+    uint8_t sent[UINT8_MAX];
+    uint8_t sentLength = 0;
+    RadioTransmitParam_t param = {UPLINK_SIZE, frame};
+
+    memset(frame, 0x5A, sizeof(frame));
+    radioFixtureLoRa(FIXTURE_FREQ_868100, SF_7, false);
+    radioEmuResetStats();
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&param));
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    checkChannel(FIXTURE_FREQ_868100, SF_7, false);
+    TEST_CHECK(radioEmuLoraTxDone(sent, &sentLength));
+    radioEmuRunTasks();
+    *cost = stepCost();
+    TEST_CHECK(UPLINK_SIZE == sentLength);
+}
+
+static void rxWindow(StepCost_t *cost, uint32_t frequency, RadioDataRate_t sf)
+{
+    RadioReceiveParam_t param = {RECEIVE_START, RX_WINDOW_SYMBOLS};
+
+    radioFixtureLoRa(frequency, sf, true);
+    radioEmuResetStats();
+    TEST_CHECK(ERR_NONE == RADIO_Receive(&param));
+    radioEmuRunUntil(radioEmuTime() + STEP_US);
+    TEST_CHECK(OPMODE_LORA_RXSINGLE == (radioEmuOpMode() & OPMODE_MODEM_AND_MODE));
+    checkChannel(frequency, sf, true);
+    TEST_CHECK(radioEmuLoraRxTimeout());
+    radioEmuRunTasks();
+    *cost = stepCost();
+}
+
+static void runCycle(Cycle_t cycle)
+{
+    uint8_t events = radioFixtureEventCount;
+
+    uplink(&results->steps[cycle][STEP_UPLINK]);
+    rxWindow(&results->steps[cycle][STEP_RX1], FIXTURE_FREQ_868100, SF_7);
+    rxWindow(&results->steps[cycle][STEP_RX2], FIXTURE_FREQ_869525, SF_12);
+
+    TEST_CHECK((events + 3) == radioFixtureEventCount);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[events].id);
+    TEST_CHECK(RADIO_RX_TIMEOUT_CALLBACK == radioFixtureEvents[events + 1].id);
+    TEST_CHECK(RADIO_RX_TIMEOUT_CALLBACK == radioFixtureEvents[events + 2].id);
+    radioFixtureEventCount = 0;
+}
+
+static void cycles(void *arg)
+{
+    (void)arg;
+    radioFixtureBoot();
+    runCycle(CYCLE_COLD);
+    runCycle(CYCLE_WARM);
+
+    /* The chip forgets its registers, the shadow must forget them too */
+    RADIO_Reset();
+    runCycle(CYCLE_RESET);
+}
+
+int main(void)
+{
+    StepCost_t total[CYCLES];
+
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(cycles, NULL);
+
+    memset(total, 0, sizeof(total));
+    for (unsigned cycle = 0; cycle < CYCLES; cycle++)
+    {
+        for (unsigned step = 0; step < STEPS; step++)
+        {
+            const StepCost_t *cost = &results->steps[cycle][step];
+
+            printf("test_radio_shadow: %-11s %-6s %3u transactions, %4u bytes, %u FRF writes, "
+                   "%2u read-modify-write reads\n", cycleNames[cycle], stepNames[step], cost->transactions,
+                   cost->bytes, cost->frfWrites, cost->rmwReads);
+            total[cycle].transactions += cost->transactions;
+            total[cycle].rmwReads += cost->rmwReads;
+        }
+    }
+
+    TEST_CHECK(total[CYCLE_WARM].transactions < total[CYCLE_COLD].transactions);
+    TEST_CHECK(total[CYCLE_WARM].transactions < total[CYCLE_RESET].transactions);
+    TEST_CHECK(0 == total[CYCLE_WARM].rmwReads);
+    TEST_CHECK(0 == results->steps[CYCLE_WARM][STEP_RX1].frfWrites);
+    TEST_CHECK(0 != results->steps[CYCLE_WARM][STEP_RX2].frfWrites);
+
+    return testDone("test_radio_shadow");
+}
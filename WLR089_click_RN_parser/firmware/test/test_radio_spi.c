@@ -0,0 +1,150 @@
+/**
+* \file  test_radio_spi.c
+*
+* \brief Host test of the SPI transfers of the radio FIFO. The SX1276
+*        emulator sits behind the SERCOM4 registers and counts the CS
+*        assertions, the calls of the SPI library and the bytes clocked. A
+*        full 255 byte FIFO write or read must be one transaction of 256
+*        bytes with a single library call for the address, and a LoRa
+*        uplink must load its payload in one FIFO transaction.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "radio_fixture.h"
+#include "radio_driver_hal.h"
+#include "radio_registers_SX1276.h"
+
+#define FRAME_SIZE              (UINT8_MAX)
+#define UPLINK_SIZE             (51U)
+/* Address byte of the FIFO */
+#define ADDRESS_BYTES           (1U)
+/* RegOpMode: LoRa standby */
+#define OPMODE_LORA_STANDBY     (0x81)
+
+int testFailures;
+
+typedef struct _Transfer
+{
+    uint32_t transactions;
+    uint32_t fifoTransactions;
+    uint32_t plibTransfers;
+    uint32_t bytes;
+    uint64_t us;
+} Transfer_t;
+
+typedef struct _Results
+{
+    Transfer_t write;
+    Transfer_t read;
+    Transfer_t uplink;
+} Results_t;
+
+static Results_t *results;
+
+static void fillFrame(uint8_t *frame, uint8_t length, uint8_t seed)
+{
+    for (uint8_t idx = 0; idx < length; idx++)
+    {
+        frame[idx] = (uint8_t)(seed + (idx * 7U));
+    }
+}
+
+static void snapshot(Transfer_t *transfer, uint64_t start)
+{
+    const RadioEmuStats_t *stats = radioEmuStats();
+
+    transfer->transactions = stats->transactions;
+    transfer->fifoTransactions = stats->fifoTransactions;
+    transfer->plibTransfers = stats->plibTransfers;
+    transfer->bytes = stats->bytes;
+    transfer->us = radioEmuTime() - start;
+    TEST_CHECK(0 == stats->spiErrors);
+}
+
+static void frameBurst(void *arg)
+{
+    uint8_t frame[FRAME_SIZE];
+    uint8_t readBack[FRAME_SIZE];
+    uint64_t start;
+
+    (void)arg;
+    radioFixtureBoot();
+    RADIO_RegisterWrite(REG_OPMODE, OPMODE_LORA_STANDBY);
+    fillFrame(frame, FRAME_SIZE, 3);
+
+    RADIO_RegisterWrite(REG_LORA_FIFOADDRPTR, 0);
+    radioEmuResetStats();
+    start = radioEmuTime();
+    RADIO_FrameWrite(REG_FIFO, frame, FRAME_SIZE);
+    snapshot(&results->write, start);
+
+    RADIO_RegisterWrite(REG_LORA_FIFOADDRPTR, 0);
+    radioEmuResetStats();
+    start = radioEmuTime();
+    memset(readBack, 0, sizeof(readBack));
+    RADIO_FrameRead(REG_FIFO, readBack, FRAME_SIZE);
+    snapshot(&results->read, start);
+
+    TEST_CHECK(0 == memcmp(frame, readBack, FRAME_SIZE));
+    TEST_CHECK(FRAME_SIZE == radioEmuStats()->regReads[REG_FIFO]);
+}
+
+static void loraUplink(void *arg)
+{
+    uint8_t frame[UPLINK_SIZE];
+    uint8_t sent[FRAME_SIZE];
+    uint8_t sentLength = 0;
+    RadioTransmitParam_t param = {UPLINK_SIZE, frame};
+    uint64_t start;
+
+    (void)arg;
+    radioFixtureBoot();
+    radioFixtureLoRa(FIXTURE_FREQ_868100, SF_7, false);
+    fillFrame(frame, UPLINK_SIZE, 11);
+
+    radioEmuResetStats();
+    start = radioEmuTime();
+    TEST_CHECK(ERR_NONE == RADIO_Transmit(&param));
+    /* The TX task waits for the TCXO, then loads the FIFO */
+    radioEmuRunUntil(start + (2 * RADIO_EMU_TCXO_US));
+    snapshot(&results->uplink, start);
+    TEST_CHECK(0 == radioEmuStats()->unclockedModes);
+
+    TEST_CHECK(radioEmuLoraTxDone(sent, &sentLength));
+    TEST_CHECK(UPLINK_SIZE == sentLength);
+    TEST_CHECK(0 == memcmp(frame, sent, UPLINK_SIZE));
+    radioEmuRunTasks();
+    TEST_CHECK(1 == radioFixtureEventCount);
+    TEST_CHECK(RADIO_TX_DONE_CALLBACK == radioFixtureEvents[0].id);
+    TEST_CHECK(ERR_NONE == radioFixtureEvents[0].status);
+}
+
+static void printTransfer(const char *name, const Transfer_t *transfer)
+{
+    printf("test_radio_spi: %-18s %3u transactions, %u on the FIFO, %3u library calls, %4u bytes\n",
+        name, transfer->transactions, transfer->fifoTransactions, transfer->plibTransfers, transfer->bytes);
+}
+
+int main(void)
+{
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(frameBurst, NULL);
+    TEST_RUN(loraUplink, NULL);
+
+    printTransfer("255 byte FIFO write", &results->write);
+    printTransfer("255 byte FIFO read", &results->read);
+    printTransfer("51 byte LoRa uplink", &results->uplink);
+
+    TEST_CHECK(1 == results->write.transactions);
+    TEST_CHECK(1 == results->write.plibTransfers);
+    TEST_CHECK((ADDRESS_BYTES + FRAME_SIZE) == results->write.bytes);
+    TEST_CHECK(1 == results->read.transactions);
+    TEST_CHECK(1 == results->read.plibTransfers);
+    TEST_CHECK((ADDRESS_BYTES + FRAME_SIZE) == results->read.bytes);
+    TEST_CHECK(1 == results->uplink.fifoTransactions);
+
+    return testDone("test_radio_spi");
+}
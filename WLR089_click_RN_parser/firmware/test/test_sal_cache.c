@@ -0,0 +1,241 @@
+/**
+* \file  test_sal_cache.c
+*
+* \brief Host simulation of the session keys cached by the SAL, with the
+*        keys in the ATECC608, over the radio and ATECC608 emulators. Once
+*        joined, uplinks and downlinks must not send anything to the
+*        ATECC608: no I2C transfer, and LORAWAN_GetUplinkDeviceCommandCount
+*        and SAL_GetDeviceCommandCount must not count a command. PMM_Sleep,
+*        LORAWAN_Reset and a new LORAWAN_Join must zeroise the cache: the
+*        session keys must not be found anywhere in the static RAM but in
+*        the MAC state and the slots of the emulator, and the next read of
+*        a key must go to the ATECC608 again.
+*/
+#include <string.h>
+#include <sys/mman.h>
+#include "test_common.h"
+#include "radio_emu.h"
+#include "ecc608_emu.h"
+#include "lorawan_fixture.h"
+#include "lorawan_private.h"
+#include "conf_sal.h"
+#include "sal.h"
+#include "pmm.h"
+
+#define UPLINKS                 (3U)
+/* The uplink the network answers */
+#define DOWNLINK_UPLINK         (1U)
+#define FRAME_PORT              (2U)
+#define SLEEP_TIME_MS           (10000U)
+#define SLEEP_RETRY_US          (100000U)
+#define SLEEP_RETRY_LIMIT_US    (10000000U)
+/* Random, Write, Random, Read (serial number), Nonce, GenDig and Read */
+#define KEY_READ_COMMANDS       (7U)
+
+int testFailures;
+
+extern LoRa_t loRa;
+
+/* Static RAM of the test, .data and .bss */
+extern char __data_start[];
+extern char _end[];
+
+typedef enum _Clear
+{
+    CLEAR_SLEEP = 0,
+    CLEAR_RESET,
+    CLEAR_REJOIN,
+    CLEARS
+} Clear_t;
+
+static const char *const clearNames[CLEARS] = {"PMM_Sleep", "LORAWAN_Reset", "LORAWAN_Join"};
+
+typedef struct _FramesResult
+{
+    bool joined;
+    uint8_t uplinks;
+    uint8_t downlinks;
+    bool downlinkData;
+    uint32_t transfers;
+    uint32_t salCommands;
+    uint32_t maxUplinkCommands;
+} FramesResult_t;
+
+typedef struct _ClearResult
+{
+    bool joined;
+    bool cleared;
+    /* Session keys found in the static RAM before and after */
+    uint8_t keysBefore;
+    uint8_t keysAfter;
+    /* The next read of the NwkSKey */
+    uint32_t readCommands;
+    uint32_t readSalCommands;
+    bool readKey;
+} ClearResult_t;
+
+typedef struct _Results
+{
+    FramesResult_t frames;
+    ClearResult_t clears[CLEARS];
+} Results_t;
+
+static Results_t *results;
+
+static bool inRange(const char *address, const void *start, size_t size)
+{
+    return (address >= (const char *)start) && (address < ((const char *)start + size));
+}
+
+/* Whether key is found in the static RAM outside the MAC state and the
+ * slots of the emulator */
+static bool keyInRam(const uint8_t *key)
+{
+    const uint8_t *slots = eccEmuSlot(0);
+
+    for (const char *address = __data_start; (address + FIXTURE_KEY_SIZE) <= _end; address++)
+    {
+        if (inRange(address, &loRa, sizeof(loRa)) || inRange(address, slots, ECC_EMU_SLOTS * ECC_EMU_SLOT_SIZE))
+        {
+            continue;
+        }
+        if (0 == memcmp(address, key, FIXTURE_KEY_SIZE))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint8_t keysInRam(const LorawanFixtureJoin_t *join)
+{
+    return (uint8_t)(keyInRam(join->nwkSKey) + keyInRam(join->appSKey));
+}
+
+static void joinNetwork(LorawanFixtureJoin_t *join)
+{
+    lorawanFixtureBoot();
+    join->joinNonce = 0x000101;
+    join->netId = 0x000013;
+    join->devAddr = 0x260B1234UL;
+}
+
+static void runFrames(void *arg)
+{
+    FramesResult_t *result = &results->frames;
+    LorawanFixtureJoin_t join = {0};
+    static const uint8_t uplink[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+    static const uint8_t downlinkPayload[] = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5};
+    uint8_t downlink[FIXTURE_FRAME_MAX];
+    uint8_t downlinkLength;
+    uint32_t salCommands;
+
+    (void)arg;
+    joinNetwork(&join);
+    result->joined = lorawanFixtureJoin(&join);
+    downlinkLength = lorawanFixtureDownlink(&join, 0, FRAME_PORT, downlinkPayload, sizeof(downlinkPayload), downlink);
+
+    eccEmuResetStats();
+    salCommands = SAL_GetDeviceCommandCount();
+    for (uint8_t i = 0; result->joined && (i < UPLINKS); i++)
+    {
+        bool answered = (DOWNLINK_UPLINK == i);
+
+        if (!lorawanFixtureUplink(&join, FRAME_PORT, uplink, sizeof(uplink), answered ? downlink : NULL,
+            answered ? downlinkLength : 0))
+        {
+            break;
+        }
+        result->uplinks++;
+        if (LORAWAN_GetUplinkDeviceCommandCount() > result->maxUplinkCommands)
+        {
+            result->maxUplinkCommands = LORAWAN_GetUplinkDeviceCommandCount();
+        }
+    }
+    result->downlinks = lorawanFixtureReport.rxFrames;
+    /* Handed over after its FPort */
+    result->downlinkData = ((1 + sizeof(downlinkPayload)) == lorawanFixtureReport.rxLength) &&
+        (FRAME_PORT == lorawanFixtureReport.rxData[0]) &&
+        (0 == memcmp(&lorawanFixtureReport.rxData[1], downlinkPayload, sizeof(downlinkPayload)));
+    result->transfers = eccEmuStats()->transfers;
+    result->salCommands = SAL_GetDeviceCommandCount() - salCommands;
+}
+
+static void runClear(void *arg)
+{
+    Clear_t clear = (Clear_t)(uintptr_t)arg;
+    ClearResult_t *result = &results->clears[clear];
+    LorawanFixtureJoin_t join = {0};
+    PMM_SleepReq_t sleepReq = {SLEEP_TIME_MS, SLEEP_MODE_STANDBY, NULL};
+    uint8_t key[FIXTURE_KEY_SIZE];
+    uint32_t salCommands;
+    uint64_t limit;
+
+    joinNetwork(&join);
+    result->joined = lorawanFixtureJoin(&join);
+    result->keysBefore = keysInRam(&join);
+
+    switch (clear)
+    {
+    case CLEAR_SLEEP:
+        /* As the application does, until no timer of the MAC expires
+         * within PMM_SLEEPTIME_MIN_MS */
+        limit = radioEmuTime() + SLEEP_RETRY_LIMIT_US;
+        while (!result->cleared && (radioEmuTime() < limit))
+        {
+            radioEmuRunUntil(radioEmuTime() + SLEEP_RETRY_US);
+            result->cleared = (PMM_SLEEP_REQ_PROCESSED == PMM_Sleep(&sleepReq));
+        }
+        break;
+    case CLEAR_RESET:
+        result->cleared = (LORAWAN_SUCCESS == LORAWAN_Reset(ISM_EU868));
+        break;
+    default:
+        result->cleared = (LORAWAN_SUCCESS == LORAWAN_Join(LORAWAN_OTAA));
+        break;
+    }
+    result->keysAfter = keysInRam(&join);
+
+    eccEmuResetStats();
+    salCommands = SAL_GetDeviceCommandCount();
+    result->readKey = (SAL_SUCCESS == SAL_Read(SAL_NWKS_KEY, key)) && (0 == memcmp(key, join.nwkSKey, sizeof(key)));
+    result->readCommands = eccEmuStats()->commands;
+    result->readSalCommands = SAL_GetDeviceCommandCount() - salCommands;
+    memset(key, 0, sizeof(key));
+}
+
+int main(void)
+{
+    const FramesResult_t *frames;
+
+    results = mmap(NULL, sizeof(Results_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    TEST_RUN(runFrames, NULL);
+    frames = &results->frames;
+    printf("test_sal_cache: %u uplinks, %u downlink, %u ECC608 transfers, %u commands, at most %u per uplink\n",
+        frames->uplinks, frames->downlinks, frames->transfers, frames->salCommands, frames->maxUplinkCommands);
+    TEST_CHECK(frames->joined);
+    TEST_CHECK(UPLINKS == frames->uplinks);
+    TEST_CHECK((1 == frames->downlinks) && frames->downlinkData);
+    TEST_CHECK(0 == frames->transfers);
+    TEST_CHECK(0 == frames->salCommands);
+    TEST_CHECK(0 == frames->maxUplinkCommands);
+
+    for (uintptr_t clear = 0; clear < CLEARS; clear++)
+    {
+        const ClearResult_t *result = &results->clears[clear];
+
+        TEST_RUN(runClear, (void *)clear);
+        printf("test_sal_cache: %-13s %u session keys in RAM before, %u after, next read %u ECC608 commands\n",
+            clearNames[clear], result->keysBefore, result->keysAfter, result->readCommands);
+        TEST_CHECK(result->joined && result->cleared);
+        /* Both of them cached by the join */
+        TEST_CHECK(2 == result->keysBefore);
+        TEST_CHECK(0 == result->keysAfter);
+        TEST_CHECK(result->readKey);
+        TEST_CHECK(KEY_READ_COMMANDS == result->readCommands);
+        TEST_CHECK(KEY_READ_COMMANDS == result->readSalCommands);
+    }
+
+    return testDone("test_sal_cache");
+}
@@ -0,0 +1,131 @@
+/**
+* \file  test_toa.c
+*
+* \brief Host test of the integer time on air computation of the MAC. The
+*        result of calcPacketTimeOnAir() must be the exact value of the
+*        SX1276 data sheet formula for every spreading factor, bandwidth,
+*        coding rate, header mode, CRC setting and payload length.
+*
+*        calcPacketTimeOnAir() is static in lorawan.c, which does not build
+*        on the host. The Makefile extracts it, with the chip time table it
+*        uses, into lorawan_toa.inc.
+*/
+#include <math.h>
+#include "test_common.h"
+#include "sw_timer.h"
+#include "lorawan.h"
+#include "lorawan_reg_params.h"
+#include "radio_interface.h"
+
+int testFailures;
+
+/* Radio parameters returned for any data rate */
+static RadioDataRate_t testSf;
+static RadioLoRaBandWidth_t testBw;
+static RadioModulation_t testModulation;
+
+StackRetStatus_t LORAREG_GetAttr(LorawanRegionalAttributes_t attrType, void *attrInput, void *attrOutput)
+{
+    (void)attrInput;
+    switch (attrType)
+    {
+        case SPREADING_FACTOR_ATTR:
+            *(RadioDataRate_t *)attrOutput = testSf;
+            break;
+        case MODULATION_ATTR:
+            *(RadioModulation_t *)attrOutput = testModulation;
+            break;
+        case BANDWIDTH_ATTR:
+            *(RadioLoRaBandWidth_t *)attrOutput = testBw;
+            break;
+        default:
+            return LORAWAN_INVALID_PARAMETER;
+    }
+    return LORAWAN_SUCCESS;
+}
+
+#include "lorawan_toa.inc"
+
+/* Time on air in us from the data sheet formula, in floating point */
+static double referenceTimeOnAir(unsigned sf, double bwHz, unsigned preambleLen,
+    unsigned impHdrMode, unsigned crcOn, unsigned cr, unsigned length)
+{
+    double ts = ldexp(1.0, (int)sf) / bwHz;
+    unsigned de = (ts > 16e-3) ? 1 : 0;
+    double np = ceil((8.0 * length - 4.0 * sf + 28 + 16.0 * crcOn - 20.0 * impHdrMode) / (4.0 * (sf - 2 * de)));
+
+    np = 8 + fmax(np, 0) * (cr + 4);
+    return (preambleLen + 4.25 + np) * ts * 1e6;
+}
+
+/* Known values of the Semtech LoRa calculator */
+static void checkKnownValues(void *arg)
+{
+    (void)arg;
+    testModulation = MODULATION_LORA;
+
+    testSf = SF_7;
+    testBw = BW_125KHZ;
+    TEST_CHECK(46336 == calcPacketTimeOnAir(0, 8, 0, 1, CR_4_5, 13));
+    TEST_CHECK(46336 == lround(referenceTimeOnAir(7, 125e3, 8, 0, 1, 1, 13)));
+
+    testSf = SF_12;
+    TEST_CHECK(2465792 == calcPacketTimeOnAir(0, 8, 0, 1, CR_4_5, 51));
+    TEST_CHECK(2465792 == lround(referenceTimeOnAir(12, 125e3, 8, 0, 1, 1, 51)));
+}
+
+/* Every LoRa configuration and payload length */
+static void checkExhaustive(void *arg)
+{
+    static const RadioLoRaBandWidth_t bws[] = {BW_125KHZ, BW_250KHZ, BW_500KHZ};
+    static const double bwHz[] = {125e3, 250e3, 500e3};
+    static const uint8_t preambleLens[] = {6, 8, 12};
+    unsigned checked = 0;
+
+    (void)arg;
+    testModulation = MODULATION_LORA;
+
+    for (unsigned sf = SF_7; sf <= SF_12; sf++)
+    {
+        testSf = (RadioDataRate_t)sf;
+        for (unsigned bw = 0; bw < sizeof(bws) / sizeof(bws[0]); bw++)
+        {
+            testBw = bws[bw];
+            for (unsigned p = 0; p < sizeof(preambleLens); p++)
+            {
+                for (unsigned cr = CR_4_5; cr <= CR_4_8; cr++)
+                {
+                    for (unsigned impHdr = 0; impHdr <= 1; impHdr++)
+                    {
+                        for (unsigned crcOn = 0; crcOn <= 1; crcOn++)
+                        {
+                            for (unsigned length = 0; length <= UINT8_MAX; length++)
+                            {
+                                double ref = referenceTimeOnAir(sf, bwHz[bw], preambleLens[p], impHdr, crcOn, cr, length);
+                                uint32_t toa = calcPacketTimeOnAir(0, preambleLens[p], impHdr, crcOn, cr, length);
+
+                                /* The exact value is a whole number of us */
+                                if (fabs(ref - toa) > 1e-6)
+                                {
+                                    testFailures++;
+                                    fprintf(stderr, "SF%u BW%u preamble %u CR4/%u implicit %u CRC %u length %u: %u us, expected %.3f us\n",
+                                        sf, (unsigned)(bwHz[bw] / 1000), preambleLens[p], cr + 4, impHdr, crcOn, length, toa, ref);
+                                }
+                                checked++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+    TEST_CHECK((6 * 3 * 3 * 4 * 2 * 2 * 256) == checked);
+}
+
+int main(void)
+{
+    TEST_RUN(checkKnownValues, NULL);
+    TEST_RUN(checkExhaustive, NULL);
+
+    return testDone("test_toa");
+}
@@ -118,6 +118,7 @@ static const parserCmdEntry_t maParserLoraGetCmd[] ={
 	{"joineui", NULL, Parser_LoraGetJoinEui, 0, 0},
 	{"lastchid", NULL, Parser_LoraGetMacLastChId, 0, 0},
 	{"lbt", NULL, Parser_LoraGetLbt, 0, 0},
+	{"linkstats", NULL, Parser_LoraGetLinkStats, 0, 0},
 	{"mcastdevaddr", NULL, Parser_LoraGetMcastDevAddr, 0, 1},
 	{"mcastdnctr", NULL, Parser_LoraGetMcastDownCounter, 0, 1},
 	{"mcastdr", NULL, Parser_LoraGetMcastDr, 0, 1},
@@ -135,6 +136,7 @@ static const parserCmdEntry_t maParserLoraGetCmd[] ={
 	{"status", NULL, Parser_LoraGetMacStatus, 0, 0},
 	{"subband", maParserLoraGetSubBandCmd, NULL, mParserLoraGetSubBandCmdSize, 0},
 	{"sync", NULL, Parser_LoraGetSyncWord, 0, 0},
+	{"toa", NULL, Parser_LoraGetTimeOnAir, 0, 1},
 	{"uncnfretrycnt", NULL, Parser_LoraGetMacUncnfRetryCnt, 0, 0},
 	{"upctr", NULL, Parser_LoraGetUplinkCounter, 0, 0}
 };
@@ -155,6 +157,7 @@ const parserCmdEntry_t maParserLoraCmd[] = {
 #define mParserLoraCmdSize  (sizeof(maParserLoraCmd) / sizeof(maParserLoraCmd[0]))
 
 static const parserCmdEntry_t maParserSysGetCmd[] ={
+	{"pdsstats", NULL, Parser_SystemGetPdsStats, 0, 0},
 	{"ver", NULL, Parser_SystemGetVer, 0, 0}
 };
 #define mParserSysGetCmdSize (sizeof(maParserSysGetCmd) / sizeof(maParserSysGetCmd[0]))
@@ -37,6 +37,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "parser_utils.h"
 #include "lorawan.h"
 #include "sys.h"
+#include "radio_link_stats.h"
 #if(ENABLE_PDS == 1)
 #include "pds_interface.h"
 #endif
@@ -258,20 +259,25 @@ void Parser_LoraReset(parserCmdInfo_t* pParserCmdInfo)
 				PDS_RestoreAll();
 				LORAWAN_GetAttr(ISMBAND, NULL, &prevBand);
 				if (prevBand != iCount) {
-					PDS_DeleteAll();
 					isSwitchReq = true;
 				}
 				status = LORAWAN_Reset(iCount);
 
 				if (isSwitchReq == true && status == LORAWAN_SUCCESS) {
-					PDS_StoreAll();
+					/* The files of the new band replace the stored ones at once */
+					if ((PDS_OK != PDS_StoreAll()) || (PDS_OK != PDS_Commit(true))) {
+						status = LORAWAN_RESOURCE_UNAVAILABLE;
+					}
 				} else {
 					PDS_RestoreAll();
 				}
 			} else {
 				status = LORAWAN_Reset(iCount);
 				if (status == LORAWAN_SUCCESS) {
-					PDS_StoreAll();
+					/* The host is told when the new band could not be stored */
+					if ((PDS_OK != PDS_StoreAll()) || (PDS_OK != PDS_Commit(true))) {
+						status = LORAWAN_RESOURCE_UNAVAILABLE;
+					}
 				}
 			}
 #else
@@ -1748,6 +1754,74 @@ void Parser_LoraGetMacNextPayloadSize(parserCmdInfo_t* pParserCmdInfo)
 	pParserCmdInfo->pReplyCmd = aParserData;
 }
 
+/* Longest "<key>:<rx>,<crc>,<timeouts>,<rssi>,<snr p10>,<snr p50>,<snr p90> " entry */
+#define PARSER_LINK_STATS_ENTRY_LEN		48U
+
+static uint16_t Parser_PrintLinkStats(uint16_t dataLen, RadioLinkStats_t *stats)
+{
+	/* Without a received frame there is no RSSI nor SNR to report */
+	if (RADIO_LINK_STATS_SNR_NONE == RADIO_GetLinkStatsSnrPercentile(stats, 50U)) {
+		dataLen += sprintf(&aParserData[dataLen], ":%u,%u,%u,-,-,-,- ",
+			stats->rxCount, stats->crcErrorCount, stats->rxTimeoutCount);
+		return dataLen;
+	}
+
+	dataLen += sprintf(&aParserData[dataLen], ":%u,%u,%u,%d,%d,%d,%d ",
+		stats->rxCount, stats->crcErrorCount, stats->rxTimeoutCount, stats->rssiAverage / 16,
+		RADIO_GetLinkStatsSnrPercentile(stats, 10U), RADIO_GetLinkStatsSnrPercentile(stats, 50U),
+		RADIO_GetLinkStatsSnrPercentile(stats, 90U));
+
+	return dataLen;
+}
+
+void Parser_LoraGetLinkStats(parserCmdInfo_t* pParserCmdInfo)
+{
+	uint16_t dataLen = 0;
+	uint8_t index;
+	uint32_t frequency;
+	RadioDataRate_t sf;
+	RadioLoRaBandWidth_t bw;
+	RadioLinkStats_t stats;
+
+	/* Reply: the used channels, then the used spreading factors and bandwidths */
+	for (index = 0; index < RADIO_LINK_STATS_CHANNELS; index++) {
+		if ((dataLen + PARSER_LINK_STATS_ENTRY_LEN < PARSER_MAX_DATA_LEN) &&
+			RADIO_GetChannelLinkStats(index, &frequency, &stats)) {
+			ultoa(&aParserData[dataLen], frequency, 10U);
+			dataLen = strlen(aParserData);
+			dataLen = Parser_PrintLinkStats(dataLen, &stats);
+		}
+	}
+	for (index = 0; index < RADIO_LINK_STATS_RATES; index++) {
+		if ((dataLen + PARSER_LINK_STATS_ENTRY_LEN < PARSER_MAX_DATA_LEN) &&
+			RADIO_GetRateLinkStats(index, &sf, &bw, &stats)) {
+			dataLen += sprintf(&aParserData[dataLen], "sf%ubw%u", sf, 125U << (bw - BW_125KHZ));
+			dataLen = Parser_PrintLinkStats(dataLen, &stats);
+		}
+	}
+
+	if (0U == dataLen) {
+		pParserCmdInfo->pReplyCmd = (char*) gapParserLorawanStatus[LORAWAN_RADIO_NO_DATA];
+	} else {
+		/* Drop the trailing separator */
+		aParserData[dataLen - 1U] = '\0';
+		pParserCmdInfo->pReplyCmd = aParserData;
+	}
+}
+
+void Parser_LoraGetTimeOnAir(parserCmdInfo_t* pParserCmdInfo)
+{
+	uint8_t length;
+
+	if (Validate_UintDecAsciiValue(pParserCmdInfo->pParam1, 3, UINT8_MAX)) {
+		length = (uint8_t) strtoul(pParserCmdInfo->pParam1, NULL, 10);
+		ultoa(aParserData, LORAWAN_GetTimeOnAir(length), 10U);
+		pParserCmdInfo->pReplyCmd = aParserData;
+	} else {
+		pParserCmdInfo->pReplyCmd = (char*) gapParserLorawanStatus[LORAWAN_INVALID_PARAMETER];
+	}
+}
+
 void Parser_LoraGetJoindutycycleremaining(parserCmdInfo_t* pParserCmdInfo)
 {
 	uint32_t remainingtime;
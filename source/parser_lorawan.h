@@ -70,6 +70,7 @@ void Parser_LoraGetJoindutycycleremaining(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetLbt(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetLinkCheckGwCnt(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetLinkCheckMargin(parserCmdInfo_t* pParserCmdInfo);
+void Parser_LoraGetLinkStats(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetMacCnfRetryCnt(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetMacDlAckReqd(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetMacLastChId(parserCmdInfo_t* pParserCmdInfo);
@@ -91,6 +92,7 @@ void Parser_LoraGetRxDelay2(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetSubBandStatus(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetSupportedEdClass(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetSyncWord(parserCmdInfo_t* pParserCmdInfo);
+void Parser_LoraGetTimeOnAir(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetTxPower(parserCmdInfo_t* pParserCmdInfo);
 void Parser_LoraGetUplinkCounter(parserCmdInfo_t* pParserCmdInfo);
 
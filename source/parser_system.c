@@ -40,9 +40,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #ifdef CONF_PMM_ENABLE
 #include "pmm.h"
 #endif
-#if (ENABLE_PDS == 1)
 #include "pds_interface.h"
-#endif
 #include "lorawan.h"
 #include "radio_driver_hal.h"
 
@@ -76,6 +74,29 @@ void Parser_SystemGetVer(parserCmdInfo_t* pParserCmdInfo)
 	pParserCmdInfo->pReplyCmd = aParserData;
 }
 
+void Parser_SystemGetPdsStats(parserCmdInfo_t* pParserCmdInfo)
+{
+	uint8_t dataLen;
+	PdsStats_t stats;
+
+	/* Reply: <pending> <dirty> <flushes> <stores> <errors> */
+	PDS_GetStats(&stats);
+	ultoa(aParserData, stats.pending, 10U);
+	dataLen = strlen(aParserData);
+	aParserData[dataLen++] = ' ';
+	ultoa(&aParserData[dataLen], stats.dirty, 10U);
+	dataLen = strlen(aParserData);
+	aParserData[dataLen++] = ' ';
+	ultoa(&aParserData[dataLen], stats.flushes, 10U);
+	dataLen = strlen(aParserData);
+	aParserData[dataLen++] = ' ';
+	ultoa(&aParserData[dataLen], stats.stores, 10U);
+	dataLen = strlen(aParserData);
+	aParserData[dataLen++] = ' ';
+	ultoa(&aParserData[dataLen], stats.errors, 10U);
+	pParserCmdInfo->pReplyCmd = aParserData;
+}
+
 void Parser_SystemReboot(parserCmdInfo_t* pParserCmdInfo)
 {
 	// Go for reboot, no reply necessary
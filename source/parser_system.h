@@ -33,6 +33,7 @@ SUBSTITUTE GOODS, TECHNOLOGY, SERVICES, OR ANY CLAIMS BY THIRD PARTIES
 #include "parser_private.h"
 
 void Parser_SystemGetVer(parserCmdInfo_t* pParserCmdInfo);
+void Parser_SystemGetPdsStats(parserCmdInfo_t* pParserCmdInfo);
 void Parser_SystemReboot(parserCmdInfo_t* pParserCmdInfo);
 #ifdef CONF_PMM_ENABLE
 void Parser_SystemSleep(parserCmdInfo_t* pParserCmdInfo);